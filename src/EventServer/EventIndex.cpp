@@ -0,0 +1,181 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "EventCache.h"
+#include "EventIndex.h"
+#include "Utilities.h"
+
+// OS includes
+#include <TypeConstants.h>
+
+
+
+/*!	\brief		Read a single 32-bit attribute.
+ *		\returns		\c true if the attribute was read successfully.
+ */
+static bool		ReadUint32Attr( BNode& node, const char* name, uint32* out )
+{
+	return ( node.ReadAttr( name, B_UINT32_TYPE, 0, out, sizeof( uint32 ) ) == sizeof( uint32 ) );
+}	// <-- end of function ReadUint32Attr
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class EventIndex
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - the index starts empty.
+ */
+EventIndex::EventIndex()
+	:
+	fCache( NULL )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+EventIndex::~EventIndex()
+{
+	MakeEmpty();
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Read the attributes of the Event file that matter for scheduling.
+ *		\param[in]	ref		The Event file.
+ *		\param[out]	out		The record to be filled.
+ *		\returns		B_OK if the file could be read.
+ */
+status_t		EventIndex::ReadRecord( const entry_ref& ref, EventIndexRecord* out )
+{
+	BNode		node;
+	uint32	tempUint32 = 0;
+	int64		tempInt64 = 0;
+	status_t	status;
+
+	if ( !out ) { return B_BAD_VALUE; }
+
+	if ( ( status = node.SetTo( &ref ) ) != B_OK ||
+		  ( status = node.GetNodeRef( &out->node ) ) != B_OK )
+	{
+		return status;
+	}
+	out->ref = ref;
+	out->eventFire = NULL;
+	out->reminderFire = NULL;
+
+	// Missing deadlines mean there's nothing to schedule
+	out->nextOccurrence = ( utl_ReadTimeAttr( &node, "EVNT:next_occurrence", &tempInt64 ) == B_OK ) ? ( time_t )tempInt64 : 0;
+	out->nextReminder = ( utl_ReadTimeAttr( &node, "EVNT:next_reminder", &tempInt64 ) == B_OK ) ? ( time_t )tempInt64 : 0;
+
+	// Missing flags mean the activities were already fired
+	out->bActivityFired = ( !ReadUint32Attr( node, "EVNT:activity_fired", &tempUint32 ) || tempUint32 != 0 );
+	out->bReminderFired = ( !ReadUint32Attr( node, "EVNT:reminder_fired", &tempUint32 ) || tempUint32 != 0 );
+	out->bReminderEnabled = ( utl_ReadTimeAttr( &node, "EVNT:reminder_offset", &tempInt64 ) == B_OK && tempInt64 != 0 );
+
+	return B_OK;
+}	// <-- end of function EventIndex::ReadRecord
+
+
+
+/*!	\brief		Add a file to the index, or re-read it if it's already there.
+ *		\details		The handles of the scheduled fires are kept. If the index has a
+ *						cache, the record is taken from it when the file didn't change.
+ *		\param[in]	ref		The Event file.
+ *		\param[out]	oldOut	If not \c NULL, receives the previous record. If the file
+ *									was not indexed, its node is set to an invalid value.
+ *		\param[out]	newOut	If not \c NULL, receives the new record.
+ *		\returns		B_OK if the file was read and indexed.
+ */
+status_t		EventIndex::Update( const entry_ref& ref,
+										  EventIndexRecord* oldOut,
+										  EventIndexRecord* newOut )
+{
+	EventIndexRecord	record;
+	EventCacheRecord	cached;
+	status_t				status;
+
+	if ( fCache && fCache->Fetch( ref, &cached ) == B_OK ) {
+		record.ref = ref;
+		record.node = cached.node;
+		record.nextOccurrence = ( time_t )cached.nextOccurrence;
+		record.nextReminder = ( time_t )cached.nextReminder;
+		record.bActivityFired = ( ( cached.flags & kEventCacheActivityFired ) != 0 );
+		record.bReminderFired = ( ( cached.flags & kEventCacheReminderFired ) != 0 );
+		record.bReminderEnabled = ( ( cached.flags & kEventCacheReminderEnabled ) != 0 );
+		record.eventFire = NULL;
+		record.reminderFire = NULL;
+	} else if ( ( status = ReadRecord( ref, &record ) ) != B_OK ) {
+		return status;
+	}
+
+	RecordMap::iterator it = fRecords.find( record.node );
+	if ( it == fRecords.end() ) {
+		if ( oldOut ) {
+			oldOut->node = node_ref();
+		}
+		fRecords.insert( RecordMap::value_type( record.node, record ) );
+	} else {
+		if ( oldOut ) {
+			*oldOut = it->second;
+		}
+		record.eventFire = it->second.eventFire;
+		record.reminderFire = it->second.reminderFire;
+		it->second = record;
+	}
+
+	if ( newOut ) {
+		*newOut = record;
+	}
+	return B_OK;
+}	// <-- end of function EventIndex::Update
+
+
+
+/*!	\brief		Remove a file from the index.
+ *		\param[out]	removedOut	If not \c NULL, receives the removed record.
+ *		\returns		\c true if the file was indexed.
+ */
+bool		EventIndex::Remove( const node_ref& node, EventIndexRecord* removedOut )
+{
+	RecordMap::iterator it = fRecords.find( node );
+	if ( it == fRecords.end() ) { return false; }
+
+	if ( removedOut ) {
+		*removedOut = it->second;
+	}
+	fRecords.erase( it );
+	return true;
+}	// <-- end of function EventIndex::Remove
+
+
+
+/*!	\brief		The file was moved or renamed - update its reference.
+ *		\returns		\c true if the file is indexed.
+ */
+bool		EventIndex::Rename( const node_ref& node, const entry_ref& newRef )
+{
+	EventIndexRecord* record = FindRecord( node );
+	if ( !record ) { return false; }
+
+	record->ref = newRef;
+	return true;
+}	// <-- end of function EventIndex::Rename
+
+
+
+/*!	\brief		Find the record of the file.
+ *		\returns		Pointer to the live record, or \c NULL if the file is not indexed.
+ */
+EventIndexRecord*		EventIndex::FindRecord( const node_ref& node )
+{
+	RecordMap::iterator it = fRecords.find( node );
+	if ( it == fRecords.end() ) { return NULL; }
+
+	return &( it->second );
+}	// <-- end of function EventIndex::FindRecord
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _EVENT_INDEX_H_
+#define _EVENT_INDEX_H_
+
+// OS includes
+#include <Entry.h>
+#include <Node.h>
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <time.h>
+
+// STL includes
+#include <map>
+
+class EventCache;
+struct ScheduledFire;
+
+
+/*!	\brief		What the server needs to know about a single pending Event.
+ *		\details		It's a small subset of the Event file's attributes - only the
+ *						ones that decide when the Event fires.
+ */
+struct EventIndexRecord {
+	entry_ref	ref;						//!< The Event file.
+	node_ref		node;						//!< Node of the Event file - the key of the index.
+	time_t		nextOccurrence;		//!< Value of "EVNT:next_occurrence".
+	time_t		nextReminder;			//!< Value of "EVNT:next_reminder".
+	bool			bActivityFired;		//!< Value of "EVNT:activity_fired".
+	bool			bReminderFired;		//!< Value of "EVNT:reminder_fired".
+	bool			bReminderEnabled;		//!< \c true if "EVNT:reminder_offset" is not 0.
+	ScheduledFire*	eventFire;			//!< Handle of the Event activity in the scheduler, or \c NULL.
+	ScheduledFire*	reminderFire;		//!< Handle of the reminder activity in the scheduler, or \c NULL.
+
+	bool			IsEventPending() const { return !bActivityFired; }
+	bool			IsReminderPending() const { return ( bReminderEnabled && !bReminderFired ); }
+};
+
+
+
+/*!	\brief		Order of node_refs in the index.
+ */
+struct NodeRefLess {
+	bool operator() ( const node_ref& a, const node_ref& b ) const {
+		if ( a.device != b.device ) { return ( a.device < b.device ); }
+		return ( a.node < b.node );
+	}
+};
+
+
+
+/*!	\brief		Resident index of the pending Events.
+ *		\details		The index is loaded once, from the live query, and then is kept
+ *						current from the query updates and node monitor messages. So the
+ *						cost of keeping it scales with the number of changes, not with
+ *						the number of Events.
+ */
+class EventIndex
+{
+public:
+	typedef std::map< node_ref, EventIndexRecord, NodeRefLess >		RecordMap;
+	typedef RecordMap::iterator												Iterator;
+	typedef RecordMap::const_iterator										ConstIterator;
+
+	EventIndex();
+	virtual ~EventIndex();
+
+	static	status_t				ReadRecord( const entry_ref& ref, EventIndexRecord* out );
+	virtual	void					SetCache( EventCache* cache ) { fCache = cache; }
+
+	virtual	status_t				Update( const entry_ref& ref,
+												  EventIndexRecord* oldOut = NULL,
+												  EventIndexRecord* newOut = NULL );
+	virtual	bool					Remove( const node_ref& node, EventIndexRecord* removedOut = NULL );
+	virtual	bool					Rename( const node_ref& node, const entry_ref& newRef );
+	virtual	EventIndexRecord*	FindRecord( const node_ref& node );
+	virtual	void					MakeEmpty() { fRecords.clear(); }
+
+	virtual	int32					CountItems() const { return ( int32 )fRecords.size(); }
+
+	Iterator							Begin() { return fRecords.begin(); }
+	Iterator							End() { return fRecords.end(); }
+	ConstIterator					Begin() const { return fRecords.begin(); }
+	ConstIterator					End() const { return fRecords.end(); }
+
+protected:
+	RecordMap		fRecords;		//!< The records, keyed by node.
+	EventCache*		fCache;			//!< If not \c NULL, the files are read through it. Not owned.
+};
+
+
+#endif // _EVENT_INDEX_H_
@@ -0,0 +1,417 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "EventScheduler.h"
+
+
+
+/*!	\brief		Layout of the wheel.
+ *		\details		All levels share one array of slots. Each level starts at its
+ *						base, and the due list is the very last slot.
+ */
+const		int32		kSecondsBase		= 0;		//!< 60 slots - seconds of the current minute.
+const		int32		kMinutesBase		= 60;		//!< 60 slots - minutes of the current hour.
+const		int32		kHoursBase			= 120;	//!< 24 slots - hours of the current day.
+const		int32		kDaysBase			= 144;	//!< 366 slots - days of the coming year.
+const		int32		kDaysInWheel		= 366;
+const		int32		kOverflowSlot		= 510;	//!< Everything that is more than a year away.
+const		int32		kDueSlot				= 511;	//!< Fires that are already due.
+const		int32		kNumberOfSlots		= 512;
+const		int32		kNumberOfLevels	= 6;
+
+const		time_t	kSecondsInMinute	= 60;
+const		time_t	kSecondsInHour		= 60 * 60;
+const		time_t	kSecondsInDay		= 24 * 60 * 60;
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class EventScheduler
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - the scheduler starts empty.
+ */
+EventScheduler::EventScheduler()
+	:
+	fCurrent( time( NULL ) ),
+	fCount( 0 ),
+	fDueLast( NULL ),
+	fOverflowEarliest( 0 )
+{
+	for ( int32 i = 0; i < kNumberOfSlots; ++i ) {
+		fSlots[ i ] = NULL;
+	}
+	for ( int32 i = 0; i < kNumberOfLevels; ++i ) {
+		fLevelCounts[ i ] = 0;
+	}
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+EventScheduler::~EventScheduler()
+{
+	MakeEmpty();
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Add a pending fire.
+ *		\param[in]	node			The node of the Event file.
+ *		\param[in]	deadline		When the activity should fire.
+ *		\param[in]	bReminder	\c true if it's the reminder activity.
+ *		\returns		The handle of the fire, or \c NULL if there's not enough memory.
+ */
+ScheduledFire*		EventScheduler::Schedule( const node_ref& node,
+															time_t deadline,
+															bool bReminder )
+{
+	ScheduledFire* toAdd = new ScheduledFire;
+	if ( !toAdd ) { return NULL; }
+
+	toAdd->node = node;
+	toAdd->deadline = deadline;
+	toAdd->bReminder = bReminder;
+	toAdd->fPrev = NULL;
+	toAdd->fNext = NULL;
+	toAdd->fSlot = -1;
+
+	Link( toAdd );
+	++fCount;
+
+	return toAdd;
+}	// <-- end of function EventScheduler::Schedule
+
+
+
+/*!	\brief		Move a pending fire to another time.
+ */
+void		EventScheduler::Reschedule( ScheduledFire* fire, time_t deadline )
+{
+	if ( !fire ) { return; }
+
+	Unlink( fire );
+	fire->deadline = deadline;
+	Link( fire );
+}	// <-- end of function EventScheduler::Reschedule
+
+
+
+/*!	\brief		Remove a pending fire from the scheduler and free it.
+ */
+void		EventScheduler::Cancel( ScheduledFire* fire )
+{
+	if ( !fire ) { return; }
+
+	Unlink( fire );
+	--fCount;
+	delete fire;
+}	// <-- end of function EventScheduler::Cancel
+
+
+
+/*!	\brief		Free the fire returned by PopDue().
+ */
+void		EventScheduler::Release( ScheduledFire* fire )
+{
+	if ( fire ) {
+		delete fire;
+	}
+}	// <-- end of function EventScheduler::Release
+
+
+
+/*!	\brief		Forget all pending fires.
+ */
+void		EventScheduler::MakeEmpty()
+{
+	ScheduledFire *current, *next;
+
+	for ( int32 i = 0; i < kNumberOfSlots; ++i ) {
+		for ( current = fSlots[ i ]; current; current = next ) {
+			next = current->fNext;
+			delete current;
+		}
+		fSlots[ i ] = NULL;
+	}
+	for ( int32 i = 0; i < kNumberOfLevels; ++i ) {
+		fLevelCounts[ i ] = 0;
+	}
+	fCount = 0;
+	fDueLast = NULL;
+}	// <-- end of function EventScheduler::MakeEmpty
+
+
+
+/*!	\brief		Forget all pending fires and restart the wheel from the given time.
+ *		\details		The wheel can't turn backwards; this is the only way to move it
+ *						to an earlier time.
+ */
+void		EventScheduler::Reset( time_t now )
+{
+	MakeEmpty();
+	fCurrent = now;
+}	// <-- end of function EventScheduler::Reset
+
+
+
+/*!	\brief		On which level the slot is?
+ */
+int32		EventScheduler::LevelOfSlot( int32 slot ) const
+{
+	if ( slot < kMinutesBase ) { return 0; }
+	if ( slot < kHoursBase ) { return 1; }
+	if ( slot < kDaysBase ) { return 2; }
+	if ( slot < kOverflowSlot ) { return 3; }
+	if ( slot == kOverflowSlot ) { return 4; }
+	return 5;
+}	// <-- end of function EventScheduler::LevelOfSlot
+
+
+
+/*!	\brief		Put the fire into the slot matching its deadline.
+ *		\details		The lowest level which spans both the current time and the
+ *						deadline is chosen. Fires that are due already go to the
+ *						end of the due list.
+ */
+void		EventScheduler::Link( ScheduledFire* fire )
+{
+	time_t	deadline = fire->deadline;
+	int32		slot;
+
+	if ( deadline <= fCurrent ) {
+		slot = kDueSlot;
+	} else if ( deadline / kSecondsInMinute == fCurrent / kSecondsInMinute ) {
+		slot = kSecondsBase + ( int32 )( deadline % kSecondsInMinute );
+	} else if ( deadline / kSecondsInHour == fCurrent / kSecondsInHour ) {
+		slot = kMinutesBase + ( int32 )( ( deadline / kSecondsInMinute ) % 60 );
+	} else if ( deadline / kSecondsInDay == fCurrent / kSecondsInDay ) {
+		slot = kHoursBase + ( int32 )( ( deadline / kSecondsInHour ) % 24 );
+	} else if ( deadline / kSecondsInDay - fCurrent / kSecondsInDay < kDaysInWheel ) {
+		slot = kDaysBase + ( int32 )( ( deadline / kSecondsInDay ) % kDaysInWheel );
+	} else {
+		slot = kOverflowSlot;
+		if ( !fSlots[ kOverflowSlot ] || deadline < fOverflowEarliest ) {
+			fOverflowEarliest = deadline;
+		}
+	}
+
+	fire->fSlot = slot;
+	if ( slot == kDueSlot ) {
+		// Append - due fires are performed in the order they became due
+		fire->fNext = NULL;
+		fire->fPrev = fDueLast;
+		if ( fDueLast ) {
+			fDueLast->fNext = fire;
+		} else {
+			fSlots[ kDueSlot ] = fire;
+		}
+		fDueLast = fire;
+	} else {
+		fire->fPrev = NULL;
+		fire->fNext = fSlots[ slot ];
+		if ( fSlots[ slot ] ) {
+			fSlots[ slot ]->fPrev = fire;
+		}
+		fSlots[ slot ] = fire;
+	}
+	++fLevelCounts[ LevelOfSlot( slot ) ];
+
+}	// <-- end of function EventScheduler::Link
+
+
+
+/*!	\brief		Take the fire out of its slot.
+ */
+void		EventScheduler::Unlink( ScheduledFire* fire )
+{
+	if ( fire->fSlot < 0 ) { return; }
+
+	if ( fire->fPrev ) {
+		fire->fPrev->fNext = fire->fNext;
+	} else {
+		fSlots[ fire->fSlot ] = fire->fNext;
+	}
+	if ( fire->fNext ) {
+		fire->fNext->fPrev = fire->fPrev;
+	} else if ( fire->fSlot == kDueSlot ) {
+		fDueLast = fire->fPrev;
+	}
+
+	--fLevelCounts[ LevelOfSlot( fire->fSlot ) ];
+	fire->fSlot = -1;
+	fire->fPrev = NULL;
+	fire->fNext = NULL;
+}	// <-- end of function EventScheduler::Unlink
+
+
+
+/*!	\brief		Redistribute the fires of a slot among the lower levels.
+ *		\details		Called when the current time reaches the period the slot covers.
+ */
+void		EventScheduler::Cascade( int32 slot )
+{
+	ScheduledFire *current, *next;
+	int32	level = LevelOfSlot( slot );
+
+	current = fSlots[ slot ];
+	fSlots[ slot ] = NULL;
+
+	for ( ; current; current = next ) {
+		next = current->fNext;
+		--fLevelCounts[ level ];
+		Link( current );
+	}
+}	// <-- end of function EventScheduler::Cascade
+
+
+
+/*!	\brief		Move the wheel forward to the given time.
+ *		\details		Empty levels are skipped over in whole minutes, hours or days,
+ *						so even a long sleep costs a few thousands of steps at most.
+ *						If the clock went back, nothing is done.
+ */
+void		EventScheduler::Advance( time_t now )
+{
+	time_t	next;
+
+	while ( true )
+	{
+		// Everything in the current second is due
+		Cascade( kSecondsBase + ( int32 )( fCurrent % kSecondsInMinute ) );
+
+		if ( fCurrent >= now ) { break; }
+
+		if ( fLevelCounts[ 0 ] > 0 ) {
+			next = fCurrent + 1;
+		} else if ( fLevelCounts[ 1 ] > 0 ) {
+			next = ( fCurrent / kSecondsInMinute + 1 ) * kSecondsInMinute;
+		} else if ( fLevelCounts[ 2 ] > 0 ) {
+			next = ( fCurrent / kSecondsInHour + 1 ) * kSecondsInHour;
+		} else {
+			next = ( fCurrent / kSecondsInDay + 1 ) * kSecondsInDay;
+		}
+		fCurrent = ( next < now ) ? next : now;
+
+		// Higher levels first - they may drop fires into the lower ones
+		if ( fCurrent % kSecondsInDay == 0 ) {
+			Cascade( kDaysBase + ( int32 )( ( fCurrent / kSecondsInDay ) % kDaysInWheel ) );
+			if ( fSlots[ kOverflowSlot ] &&
+				  fOverflowEarliest / kSecondsInDay - fCurrent / kSecondsInDay < kDaysInWheel )
+			{
+				Cascade( kOverflowSlot );
+			}
+		}
+		if ( fCurrent % kSecondsInHour == 0 ) {
+			Cascade( kHoursBase + ( int32 )( ( fCurrent / kSecondsInHour ) % 24 ) );
+		}
+		if ( fCurrent % kSecondsInMinute == 0 ) {
+			Cascade( kMinutesBase + ( int32 )( ( fCurrent / kSecondsInMinute ) % 60 ) );
+		}
+	}
+}	// <-- end of function EventScheduler::Advance
+
+
+
+/*!	\brief		Find the earliest deadline in a slot.
+ */
+time_t	EventScheduler::EarliestInSlot( ScheduledFire* head )
+{
+	time_t toReturn = head->deadline;
+
+	for ( head = head->fNext; head; head = head->fNext ) {
+		if ( head->deadline < toReturn ) {
+			toReturn = head->deadline;
+		}
+	}
+	return toReturn;
+}	// <-- end of function EventScheduler::EarliestInSlot
+
+
+
+/*!	\brief		When the next fire is due?
+ *		\details		Every level holds only fires that are later than the fires
+ *						of the levels below it, so only the first non-empty slot
+ *						of the first non-empty level is examined.
+ *		\returns		The earliest deadline, or 0 if nothing is scheduled.
+ */
+time_t	EventScheduler::NextDeadline() const
+{
+	int32	i, current;
+
+	if ( fSlots[ kDueSlot ] ) {
+		return fSlots[ kDueSlot ]->deadline;
+	}
+
+	if ( fLevelCounts[ 0 ] > 0 ) {
+		current = ( int32 )( fCurrent % kSecondsInMinute );
+		for ( i = current; i < 60; ++i ) {
+			if ( fSlots[ kSecondsBase + i ] ) {
+				return ( fCurrent - current + i );
+			}
+		}
+	}
+
+	if ( fLevelCounts[ 1 ] > 0 ) {
+		current = ( int32 )( ( fCurrent / kSecondsInMinute ) % 60 );
+		for ( i = current + 1; i < 60; ++i ) {
+			if ( fSlots[ kMinutesBase + i ] ) {
+				return EarliestInSlot( fSlots[ kMinutesBase + i ] );
+			}
+		}
+	}
+
+	if ( fLevelCounts[ 2 ] > 0 ) {
+		current = ( int32 )( ( fCurrent / kSecondsInHour ) % 24 );
+		for ( i = current + 1; i < 24; ++i ) {
+			if ( fSlots[ kHoursBase + i ] ) {
+				return EarliestInSlot( fSlots[ kHoursBase + i ] );
+			}
+		}
+	}
+
+	if ( fLevelCounts[ 3 ] > 0 ) {
+		current = ( int32 )( ( fCurrent / kSecondsInDay ) % kDaysInWheel );
+		for ( i = 1; i < kDaysInWheel; ++i ) {
+			int32 slot = kDaysBase + ( current + i ) % kDaysInWheel;
+			if ( fSlots[ slot ] ) {
+				return EarliestInSlot( fSlots[ slot ] );
+			}
+		}
+	}
+
+	if ( fSlots[ kOverflowSlot ] ) {
+		return EarliestInSlot( fSlots[ kOverflowSlot ] );
+	}
+
+	return 0;
+}	// <-- end of function EventScheduler::NextDeadline
+
+
+
+/*!	\brief		Take the earliest due fire out of the scheduler.
+ *		\param[in]	now		Current time.
+ *		\returns		The fire that should be performed, or \c NULL if nothing is due.
+ *						The caller should free the fire with Release().
+ */
+ScheduledFire*		EventScheduler::PopDue( time_t now )
+{
+	ScheduledFire* toReturn;
+
+	if ( !fSlots[ kDueSlot ] ) {
+		Advance( now );
+	}
+
+	if ( NULL == ( toReturn = fSlots[ kDueSlot ] ) ) {
+		return NULL;
+	}
+
+	Unlink( toReturn );
+	--fCount;
+
+	return toReturn;
+}	// <-- end of function EventScheduler::PopDue
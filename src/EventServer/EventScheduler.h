@@ -0,0 +1,83 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _EVENT_SCHEDULER_H_
+#define _EVENT_SCHEDULER_H_
+
+// OS includes
+#include <Node.h>
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <time.h>
+
+
+/*!	\brief		One pending fire - the Event file and the moment it's due.
+ *		\details		The fire is also the handle the scheduler returns: it's linked
+ *						into a slot of the wheel, so it can be cancelled or moved to
+ *						another time without searching for it.
+ */
+struct ScheduledFire {
+	node_ref		node;			//!< Node of the Event file.
+	time_t		deadline;	//!< When should the activity fire, in seconds from UNIX epoch.
+	bool			bReminder;	//!< \c true for the reminder activity, \c false for the Event activity.
+
+	ScheduledFire*	fPrev;	//!< Previous fire in the same slot.
+	ScheduledFire*	fNext;	//!< Next fire in the same slot.
+	int32				fSlot;	//!< Index of the slot the fire is linked into, or -1.
+};
+
+
+
+/*!	\brief		Keeps the pending fires sorted by their deadlines.
+ *		\details		This is a hierarchical timing wheel. It has four levels - seconds
+ *						of the current minute, minutes of the current hour, hours of the
+ *						current day, and days of the coming year - and an overflow list
+ *						for the rest. Inserting, cancelling and rescheduling a fire are
+ *						O(1); the fires move to the lower levels as the time advances,
+ *						each fire at most once per level.
+ *
+ *						All fires belong to the scheduler. A fire returned by PopDue()
+ *						is not in the wheel anymore, and must be released by the caller
+ *						with Release().
+ */
+class EventScheduler
+{
+public:
+	EventScheduler();
+	virtual ~EventScheduler();
+
+	virtual ScheduledFire*	Schedule( const node_ref& node,
+												 time_t deadline,
+												 bool bReminder );
+	virtual void		Reschedule( ScheduledFire* fire, time_t deadline );
+	virtual void		Cancel( ScheduledFire* fire );
+	virtual void		Release( ScheduledFire* fire );
+	virtual void		MakeEmpty();
+	virtual void		Reset( time_t now );
+
+	virtual bool		IsEmpty() const { return ( fCount == 0 ); }
+	virtual int32		CountItems() const { return fCount; }
+	virtual time_t		NextDeadline() const;
+
+	virtual ScheduledFire*	PopDue( time_t now );
+
+protected:
+	virtual void		Link( ScheduledFire* fire );
+	virtual void		Unlink( ScheduledFire* fire );
+	virtual void		Cascade( int32 slot );
+	virtual void		Advance( time_t now );
+	virtual int32		LevelOfSlot( int32 slot ) const;
+	static  time_t		EarliestInSlot( ScheduledFire* head );
+
+	time_t			fCurrent;		//!< Time up to which the wheel was advanced.
+	ScheduledFire*	fSlots[ 512 ];	//!< Heads of the slots of all levels; the last one is the due list.
+	int32				fLevelCounts[ 6 ];	//!< Number of fires on each level.
+	int32				fCount;			//!< Number of fires in the scheduler.
+	ScheduledFire*	fDueLast;		//!< Last fire of the due list - due fires are popped in order.
+	time_t			fOverflowEarliest;	//!< No fire in the overflow list is earlier.
+};
+
+
+#endif // _EVENT_SCHEDULER_H_
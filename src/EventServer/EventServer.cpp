@@ -6,25 +6,39 @@
 // Project includes
 #include "AboutWindow.h"
 #include "ActivityData.h"
+#include "ActivityListWindow.h"
 #include "ActivityWindow.h"
 #include "Category.h"
 #include "CategoryItem.h"
 #include "Event.h"
+#include "EventCache.h"
 #include "EventServer.h"
+#include "FirePipeline.h"
 #include "Preferences.h"
+#include "TimePreferences.h"
 #include "Utilities.h"
+#include "VolumeQuery.h"
 
 // OS includes
+#include <Alert.h>
 #include <Handler.h>
 #include <InterfaceDefs.h>
 #include <Looper.h>
 #include <Message.h>
+#include <Node.h>
+#include <NodeMonitor.h>
+#include <OS.h>
 #include <Volume.h>
 #include <VolumeRoster.h>
 
 // POSIX includes
+#include <string.h>
+#include <sys/resource.h>
 #include <time.h>
 
+// STL includes
+#include <vector>
+
 
 
 /*!	\brief		Return value of the program.
@@ -37,6 +51,86 @@ uint32	global_toReturn = B_OK;
 const		uint32	kUserSnoozedEvent	= 'UsSn';
 
 
+/*!	\brief		The earliest deadline has arrived.
+ */
+const		uint32	kWakeUpTimer		= 'WkUp';
+
+
+/*!	\brief		Some indexed Event files have changed - re-read them.
+ */
+const		uint32	kRefreshIndex		= 'RfIx';
+
+
+/*!	\brief		Time to pass the next part of the overdue activities to the pipeline.
+ */
+const		uint32	kDrainBacklog		= 'DrBl';
+
+
+/*!	\brief		A batch of pending Events found by a VolumeQuery.
+ */
+const		uint32	kIndexRefs			= 'IxRf';
+
+
+/*!	\brief		The preferences file has changed - re-read it.
+ */
+const		uint32	kReloadPreferences	= 'RlPr';
+
+
+/*!	\brief		The pipeline has saved the "fired" flag of an activity.
+ */
+const		uint32	kFireSaved			= 'FiSv';
+
+
+/*!	\brief		Predicate of the live query for the pending Events.
+ *		\details		"EVNT:next_due" exists only while some activity of the Event is
+ *						pending, so a single range over its index finds all of them,
+ *						without the type check and without the two "fired" indexes.
+ */
+const		char*		kPendingEventsPredicate	= "(EVNT:next_due>=0)";
+
+
+/*!	\brief		Minimal delay of the wake-up timer, in microseconds.
+ *		\details		Overdue deadlines are served after this delay, which lets
+ *						the server coalesce them into one wake-up.
+ */
+const		bigtime_t	kMinimalWakeUpDelay	= 1000;
+
+
+/*!	\brief		Number of node monitors the server asks for.
+ *		\details		Every indexed Event file is watched. The default limit of
+ *						the system is too low for a big calendar.
+ */
+const		rlim_t	kNodeMonitorsLimit	= 65536;
+
+
+/*!	\brief		How late, in seconds, may an activity fire and still count as on time.
+ *		\details		Later activities were missed - the computer was off or suspended,
+ *						or the clock jumped forward. They are collapsed into one summary.
+ */
+const		time_t	kOverdueGracePeriod	= 120;
+
+
+/*!	\brief		How far, in seconds, the clock may go back before the schedule is rebuilt.
+ */
+const		time_t	kClockJumpThreshold	= 120;
+
+
+/*!	\brief		The overdue activities are passed to the pipeline at a limited rate:
+ *					this many activities...
+ */
+const		int32		kBacklogBatchSize		= 4;
+
+
+/*!	\brief		...once in this many microseconds.
+ */
+const		bigtime_t	kBacklogDrainInterval	= 500000;
+
+
+/*!	\brief		Maximal number of Event names listed in the summary.
+ */
+const		int32		kSummaryNamesLimit	= 10;
+
+
 /*!	\brief		Main function of the Event Server.
  *		\details		It just constructs the object and makes it run.
  */
@@ -64,262 +158,894 @@ int main( int argc, char* argv[] ) {
 EventServer::EventServer()
 	:
 	BApplication( kEventServerApplicationSignature ),
-	fEventQuery(),
-	fReminderQuery(),
-	fCurrentMessenger( NULL )
+	fCurrentMessenger( NULL ),
+	fPipeline( NULL ),
+	fListWindow( NULL ),
+	fCache( NULL ),
+	fWakeUpRunner( NULL ),
+	bRefreshRequested( false ),
+	bPreferencesReloadRequested( false ),
+	fDrainRunner( NULL ),
+	fLastWakeUpTime( 0 )
 {
-	this->SetPulseRate( 30000000 );		// Pulse is once per 30 secs
+	struct rlimit	limit;
+	
+	// Make sure there's enough node monitors for all pending Events
+	if ( ( getrlimit( RLIMIT_NOVMON, &limit ) == 0 ) &&
+		  ( limit.rlim_cur < kNodeMonitorsLimit ) )
+	{
+		limit.rlim_cur = kNodeMonitorsLimit;
+		setrlimit( RLIMIT_NOVMON, &limit );
+	}
+	
 	this->fCurrentMessenger = new BMessenger( ( BHandler* )be_app, ( BLooper* )be_app );
 	if ( !fCurrentMessenger ) {
 		global_toReturn = B_NO_MEMORY;
 		return;
 	}
+	
+	fPipeline = new FirePipeline( fCurrentMessenger, kUserSnoozedEvent, kFireSaved );
+	if ( !fPipeline ) {
+		global_toReturn = B_NO_MEMORY;
+		return;
+	}
+	
+	// The server keeps the cache current; the server works without it, too
+	fCache = new EventCache( true );
+	if ( fCache && fCache->InitCheck() != B_OK ) {
+		delete fCache;
+		fCache = NULL;
+	}
+	fIndex.SetCache( fCache );
 }	// <-- end of constructor
 
 
 
 
-/*!	\brief		Update the categories recognized by the server.
- *		\details		I have no choise but to fully reload the whole Preferences message.
+/*!	\brief		Re-read the sections of the preferences that were changed.
+ *		\details		Called only when the node monitor reports a change of the
+ *						preferences file, so the idle server never reads it.
  */
-void	EventServer::UpdateCategories()
+void	EventServer::UpdatePreferences()
 {
-	pref_ReloadAllPreferences();
-}	// <-- end of function EventServer::UpdateCategories
+	uint32 changed = PREF_SECTION_NONE;
+	
+	bPreferencesReloadRequested = false;
+	
+	// The notifications read categories from another thread
+	fPipeline->CategoriesLock().Lock();
+	pref_ReloadChangedPreferences( &changed );
+	fPipeline->CategoriesLock().Unlock();
+	
+}	// <-- end of function EventServer::UpdatePreferences
 
 
 
-/*!	\brief		Run the queries
+/*!	\brief		Start watching the preferences file.
+ *		\details		The file is watched for changes of its contents, and its
+ *						directory - for the file being created, replaced or removed.
  */
-void	EventServer::Pulse()
+void	EventServer::WatchPreferences()
 {
-	static unsigned char pendulum = 0;
+	if ( fPreferencesFile.device != -1 ) {
+		watch_node( &fPreferencesFile, B_STOP_WATCHING, *fCurrentMessenger );
+	}
+	if ( fPreferencesDirectory.device != -1 ) {
+		watch_node( &fPreferencesDirectory, B_STOP_WATCHING, *fCurrentMessenger );
+	}
 	
-	// To ease loads on the system, I read preferences only once in 2 minutes.
-	if ( pendulum == 3 ) {
-		pendulum = 0;
-		UpdateCategories();
-	} else {
-		++pendulum;
+	if ( pref_GetPreferencesFileNodes( &fPreferencesFile, &fPreferencesDirectory ) != B_OK ) {
+		utl_Deb = new DebuggerPrintout( "Did not succeed to watch the preferences!" );
+		fPreferencesFile = node_ref();
+		fPreferencesDirectory = node_ref();
+		return;
 	}
+	watch_node( &fPreferencesFile, B_WATCH_STAT, *fCurrentMessenger );
+	watch_node( &fPreferencesDirectory, B_WATCH_DIRECTORY, *fCurrentMessenger );
 	
-	fCurrentTime = time( NULL );
+}	// <-- end of function EventServer::WatchPreferences
+
+
+
+/*!	\brief		Respond to the node monitor message about the preferences.
+ *		\returns		\c true if the message was about the preferences.
+ */
+bool	EventServer::HandlePreferencesMonitor( BMessage* in, int32 opcode, const node_ref& node )
+{
+	node_ref		directory;
+	const char*	name;
+	bool			bReplaced = false;
+	
+	directory.device = node.device;
+	
+	switch ( opcode )
+	{
+		case B_STAT_CHANGED:
+			if ( node != fPreferencesFile ) { return false; }
+			break;
+		
+		case B_ENTRY_CREATED:	// Intentional fall-through
+		case B_ENTRY_REMOVED:
+			if ( ( in->FindInt64( "directory", &directory.node ) != B_OK ) ||
+				  ( directory != fPreferencesDirectory ) )
+			{
+				// The preferences file itself might be removed
+				if ( node != fPreferencesFile ) { return false; }
+			}
+			else if ( ( in->FindString( "name", &name ) != B_OK ) ||
+						 ( strcmp( name, "Preferences" ) != 0 ) )
+			{
+				// Another file in the same directory
+				return true;
+			}
+			bReplaced = true;
+			break;
+		
+		case B_ENTRY_MOVED:
+			if ( node != fPreferencesFile ) {
+				if ( ( in->FindInt64( "to directory", &directory.node ) != B_OK ) ||
+					  ( directory != fPreferencesDirectory ) ||
+					  ( in->FindString( "name", &name ) != B_OK ) ||
+					  ( strcmp( name, "Preferences" ) != 0 ) )
+				{
+					// Not moved over the preferences file
+					return ( node == fPreferencesDirectory );
+				}
+			}
+			bReplaced = true;
+			break;
+		
+		default:
+			return ( node == fPreferencesFile || node == fPreferencesDirectory );
+	};
 	
-	PerformEventQuery();
+	if ( bReplaced ) {
+		WatchPreferences();
+	}
+	
+	// Saving the file produces many notifications; it's read once.
+	if ( !bPreferencesReloadRequested ) {
+		bPreferencesReloadRequested = true;
+		this->PostMessage( kReloadPreferences );
+	}
+	return true;
 	
-	PerformReminderQuery();
+}	// <-- end of function EventServer::HandlePreferencesMonitor
 
-}	// <-- end of function EventServer::Pulse	
+
+
+/*!	\brief		Start the live queries of pending Events on all volumes.
+ *		\details		Every volume that supports queries gets a VolumeQuery with a
+ *						worker thread of its own, so the volumes are scanned in parallel.
+ *						Their results are merged into the single index and scheduler.
+ *						Volumes mounted later are added when the roster reports them.
+ */
+void 	EventServer::StartVolumeQueries()
+{
+	BVolume volume;
+	
+	fVolumeRoster.Rewind();
+	while ( fVolumeRoster.GetNextVolume( &volume ) == B_OK )
+	{
+		AddVolume( volume );
+	}
+	
+	fVolumeRoster.StartWatching( *fCurrentMessenger );
+	
+}	// <-- end of function EventServer::StartVolumeQueries
 
 
 
-/*!	\brief		Perform the event query fetch
+/*!	\brief		Start the live query of pending Events on a single volume.
  */
-void	EventServer::PerformEventQuery()
+void		EventServer::AddVolume( const BVolume& volume )
 {
-	PrepareEventQuery();
-	fEventQuery.Fetch();
-	DealWithEntries( &fEventQuery, false );
-}	// <-- end of function EventServer::PerformEventQuery
+	VolumeQuery* toAdd;
+	
+	if ( ( volume.InitCheck() != B_OK ) || !volume.KnowsQuery() ||
+		  ( fVolumeQueries.find( volume.Device() ) != fVolumeQueries.end() ) )
+	{
+		return;
+	}
+	
+	toAdd = new VolumeQuery( volume, kPendingEventsPredicate, fCurrentMessenger, kIndexRefs );
+	if ( !toAdd ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+		return;
+	}
+	fVolumeQueries[ volume.Device() ] = toAdd;
+	
+	if ( toAdd->Start() != B_OK ) {
+		utl_Deb = new DebuggerPrintout( "Did not succeed to start the query of a volume!" );
+	}
+}	// <-- end of function EventServer::AddVolume
 
 
 
-/*!	\brief		Prepare the event query for re-run
+/*!	\brief		Forget the Events of an unmounted volume.
+ *		\details		Only the Events of this volume are removed from the index and the
+ *						scheduler; the other volumes are not rescanned.
  */
-void 	EventServer::PrepareEventQuery()
+void		EventServer::RemoveVolume( dev_t device )
 {
-	BVolumeRoster volumeRoster;
-	BVolume bootVolume;
-	volumeRoster.GetBootVolume( &bootVolume );
+	std::map< dev_t, VolumeQuery* >::iterator	found;
+	std::vector< node_ref >	toRemove;
+	EventIndex::Iterator		it;
+	
+	found = fVolumeQueries.find( device );
+	if ( found != fVolumeQueries.end() ) {
+		delete found->second;
+		fVolumeQueries.erase( found );
+	}
+	
+	for ( it = fIndex.Begin(); it != fIndex.End(); ++it )
+	{
+		if ( it->first.device == device ) {
+			toRemove.push_back( it->first );
+		}
+	}
+	for ( size_t i = 0; i < toRemove.size(); ++i )
+	{
+		UnindexNode( toRemove[ i ] );
+	}
+	
+	ArmWakeUpTimer();
+	
+}	// <-- end of function EventServer::RemoveVolume
+
+
 
-	/*---------------------------------------
-	 *			 Prepare the Event query
-	 *--------------------------------------*/	
-	 
-	// Clear the query
-	fEventQuery.Clear();
+/*!	\brief		Respond to the roster's message about a volume being (un)mounted.
+ */
+void		EventServer::HandleVolumeMonitor( BMessage* in, int32 opcode )
+{
+	dev_t		device;
+	
+	switch ( opcode )
+	{
+		case B_DEVICE_MOUNTED:
+			if ( in->FindInt32( "new device", &device ) == B_OK ) {
+				BVolume volume( device );
+				if ( ( volume.InitCheck() == B_OK ) && volume.KnowsQuery() ) {
+					utl_CreateIndexesOnVolume( volume );
+					AddVolume( volume );
+				}
+			}
+			break;
+		
+		case B_DEVICE_UNMOUNTED:
+			if ( in->FindInt32( "device", &device ) == B_OK ) {
+				RemoveVolume( device );
+			}
+			break;
+		
+		default:
+			break;
+	};
 	
-	// Setting the query to look in the boot volume
-	fEventQuery.SetVolume( &bootVolume );
+}	// <-- end of function EventServer::HandleVolumeMonitor
+
+
+
+/*!	\brief		Merge a batch of refs, fetched by a VolumeQuery, into the index.
+ *		\details		The batch may arrive after the live query reported that some of
+ *						the files stopped being pending; such files are not kept.
+ *
+ *						The Events the cache doesn't know yet are decoded all together
+ *						first, in parallel; indexing them then finds them in the cache.
+ */
+void		EventServer::IndexRefs( BMessage* in )
+{
+	entry_ref	ref;
+	node_ref		node;
+	EventIndexRecord*	record;
+	std::vector< entry_ref >	refs;
 	
-	// Build the predicate
-		// Only files of the "Eventual" type
-	fEventQuery.PushAttr( "BEOS:TYPE" );
-	fEventQuery.PushString( kEventFileMIMEType );
-	fEventQuery.PushOp( B_EQ );
+	for ( int32 i = 0; in->FindRef( "refs", i, &ref ) == B_OK; ++i ) {
+		refs.push_back( ref );
+	}
+	if ( fCache && !refs.empty() ) {
+		fCache->Prefetch( &refs[ 0 ], ( int32 )refs.size() );
+	}
 	
-		// Where time of the next event has arrived
-	fEventQuery.PushAttr( "EVNT:next_occurrence" );
-	fEventQuery.PushUInt32( fCurrentTime );
-	fEventQuery.PushOp( B_LE );
-	fEventQuery.PushOp( B_AND );
+	for ( size_t i = 0; i < refs.size(); ++i )
+	{
+		IndexEntry( refs[ i ] );
+		
+		BNode file( &refs[ i ] );
+		if ( ( file.GetNodeRef( &node ) == B_OK ) &&
+			  ( NULL != ( record = fIndex.FindRecord( node ) ) ) &&
+			  !record->IsEventPending() && !record->IsReminderPending() )
+		{
+			UnindexNode( node );
+		}
+	}
 	
-		// And the event wasn't fired yet
-	fEventQuery.PushAttr( "EVNT:activity_fired" );
-	fEventQuery.PushUInt32( 0 );
-	fEventQuery.PushOp( B_EQ );
-	fEventQuery.PushOp( B_AND );
+	ArmWakeUpTimer();
 	
-}	// <-- end of function PerformEventQuery
+}	// <-- end of function EventServer::IndexRefs
 
 
 
-/*!	\brief		Receive the results from the Entries query and run activities.
- *		\param[in]	toFetchFrom 	The BQuery object that represents the query
- *											which results are to be analized.
- *		\param[in]	bReminder		\c true if we should run the reminder activity,
- *											\c false (default) if we should run the Event activity.
+/*!	\brief		Add an Event file to the index, or re-read it.
+ *		\details		Only the attributes which define the deadlines are read, not the
+ *						whole Event. New files are watched for changes and renames.
+ *						Activities which are in the pipeline stay fired, whatever the file
+ *						says, until their flags are saved.
+ *		\param[in]	ref		The Event file.
  */
-void 	EventServer::DealWithEntries( BQuery* toFetchFrom, bool bReminder )
+void		EventServer::IndexEntry( const entry_ref& ref )
 {
-	ActivityWindow* actWindow;
-	entry_ref ref;
-	EventData* eventData = NULL;
-	ActivityData* activityData = NULL;
-	status_t	status = B_OK;
-	Category* category = NULL;
-	BString eventName;
-	BMessage* toSend = NULL;
+	EventIndexRecord	oldRecord, newRecord;
+	EventIndexRecord*	record;
+	
+	if ( fIndex.Update( ref, &oldRecord, &newRecord ) != B_OK ) {
+		return;
+	}
 	
-	if ( !toFetchFrom ) { return; }
+	if ( oldRecord.node == node_ref() ) {
+		// The file was not indexed before - start watching it
+		watch_node( &newRecord.node, B_WATCH_ATTR | B_WATCH_NAME, *fCurrentMessenger );
+	}
 	
-	int temp = 0;
+	// The file doesn't say it was fired until the pipeline saves the flag
+	record = fIndex.FindRecord( newRecord.node );
+	if ( record ) {
+		if ( fEventsInFlight.count( record->node ) ) {
+			record->bActivityFired = true;
+		}
+		if ( fRemindersInFlight.count( record->node ) ) {
+			record->bReminderFired = true;
+		}
+	}
+	SyncFires( record );
 	
-	while ( B_OK == ( status = toFetchFrom->GetNextRef( &ref ) ) )
-	{
-		eventData = new EventData( ref );	// Read the entry
-		if ( !eventData ) {
+}	// <-- end of function EventServer::IndexEntry
+
+
+
+/*!	\brief		Remove an Event file from the index.
+ *		\details		Its pending fires are removed from the scheduler.
+ */
+void		EventServer::UnindexNode( const node_ref& node )
+{
+	EventIndexRecord	removed;
+	
+	if ( fIndex.Remove( node, &removed ) ) {
+		fScheduler.Cancel( removed.eventFire );
+		fScheduler.Cancel( removed.reminderFire );
+		watch_node( &node, B_STOP_WATCHING, *fCurrentMessenger );
+	}
+	fDirtyNodes.erase( node );
+}	// <-- end of function EventServer::UnindexNode
+
+
+
+/*!	\brief		Bring a single fire of the Event in line with the index.
+ *		\param[in,out]	handle		The handle of the fire kept in the index.
+ *		\param[in]	bPending		\c true if the activity should fire.
+ *		\param[in]	deadline		When the activity should fire.
+ *		\param[in]	node			The node of the Event file.
+ *		\param[in]	bReminder	\c true if it's the reminder activity.
+ */
+void		EventServer::SyncFire( ScheduledFire** handle,
+											  bool bPending,
+											  time_t deadline,
+											  const node_ref& node,
+											  bool bReminder )
+{
+	if ( !bPending ) {
+		if ( *handle ) {
+			fScheduler.Cancel( *handle );
+			*handle = NULL;
+		}
+		return;
+	}
+	
+	if ( !*handle ) {
+		*handle = fScheduler.Schedule( node, deadline, bReminder );
+		if ( !*handle ) {
 			/* Panic! */
 			global_toReturn = B_NO_MEMORY;
 			be_app->PostMessage( B_QUIT_REQUESTED );
 		}
+	} else if ( ( *handle )->deadline != deadline ) {
+		fScheduler.Reschedule( *handle, deadline );
+	}
+}	// <-- end of function EventServer::SyncFire
+
+
+
+/*!	\brief		Put the deadlines of an indexed Event into the scheduler.
+ *		\details		Every Event has at most two fires in the scheduler. If they
+ *						already exist, they are moved to the new deadlines or cancelled,
+ *						each in constant time.
+ */
+void		EventServer::SyncFires( EventIndexRecord* record )
+{
+	if ( !record ) { return; }
+	
+	SyncFire( &record->eventFire,
+				 record->IsEventPending(),
+				 record->nextOccurrence,
+				 record->node,
+				 false );
+	SyncFire( &record->reminderFire,
+				 record->IsReminderPending(),
+				 record->nextReminder,
+				 record->node,
+				 true );
+}	// <-- end of function EventServer::SyncFires
+
+
+
+/*!	\brief		Snooze the activity in the schedule.
+ *		\details		The new time is also saved to the file, but the schedule does
+ *						not wait for the node monitor - the fire is moved right away.
+ */
+void		EventServer::SnoozeInIndex( const entry_ref& ref, bool bReminder,
+												 int32 hours, int32 minutes )
+{
+	node_ref		nodeRef;
+	BNode			node( &ref );
+	time_t		newTime = time( NULL ) + ( minutes * 60 + hours * 60 * 60 );
+	EventIndexRecord*	record;
+	
+	if ( node.InitCheck() != B_OK || node.GetNodeRef( &nodeRef ) != B_OK ) {
+		return;
+	}
+	if ( NULL == ( record = fIndex.FindRecord( nodeRef ) ) ) {
+		// The query will report the file when it's saved
+		return;
+	}
+	
+	if ( bReminder ) {
+		if ( !record->bReminderEnabled ) { return; }
+		record->nextReminder = newTime;
+		record->bReminderFired = false;
+		fRemindersInFlight.erase( nodeRef );
+	} else {
+		record->nextOccurrence = newTime;
+		record->bActivityFired = false;
+		fEventsInFlight.erase( nodeRef );
+	}
+	SyncFires( record );
+	ArmWakeUpTimer();
+	
+}	// <-- end of function EventServer::SnoozeInIndex
+
+
+
+/*!	\brief		Respond to the update of the live query.
+ *		\details		An Event has become pending, or stopped being pending.
+ */
+void		EventServer::HandleQueryUpdate( BMessage* in )
+{
+	int32			opcode;
+	entry_ref	ref;
+	node_ref		node;
+	const char*	name;
+	
+	if ( !in || in->FindInt32( "opcode", &opcode ) != B_OK ) { return; }
+	
+	switch ( opcode )
+	{
+		case B_ENTRY_CREATED:
+			if ( ( in->FindInt32( "device", &ref.device ) == B_OK ) &&
+				  ( in->FindInt64( "directory", &ref.directory ) == B_OK ) &&
+				  ( in->FindString( "name", &name ) == B_OK ) )
+			{
+				ref.set_name( name );
+				IndexEntry( ref );
+				ArmWakeUpTimer();
+			}
+			break;
 		
-		// Set the activity as fired
-		if ( bReminder ) {
-			eventData->SetReminderActivityFired( true );
-		} else {
-			eventData->SetEventActivityFired( true );
-		}
+		case B_ENTRY_REMOVED:
+			if ( ( in->FindInt32( "device", &node.device ) == B_OK ) &&
+				  ( in->FindInt64( "node", &node.node ) == B_OK ) )
+			{
+				UnindexNode( node );
+			}
+			break;
+			
+		default:
+			break;
+	};
+	
+}	// <-- end of function EventServer::HandleQueryUpdate
+
+
+
+/*!	\brief		Report the migration of the time attributes.
+ *		\details		The volume queries migrate the older Event files before they are
+ *						indexed; on large volumes, it may take a while. The intermediate
+ *						progress is not shown - the user is told once, when a volume is
+ *						done, and only if some files were actually migrated.
+ */
+void		EventServer::HandleMigrationProgress( BMessage* in )
+{
+	int32		device = -1, checked = 0, migrated = 0;
+	bool		bFinished = false;
+	BString	text;
+
+	if ( !in ) { return; }
+	in->FindInt32( "device", &device );
+	in->FindInt32( "checked", &checked );
+	in->FindInt32( "migrated", &migrated );
+	in->FindBool( "finished", &bFinished );
+
+	if ( !bFinished || migrated == 0 ) { return; }
+
+	text << "Volume " << device << ": " << checked << " Event files checked, ";
+	text << migrated << " migrated.";
+	utl_Deb = new DebuggerPrintout( text.String() );
+}	// <-- end of function EventServer::HandleMigrationProgress
+
+
+
+/*!	\brief		Respond to the node monitor message about indexed Event file.
+ */
+void		EventServer::HandleNodeMonitor( BMessage* in )
+{
+	int32			opcode;
+	entry_ref	ref;
+	node_ref		node;
+	const char*	name;
+	
+	if ( !in || ( in->FindInt32( "opcode", &opcode ) != B_OK ) ) { return; }
+	
+	if ( ( opcode == B_DEVICE_MOUNTED ) || ( opcode == B_DEVICE_UNMOUNTED ) ) {
+		HandleVolumeMonitor( in, opcode );
+		return;
+	}
+	
+	if ( ( in->FindInt32( "device", &node.device ) != B_OK ) ||
+		  ( in->FindInt64( "node", &node.node ) != B_OK ) )
+	{
+		return;
+	}
+	
+	if ( HandlePreferencesMonitor( in, opcode, node ) ) { return; }
+	
+	switch ( opcode )
+	{
+		case B_ATTR_CHANGED:
+			// Saving an Event writes many attributes; the file is re-read once.
+			if ( fCache ) {
+				fCache->Invalidate( node );
+			}
+			RequestRefresh( node );
+			break;
 		
-		// Save the new data
-		eventData->SaveToFile( &ref );
+		case B_ENTRY_MOVED:
+			if ( ( in->FindInt64( "to directory", &ref.directory ) == B_OK ) &&
+				  ( in->FindString( "name", &name ) == B_OK ) )
+			{
+				ref.device = node.device;
+				ref.set_name( name );
+				fIndex.Rename( node, ref );
+			}
+			break;
+			
+		case B_ENTRY_REMOVED:
+			if ( fCache ) {
+				fCache->Invalidate( node );
+			}
+			UnindexNode( node );
+			break;
 		
-		// Obtain the activity data
-		if ( bReminder ) {
-			activityData = eventData->GetReminderActivity();	
-		} else {
-			activityData = eventData->GetEventActivity();
+		default:
+			break;
+	};
+	
+}	// <-- end of function EventServer::HandleNodeMonitor
+
+
+
+/*!	\brief		Re-read all Event files that were changed since the last refresh.
+ */
+void		EventServer::RefreshIndex()
+{
+	EventIndexRecord*	record;
+	std::set< node_ref, NodeRefLess >::iterator it;
+	
+	bRefreshRequested = false;
+	
+	for ( it = fDirtyNodes.begin(); it != fDirtyNodes.end(); ++it )
+	{
+		if ( NULL != ( record = fIndex.FindRecord( *it ) ) ) {
+			IndexEntry( record->ref );
 		}
-		
-		// Get the Event name
-		eventName = eventData->GetEventName();
-		
-		// Obtain the category name and color
-		if ( NULL == ( category = FindCategory( eventData->GetCategory() ) ) ) {
-			category = FindDefaultCategory();	
+	}
+	fDirtyNodes.clear();
+	
+	ArmWakeUpTimer();
+	
+}	// <-- end of function EventServer::RefreshIndex
+
+
+
+/*!	\brief		Queue re-reading of an indexed Event file.
+ *		\details		All files changed before the refresh runs are re-read at once.
+ */
+void		EventServer::RequestRefresh( const node_ref& node )
+{
+	fDirtyNodes.insert( node );
+	if ( !bRefreshRequested ) {
+		bRefreshRequested = true;
+		this->PostMessage( kRefreshIndex );
+	}
+}	// <-- end of function EventServer::RequestRefresh
+
+
+
+/*!	\brief		Set the wake-up timer to the earliest deadline.
+ *		\details		If nothing is scheduled, no timer is set at all - the server
+ *						sleeps until the live query reports a change.
+ */
+void		EventServer::ArmWakeUpTimer()
+{
+	bigtime_t	delay;
+	
+	if ( fWakeUpRunner ) {
+		delete fWakeUpRunner;
+		fWakeUpRunner = NULL;
+	}
+	
+	if ( fScheduler.IsEmpty() ) { return; }
+	
+	delay = ( bigtime_t )fScheduler.NextDeadline() * 1000000LL - real_time_clock_usecs();
+	if ( delay < kMinimalWakeUpDelay ) {
+		delay = kMinimalWakeUpDelay;
+	}
+	
+	BMessage wakeUp( kWakeUpTimer );
+	fWakeUpRunner = new BMessageRunner( *fCurrentMessenger, &wakeUp, delay, 1 );
+	if ( !fWakeUpRunner || fWakeUpRunner->InitCheck() != B_OK ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+	}
+	
+}	// <-- end of function EventServer::ArmWakeUpTimer
+
+
+
+/*!	\brief		Fire everything that is due and sleep until the next deadline.
+ *		\details		Activities that are late by more than the grace period were
+ *						missed. They are not fired one by one; instead, the user gets
+ *						a single summary, and the activities are drained in the background.
+ */
+void		EventServer::FireDueEntries()
+{
+	ScheduledFire*		fire;
+	EventIndexRecord*	record;
+	BString				summary;
+	int32					overdueCount = 0;
+	BacklogEntry		overdue;
+	std::vector< BacklogEntry >	onTime;
+	NotifyMode			notifyMode;
+	
+	fCurrentTime = time( NULL );
+	
+	// The wheel can't turn backwards - if the clock was moved back, rebuild it
+	if ( fLastWakeUpTime - fCurrentTime > kClockJumpThreshold ) {
+		ResetSchedule();
+	}
+	fLastWakeUpTime = fCurrentTime;
+	
+	while ( NULL != ( fire = fScheduler.PopDue( fCurrentTime ) ) )
+	{
+		record = fIndex.FindRecord( fire->node );
+		if ( record ) {
+			// Don't wait for the node monitor to know it was fired
+			if ( fire->bReminder ) {
+				record->reminderFire = NULL;
+				record->bReminderFired = true;
+				fRemindersInFlight.insert( record->node );
+			} else {
+				record->eventFire = NULL;
+				record->bActivityFired = true;
+				fEventsInFlight.insert( record->node );
+			}
 			
-			// If unsuccessfully, failback to "Default"
-			if ( category == NULL ) {
-				category = new Category( "Default", ui_color( B_WINDOW_TAB_COLOR ) );
-				if ( !category ) {
-					/* Panic! */
-					global_toReturn = B_NO_MEMORY;
-					be_app->PostMessage( B_QUIT_REQUESTED );
+			if ( fCurrentTime - fire->deadline > kOverdueGracePeriod ) {
+				// Missed - goes to the summary and to the backlog
+				if ( overdueCount++ < kSummaryNamesLimit ) {
+					AddToSummary( &summary, record->ref, fire->bReminder );
 				}
+				overdue.ref = record->ref;
+				overdue.node = record->node;
+				overdue.bReminder = fire->bReminder;
+				fBacklog.push_back( overdue );
+			} else {
+				overdue.ref = record->ref;
+				overdue.node = record->node;
+				overdue.bReminder = fire->bReminder;
+				onTime.push_back( overdue );
 			}
 		}
-		
-		// Build the template message
-		toSend = new BMessage( kUserSnoozedEvent );
-		if ( !toSend ) {
-			/* Panic! */
-			global_toReturn = B_NO_MEMORY;
-			be_app->PostMessage( B_QUIT_REQUESTED );
-		}
-		toSend->AddRef( "Event to snooze", &ref );
-		toSend->AddBool( "Reminder", bReminder );
-		
-		// Open the activity window
-		actWindow = new ActivityWindow( activityData,
-												  fCurrentMessenger,
-												  eventName,
-												  category,
-												  toSend,
-												  bReminder );
-		if ( !actWindow ) {
-			/* Panic! */
-			global_toReturn = B_NO_MEMORY;
-			be_app->PostMessage( B_QUIT_REQUESTED );
-		} else {
-			actWindow->Show();
+		fScheduler.Release( fire );
+	}
+	
+	// Activities fired together share one list window instead of a window each
+	notifyMode = ( onTime.size() > 1 ) ? NOTIFY_LIST : NOTIFY_WINDOW;
+	for ( size_t i = 0; i < onTime.size(); ++i )
+	{
+		if ( fPipeline->Fire( onTime[ i ].ref, onTime[ i ].node,
+									 onTime[ i ].bReminder, notifyMode ) != B_OK )
+		{
+			utl_Deb = new DebuggerPrintout( "Did not succeed to fire the Event!" );
+			ForgetInFlight( onTime[ i ].node, onTime[ i ].bReminder );
 		}
-		
-		// Run the activity
-		ActivityData::PerformActivity( activityData );
-		
-		// Delete temporary allocated data
-		delete eventData;
-		
-	}	// <-- end of "while ( there are entries in query results )"
+	}
+	
+	if ( overdueCount > 0 ) {
+		ShowOverdueSummary( summary, overdueCount );
+		StartDrainingBacklog();
+	}
 	
-}	// <-- end of function EventServer::DealWithEntries
+	ArmWakeUpTimer();
+	
+}	// <-- end of function EventServer::FireDueEntries
 
 
 
-/*!	\brief		Perform the reminder query fetch
+/*!	\brief		Stop keeping the activity fired regardless of its file.
  */
-void	EventServer::PerformReminderQuery()
+void		EventServer::ForgetInFlight( const node_ref& node, bool bReminder )
 {
-	PrepareReminderQuery();
-	fReminderQuery.Fetch();
-	DealWithEntries( &fReminderQuery, true );
-}	// <-- end of function EventServer::PerformReminderQuery
+	if ( bReminder ) {
+		fRemindersInFlight.erase( node );
+	} else {
+		fEventsInFlight.erase( node );
+	}
+}	// <-- end of function EventServer::ForgetInFlight
 
 
 
-/*!	\brief		Prepare the Reminders query for running
+/*!	\brief		The pipeline is done with the "fired" flag of an activity.
+ *		\details		From now on, the file is the source of truth again. It's re-read,
+ *						since a repeating Event was moved to its next occurrence, and
+ *						the refreshes made in the meantime saw the old flags.
  */
-void 	EventServer::PrepareReminderQuery()
+void		EventServer::HandleFireSaved( BMessage* in )
 {
-	BVolumeRoster volumeRoster;
-	BVolume bootVolume;
-	volumeRoster.GetBootVolume( &bootVolume );
+	node_ref		node;
+	bool			bReminder = false;
 	
-	/*---------------------------------------
-	 *			 Prepare the Reminder query
-	 *--------------------------------------*/	
+	if ( !in ||
+		  ( in->FindInt32( "device", &node.device ) != B_OK ) ||
+		  ( in->FindInt64( "node", &node.node ) != B_OK ) ||
+		  ( in->FindBool( "Reminder", &bReminder ) != B_OK ) )
+	{
+		return;
+	}
+	
+	ForgetInFlight( node, bReminder );
+	if ( fIndex.FindRecord( node ) ) {
+		RequestRefresh( node );
+	}
+}	// <-- end of function EventServer::HandleFireSaved
+
+
+
+/*!	\brief		Rebuild the schedule from the index, starting from the current time.
+ */
+void		EventServer::ResetSchedule()
+{
+	EventIndex::Iterator	it;
+	
+	fScheduler.Reset( fCurrentTime );
+	for ( it = fIndex.Begin(); it != fIndex.End(); ++it )
+	{
+		it->second.eventFire = NULL;
+		it->second.reminderFire = NULL;
+		SyncFires( &( it->second ) );
+	}
+}	// <-- end of function EventServer::ResetSchedule
+
 
-	// Clear the previous query
-	fReminderQuery.Clear();
+
+/*!	\brief		Add the name of a missed Event to the summary.
+ */
+void		EventServer::AddToSummary( BString* summary, const entry_ref& ref, bool bReminder )
+{
+	BNode		node( &ref );
+	BString	name;
 	
-	// Setting the query to look in the boot volume
-	fReminderQuery.SetVolume( &bootVolume );
+	if ( ( node.InitCheck() != B_OK ) ||
+		  ( node.ReadAttrString( "EVNT:name", &name ) != B_OK ) )
+	{
+		name.SetTo( ref.name );
+	}
 	
-	// Build the predicate
-		// Only Eventual files
-	fReminderQuery.PushAttr( "BEOS:TYPE" );
-	fReminderQuery.PushString( kEventFileMIMEType );
-	fReminderQuery.PushOp( B_EQ );
+	*summary << "\n    " << name;
+	if ( bReminder ) {
+		*summary << " (reminder)";
+	}
+}	// <-- end of function EventServer::AddToSummary
+
+
+
+/*!	\brief		Tell the user about all missed activities at once.
+ *		\param[in]	names		List of names of the first missed Events.
+ *		\param[in]	count		Total number of missed activities.
+ */
+void		EventServer::ShowOverdueSummary( const BString& names, int32 count )
+{
+	BString	text;
+	BAlert*	alert;
 	
-		// When next reminder should be already run
-	fReminderQuery.PushAttr( "EVNT:next_reminder" );
-	fReminderQuery.PushUInt32( fCurrentTime );
-	fReminderQuery.PushOp( B_LE );
-	fReminderQuery.PushOp( B_AND );
+	text << count << ( count == 1 ? " activity was" : " activities were" );
+	text << " missed while the computer was off or asleep:\n" << names;
+	if ( count > kSummaryNamesLimit ) {
+		text << "\n    ...and " << ( count - kSummaryNamesLimit ) << " more.";
+	}
 	
-		// And was not fired yet
-	fReminderQuery.PushAttr( "EVNT:reminder_fired" );
-	fReminderQuery.PushUInt32( 0 );
-	fReminderQuery.PushOp( B_EQ );
-	fReminderQuery.PushOp( B_AND );
+	alert = new BAlert( "Missed Events", text.String(), "Ok" );
+	if ( !alert ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+		return;
+	}
+	alert->Go( NULL );		// Don't block the server
+}	// <-- end of function EventServer::ShowOverdueSummary
+
+
+
+/*!	\brief		Start passing the missed activities to the pipeline.
+ */
+void		EventServer::StartDrainingBacklog()
+{
+	if ( fDrainRunner ) { return; }
+	
+	BMessage drain( kDrainBacklog );
+	fDrainRunner = new BMessageRunner( *fCurrentMessenger, &drain, kBacklogDrainInterval );
+	if ( !fDrainRunner || fDrainRunner->InitCheck() != B_OK ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+	}
+}	// <-- end of function EventServer::StartDrainingBacklog
+
+
+
+/*!	\brief		Pass the next part of the missed activities to the pipeline.
+ *		\details		No notification windows are opened - the summary replaces them.
+ *						The "fired" flag is always saved, and the activity runs only if
+ *						the user's policy allows it.
+ */
+void		EventServer::DrainBacklog()
+{
+	TimePreferences*	prefs = pref_GetTimePreferences();
+	OverduePolicy		policy = ( prefs ? prefs->GetOverduePolicy() : OVERDUE_SUMMARY_ONLY );
+	BacklogEntry		entry;
+	bool					bRun;
 	
-		// And the reminder is not disabled
-	fReminderQuery.PushAttr( "EVNT:reminder_offset" );
-	fReminderQuery.PushUInt32( 0 );
-	fReminderQuery.PushOp( B_NE );
-	fReminderQuery.PushOp( B_AND );	
+	for ( int32 i = 0; ( i < kBacklogBatchSize ) && !fBacklog.empty(); ++i )
+	{
+		entry = fBacklog.front();
+		fBacklog.pop_front();
+		
+		bRun = ( policy == OVERDUE_RUN_ALL ) ||
+				 ( policy == OVERDUE_RUN_EVENTS && !entry.bReminder );
+		if ( fPipeline->Fire( entry.ref, entry.node, entry.bReminder,
+									 NOTIFY_NONE, bRun ) != B_OK )
+		{
+			ForgetInFlight( entry.node, entry.bReminder );
+		}
+	}
 	
-}	// <-- end of constructor for the application
+	if ( fBacklog.empty() && fDrainRunner ) {
+		delete fDrainRunner;
+		fDrainRunner = NULL;
+	}
+}	// <-- end of function EventServer::DrainBacklog
 
 
 
@@ -327,7 +1053,34 @@ void 	EventServer::PrepareReminderQuery()
  */
 EventServer::~EventServer()
 {
+	if ( fWakeUpRunner ) {
+		delete fWakeUpRunner;
+	}
+	
+	if ( fDrainRunner ) {
+		delete fDrainRunner;
+	}
+	
+	if ( fPipeline ) {
+		delete fPipeline;
+	}
+	
+	fIndex.SetCache( NULL );
+	if ( fCache ) {
+		delete fCache;
+	}
+	
+	fVolumeRoster.StopWatching();
+	std::map< dev_t, VolumeQuery* >::iterator it;
+	for ( it = fVolumeQueries.begin(); it != fVolumeQueries.end(); ++it ) {
+		delete it->second;
+	}
+	fVolumeQueries.clear();
+	
+	// The list window is quit together with the other windows of the application
+	
 	if ( fCurrentMessenger ) {
+		stop_watching( *fCurrentMessenger );
 		delete fCurrentMessenger;
 	}
 	
@@ -375,7 +1128,7 @@ void		EventServer::SnoozeActivity( entry_ref ref, bool bReminder,
 
 
 /*!	\brief		Responds to the messages sent to this application.
- *		\details		Actually, the sole purpose is snoozing events.
+ *		\details		Snoozes events, and keeps the schedule up to date.
  *		\param[in]	in		The message that was received.
  */
 void		EventServer::MessageReceived( BMessage* in ) {
@@ -390,9 +1143,46 @@ void		EventServer::MessageReceived( BMessage* in ) {
 				  ( B_OK == in->FindInt32( "Hours", &hours ) )			&&
 				  ( B_OK == in->FindInt32( "Minutes", &minutes ) ) )
 			{
+				SnoozeInIndex( ref, bReminder, hours, minutes );
 				EventServer::SnoozeActivity( ref, bReminder, hours, minutes );				
 			}
 			break;
+		
+		case kWakeUpTimer:
+			FireDueEntries();
+			break;
+		
+		case B_QUERY_UPDATE:
+			HandleQueryUpdate( in );
+			break;
+		
+		case B_NODE_MONITOR:
+			HandleNodeMonitor( in );
+			break;
+		
+		case kRefreshIndex:
+			RefreshIndex();
+			break;
+		
+		case kDrainBacklog:
+			DrainBacklog();
+			break;
+		
+		case kIndexRefs:
+			IndexRefs( in );
+			break;
+		
+		case kMigrationProgress:
+			HandleMigrationProgress( in );
+			break;
+		
+		case kReloadPreferences:
+			UpdatePreferences();
+			break;
+		
+		case kFireSaved:
+			HandleFireSaved( in );
+			break;
 
 		default:
 			BApplication::MessageReceived( in );
@@ -414,17 +1204,51 @@ void		EventServer::ReadyToRun()
 	{
 		utl_Deb = new DebuggerPrintout( "Did not succeed to read the preferences!" );
 	}
+	WatchPreferences();
 	
 	utl_RegisterFileType();	
 	
+	fListWindow = new ActivityListWindow( fCurrentMessenger );
+	if ( !fListWindow || fListWindow->InitCheck() != B_OK ) {
+		utl_Deb = new DebuggerPrintout( "Did not succeed to create the activities list!" );
+		// Not fatal - every activity will open its own window
+		if ( fListWindow ) {
+			fListWindow->Lock();
+			fListWindow->Quit();
+			fListWindow = NULL;
+		}
+	}
+	fPipeline->SetListWindow( fListWindow );
+	
+	if ( fPipeline->Start() != B_OK ) {
+		utl_Deb = new DebuggerPrintout( "Did not succeed to start the firing threads!" );
+		global_toReturn = B_ERROR;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+		return;
+	}
+	
 		
-	// Immediately perform the first check
-	this->Pulse();
+	// Load the index; overdue Events fire immediately
+	StartVolumeQueries();
 
 }	// <-- end of function EventServer::ReadyToRun
 
 
 
+/*!	\brief		Stop firing before the windows are closed.
+ *		\details		The pipeline's threads post to the activities list window, so
+ *						they are stopped before the application quits its windows.
+ */
+bool		EventServer::QuitRequested()
+{
+	if ( fPipeline ) {
+		fPipeline->Stop();
+	}
+	return BApplication::QuitRequested();
+}	// <-- end of function EventServer::QuitRequested
+
+
+
 /*!	\brief		User wants the "about" information.
  */
 void		EventServer::AboutRequested() {
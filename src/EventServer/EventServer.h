@@ -9,13 +9,44 @@
 #include <Application.h>
 #include <Entry.h>
 #include <Message.h>
+#include <MessageRunner.h>
 #include <Query.h>
+#include <Volume.h>
+#include <VolumeRoster.h>
+#include <String.h>
 #include <SupportDefs.h>
 
+// Project includes
+#include "EventIndex.h"
+#include "EventScheduler.h"
+
+class EventCache;
+class FirePipeline;
+class ActivityListWindow;
+class VolumeQuery;
+
+// STL includes
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+/*!	\brief		An activity that was missed and waits to be passed to the pipeline.
+ */
+struct BacklogEntry {
+	entry_ref	ref;			//!< The Event file.
+	node_ref		node;			//!< Node of the Event file.
+	bool			bReminder;	//!< \c true for the reminder activity.
+};
+
 
 extern uint32	global_toReturn;
 
-/*!	\brief		Class that polls the events and finds what events should fire.
+/*!	\brief		Class that keeps track of the events and fires them when they are due.
+ *		\details		The server does not poll. It keeps a resident index of pending
+ *						Events, fed by live queries on all volumes and node monitoring,
+ *						and sleeps on a single timer until the earliest deadline in its
+ *						EventScheduler.
  */
 class EventServer :
 	public BApplication
@@ -27,32 +58,75 @@ public:
 	virtual void ReadyToRun();
 	virtual void MessageReceived( BMessage* in );
 	virtual void AboutRequested();
-	
-	virtual void Pulse();
+	virtual bool QuitRequested();
 	
 protected:
 	//!	\name		Data members
 	///@{
-	BQuery fEventQuery;		//!< Query working with events' start time
-	BQuery fReminderQuery;	//!< Query working with reminders' start time
+	std::map< dev_t, VolumeQuery* >	fVolumeQueries;	//!< Live queries of pending Events, per volume.
+	BVolumeRoster	fVolumeRoster;	//!< Reports volumes being mounted and unmounted.
 	time_t fCurrentTime;		//!< Current time
 	BMessenger*	fCurrentMessenger;	//!< Way to send messages to the current application.
+	FirePipeline*	fPipeline;		//!< Runs the activities out of the application's thread.
+	ActivityListWindow*	fListWindow;	//!< Shows the activities fired together.
+	EventIndex		fIndex;			//!< Resident index of all pending Events.
+	EventCache*		fCache;			//!< Decoded Events kept between the runs, or \c NULL.
+	EventScheduler	fScheduler;		//!< Deadlines of all pending activities.
+	BMessageRunner*	fWakeUpRunner;	//!< Single-shot timer set to the earliest deadline.
+	std::set< node_ref, NodeRefLess >	fDirtyNodes;	//!< Indexed files changed since last refresh.
+	bool		bRefreshRequested;		//!< \c true if refresh of the index is already queued.
+	node_ref	fPreferencesFile;			//!< The watched preferences file.
+	node_ref	fPreferencesDirectory;	//!< Directory of the preferences file.
+	bool		bPreferencesReloadRequested;	//!< \c true if reload is already queued.
+	std::deque< BacklogEntry >	fBacklog;	//!< Missed activities, drained at a limited rate.
+	BMessageRunner*	fDrainRunner;	//!< Periodic timer that drains the backlog.
+	time_t	fLastWakeUpTime;			//!< Used to detect the clock being moved back.
+	std::set< node_ref, NodeRefLess >	fEventsInFlight;		//!< Event activities fired, but not saved yet.
+	std::set< node_ref, NodeRefLess >	fRemindersInFlight;	//!< Reminders fired, but not saved yet.
 	///@}
 	
 	//!	\name		Service functions
 	///@{
-	virtual void		PerformEventQuery();
-	virtual void		PrepareEventQuery();
+	virtual void		StartVolumeQueries();
+	virtual void		AddVolume( const BVolume& volume );
+	virtual void		RemoveVolume( dev_t device );
+	virtual void		HandleVolumeMonitor( BMessage* in, int32 opcode );
+	virtual void		IndexRefs( BMessage* in );
+	virtual void		IndexEntry( const entry_ref& ref );
+	virtual void		UnindexNode( const node_ref& node );
+	virtual void		HandleQueryUpdate( BMessage* in );
+	virtual void		HandleNodeMonitor( BMessage* in );
+	virtual void		HandleMigrationProgress( BMessage* in );
+	virtual void		RefreshIndex();
+	virtual void		RequestRefresh( const node_ref& node );
+
+	virtual void		SyncFire( ScheduledFire** handle,
+									  bool bPending,
+									  time_t deadline,
+									  const node_ref& node,
+									  bool bReminder );
+	virtual void		SyncFires( EventIndexRecord* record );
+	virtual void		SnoozeInIndex( const entry_ref& ref, bool bReminder,
+											int32 hours, int32 minutes );
+	virtual void		ArmWakeUpTimer();
+	virtual void		ResetSchedule();
 	
-	virtual void		PerformReminderQuery();
-	virtual void		PrepareReminderQuery();
+	virtual void		AddToSummary( BString* summary, const entry_ref& ref, bool bReminder );
+	virtual void		ShowOverdueSummary( const BString& names, int32 count );
+	virtual void		StartDrainingBacklog();
+	virtual void		DrainBacklog();
+	virtual void		FireDueEntries();
+	virtual void		ForgetInFlight( const node_ref& node, bool bReminder );
+	virtual void		HandleFireSaved( BMessage* in );
 
-	virtual void		DealWithEntries( BQuery* in, bool bReminder = false );
 	
 	static  void		SnoozeActivity( entry_ref ref, bool bReminder,
 												 int32 hours, int32 minutes );
 	
-	virtual void		UpdateCategories();
+	virtual void		UpdatePreferences();
+	virtual void		WatchPreferences();
+	virtual bool		HandlePreferencesMonitor( BMessage* in, int32 opcode,
+															 const node_ref& node );
 	///@}
 };
 
@@ -0,0 +1,481 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "ActivityData.h"
+#include "ActivityWindow.h"
+#include "FirePipeline.h"
+
+// OS includes
+#include <Application.h>
+#include <InterfaceDefs.h>
+#include <Message.h>
+
+// POSIX includes
+#include <time.h>
+
+
+
+/*!	\brief		Return value of the program, defined by the server.
+ */
+extern	uint32	global_toReturn;
+
+
+/*!	\brief		Sizes of the queues - powers of two.
+ */
+const		int32		kDecodeQueueSize		= 256;
+const		int32		kPersistQueueSize		= 64;
+const		int32		kRunQueueSize			= 64;
+
+
+/*!	\brief		Maximal number of flags saved in one batch.
+ */
+const		int32		kPersistBatchSize		= 64;
+
+
+/*!	\brief		Number of workers in each stage.
+ *		\details		The "fired" flags are persisted by a single thread, so that the
+ *						disk is not seeked back and forth.
+ */
+const		int32		kDecodeThreads			= 2;
+const		int32		kPersistThreads		= 1;
+const		int32		kRunThreads				= 4;
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class FirePipeline
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\param[in]	target			Messenger of the server, for the snooze messages.
+ *		\param[in]	snoozeCommand	"what" of the snooze message.
+ *		\param[in]	savedCommand	"what" of the message which tells the server that
+ *											the pipeline is done with the "fired" flag.
+ */
+FirePipeline::FirePipeline( BMessenger* target, uint32 snoozeCommand, uint32 savedCommand )
+	:
+	fTarget( target ),
+	fSnoozeCommand( snoozeCommand ),
+	fSavedCommand( savedCommand ),
+	fListWindow( NULL ),
+	fCategoriesLock( "Categories lock" ),
+	fDecodeQueue( kDecodeQueueSize ),
+	fPersistQueue( kPersistQueueSize ),
+	fRunQueue( kRunQueueSize ),
+	fThreadsCount( 0 )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+FirePipeline::~FirePipeline()
+{
+	Stop();
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Start the workers of all stages.
+ */
+status_t		FirePipeline::Start()
+{
+	int32		i;
+	thread_id	thread;
+	status_t		status;
+
+	if ( ( ( status = fDecodeQueue.InitCheck() ) != B_OK ) ||
+		  ( ( status = fPersistQueue.InitCheck() ) != B_OK ) ||
+		  ( ( status = fRunQueue.InitCheck() ) != B_OK ) )
+	{
+		return status;
+	}
+
+	for ( i = 0; i < kDecodeThreads + kPersistThreads + kRunThreads; ++i )
+	{
+		if ( i < kDecodeThreads ) {
+			thread = spawn_thread( DecodeThread, "Event decoder", B_NORMAL_PRIORITY, this );
+		} else if ( i < kDecodeThreads + kPersistThreads ) {
+			thread = spawn_thread( PersistThread, "Event saver", B_LOW_PRIORITY, this );
+		} else {
+			thread = spawn_thread( RunThread, "Activity runner", B_NORMAL_PRIORITY, this );
+		}
+		if ( thread < B_OK ) {
+			return thread;
+		}
+		fThreads[ fThreadsCount++ ] = thread;
+		resume_thread( thread );
+	}
+
+	return B_OK;
+}	// <-- end of function FirePipeline::Start
+
+
+
+/*!	\brief		Stop the workers.
+ *		\details		Every worker finishes the job it's busy with; the jobs still
+ *						waiting in the queues are dropped and deleted.
+ */
+void		FirePipeline::Stop()
+{
+	status_t		threadStatus;
+	FireJob*		job;
+
+	fDecodeQueue.Close();
+	fPersistQueue.Close();
+	fRunQueue.Close();
+
+	for ( int32 i = 0; i < fThreadsCount; ++i ) {
+		wait_for_thread( fThreads[ i ], &threadStatus );
+	}
+	fThreadsCount = 0;
+
+	while ( NULL != ( job = fDecodeQueue.TakeLeftover() ) ) {
+		DeleteJob( job );
+	}
+	while ( NULL != ( job = fPersistQueue.TakeLeftover() ) ) {
+		DeleteJob( job );
+	}
+	while ( NULL != ( job = fRunQueue.TakeLeftover() ) ) {
+		DeleteJob( job );
+	}
+}	// <-- end of function FirePipeline::Stop
+
+
+
+/*!	\brief		First stage - the server passes the ref of a due Event.
+ *		\details		Returns as soon as the job is queued. The "fired" flag is
+ *						always saved; the notification and the activity are optional.
+ *		\param[in]	ref			The Event file.
+ *		\param[in]	node			Node of the Event file; returned in the "saved" message.
+ *		\param[in]	bReminder	\c true for the reminder activity.
+ *		\param[in]	notifyMode	How to show the notification. If the list window
+ *										is not set, NOTIFY_LIST falls back to a window.
+ *		\param[in]	bRun			\c true to run the program and sound.
+ */
+status_t		FirePipeline::Fire( const entry_ref& ref,
+											 const node_ref& node,
+											 bool bReminder,
+											 NotifyMode notifyMode,
+											 bool bRun )
+{
+	status_t	status;
+	FireJob* job = new FireJob;
+	if ( !job ) {
+		return B_NO_MEMORY;
+	}
+	job->ref = ref;
+	job->node = node;
+	job->bReminder = bReminder;
+	job->notifyMode = notifyMode;
+	if ( notifyMode == NOTIFY_LIST && !fListWindow ) {
+		job->notifyMode = NOTIFY_WINDOW;
+	}
+	job->bRun = bRun;
+	job->eventData = NULL;
+
+	if ( ( status = fDecodeQueue.Push( job ) ) != B_OK ) {
+		DeleteJob( job );
+	}
+	return status;
+}	// <-- end of function FirePipeline::Fire
+
+
+
+/*!	\brief		Main function of the decoding threads.
+ */
+int32		FirePipeline::DecodeThread( void* data )
+{
+	FirePipeline* me = ( FirePipeline* )data;
+	FireJob* job;
+
+	while ( NULL != ( job = me->fDecodeQueue.Pop() ) )
+	{
+		if ( !me->Decode( job ) ) {
+			me->Acknowledge( job );
+			DeleteJob( job );
+			continue;
+		}
+		if ( job->notifyMode != NOTIFY_NONE ) {
+			me->Notify( job );
+		}
+		if ( me->fPersistQueue.Push( job ) != B_OK ) {
+			DeleteJob( job );
+		}
+	}
+	return B_OK;
+}	// <-- end of function FirePipeline::DecodeThread
+
+
+
+/*!	\brief		Main function of the persisting thread.
+ *		\details		Everything that was fired in the same tick is queued at once,
+ *						so the thread takes all queued jobs and saves them as a batch.
+ */
+int32		FirePipeline::PersistThread( void* data )
+{
+	FirePipeline* me = ( FirePipeline* )data;
+	FireJob* batch[ kPersistBatchSize ];
+	int32		count, i;
+
+	while ( NULL != ( batch[ 0 ] = me->fPersistQueue.Pop() ) )
+	{
+		count = 1;
+		while ( ( count < kPersistBatchSize ) &&
+				  ( NULL != ( batch[ count ] = me->fPersistQueue.Pop( false ) ) ) )
+		{
+			++count;
+		}
+
+		me->Persist( batch, count );
+
+		for ( i = 0; i < count; ++i ) {
+			me->Acknowledge( batch[ i ] );
+			if ( me->fRunQueue.Push( batch[ i ] ) != B_OK ) {
+				DeleteJob( batch[ i ] );
+			}
+		}
+	}
+	return B_OK;
+}	// <-- end of function FirePipeline::PersistThread
+
+
+
+/*!	\brief		Tell the server that the pipeline is done with the "fired" flag.
+ *		\details		Until then, the server keeps the activity fired, even if it
+ *						re-reads the file in the meantime and sees the old flag.
+ */
+void		FirePipeline::Acknowledge( FireJob* job )
+{
+	BMessage	saved( fSavedCommand );
+
+	if ( !fTarget ) { return; }
+	saved.AddInt32( "device", job->node.device );
+	saved.AddInt64( "node", job->node.node );
+	saved.AddBool( "Reminder", job->bReminder );
+	fTarget->SendMessage( &saved );
+}	// <-- end of function FirePipeline::Acknowledge
+
+
+
+/*!	\brief		Main function of the activity threads.
+ */
+int32		FirePipeline::RunThread( void* data )
+{
+	FirePipeline* me = ( FirePipeline* )data;
+	FireJob* job;
+
+	while ( NULL != ( job = me->fRunQueue.Pop() ) )
+	{
+		if ( job->bRun ) {
+			me->Run( job );
+		}
+		DeleteJob( job );
+	}
+	return B_OK;
+}	// <-- end of function FirePipeline::RunThread
+
+
+
+/*!	\brief		Read the Event file.
+ *		\returns		\c false if the activity should not be fired.
+ */
+bool		FirePipeline::Decode( FireJob* job )
+{
+	job->eventData = new EventData( job->ref );
+	if ( !job->eventData ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+		return false;
+	}
+
+	// The file might have been changed since it was scheduled
+	if ( ( job->bReminder && job->eventData->WasReminderActivityFired() ) ||
+		  ( !job->bReminder && job->eventData->WasEventActivityFired() ) )
+	{
+		return false;
+	}
+	return true;
+}	// <-- end of function FirePipeline::Decode
+
+
+
+/*!	\brief		Open the notification window of the activity.
+ *		\details		The window is shown before the "fired" flag is saved and before
+ *						the activity runs, so neither of them can delay it.
+ *						In the NOTIFY_LIST mode, no window is created - the activity is
+ *						added as a row to the shared list window.
+ */
+void		FirePipeline::Notify( FireJob* job )
+{
+	ActivityWindow* actWindow;
+	const EventData* eventData = job->eventData;
+	const ActivityData* activityData;
+	Category* found;
+	Category category( "Default", ui_color( B_WINDOW_TAB_COLOR ) );
+	BMessage* toSend;
+
+	// Obtain the activity data - only for reading, the Event is not changed
+	if ( job->bReminder ) {
+		activityData = eventData->GetReminderActivity();
+	} else {
+		activityData = eventData->GetEventActivity();
+	}
+
+	// Obtain the category name and color; if unsuccessfully, failback to "Default"
+	fCategoriesLock.Lock();
+	if ( NULL == ( found = FindCategory( job->eventData->GetCategory() ) ) ) {
+		found = FindDefaultCategory();
+	}
+	if ( found ) {
+		category = *found;
+	}
+	fCategoriesLock.Unlock();
+
+	// Build the template message
+	toSend = new BMessage( fSnoozeCommand );
+	if ( !toSend ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+		return;
+	}
+	toSend->AddRef( "Event to snooze", &job->ref );
+	toSend->AddBool( "Reminder", job->bReminder );
+
+	if ( job->notifyMode == NOTIFY_LIST ) {
+		BString notificationText;
+		
+		// Same rule as the ActivityWindow - nothing to do, nothing to show
+		if ( !activityData ||
+			  ( !activityData->GetNotification( NULL ) &&
+				 !activityData->GetSound( NULL ) &&
+				 !activityData->GetProgram( NULL, NULL ) ) )
+		{
+			delete toSend;
+			return;
+		}
+		if ( !activityData->GetNotification( &notificationText ) ) {
+			notificationText.Truncate( 0 );
+		}
+		fListWindow->PostActivity( job->eventData->GetEventName(),
+											category,
+											notificationText,
+											job->bReminder,
+											*toSend );
+		delete toSend;
+		return;
+	}
+
+	// Open the activity window
+	actWindow = new ActivityWindow( activityData,
+											  fTarget,
+											  job->eventData->GetEventName(),
+											  &category,
+											  toSend,
+											  job->bReminder );
+	if ( !actWindow ) {
+		/* Panic! */
+		global_toReturn = B_NO_MEMORY;
+		be_app->PostMessage( B_QUIT_REQUESTED );
+	} else {
+		actWindow->Show();
+	}
+}	// <-- end of function FirePipeline::Notify
+
+
+
+/*!	\brief		Save the "fired" flags of a batch of activities.
+ *		\details		Only the flag attribute is written - the rest of the file, and
+ *						the indexes of the other attributes, are left alone.
+ *
+ *						A repeating Event whose occurrence is over is moved to the next
+ *						occurrence instead: its next times are rewritten, and both flags
+ *						are cleared. All the jobs of the batch use the same moment, so
+ *						the Events fired in one tick are advanced consistently.
+ */
+void		FirePipeline::Persist( FireJob** jobs, int32 count )
+{
+	FireJob*	job;
+	time_t	now = time( NULL );
+	time_t	nextOccurrence;
+	time_t	reminderOffset;
+	bool		bReminderBeforeEvent;
+
+	for ( int32 i = 0; i < count; ++i )
+	{
+		job = jobs[ i ];
+		if ( job->bReminder ) {
+			job->eventData->SetReminderActivityFired( true );
+		} else {
+			job->eventData->SetEventActivityFired( true );
+		}
+
+		if ( ( nextOccurrence = NextOccurrence( job, now ) ) != 0 ) {
+			reminderOffset = job->eventData->GetReminderOffset( &bReminderBeforeEvent );
+			EventData::SaveNextOccurrence( job->ref, ( int64 )nextOccurrence,
+													 bReminderBeforeEvent ? ( int64 )reminderOffset : -( int64 )reminderOffset );
+		} else {
+			EventData::SaveFiredFlag( job->ref, job->bReminder );
+		}
+	}
+}	// <-- end of function FirePipeline::Persist
+
+
+
+/*!	\brief		The next occurrence of the Event, if the fired activity ends this one.
+ *		\details		The occurrence ends with the Event activity - unless the reminder
+ *						is set to fire after the Event, in which case it ends with the
+ *						reminder.
+ *		\param[in]	now		The moment the batch is saved at.
+ *		\returns		Start of the next occurrence, or 0 if the Event doesn't repeat, the
+ *						occurrence is not over yet, or there are no more occurrences.
+ */
+time_t		FirePipeline::NextOccurrence( FireJob* job, time_t now )
+{
+	EventData*	eventData = job->eventData;
+	bool			bReminderBeforeEvent;
+	bool			bReminderAfterEvent;
+
+	if ( !eventData->IsRepeating() ) { return 0; }
+
+	bReminderAfterEvent = ( eventData->GetReminderOffset( &bReminderBeforeEvent ) != 0 &&
+									!bReminderBeforeEvent );
+	if ( job->bReminder != bReminderAfterEvent ) { return 0; }
+
+	return eventData->NextOccurrenceAfter( now );
+}	// <-- end of function FirePipeline::NextOccurrence
+
+
+
+/*!	\brief		Run the activity - program and sound.
+ */
+void		FirePipeline::Run( FireJob* job )
+{
+	const EventData* eventData = job->eventData;
+
+	if ( job->bReminder ) {
+		ActivityData::PerformActivity( eventData->GetReminderActivity() );
+	} else {
+		ActivityData::PerformActivity( eventData->GetEventActivity() );
+	}
+}	// <-- end of function FirePipeline::Run
+
+
+
+/*!	\brief		Free the job and everything it owns.
+ */
+void		FirePipeline::DeleteJob( FireJob* job )
+{
+	if ( !job ) { return; }
+
+	if ( job->eventData ) {
+		delete job->eventData;
+	}
+	delete job;
+}	// <-- end of function FirePipeline::DeleteJob
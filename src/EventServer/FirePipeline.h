@@ -0,0 +1,101 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _FIRE_PIPELINE_H_
+#define _FIRE_PIPELINE_H_
+
+// OS includes
+#include <Entry.h>
+#include <Locker.h>
+#include <Messenger.h>
+#include <Node.h>
+#include <OS.h>
+#include <SupportDefs.h>
+
+// Project includes
+#include "ActivityListWindow.h"
+#include "Category.h"
+#include "Event.h"
+#include "FireQueue.h"
+
+
+/*!	\brief		How the user is notified about a fired activity.
+ */
+enum NotifyMode {
+	NOTIFY_NONE = 0,				//!< No window at all.
+	NOTIFY_WINDOW,					//!< A separate ActivityWindow.
+	NOTIFY_LIST						//!< A row in the shared ActivityListWindow.
+};
+
+
+/*!	\brief		One activity on its way through the pipeline.
+ */
+struct FireJob {
+	entry_ref	ref;				//!< The Event file.
+	node_ref		node;				//!< Node of the Event file.
+	bool			bReminder;		//!< \c true for the reminder activity.
+	NotifyMode	notifyMode;		//!< How the notification is shown.
+	bool			bRun;				//!< \c true if the program and sound should run.
+	EventData*	eventData;		//!< The decoded Event; owned by the job.
+};
+
+
+
+/*!	\brief		Runs the activities of the Events out of the application's thread.
+ *		\details		Firing an Event is split into stages, each with its own threads:
+ *						- The server's looper fetches the refs of due Events and passes them in.
+ *						- Decoding threads read the Event files and show the notifications.
+ *						- A single thread persists the "fired" flags, in batches, and
+ *						  moves the repeating Events to their next occurrences.
+ *						- Several threads run the activities - programs and sounds.
+ *						A slow disk or a hung program blocks only the thread it runs in.
+ */
+class FirePipeline
+{
+public:
+	FirePipeline( BMessenger* target, uint32 snoozeCommand, uint32 savedCommand );
+	virtual ~FirePipeline();
+
+	virtual status_t		Start();
+	virtual void			Stop();
+
+	virtual status_t		Fire( const entry_ref& ref,
+										const node_ref& node,
+										bool bReminder,
+										NotifyMode notifyMode = NOTIFY_WINDOW,
+										bool bRun = true );
+
+	//! Set the window which collects the activities fired together.
+	virtual void			SetListWindow( ActivityListWindow* in ) { fListWindow = in; }
+
+	//! Guards the global list of categories while the decoding threads use it.
+	BLocker&					CategoriesLock() { return fCategoriesLock; }
+
+protected:
+	static int32			DecodeThread( void* data );
+	static int32			PersistThread( void* data );
+	static int32			RunThread( void* data );
+
+	virtual bool			Decode( FireJob* job );
+	virtual void			Notify( FireJob* job );
+	virtual void			Persist( FireJob** jobs, int32 count );
+	virtual time_t			NextOccurrence( FireJob* job, time_t now );
+	virtual void			Acknowledge( FireJob* job );
+	virtual void			Run( FireJob* job );
+	static  void			DeleteJob( FireJob* job );
+
+	BMessenger*		fTarget;				//!< Where the snooze and "saved" messages are sent.
+	uint32			fSnoozeCommand;	//!< The "what" of the snooze message.
+	uint32			fSavedCommand;		//!< The "what" of the message sent once the flag is saved.
+	ActivityListWindow*	fListWindow;	//!< Belongs to the server; may be \c NULL.
+	BLocker			fCategoriesLock;
+	FireQueue		fDecodeQueue;
+	FireQueue		fPersistQueue;
+	FireQueue		fRunQueue;
+	thread_id		fThreads[ 8 ];		//!< Workers of all stages.
+	int32				fThreadsCount;
+};
+
+
+#endif // _FIRE_PIPELINE_H_
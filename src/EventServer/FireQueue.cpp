@@ -0,0 +1,292 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "FireQueue.h"
+
+// C++ includes
+#include <new>
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class FireQueue
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\param[in]	capacity		Maximal number of jobs in the queue, a power of two.
+ */
+FireQueue::FireQueue( int32 capacity )
+	:
+	fCells( NULL ),
+	fMask( capacity - 1 ),
+	fEnqueuePos( 0 ),
+	fDequeuePos( 0 ),
+	fPushWaiters( 0 ),
+	fPopWaiters( 0 ),
+	fItems( -1 ),
+	fFreeCells( -1 ),
+	fClosed( 0 ),
+	fLastError( B_OK )
+{
+	if ( capacity <= 0 || ( capacity & ( capacity - 1 ) ) != 0 ) {
+		fLastError = B_BAD_VALUE;
+		return;
+	}
+
+	fCells = new ( std::nothrow ) Cell[ capacity ];
+	if ( !fCells ) {
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	for ( int32 i = 0; i < capacity; ++i ) {
+		fCells[ i ].sequence = i;
+		fCells[ i ].job = NULL;
+	}
+
+	fItems = create_sem( 0, "Fire queue items" );
+	fFreeCells = create_sem( 0, "Fire queue free cells" );
+	if ( fItems < B_OK || fFreeCells < B_OK ) {
+		fLastError = B_NO_MORE_SEMS;
+	}
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ *		\details		The jobs still in the queue are not deleted - the owner of the
+ *						queue should take them with TakeLeftover() first.
+ */
+FireQueue::~FireQueue()
+{
+	Close();
+	delete [] fCells;
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Add a job to the queue.
+ *		\details		Blocks while the queue is full.
+ *		\returns		B_OK if the job was added, error if the queue was closed.
+ */
+status_t		FireQueue::Push( FireJob* job )
+{
+	status_t	status;
+
+	if ( !job ) { return B_BAD_VALUE; }
+	if ( fLastError != B_OK ) { return fLastError; }
+
+	while ( !TryPush( job ) )
+	{
+		if ( atomic_get( &fClosed ) != 0 ) { return B_NOT_ALLOWED; }
+
+		// Full. A consumer which frees a cell from now on will see the waiter.
+		atomic_add( &fPushWaiters, 1 );
+		if ( TryPush( job ) ) {
+			CancelWait( &fPushWaiters, fFreeCells );
+			break;
+		}
+		do {
+			status = acquire_sem( fFreeCells );
+		} while ( status == B_INTERRUPTED );
+
+		if ( status != B_OK ) { return B_NOT_ALLOWED; }
+	}
+
+	Wake( &fPopWaiters, fItems );
+	return B_OK;
+}	// <-- end of function FireQueue::Push
+
+
+
+/*!	\brief		Take a job from the queue.
+ *		\details		Blocks while the queue is empty, unless told not to.
+ *		\param[in]	bWait		If \c false, return immediately when the queue is empty.
+ *		\returns		The job, or \c NULL if the queue was closed (or is empty).
+ */
+FireJob*		FireQueue::Pop( bool bWait )
+{
+	FireJob*	toReturn;
+	status_t	status;
+
+	if ( fLastError != B_OK ) { return NULL; }
+
+	while ( NULL == ( toReturn = TryPop() ) )
+	{
+		if ( !bWait || atomic_get( &fClosed ) != 0 ) { return NULL; }
+
+		// Empty. A producer which publishes a job from now on will see the waiter.
+		atomic_add( &fPopWaiters, 1 );
+		if ( NULL != ( toReturn = TryPop() ) ) {
+			CancelWait( &fPopWaiters, fItems );
+			break;
+		}
+		do {
+			status = acquire_sem( fItems );
+		} while ( status == B_INTERRUPTED );
+
+		if ( status != B_OK ) { return NULL; }
+	}
+
+	Wake( &fPushWaiters, fFreeCells );
+	return toReturn;
+}	// <-- end of function FireQueue::Pop
+
+
+
+/*!	\brief		Wake up everyone waiting on the queue, and refuse new jobs.
+ */
+void		FireQueue::Close()
+{
+	if ( atomic_test_and_set( &fClosed, 1, 0 ) != 0 ) { return; }
+
+	if ( fLastError == B_OK ) {
+		fLastError = B_NOT_ALLOWED;
+	}
+	if ( fItems >= B_OK ) {
+		delete_sem( fItems );
+	}
+	if ( fFreeCells >= B_OK ) {
+		delete_sem( fFreeCells );
+	}
+}	// <-- end of function FireQueue::Close
+
+
+
+/*!	\brief		Take a job which was left in a closed queue.
+ *		\details		Call it only when no thread uses the queue any more.
+ *		\returns		The job, or \c NULL if there are no more jobs.
+ */
+FireJob*		FireQueue::TakeLeftover()
+{
+	Cell*		cell;
+	FireJob*	toReturn;
+
+	if ( !fCells ) { return NULL; }
+
+	while ( fDequeuePos != fEnqueuePos )
+	{
+		cell = &fCells[ fDequeuePos & fMask ];
+		toReturn = ( cell->sequence == fDequeuePos + 1 ) ? cell->job : NULL;
+		cell->job = NULL;
+		cell->sequence = fDequeuePos + fMask + 1;
+		++fDequeuePos;
+		if ( toReturn ) {
+			return toReturn;
+		}
+	}
+	return NULL;
+}	// <-- end of function FireQueue::TakeLeftover
+
+
+
+/*!	\brief		Put the job into the next cell, if it's free.
+ *		\details		The cell is claimed by advancing the enqueue position; if another
+ *						producer advanced it first, the next cell is tried.
+ *		\returns		\c false if the queue is full.
+ */
+bool		FireQueue::TryPush( FireJob* job )
+{
+	Cell*		cell;
+	int32		pos, seen, diff;
+
+	pos = atomic_get( &fEnqueuePos );
+	while ( true )
+	{
+		cell = &fCells[ pos & fMask ];
+		diff = ( int32 )( ( uint32 )atomic_get( &cell->sequence ) - ( uint32 )pos );
+		if ( diff < 0 ) {
+			// The consumer of the previous round didn't free the cell yet
+			return false;
+		}
+		if ( diff == 0 ) {
+			seen = atomic_test_and_set( &fEnqueuePos, pos + 1, pos );
+			if ( seen == pos ) { break; }
+			pos = seen;
+		} else {
+			pos = atomic_get( &fEnqueuePos );
+		}
+	}
+
+	cell->job = job;
+	atomic_set( &cell->sequence, pos + 1 );
+	return true;
+}	// <-- end of function FireQueue::TryPush
+
+
+
+/*!	\brief		Take the job from the next cell, if it was published.
+ *		\returns		The job, or \c NULL if the queue is empty.
+ */
+FireJob*		FireQueue::TryPop()
+{
+	Cell*		cell;
+	FireJob*	toReturn;
+	int32		pos, seen, diff;
+
+	pos = atomic_get( &fDequeuePos );
+	while ( true )
+	{
+		cell = &fCells[ pos & fMask ];
+		diff = ( int32 )( ( uint32 )atomic_get( &cell->sequence ) - ( uint32 )( pos + 1 ) );
+		if ( diff < 0 ) {
+			// The producer didn't publish the job yet
+			return NULL;
+		}
+		if ( diff == 0 ) {
+			seen = atomic_test_and_set( &fDequeuePos, pos + 1, pos );
+			if ( seen == pos ) { break; }
+			pos = seen;
+		} else {
+			pos = atomic_get( &fDequeuePos );
+		}
+	}
+
+	toReturn = cell->job;
+	cell->job = NULL;
+	atomic_set( &cell->sequence, pos + fMask + 1 );
+	return toReturn;
+}	// <-- end of function FireQueue::TryPop
+
+
+
+/*!	\brief		Wake up one of the threads that wait on the semaphore, if any.
+ *		\details		The waiter is taken off the count here, so the following calls
+ *						don't release the semaphore for it again.
+ */
+void		FireQueue::Wake( int32* waiters, sem_id sem )
+{
+	int32		count;
+
+	while ( ( count = atomic_get( waiters ) ) > 0 )
+	{
+		if ( atomic_test_and_set( waiters, count - 1, count ) == count ) {
+			release_sem( sem );
+			return;
+		}
+	}
+}	// <-- end of function FireQueue::Wake
+
+
+
+/*!	\brief		Take back the waiter of a thread which didn't have to wait after all.
+ *		\details		If another thread took it off the count already, it released
+ *						the semaphore for it - the release is consumed here.
+ */
+void		FireQueue::CancelWait( int32* waiters, sem_id sem )
+{
+	int32		count;
+	status_t	status;
+
+	while ( ( count = atomic_get( waiters ) ) > 0 )
+	{
+		if ( atomic_test_and_set( waiters, count - 1, count ) == count ) {
+			return;
+		}
+	}
+	do {
+		status = acquire_sem( sem );
+	} while ( status == B_INTERRUPTED );
+}	// <-- end of function FireQueue::CancelWait
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _FIRE_QUEUE_H_
+#define _FIRE_QUEUE_H_
+
+// OS includes
+#include <OS.h>
+#include <SupportDefs.h>
+
+struct FireJob;
+
+
+/*!	\brief		Bounded queue of jobs between two stages of the pipeline.
+ *		\details		The jobs are kept in a ring of cells. A producer claims the next
+ *						cell by advancing the enqueue position with compare-and-set, and
+ *						publishes the job by advancing the cell's sequence number; a
+ *						consumer does the same with the dequeue position. No thread ever
+ *						waits for another one inside the ring: a cell that is not ready
+ *						for the thread means that the queue is full (or empty) for it.
+ *
+ *						Only there a thread blocks, on a semaphore. It counts itself as a
+ *						waiter first and tries once more; the thread that frees a cell
+ *						(or publishes a job) takes one waiter off the count and releases
+ *						the semaphore for it. While the queue is neither empty nor full,
+ *						no semaphore is touched.
+ */
+class FireQueue
+{
+public:
+	FireQueue( int32 capacity );
+	virtual ~FireQueue();
+
+	virtual status_t		InitCheck() const { return fLastError; }
+
+	virtual status_t		Push( FireJob* job );
+	virtual FireJob*		Pop( bool bWait = true );
+	virtual void			Close();
+	virtual FireJob*		TakeLeftover();
+
+protected:
+	/*!	\brief		A cell of the ring.
+	 *		\details		The sequence number tells whose turn it is: it equals the
+	 *						position for the producer, and position + 1 for the consumer.
+	 */
+	struct Cell {
+		int32			sequence;
+		FireJob*		job;
+	};
+
+	virtual bool			TryPush( FireJob* job );
+	virtual FireJob*		TryPop();
+	virtual void			Wake( int32* waiters, sem_id sem );
+	virtual void			CancelWait( int32* waiters, sem_id sem );
+
+	Cell*		fCells;				//!< The ring.
+	int32		fMask;				//!< Capacity minus one; capacity is a power of two.
+	int32		fEnqueuePos;		//!< Next position to be written.
+	int32		fDequeuePos;		//!< Next position to be read.
+	int32		fPushWaiters;		//!< Producers which found the queue full, not woken yet.
+	int32		fPopWaiters;		//!< Consumers which found the queue empty, not woken yet.
+	sem_id	fItems;				//!< Wakes the consumers up.
+	sem_id	fFreeCells;			//!< Wakes the producers up.
+	int32		fClosed;				//!< Set atomically by Close().
+	status_t	fLastError;
+};
+
+
+#endif // _FIRE_QUEUE_H_
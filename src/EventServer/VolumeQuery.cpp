@@ -0,0 +1,427 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "Event.h"
+#include "Utilities.h"
+#include "VolumeQuery.h"
+#include "WorkerPool.h"
+
+// OS includes
+#include <Directory.h>
+#include <Entry.h>
+#include <Message.h>
+#include <Node.h>
+#include <String.h>
+#include <fs_attr.h>
+
+
+
+/*!	\brief		Number of refs passed to the target in one message.
+ */
+const		int32		kRefsBatchSize		= 64;
+
+
+/*!	\brief		Number of files migrated between two progress reports.
+ */
+const		int32		kMigrationBatchSize	= 256;
+
+
+/*!	\brief		Number of threads that rewrite a batch, including the querying one.
+ *		\details		The rewriting waits for the disk, not for the CPU - several
+ *						threads give the disk more requests to order.
+ */
+const		int32		kMaxMigrationThreads	= 4;
+
+
+/*!	\brief		Attribute of the volume's root directory that marks a migrated volume.
+ *		\details		Holds \c kTimeAttributesFormat when all Event files of the volume
+ *						have 64-bit time attributes.
+ */
+const		char*		kTimeFormatAttribute	= "EVNT:time_format";
+const		int32		kTimeAttributesFormat	= 64;
+
+
+/*!	\brief		Time attributes of the Event files, which used to be 32-bit.
+ *		\details		"EVNT:next_occurrence" is the last one: it's rewritten only after
+ *						all others, so its type tells if the file was migrated.
+ */
+static const char*	kTimeAttributes[] = {
+	"EVNT:duration",
+	"EVNT:reminder_offset",
+	"EVNT:next_reminder",
+	"EVNT:next_due",
+	"EVNT:next_occurrence",
+	NULL
+};
+
+
+/*!	\brief		The threads that migrate the batches.
+ *		\details		Shared by all volumes; a volume whose batch is ready while
+ *						another volume's batch is migrated waits for it.
+ */
+static WorkerPool	sMigrationPool( "Event migration", kMaxMigrationThreads, B_LOW_PRIORITY );
+
+
+/*!	\brief		A batch of files migrated by the threads of the pool.
+ */
+struct MigrationJob {
+	VolumeQuery*							query;
+	const std::vector< entry_ref >*	batch;
+	int32										next;			//!< The first file no thread took yet.
+	int32										checked;
+	int32										migrated;
+};
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class VolumeQuery
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\param[in]	volume			The volume to query.
+ *		\param[in]	predicate		The predicate of the query; must stay valid.
+ *		\param[in]	target			Receives the batches and the live updates.
+ *		\param[in]	refsCommand		"what" of the message with a batch of refs.
+ */
+VolumeQuery::VolumeQuery( const BVolume& volume,
+								  const char* predicate,
+								  BMessenger* target,
+								  uint32 refsCommand )
+	:
+	fVolume( volume ),
+	fPredicate( predicate ),
+	fTarget( target ),
+	fRefsCommand( refsCommand ),
+	fThread( -1 ),
+	fQuitRequested( 0 )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - stops the fetch, and the live query with it.
+ */
+VolumeQuery::~VolumeQuery()
+{
+	Stop();
+	fQuery.Clear();
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Start fetching the results in the worker thread.
+ */
+status_t		VolumeQuery::Start()
+{
+	BString	name( "Event query on " );
+	char		volumeName[ B_FILE_NAME_LENGTH ];
+
+	if ( !fTarget ) { return B_BAD_VALUE; }
+
+	if ( fVolume.GetName( volumeName ) == B_OK ) {
+		name << volumeName;
+	} else {
+		name << fVolume.Device();
+	}
+
+	fThread = spawn_thread( FetchThread, name.String(), B_LOW_PRIORITY, this );
+	if ( fThread < B_OK ) {
+		return fThread;
+	}
+	return resume_thread( fThread );
+}	// <-- end of function VolumeQuery::Start
+
+
+
+/*!	\brief		Stop the worker thread, if it's still fetching.
+ */
+void		VolumeQuery::Stop()
+{
+	status_t		threadStatus;
+
+	if ( fThread < B_OK ) { return; }
+
+	atomic_set( &fQuitRequested, 1 );
+	wait_for_thread( fThread, &threadStatus );
+	fThread = -1;
+}	// <-- end of function VolumeQuery::Stop
+
+
+
+/*!	\brief		Main function of the worker thread.
+ *		\details		The live query uses the 64-bit index, so on a volume that wasn't
+ *						migrated yet the pending Events are migrated first; they are few,
+ *						and the query finds them right after it. The rest of the files are
+ *						migrated while the query is already live.
+ */
+int32		VolumeQuery::FetchThread( void* data )
+{
+	VolumeQuery* me = ( VolumeQuery* )data;
+	bool			bMigrated = me->IsVolumeMigrated();
+
+	if ( !bMigrated && !me->MigratePendingEvents() ) { return B_OK; }
+
+	me->Fetch();
+	if ( atomic_get( &me->fQuitRequested ) != 0 ) { return B_OK; }
+
+	if ( !bMigrated ) {
+		me->MigrateVolume();
+	}
+	return B_OK;
+}	// <-- end of function VolumeQuery::FetchThread
+
+
+
+/*!	\brief		Start the live query, and pass its initial results to the target.
+ */
+void		VolumeQuery::Fetch()
+{
+	entry_ref	ref;
+	int32			count = 0;
+	BMessage		batch( fRefsCommand );
+
+	fQuery.Clear();
+	fQuery.SetVolume( &fVolume );
+	fQuery.SetTarget( *fTarget );
+
+	// The predicate is constant - no need to build it
+	fQuery.SetPredicate( fPredicate );
+
+	if ( fQuery.Fetch() != B_OK ) { return; }
+
+	while ( ( atomic_get( &fQuitRequested ) == 0 ) &&
+			  ( B_OK == fQuery.GetNextRef( &ref ) ) )
+	{
+		batch.AddRef( "refs", &ref );
+		if ( ++count == kRefsBatchSize ) {
+			fTarget->SendMessage( &batch );
+			batch.MakeEmpty();
+			count = 0;
+		}
+	}
+
+	// Even an empty batch is sent - it tells the volume was scanned
+	if ( atomic_get( &fQuitRequested ) == 0 ) {
+		fTarget->SendMessage( &batch );
+	}
+}	// <-- end of function VolumeQuery::Fetch
+
+
+
+/*!	\brief		Check if the volume is marked as migrated.
+ */
+bool		VolumeQuery::IsVolumeMigrated()
+{
+	BDirectory	root;
+	int32			format = 0;
+
+	return ( fVolume.GetRootDirectory( &root ) == B_OK &&
+				root.ReadAttr( kTimeFormatAttribute, B_INT32_TYPE, 0, &format, sizeof( int32 ) ) == sizeof( int32 ) &&
+				format == kTimeAttributesFormat );
+}	// <-- end of function VolumeQuery::IsVolumeMigrated
+
+
+
+/*!	\brief		Migrate the pending Events, so the live query finds them.
+ *		\details		Their time attributes are rewritten as 64-bit, and those saved by
+ *						older versions, which have only the "fired" flags, get
+ *						"EVNT:next_due". They are found with the old query, which doesn't
+ *						use the new index; it runs only until the volume is marked as
+ *						migrated.
+ *		\returns		\c false if the thread was asked to stop.
+ */
+bool		VolumeQuery::MigratePendingEvents()
+{
+	BQuery		legacyQuery;
+	entry_ref	ref;
+	attr_info	info;
+
+	legacyQuery.SetVolume( &fVolume );
+
+		// Only files of the "Eventual" type
+	legacyQuery.PushAttr( "BEOS:TYPE" );
+	legacyQuery.PushString( kEventFileMIMEType );
+	legacyQuery.PushOp( B_EQ );
+
+		// Where the event wasn't fired yet...
+	legacyQuery.PushAttr( "EVNT:activity_fired" );
+	legacyQuery.PushUInt32( 0 );
+	legacyQuery.PushOp( B_EQ );
+
+		// ...or the reminder wasn't fired yet
+	legacyQuery.PushAttr( "EVNT:reminder_fired" );
+	legacyQuery.PushUInt32( 0 );
+	legacyQuery.PushOp( B_EQ );
+	legacyQuery.PushOp( B_OR );
+	legacyQuery.PushOp( B_AND );
+
+	if ( legacyQuery.Fetch() != B_OK ) { return true; }
+
+	while ( B_OK == legacyQuery.GetNextRef( &ref ) )
+	{
+		if ( atomic_get( &fQuitRequested ) != 0 ) { return false; }
+
+		MigrateTimeAttributes( ref );
+
+		BNode node( &ref );
+		if ( ( node.InitCheck() == B_OK ) &&
+			  ( node.GetAttrInfo( "EVNT:next_due", &info ) != B_OK ) )
+		{
+			EventData::UpdateNextDue( &node );
+		}
+	}
+	return true;
+
+}	// <-- end of function VolumeQuery::MigratePendingEvents
+
+
+
+/*!	\brief		Rewrite the 32-bit time attributes of all Event files on the volume.
+ *		\details		The files are found with a query on their type, and rewritten in
+ *						batches by the threads of the migration pool; the target gets a
+ *						progress report after every batch.
+ *
+ *						The migration can be interrupted at any moment. The files that
+ *						were already migrated are skipped on the next run after a single
+ *						check, and a volume that was completed is marked, so it's not
+ *						scanned again.
+ */
+void		VolumeQuery::MigrateVolume()
+{
+	BQuery		query;
+	BDirectory	root;
+	entry_ref	ref;
+	int32			format = 0;
+	int32			checked = 0, migrated = 0;
+	std::vector< entry_ref >	batch;
+
+	if ( fVolume.GetRootDirectory( &root ) != B_OK ) { return; }
+
+	query.SetVolume( &fVolume );
+	query.PushAttr( "BEOS:TYPE" );
+	query.PushString( kEventFileMIMEType );
+	query.PushOp( B_EQ );
+	if ( query.Fetch() != B_OK ) { return; }
+
+	batch.reserve( kMigrationBatchSize );
+	while ( B_OK == query.GetNextRef( &ref ) )
+	{
+		batch.push_back( ref );
+		if ( ( int32 )batch.size() < kMigrationBatchSize ) { continue; }
+
+		if ( !MigrateBatch( batch, &checked, &migrated ) ) { return; }
+		batch.clear();
+		ReportProgress( checked, migrated, false );
+	}
+	if ( !MigrateBatch( batch, &checked, &migrated ) ) { return; }
+
+	// Done - the next run won't scan this volume
+	format = kTimeAttributesFormat;
+	root.WriteAttr( kTimeFormatAttribute, B_INT32_TYPE, 0, &format, sizeof( int32 ) );
+	ReportProgress( checked, migrated, true );
+
+}	// <-- end of function VolumeQuery::MigrateVolume
+
+
+
+/*!	\brief		Migrate a batch of Event files.
+ *		\param[in]	batch			The files.
+ *		\param[out]	checked		Incremented by the number of files checked.
+ *		\param[out]	migrated		Incremented by the number of files rewritten.
+ *		\returns		\c false if the thread was asked to stop.
+ */
+bool		VolumeQuery::MigrateBatch( const std::vector< entry_ref >& batch,
+											int32* checked, int32* migrated )
+{
+	MigrationJob	job;
+
+	job.query = this;
+	job.batch = &batch;
+	job.next = 0;
+	job.checked = 0;
+	job.migrated = 0;
+	if ( !batch.empty() ) {
+		sMigrationPool.Run( MigrateThread, &job, kMaxMigrationThreads );
+	}
+
+	*checked += job.checked;
+	*migrated += job.migrated;
+	return ( atomic_get( &fQuitRequested ) == 0 );
+}	// <-- end of function VolumeQuery::MigrateBatch
+
+
+
+/*!	\brief		Work of every thread that migrates a batch.
+ *		\details		Every thread takes the next file no other thread took, until none
+ *						are left or the query is stopped.
+ */
+void		VolumeQuery::MigrateThread( void* data )
+{
+	MigrationJob*	job = ( MigrationJob* )data;
+	int32				index;
+
+	while ( atomic_get( &job->query->fQuitRequested ) == 0 &&
+			  ( index = atomic_add( &job->next, 1 ) ) < ( int32 )job->batch->size() )
+	{
+		if ( MigrateTimeAttributes( ( *job->batch )[ index ] ) ) {
+			atomic_add( &job->migrated, 1 );
+		}
+		atomic_add( &job->checked, 1 );
+	}
+}	// <-- end of function VolumeQuery::MigrateThread
+
+
+
+/*!	\brief		Rewrite the time attributes of a single Event file as 64-bit.
+ *		\details		Only these attributes are rewritten; the rest of the file is not
+ *						touched. A reminder offset of an older file is kept positive, as
+ *						older versions read it - the next save writes its sign.
+ *		\returns		\c true if the file was rewritten, \c false if it was already
+ *						migrated or couldn't be read.
+ */
+bool		VolumeQuery::MigrateTimeAttributes( const entry_ref& ref )
+{
+	BNode			node( &ref );
+	attr_info	info;
+	int64			value;
+	bool			bLocked;
+
+	if ( node.InitCheck() != B_OK ) { return false; }
+
+	// Files without the attribute have nothing to migrate
+	if ( node.GetAttrInfo( "EVNT:next_occurrence", &info ) != B_OK ||
+		  info.type == B_INT64_TYPE )
+	{
+		return false;
+	}
+
+	bLocked = ( node.Lock() == B_OK );
+	for ( const char** name = kTimeAttributes; *name; ++name )
+	{
+		if ( utl_ReadTimeAttr( &node, *name, &value ) == B_OK ) {
+			utl_WriteTimeAttr( &node, *name, value );
+		}
+	}
+	if ( bLocked ) { node.Unlock(); }
+
+	return true;
+}	// <-- end of function VolumeQuery::MigrateTimeAttributes
+
+
+
+/*!	\brief		Send the progress of the migration to the target.
+ */
+void		VolumeQuery::ReportProgress( int32 checked, int32 migrated, bool bFinished )
+{
+	BMessage		report( kMigrationProgress );
+
+	report.AddInt32( "device", ( int32 )fVolume.Device() );
+	report.AddInt32( "checked", checked );
+	report.AddInt32( "migrated", migrated );
+	report.AddBool( "finished", bFinished );
+	fTarget->SendMessage( &report );
+}	// <-- end of function VolumeQuery::ReportProgress
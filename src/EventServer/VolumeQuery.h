@@ -0,0 +1,77 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _VOLUME_QUERY_H_
+#define _VOLUME_QUERY_H_
+
+// OS includes
+#include <Messenger.h>
+#include <OS.h>
+#include <Query.h>
+#include <SupportDefs.h>
+#include <Volume.h>
+
+// STL includes
+#include <vector>
+
+
+/*!	\brief		Progress of the migration of the time attributes on a volume.
+ *		\details		Sent to the target after every batch. Fields:
+ *						\li	"device" ( \c int32 ) - the volume;
+ *						\li	"checked" ( \c int32 ) - Event files checked so far;
+ *						\li	"migrated" ( \c int32 ) - files rewritten so far;
+ *						\li	"finished" ( \c bool ) - \c true if the whole volume is done.
+ */
+const uint32	kMigrationProgress = 'MgPr';
+
+
+/*!	\brief		Live query of the pending Events on a single volume.
+ *		\details		The initial results are fetched by a worker thread of its own, so
+ *						all volumes are scanned in parallel. The refs are passed to the
+ *						target in batches; the target merges them into its index.
+ *						After the fetch, the query stays live: updates are sent by the
+ *						system directly to the target as \c B_QUERY_UPDATE messages.
+ *
+ *						A volume whose time attributes are still 32-bit is migrated by the
+ *						same thread: the pending Events before the fetch, the rest of the
+ *						files after it.
+ */
+class VolumeQuery
+{
+public:
+	VolumeQuery( const BVolume& volume,
+					 const char* predicate,
+					 BMessenger* target,
+					 uint32 refsCommand );
+	virtual ~VolumeQuery();
+
+	virtual status_t		Start();
+	virtual void			Stop();
+
+	dev_t						Device() const { return fVolume.Device(); }
+
+	static  bool			MigrateTimeAttributes( const entry_ref& ref );
+
+protected:
+	static int32			FetchThread( void* data );
+	virtual void			Fetch();
+	virtual bool			IsVolumeMigrated();
+	virtual bool			MigratePendingEvents();
+	virtual void			MigrateVolume();
+	virtual bool			MigrateBatch( const std::vector< entry_ref >& batch,
+												  int32* checked, int32* migrated );
+	static  void			MigrateThread( void* data );
+	virtual void			ReportProgress( int32 checked, int32 migrated, bool bFinished );
+
+	BVolume			fVolume;
+	BQuery			fQuery;
+	const char*		fPredicate;
+	BMessenger*		fTarget;				//!< Receives the batches of refs.
+	uint32			fRefsCommand;		//!< The "what" of the batch message.
+	thread_id		fThread;
+	int32				fQuitRequested;	//!< Set atomically to stop the fetch.
+};
+
+
+#endif // _VOLUME_QUERY_H_
@@ -6,6 +6,7 @@
 // Project includes
 #include "ActivityData.h"
 #include "ActivityWindow.h"
+#include "BinaryRecord.h"
 
 // OS includes
 #include <Alert.h>
@@ -22,6 +23,17 @@
 #include <cstdlib>
 
 
+/*!	\name		Flags of the binary form of the activity.
+ */
+///@{
+const		uint8		kActivityNotification		= 0x01;
+const		uint8		kActivitySound					= 0x02;
+const		uint8		kActivityProgram				= 0x04;
+const		uint8		kActivityProgramVerified	= 0x08;
+///@}
+
+
+
 /*---------------------------------------------------------------------------
  *								Definition of class ActivityData
  *--------------------------------------------------------------------------*/
@@ -180,6 +192,84 @@ status_t		ActivityData::Archive( BMessage* out )
 
 
 
+/*!	\brief		Write the activity data in the compact binary form.
+ *		\details		One byte of flags, then the notification text, the sound file,
+ *						the program and its options as length-prefixed strings. An unset
+ *						path is written as an empty string.
+ *		\param[out]	out	The record to add the data to.
+ */
+status_t		ActivityData::Flatten( RecordWriter* out ) const
+{
+	uint8		flags = 0;
+
+	if ( !out ) { return B_NO_INIT; }
+
+	if ( bNotification )		{ flags |= kActivityNotification; }
+	if ( bSound )				{ flags |= kActivitySound; }
+	if ( bProgramRun )		{ flags |= kActivityProgram; }
+	if ( bVerifiedByUser )	{ flags |= kActivityProgramVerified; }
+
+	out->AddUint8( flags );
+	out->AddString( fNotificationText );
+	out->AddString( BString( ( fSoundFile.InitCheck() == B_OK ) ? fSoundFile.Path() : "" ) );
+	out->AddString( BString( ( fProgramPath.InitCheck() == B_OK ) ? fProgramPath.Path() : "" ) );
+	out->AddString( fCommandLineOptions );
+
+	/* Email - deprecated */
+
+	return out->InitCheck();
+}	// <-- end of function ActivityData::Flatten
+
+
+
+/*!	\brief		Read the activity data written by Flatten().
+ *		\details		The strings are decoded straight from the record into the object;
+ *						no intermediate BMessage is built. Missing texts disable the parts
+ *						of the activity that need them, like Instantiate() does.
+ *		\param[in]	in		The record, positioned at the activity data.
+ */
+status_t		ActivityData::Unflatten( RecordReader* in )
+{
+	uint8			flags = 0;
+	const void*	data;
+	uint32		length;
+
+	if ( !in ) { return B_NO_INIT; }
+
+	if ( in->ReadUint8( &flags ) != B_OK ) { return in->InitCheck(); }
+	bNotification = ( ( flags & kActivityNotification ) != 0 );
+	bSound = ( ( flags & kActivitySound ) != 0 );
+	bProgramRun = ( ( flags & kActivityProgram ) != 0 );
+	bVerifiedByUser = ( ( flags & kActivityProgramVerified ) != 0 );
+
+	/* Notification section */
+	in->ReadString( &fNotificationText );
+	if ( fNotificationText.Length() == 0 ) {
+		bNotification = false;		// No need to launch notification if no text exists
+	}
+
+	/* Sound play section */
+	fSoundFile.Unset();
+	if ( in->ReadData( &data, &length ) == B_OK && length > 0 ) {
+		fSoundFile.SetTo( BString( ( const char* )data, length ).String() );
+	} else {
+		bSound = false;
+	}
+
+	/* Program run section */
+	fProgramPath.Unset();
+	if ( in->ReadData( &data, &length ) == B_OK && length > 0 ) {
+		fProgramPath.SetTo( BString( ( const char* )data, length ).String() );
+	} else {
+		bProgramRun = false;
+	}
+	in->ReadString( &fCommandLineOptions );
+
+	return in->InitCheck();
+}	// <-- end of function ActivityData::Unflatten
+
+
+
 /*!	\brief						Adds an Email address.
  *		\param[in]	addrIn		Address to be added
  */
@@ -239,7 +329,7 @@ BString		ActivityData::VerifyCommandLineParameters( const char* in )
  *						the Event's name, category, and can't handle the "Snooze" message.
  *		\param[in]	in		Pointer to the \c Activity to be performed.
  */
-void			ActivityData::PerformActivity( ActivityData* in )
+void			ActivityData::PerformActivity( const ActivityData* in )
 {
 	if ( !in ) { return; }
 	
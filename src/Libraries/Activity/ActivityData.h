@@ -14,7 +14,8 @@
 #include <SupportDefs.h>
 
 // Project includes
-
+class RecordReader;
+class RecordWriter;
 
 
 /*---------------------------------------------------------------------------
@@ -54,13 +55,15 @@ public:
 	///@{
 	static BString	VerifyCommandLineParameters( const BString& in );
 	static BString	VerifyCommandLineParameters( const char* in );
-	static void		PerformActivity( ActivityData* in );
+	static void		PerformActivity( const ActivityData* in );
 	///@}
 
 	//!	\name			Archive and unarchive functions
 	///@{
 	virtual status_t	Archive( BMessage* out );
 	virtual void		Instantiate( BMessage* in = NULL );
+	virtual status_t	Flatten( RecordWriter* out ) const;
+	virtual status_t	Unflatten( RecordReader* in );
 	///@}
 	
 	//!	\name			Getters and setters for the Notification
@@ -0,0 +1,492 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "ActivityListWindow.h"
+#include "Preferences.h"
+#include "Utilities.h"
+
+// OS includes
+#include <GridLayout.h>
+#include <InterfaceDefs.h>
+#include <LayoutItem.h>
+#include <Rect.h>
+
+// POSIX includes
+#include <math.h>
+
+
+const uint32		kAddActivityToList			= 'AdAL';
+const uint32		kListSnoozeTimeChanged		= 'LSTC';
+const	uint32		kListSnoozePressed			= 'LSnP';
+const	uint32		kListDismissPressed			= 'LDmP';
+const	uint32		kListDismissAllPressed		= 'LDAP';
+
+#ifndef SPACING
+	#define SPACING 2
+#endif
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class ActivityListItem
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\param[in]	name					Name of the Event.
+ *		\param[in]	category				Category of the Event.
+ *		\param[in]	notification		Text of the notification, may be empty.
+ *		\param[in]	reminder				\c true if it's the reminder activity.
+ *		\param[in]	templateMessage	The message sent to the target on snooze.
+ */
+ActivityListItem::ActivityListItem( const BString& name,
+												const Category& category,
+												const BString& notification,
+												bool reminder,
+												const BMessage& templateMessage )
+	:
+	BListItem(),
+	fEventName( name ),
+	fCategory( category ),
+	fNotification( notification ),
+	bIsReminder( reminder ),
+	fFiredAt( time( NULL ) ),
+	fTemplateMessage( templateMessage ),
+	fLineHeight( 0 )
+{
+	// Only the first line of the notification is displayed
+	int32 newLine = fNotification.FindFirst( '\n' );
+	if ( newLine >= 0 ) {
+		fNotification.Truncate( newLine );
+	}
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+ActivityListItem::~ActivityListItem()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Each item takes two lines - the Event's name and the notification.
+ */
+void		ActivityListItem::Update( BView* owner, const BFont* font )
+{
+	font_height	fh;
+
+	BListItem::Update( owner, font );
+
+	font->GetHeight( &fh );
+	fLineHeight = ceilf( fh.ascent + fh.descent + fh.leading );
+	SetHeight( 2 * fLineHeight + 2 * SPACING );
+}	// <-- end of function ActivityListItem::Update
+
+
+
+/*!	\brief		Draw the item - category color, Event name, time and notification.
+ */
+void		ActivityListItem::DrawItem( BView* owner, BRect frame, bool complete )
+{
+	BRect		colorRect = frame;
+	BString	line;
+	BFont		font;
+	char		timeBuffer[ 16 ];
+	struct tm	firedAt;
+
+	if ( !owner ) { return; }
+
+	// Background
+	if ( IsSelected() ) {
+		owner->SetLowColor( ui_color( B_MENU_SELECTED_BACKGROUND_COLOR ) );
+	} else {
+		owner->SetLowColor( ui_color( B_DOCUMENT_BACKGROUND_COLOR ) );
+	}
+	owner->FillRect( frame, B_SOLID_LOW );
+
+	// Category color
+	colorRect.left += SPACING;
+	colorRect.right = colorRect.left + 2 * SPACING + 4;
+	colorRect.InsetBy( 0, SPACING );
+	owner->SetHighColor( fCategory.categoryColor );
+	owner->FillRect( colorRect );
+
+	// First line - time and name of the Event
+	localtime_r( &fFiredAt, &firedAt );
+	strftime( timeBuffer, sizeof( timeBuffer ), "%H:%M", &firedAt );
+	line << timeBuffer << "  " << fEventName;
+	if ( bIsReminder ) {
+		line << " (reminder)";
+	}
+
+	owner->SetHighColor( ui_color( B_DOCUMENT_TEXT_COLOR ) );
+	owner->GetFont( &font );
+	font.SetFace( B_BOLD_FACE );
+	owner->SetFont( &font, B_FONT_FACE );
+	font.TruncateString( &line, B_TRUNCATE_END, frame.right - colorRect.right - 3 * SPACING );
+	owner->MovePenTo( colorRect.right + 2 * SPACING, frame.top + SPACING + fLineHeight - 2 );
+	owner->DrawString( line.String() );
+
+	// Second line - category and notification
+	line.SetTo( fCategory.categoryName );
+	if ( fNotification.Length() > 0 ) {
+		line << ": " << fNotification;
+	}
+	font.SetFace( B_REGULAR_FACE );
+	owner->SetFont( &font, B_FONT_FACE );
+	font.TruncateString( &line, B_TRUNCATE_END, frame.right - colorRect.right - 3 * SPACING );
+	owner->MovePenTo( colorRect.right + 2 * SPACING, frame.top + SPACING + 2 * fLineHeight - 2 );
+	owner->DrawString( line.String() );
+}	// <-- end of function ActivityListItem::DrawItem
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class ActivityListWindow
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\details		The window starts hidden; it shows itself when activities are added.
+ *		\param[in]	target		Where the snooze messages are sent. Belongs to the caller.
+ */
+ActivityListWindow::ActivityListWindow( BMessenger* target )
+	:
+	BWindow( BRect( 0, 0, 400, 400 ),
+				"Events occurred",
+				B_FLOATING_WINDOW_LOOK,
+				B_NORMAL_WINDOW_FEEL,
+				B_NOT_CLOSABLE | B_NOT_MINIMIZABLE | B_NOT_ZOOMABLE | B_ASYNCHRONOUS_CONTROLS ),
+	fTarget( target ),
+	fLastError( B_OK ),
+	fTitle( NULL ),
+	fList( NULL ),
+	fScroller( NULL ),
+	fSnoozeTime( NULL ),
+	fSnooze( NULL ),
+	fDismiss( NULL ),
+	fDismissAll( NULL )
+{
+	BLayoutItem* layoutItem;
+	BMessage* toSend;
+
+	BView*	background = new BView( Bounds(),
+												"Background view",
+												B_FOLLOW_ALL_SIDES,
+												B_WILL_DRAW );
+	BGridLayout* gridLayout = new BGridLayout();
+	if ( !background || !gridLayout ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	this->AddChild( background );
+	background->SetLayout( gridLayout );
+	background->SetViewColor( ui_color( B_PANEL_BACKGROUND_COLOR ) );
+	gridLayout->SetInsets( 5, 5, 5, 5 );
+
+	/*-------------------------------------------------
+	 * First line - explaining what's happening here
+	 *------------------------------------------------*/
+	fTitle = new BStringView( BRect( 0, 0, 1, 1 ),
+									  "Explanation",
+									  "Several Events have occured!" );
+	if ( !fTitle ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	fTitle->SetFont( be_bold_font );
+	layoutItem = gridLayout->AddView( fTitle, 0, 0, 3, 1 );
+	if ( layoutItem ) {
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_CENTER, B_ALIGN_TOP ) );
+	}
+
+	/*-------------------------------------------------
+	 * The list of activities
+	 *------------------------------------------------*/
+	fList = new BListView( BRect( 0, 0, 300, 250 ),
+								  "Activities list",
+								  B_MULTIPLE_SELECTION_LIST,
+								  B_FOLLOW_ALL_SIDES );
+	if ( !fList ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	fScroller = new BScrollView( "Activities list scroller",
+										  fList,
+										  B_FOLLOW_ALL_SIDES,
+										  0,
+										  false,
+										  true );
+	if ( !fScroller ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	layoutItem = gridLayout->AddView( fScroller, 0, 1, 3, 1 );
+	if ( layoutItem ) {
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_USE_FULL_WIDTH, B_ALIGN_USE_FULL_HEIGHT ) );
+	}
+
+	/*-------------------------------------------------
+	 * Snooze time selector
+	 *------------------------------------------------*/
+	TimePreferences* prefs = pref_GetTimePreferences();
+	if ( prefs ) {
+		prefs->GetDefaultSnoozeTime( ( int* )&fSnoozeHours, ( int* )&fSnoozeMins );
+	} else {
+		fSnoozeHours = 0;
+		fSnoozeMins = 10;
+	}
+
+	toSend = new BMessage( kListSnoozeTimeChanged );
+	if ( !toSend ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	fSnoozeTime = new GeneralHourMinControl( BRect( 0, 0, 1, 1 ),
+														  "Snooze time selector",
+														  "Snooze selected Activities for:",
+														  BString( "" ),	// No check box
+														  toSend );
+	if ( !fSnoozeTime ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	fSnoozeTime->SetHoursLimit( 23 );
+	fSnoozeTime->SetMinutesLimit( 55 );
+	fSnoozeTime->SetCurrentTime( fSnoozeHours, fSnoozeMins );
+	layoutItem = gridLayout->AddView( fSnoozeTime, 0, 2, 3, 1 );
+	if ( layoutItem ) {
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_CENTER, B_ALIGN_MIDDLE ) );
+	}
+	fSnoozeTime->SetTarget( this );
+
+	/*-------------------------------------------------
+	 * Buttons
+	 *------------------------------------------------*/
+	fSnooze = new BButton( BRect( 0, 0, 1, 1 ),
+								  "Snooze button",
+								  "Snooze",
+								  new BMessage( kListSnoozePressed ) );
+	fDismiss = new BButton( BRect( 0, 0, 1, 1 ),
+									"Dismiss button",
+									"Dismiss",
+									new BMessage( kListDismissPressed ) );
+	fDismissAll = new BButton( BRect( 0, 0, 1, 1 ),
+										"Dismiss all button",
+										"Dismiss all",
+										new BMessage( kListDismissAllPressed ) );
+	if ( !fSnooze || !fDismiss || !fDismissAll ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	fSnooze->ResizeToPreferred();
+	fDismiss->ResizeToPreferred();
+	fDismissAll->ResizeToPreferred();
+
+	layoutItem = gridLayout->AddView( fSnooze, 0, 3 );
+	if ( layoutItem ) {
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_LEFT, B_ALIGN_TOP ) );
+	}
+	layoutItem = gridLayout->AddView( fDismiss, 1, 3 );
+	if ( layoutItem ) {
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_CENTER, B_ALIGN_TOP ) );
+	}
+	layoutItem = gridLayout->AddView( fDismissAll, 2, 3 );
+	if ( layoutItem ) {
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_RIGHT, B_ALIGN_TOP ) );
+	}
+	fSnooze->SetTarget( this );
+	fDismiss->SetTarget( this );
+	fDismissAll->SetTarget( this );
+
+	this->CenterOnScreen();
+
+	// Start the looper, but keep the window hidden until there's something to show
+	this->Hide();
+	this->Show();
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ *		\details		The views are deleted by the BWindow; only the items are freed here.
+ */
+ActivityListWindow::~ActivityListWindow()
+{
+	if ( fList ) {
+		RemoveAll();
+	}
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Add an activity to the list.
+ *		\details		Thread-safe: the activity is posted to the window's looper.
+ */
+status_t		ActivityListWindow::PostActivity( const BString& name,
+															 const Category& category,
+															 const BString& notification,
+															 bool reminder,
+															 const BMessage& templateMessage )
+{
+	BMessage toPost( kAddActivityToList );
+
+	toPost.AddString( "Name", name );
+	toPost.AddString( "Category", category.categoryName );
+	toPost.AddData( "Color", B_RGB_COLOR_TYPE, &category.categoryColor, sizeof( rgb_color ) );
+	toPost.AddString( "Notification", notification );
+	toPost.AddBool( "Reminder", reminder );
+	toPost.AddMessage( "Template", &templateMessage );
+
+	return this->PostMessage( &toPost, this );
+}	// <-- end of function ActivityListWindow::PostActivity
+
+
+
+/*!	\brief		Create the list item from the posted message.
+ */
+void		ActivityListWindow::AddActivity( BMessage* in )
+{
+	BString		name, categoryName, notification;
+	const void*	color = NULL;
+	ssize_t		colorSize = 0;
+	bool			reminder = false;
+	BMessage		templateMessage;
+	ActivityListItem* toAdd;
+
+	in->FindString( "Name", &name );
+	in->FindString( "Category", &categoryName );
+	in->FindString( "Notification", &notification );
+	in->FindBool( "Reminder", &reminder );
+	in->FindMessage( "Template", &templateMessage );
+
+	Category category( categoryName, ui_color( B_WINDOW_TAB_COLOR ) );
+	if ( ( B_OK == in->FindData( "Color", B_RGB_COLOR_TYPE, &color, &colorSize ) ) &&
+		  ( colorSize == sizeof( rgb_color ) ) )
+	{
+		category.categoryColor = *( const rgb_color* )color;
+	}
+
+	toAdd = new ActivityListItem( name, category, notification, reminder, templateMessage );
+	if ( !toAdd ) {
+		/* Panic! */
+		fLastError = B_NO_MEMORY;
+		return;
+	}
+	fList->AddItem( toAdd );
+	UpdateTitle();
+
+	if ( IsHidden() ) {
+		Show();
+	}
+	Activate();
+}	// <-- end of function ActivityListWindow::AddActivity
+
+
+
+/*!	\brief		Remove the selected activities, snoozing them if needed.
+ *		\details		If nothing is selected, nothing is done. When the list becomes
+ *						empty, the window hides.
+ */
+void		ActivityListWindow::RemoveSelected( bool bSnooze )
+{
+	int32 selected;
+	ActivityListItem* item;
+
+	while ( ( selected = fList->CurrentSelection( 0 ) ) >= 0 )
+	{
+		item = ( ActivityListItem* )fList->RemoveItem( selected );
+		if ( !item ) { break; }
+
+		if ( bSnooze && fTarget ) {
+			BMessage toSend( item->TemplateMessage() );
+			toSend.AddInt32( "Hours", ( int32 )fSnoozeHours );
+			toSend.AddInt32( "Minutes", ( int32 )fSnoozeMins );
+			fTarget->SendMessage( &toSend );
+		}
+		delete item;
+	}
+
+	UpdateTitle();
+	if ( fList->IsEmpty() && !IsHidden() ) {
+		Hide();
+	}
+}	// <-- end of function ActivityListWindow::RemoveSelected
+
+
+
+/*!	\brief		Dismiss all activities.
+ */
+void		ActivityListWindow::RemoveAll()
+{
+	ActivityListItem* item;
+
+	while ( NULL != ( item = ( ActivityListItem* )fList->RemoveItem( ( int32 )0 ) ) ) {
+		delete item;
+	}
+}	// <-- end of function ActivityListWindow::RemoveAll
+
+
+
+/*!	\brief		Show the number of activities in the title.
+ */
+void		ActivityListWindow::UpdateTitle()
+{
+	BString title;
+	int32 count = fList->CountItems();
+
+	title << count << ( count == 1 ? " Activity has" : " Activities have" ) << " occured!";
+	fTitle->SetText( title.String() );
+}	// <-- end of function ActivityListWindow::UpdateTitle
+
+
+
+/*!	\brief		Main function of the window.
+ */
+void		ActivityListWindow::MessageReceived( BMessage* in )
+{
+	switch ( in->what )
+	{
+	case kAddActivityToList:
+		AddActivity( in );
+		break;
+
+	case kListSnoozePressed:
+		RemoveSelected( true );
+		break;
+
+	case kListDismissPressed:
+		RemoveSelected( false );
+		break;
+
+	case kListDismissAllPressed:
+		RemoveAll();
+		UpdateTitle();
+		Hide();
+		break;
+
+	case kListSnoozeTimeChanged:	// Intentional fall-through
+	case kGeneralHourMinControlUpdated:
+		if ( B_OK == in->FindInt32( kHoursValueKey.String(), ( int32* )&fSnoozeHours ) &&
+			  B_OK == in->FindInt32( kMinutesValueKey.String(), ( int32* )&fSnoozeMins ) )
+		{
+			// No action is needed
+		} else {
+			utl_Deb = new DebuggerPrintout( "Did not succeed to read the new time!" );
+		}
+		break;
+
+	default:
+		BWindow::MessageReceived( in );
+	};	// <-- end of "switch ( in->what )"
+}	// <-- end of function ActivityListWindow::MessageReceived
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _ACTIVITY_LIST_WINDOW_H_
+#define _ACTIVITY_LIST_WINDOW_H_
+
+// OS includes
+#include <Button.h>
+#include <ListItem.h>
+#include <ListView.h>
+#include <Message.h>
+#include <Messenger.h>
+#include <ScrollView.h>
+#include <String.h>
+#include <StringView.h>
+#include <SupportDefs.h>
+#include <Window.h>
+
+// POSIX includes
+#include <time.h>
+
+// Project includes
+#include "Category.h"
+#include "GeneralHourMinControl.h"
+
+
+/*!	\brief		A single activity in the ActivityListWindow.
+ *		\details		This is a plain list item - it has no views of its own, and the
+ *						list view draws only the items which are visible. Therefore the
+ *						cost of an item doesn't depend on the number of items.
+ */
+class ActivityListItem
+	:
+	public BListItem
+{
+public:
+	ActivityListItem( const BString& name,
+							const Category& category,
+							const BString& notification,
+							bool reminder,
+							const BMessage& templateMessage );
+	virtual ~ActivityListItem();
+
+	virtual void		DrawItem( BView* owner, BRect frame, bool complete = false );
+	virtual void		Update( BView* owner, const BFont* font );
+
+	virtual const BMessage&		TemplateMessage() const { return fTemplateMessage; }
+
+protected:
+	BString			fEventName;
+	Category			fCategory;
+	BString			fNotification;
+	bool				bIsReminder;
+	time_t			fFiredAt;
+	BMessage			fTemplateMessage;
+	float				fLineHeight;
+};
+
+
+
+/*!	\brief		One window for all activities that fired together.
+ *		\details		When many Events fire at the same time, opening an ActivityWindow
+ *						for each of them costs a window and a thread per Event. This
+ *						window lists them all; the user can snooze or dismiss the selected
+ *						ones. It's created once, and is hidden when the list is empty, so
+ *						the number of windows and threads doesn't grow with the number of
+ *						Events.
+ *
+ *						The activities are added with PostActivity(), which may be called
+ *						from any thread.
+ */
+class ActivityListWindow
+	:
+	public BWindow
+{
+public:
+	ActivityListWindow( BMessenger* target );
+	virtual ~ActivityListWindow();
+
+	virtual void		MessageReceived( BMessage* in );
+
+	virtual status_t	PostActivity( const BString& name,
+											  const Category& category,
+											  const BString& notification,
+											  bool reminder,
+											  const BMessage& templateMessage );
+
+	virtual status_t	InitCheck() const { return fLastError; }
+
+protected:
+	virtual void		AddActivity( BMessage* in );
+	virtual void		RemoveSelected( bool bSnooze );
+	virtual void		RemoveAll();
+	virtual void		UpdateTitle();
+
+	BMessenger*		fTarget;
+	status_t			fLastError;
+	uint32			fSnoozeHours;
+	uint32			fSnoozeMins;
+
+	//!	\name  	UI elements.
+	///@{
+	BStringView					*fTitle;
+	BListView					*fList;
+	BScrollView					*fScroller;
+	GeneralHourMinControl	*fSnoozeTime;
+	BButton						*fSnooze;
+	BButton						*fDismiss;
+	BButton						*fDismissAll;
+	///@}
+};
+
+#endif // _ACTIVITY_LIST_WINDOW_H_
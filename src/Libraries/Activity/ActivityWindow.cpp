@@ -40,7 +40,7 @@ const	uint32		kDismissButtonPressed		= 'DmBP';
  *						However, \c target and \c templateMessage belong to this object. User
  *						shouldn't free them or do anything else.
  */
-ActivityWindow::ActivityWindow( ActivityData* data,
+ActivityWindow::ActivityWindow( const ActivityData* data,
 									 BMessenger* target,
 									 BString		 name,
 									 Category*	 category,
@@ -37,7 +37,7 @@ class ActivityWindow
 	public BWindow
 {
 public:
-	ActivityWindow( ActivityData* data,
+	ActivityWindow( const ActivityData* data,
 					  BMessenger* target,
 					  BString	  name,
 					  Category*	  category,
@@ -61,7 +61,7 @@ protected:
 	//!	\name		Data placeholders
 	///@{ 
 	BMessenger*		fTarget;
-	ActivityData*	fData;
+	const ActivityData*	fData;
 	BMessage*		fTemplateMessage;
 	bool				bIsReminder;
 	status_t			fLastError;
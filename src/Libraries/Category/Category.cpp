@@ -187,11 +187,7 @@ bool	MergeCategories( BString& source, BString& target )
 		return false;
 	}
 	BVolumeRoster volumeRoster;
-	BVolume bootVolume;
-	volumeRoster.GetBootVolume( &bootVolume );
-	
-		// Setting the query to look in the boot volume
-	categoryQuery->SetVolume( &bootVolume );
+	BVolume volume;
 	
 		// Check the category attribute type's name.
 	int i = 0;
@@ -212,48 +208,57 @@ bool	MergeCategories( BString& source, BString& target )
 		return false;
 	}
 	
-		// Construct the predicate
-	categoryQuery->PushAttr( AttributesArray[ i ].internalName );
-	categoryQuery->PushString( source.String() );
-	categoryQuery->PushOp( B_EQ );
+		// Events may be stored on any volume that supports queries
+	while ( volumeRoster.GetNextVolume( &volume ) == B_OK )
+	{
+		if ( !volume.KnowsQuery() ) { continue; }
+		
+		categoryQuery->Clear();
+		categoryQuery->SetVolume( &volume );
+		
+			// Construct the predicate
+		categoryQuery->PushAttr( AttributesArray[ i ].internalName );
+		categoryQuery->PushString( source.String() );
+		categoryQuery->PushOp( B_EQ );
 	
-		// Another item of the predicate is the type of the file.
-	categoryQuery->PushAttr( "BEOS:TYPE" );
-	categoryQuery->PushString( kEventFileMIMEType );
-	categoryQuery->PushOp( B_EQ );
-	categoryQuery->PushOp( B_AND );
+			// Another item of the predicate is the type of the file.
+		categoryQuery->PushAttr( "BEOS:TYPE" );
+		categoryQuery->PushString( kEventFileMIMEType );
+		categoryQuery->PushOp( B_EQ );
+		categoryQuery->PushOp( B_AND );
 	
-		// Fire the query!
-	categoryQuery->Fetch();
+			// Fire the query!
+		categoryQuery->Fetch();
 	
-		// Fetching the results
-	while ( ( status = categoryQuery->GetNextRef( &fileToReadAttributesFrom ) ) == B_OK )
-	{
-		// Successfully retrieved next entry
+			// Fetching the results
+		while ( ( status = categoryQuery->GetNextRef( &fileToReadAttributesFrom ) ) == B_OK )
+		{
+			// Successfully retrieved next entry
 		
-		file = new BFile( &fileToReadAttributesFrom, B_READ_ONLY );
-		if ( !file || file->InitCheck() != B_OK )
-			continue;
+			file = new BFile( &fileToReadAttributesFrom, B_READ_ONLY );
+			if ( !file || file->InitCheck() != B_OK )
+				continue;
 		
-		status = file->GetAttrInfo( AttributesArray[ i ].internalName,
-											 &attribute_info );
-		if ( status != B_OK )
-			continue;
+			status = file->GetAttrInfo( AttributesArray[ i ].internalName,
+												 &attribute_info );
+			if ( status != B_OK )
+				continue;
 	
-			// Update the category attribute	
-		file->WriteAttr( AttributesArray[ i ].internalName,
-							  AttributesArray[ i ].type,	// Supposedly, B_STRING_TYPE
-							  0,
-							  target.String(),
-							  target.Length() );
+				// Update the category attribute	
+			file->WriteAttr( AttributesArray[ i ].internalName,
+								  AttributesArray[ i ].type,	// Supposedly, B_STRING_TYPE
+								  0,
+								  target.String(),
+								  target.Length() );
 		
-		/* Actually, the return value is not needed.
-		 * In any case we're continuing to a next item.
-		 */
+			/* Actually, the return value is not needed.
+			 * In any case we're continuing to a next item.
+			 */
 		 
-		 	// Clear the file descriptor.
-		delete file;
-	}
+			 	// Clear the file descriptor.
+			delete file;
+		}
+	}	// <-- end of "while ( there are volumes )"
 	
 	delete categoryQuery;
 	
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "BfsEventStorage.h"
+#include "Utilities.h"
+
+// OS includes
+#include <Entry.h>
+#include <NodeInfo.h>
+#include <Path.h>
+#include <Query.h>
+#include <VolumeRoster.h>
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class BfsEventNode
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor from an open file of the caller.
+ */
+BfsEventNode::BfsEventNode( BFile* file )
+	:
+	fNode( file ),
+	fFile( file ),
+	bOwned( false )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Constructor from an open node of the caller - attributes only.
+ */
+BfsEventNode::BfsEventNode( BNode* node )
+	:
+	fNode( node ),
+	fFile( NULL ),
+	bOwned( false )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Constructor - opens the file.
+ */
+BfsEventNode::BfsEventNode( const entry_ref& ref, uint32 openMode )
+	:
+	fNode( NULL ),
+	fFile( new BFile( &ref, openMode ) ),
+	bOwned( true )
+{
+	fNode = fFile;
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Constructor - opens the file.
+ */
+BfsEventNode::BfsEventNode( const char* path, uint32 openMode )
+	:
+	fNode( NULL ),
+	fFile( new BFile( path, openMode ) ),
+	bOwned( true )
+{
+	fNode = fFile;
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - closes the file, if it was opened by the node.
+ */
+BfsEventNode::~BfsEventNode()
+{
+	if ( bOwned && fFile ) {
+		delete fFile;
+	}
+}	// <-- end of destructor
+
+
+
+status_t		BfsEventNode::InitCheck() const
+{
+	return fNode ? fNode->InitCheck() : B_NO_INIT;
+}	// <-- end of function BfsEventNode::InitCheck
+
+
+
+status_t		BfsEventNode::Lock()
+{
+	return fNode ? fNode->Lock() : B_NO_INIT;
+}	// <-- end of function BfsEventNode::Lock
+
+
+
+status_t		BfsEventNode::Unlock()
+{
+	return fNode ? fNode->Unlock() : B_NO_INIT;
+}	// <-- end of function BfsEventNode::Unlock
+
+
+
+ssize_t		BfsEventNode::ReadAttr( const char* name, type_code type, void* buffer, size_t size )
+{
+	return fNode ? fNode->ReadAttr( name, type, 0, buffer, size ) : B_NO_INIT;
+}	// <-- end of function BfsEventNode::ReadAttr
+
+
+
+ssize_t		BfsEventNode::WriteAttr( const char* name, type_code type, const void* buffer, size_t size )
+{
+	return fNode ? fNode->WriteAttr( name, type, 0, buffer, size ) : B_NO_INIT;
+}	// <-- end of function BfsEventNode::WriteAttr
+
+
+
+status_t		BfsEventNode::RemoveAttr( const char* name )
+{
+	return fNode ? fNode->RemoveAttr( name ) : B_NO_INIT;
+}	// <-- end of function BfsEventNode::RemoveAttr
+
+
+
+status_t		BfsEventNode::GetAttrInfo( const char* name, attr_info* info )
+{
+	return fNode ? fNode->GetAttrInfo( name, info ) : B_NO_INIT;
+}	// <-- end of function BfsEventNode::GetAttrInfo
+
+
+
+status_t		BfsEventNode::RewindAttrs()
+{
+	return fNode ? fNode->RewindAttrs() : B_NO_INIT;
+}	// <-- end of function BfsEventNode::RewindAttrs
+
+
+
+status_t		BfsEventNode::GetNextAttrName( char* buffer )
+{
+	return fNode ? fNode->GetNextAttrName( buffer ) : B_NO_INIT;
+}	// <-- end of function BfsEventNode::GetNextAttrName
+
+
+
+status_t		BfsEventNode::ReadAttrString( const char* name, BString* out )
+{
+	return fNode ? fNode->ReadAttrString( name, out ) : B_NO_INIT;
+}	// <-- end of function BfsEventNode::ReadAttrString
+
+
+
+status_t		BfsEventNode::SetMimeType( const char* type, const char* preferredApp )
+{
+	BNodeInfo	nodeInfo;
+	status_t		status;
+
+	if ( !fNode || !type ) { return B_BAD_VALUE; }
+	if ( ( status = nodeInfo.SetTo( fNode ) ) != B_OK ) { return status; }
+
+	if ( ( status = nodeInfo.SetType( type ) ) != B_OK ) { return status; }
+	if ( preferredApp ) {
+		status = nodeInfo.SetPreferredApp( preferredApp, B_OPEN );
+	}
+	return status;
+}	// <-- end of function BfsEventNode::SetMimeType
+
+
+
+status_t		BfsEventNode::GetSize( off_t* size )
+{
+	return fFile ? fFile->GetSize( size ) : B_NOT_SUPPORTED;
+}	// <-- end of function BfsEventNode::GetSize
+
+
+
+ssize_t		BfsEventNode::ReadAt( off_t position, void* buffer, size_t size )
+{
+	return fFile ? fFile->ReadAt( position, buffer, size ) : B_NOT_SUPPORTED;
+}	// <-- end of function BfsEventNode::ReadAt
+
+
+
+/*!	\brief		Replace the data of the file.
+ */
+status_t		BfsEventNode::SetData( const void* buffer, size_t size )
+{
+	ssize_t		written;
+	status_t		status;
+
+	if ( !fFile ) { return B_NOT_SUPPORTED; }
+
+	if ( ( status = fFile->SetSize( ( off_t )size ) ) != B_OK ) { return status; }
+	if ( size == 0 ) { return B_OK; }
+
+	written = fFile->WriteAt( 0, buffer, size );
+	if ( written < 0 ) {
+		return ( status_t )written;
+	}
+	return ( ( size_t )written == size ) ? B_OK : B_IO_ERROR;
+}	// <-- end of function BfsEventNode::SetData
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class BfsEventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - the storage is on the boot volume.
+ */
+BfsEventStorage::BfsEventStorage()
+{
+	BVolumeRoster().GetBootVolume( &fVolume );
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Constructor.
+ *		\param[in]	volume	The volume ListByRange() queries.
+ */
+BfsEventStorage::BfsEventStorage( const BVolume& volume )
+	:
+	fVolume( volume )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+BfsEventStorage::~BfsEventStorage()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Open the Event file.
+ *		\param[in]	key		Absolute path of the file.
+ */
+EventNode*		BfsEventStorage::Open( const char* key, uint32 openMode )
+{
+	if ( !key ) { return NULL; }
+	return new BfsEventNode( key, openMode );
+}	// <-- end of function BfsEventStorage::Open
+
+
+
+/*!	\brief		Delete the Event file.
+ */
+status_t		BfsEventStorage::Remove( const char* key )
+{
+	BEntry		entry;
+	status_t		status;
+
+	if ( !key ) { return B_BAD_VALUE; }
+	if ( ( status = entry.SetTo( key ) ) != B_OK ) { return status; }
+	return entry.Remove();
+}	// <-- end of function BfsEventStorage::Remove
+
+
+
+/*!	\brief		Find the Events whose time attribute is in the range.
+ *		\param[in]	attribute	A 64-bit, indexed attribute, like "EVNT:next_occurrence".
+ *		\param[in]	from			Start of the range.
+ *		\param[in]	to				End of the range; it's not included.
+ *		\param[out]	keys			The paths of the Event files are added here.
+ */
+status_t		BfsEventStorage::ListByRange( const char* attribute, int64 from, int64 to,
+													  std::vector< BString >* keys )
+{
+	BQuery		query;
+	entry_ref	ref;
+	BPath			path;
+	status_t		status;
+
+	if ( !attribute || !keys ) { return B_BAD_VALUE; }
+
+	query.SetVolume( &fVolume );
+	query.PushAttr( "BEOS:TYPE" );
+	query.PushString( kEventFileMIMEType );
+	query.PushOp( B_EQ );
+	query.PushAttr( attribute );
+	query.PushInt64( from );
+	query.PushOp( B_GE );
+	query.PushOp( B_AND );
+	query.PushAttr( attribute );
+	query.PushInt64( to );
+	query.PushOp( B_LT );
+	query.PushOp( B_AND );
+
+	if ( ( status = query.Fetch() ) != B_OK ) { return status; }
+
+	while ( B_OK == query.GetNextRef( &ref ) )
+	{
+		if ( path.SetTo( &ref ) == B_OK ) {
+			keys->push_back( BString( path.Path() ) );
+		}
+	}
+	return B_OK;
+}	// <-- end of function BfsEventStorage::ListByRange
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BFS_EVENT_STORAGE_H_
+#define _BFS_EVENT_STORAGE_H_
+
+// OS includes
+#include <Entry.h>
+#include <File.h>
+#include <Node.h>
+#include <Volume.h>
+
+// Project includes
+#include "EventStorage.h"
+
+
+/*---------------------------------------------------------------------------
+ *					Declaration of classes BfsEventNode and BfsEventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		An Event file in BFS.
+ *		\details		The node may wrap an open BFile or BNode of the caller, which is
+ *						not closed when the node is deleted. A node created from a BNode
+ *						has attributes, but no data.
+ */
+class BfsEventNode
+	: public EventNode
+{
+public:
+	BfsEventNode( BFile* file );
+	BfsEventNode( BNode* node );
+	BfsEventNode( const entry_ref& ref, uint32 openMode );
+	BfsEventNode( const char* path, uint32 openMode );
+	virtual ~BfsEventNode();
+
+	virtual status_t	InitCheck() const;
+	virtual status_t	Lock();
+	virtual status_t	Unlock();
+
+	virtual ssize_t	ReadAttr( const char* name, type_code type, void* buffer, size_t size );
+	virtual ssize_t	WriteAttr( const char* name, type_code type, const void* buffer, size_t size );
+	virtual status_t	RemoveAttr( const char* name );
+	virtual status_t	GetAttrInfo( const char* name, attr_info* info );
+	virtual status_t	RewindAttrs();
+	virtual status_t	GetNextAttrName( char* buffer );
+	virtual status_t	ReadAttrString( const char* name, BString* out );
+	virtual status_t	SetMimeType( const char* type, const char* preferredApp );
+
+	virtual status_t	GetSize( off_t* size );
+	virtual ssize_t	ReadAt( off_t position, void* buffer, size_t size );
+	virtual status_t	SetData( const void* buffer, size_t size );
+
+protected:
+	BNode*		fNode;		//!< The attributes.
+	BFile*		fFile;		//!< The data; the same object as \c fNode, or \c NULL.
+	bool			bOwned;		//!< If \c true, the file is deleted with the node.
+};
+
+
+
+/*!	\brief		The Event files on a BFS volume.
+ *		\details		The keys are absolute paths. ListByRange() is a query on the
+ *						volume, so the attribute must be indexed.
+ */
+class BfsEventStorage
+	: public EventStorage
+{
+public:
+	BfsEventStorage();
+	BfsEventStorage( const BVolume& volume );
+	virtual ~BfsEventStorage();
+
+	virtual EventNode*	Open( const char* key, uint32 openMode );
+	virtual status_t		Remove( const char* key );
+	virtual status_t		ListByRange( const char* attribute, int64 from, int64 to,
+												 std::vector< BString >* keys );
+
+protected:
+	BVolume		fVolume;
+};
+
+
+#endif // _BFS_EVENT_STORAGE_H_
@@ -5,15 +5,20 @@
  
 // Project includes
 #include "ActivityData.h"
+#include "BfsEventStorage.h"
+#include "BinaryRecord.h"
 #include "CalendarModule.h"
 #include "Event.h"
+#include "EventAttributes.h"
 #include "Preferences.h"
 #include "Utilities.h"
+#include "WorkerPool.h"
 
 // OS includes
 #include <Message.h>
 #include <File.h>
-#include <NodeInfo.h>
+#include <Node.h>
+#include <OS.h>
 #include <SupportDefs.h>
 #include <fs_attr.h>
 
@@ -23,6 +28,10 @@
 #include <time.h>		// For time() function
 #include	<stdio.h>	// For memset() function
 #include <string.h>	// For strcmp() function
+#include <stdlib.h>	// For malloc() function
+
+// C++ includes
+#include <new>			// For placement new
 
 
 
@@ -38,12 +47,85 @@
 
 
 
+/*---------------------------------------------------------------------------
+ *					Decoder of the Event file attributes
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Size of the buffer on the stack used for reading the attributes.
+ *		\details		It accomodates the usual "EVNT:record". Larger records and
+ *						attributes are read into a buffer on the heap.
+ */
+const		uint32	kDecoderStackBufferSize		= 4096;
+
+
+
+/*---------------------------------------------------------------------------
+ *					Layout of the "EVNT:record" attribute
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Identifies the record.
+ */
+const		uint32	kEventRecordMagic				= 'EvRc';
+
+/*!	\brief		Version of the record written by this code.
+ *		\details		The version changes when the record can't be read by older
+ *						code. New fixed fields may be appended to the header without
+ *						changing the version - older code skips them using the header size.
+ */
+const		uint16	kEventRecordVersion			= 1;
+
+/*!	\brief		Size of the fixed header.
+ *		\details		The header is:
+ *						\li	\c uint32 magic, \c uint16 version, \c uint16 header size;
+ *						\li	\c uint32 size of the whole record;
+ *						\li	\c uint32 flags, \c int32 Event type, \c uint32 duration,
+ *							\c uint32 reminder offset.
+ *
+ *						It's followed by the calendar module ID as a string, by the
+ *						start time in its 16-byte binary form, and by the
+ *						Event activity and the reminder activity in their binary form. All
+ *						numbers are little-endian; see RecordWriter.
+ *
+ *						The recurrence rules of a recurring Event follow: a \c uint32
+ *						count and the inclusion rules, then a \c uint32 count and the
+ *						exclusion rules. Every rule is a block of data (see
+ *						RecordWriter::AddData()) holding RecurrenceRule::Flatten(). Older
+ *						code doesn't read past the activities, so the section is optional.
+ */
+const		uint16	kEventRecordHeaderSize		= 28;
+
+/*!	\brief		Offset of the size of the whole record.
+ */
+const		size_t	kEventRecordSizeOffset		= 8;
+
+/*!	\brief		Offset of the first field of the Event.
+ */
+const		size_t	kEventRecordFlagsOffset		= 12;
+
+/*!	\name		Flags of the record.
+ */
+///@{
+const		uint32	kEventRecordPrivate					= 0x00000001;
+const		uint32	kEventRecordVerified					= 0x00000002;
+const		uint32	kEventRecordWholeDay					= 0x00000004;
+const		uint32	kEventRecordReminderBeforeEvent	= 0x00000008;
+///@}
+
+
+/*!	\brief		How many excluded occurrences in a row are skipped.
+ *		\details		An Event whose every occurrence is excluded has no next one.
+ */
+const		int32		kMaxExcludedOccurrences		= 1000;
+
+
+
 /*!	\brief		Destructor
  */
 EventData::~EventData() {
-	// The only thing we need to destroy is fEventFile.
 	if ( fEventFile )
 		delete fEventFile;	
+	_DeleteRules( &fAndRules );
+	_DeleteRules( &fNotRules );
 }	// <-- end of destructor
 
 
@@ -52,7 +134,8 @@ EventData::~EventData() {
  */
 EventData::EventData( time_t startingTime )
 	:
-	fEventFile( NULL )
+	fEventFile( NULL ),
+	fStorage( NULL )
 {
 	_InitDefaults();
 	startTime = startingTime;	// Save the time for "Revert" feature
@@ -68,7 +151,8 @@ EventData::EventData( time_t startingTime )
  */
 EventData::EventData( const entry_ref& fileIn )
 	:
-	fEventFile( NULL )
+	fEventFile( NULL ),
+	fStorage( NULL )
 {
 	_InitDefaults();
 	InitFromFile( fileIn );
@@ -84,6 +168,8 @@ void		EventData::Revert( void )
 	_InitDefaults();
 	if ( fEventFile != NULL ) {
 		InitFromFile( *fEventFile );
+	} else if ( fStorage != NULL ) {
+		Load( fStorage, fStorageKey.String() );
 	} else {
 		if ( startTime != 0 ) {
 			fStart = fCalModule->FromTimeTToLocalCalendar( startTime );
@@ -163,9 +249,10 @@ void 		EventData::_InitDefaults()
 	fOffsetBetweenReminderAndEvent = 0;	// By default, reminder is turned off
 	bReminderIsFiredBeforeEvent = true;
 	
-	// Clear the rules (which should be clear anyway)
-	fAndRules.MakeEmpty();
-	fNotRules.MakeEmpty();
+	// Clear the rules
+	_DeleteRules( &fAndRules );
+	_DeleteRules( &fNotRules );
+	_InvalidateExclusions();
 	
 	// Clear reminder activity and event activity
 	fEventActivity.Instantiate( NULL );
@@ -175,9 +262,13 @@ void 		EventData::_InitDefaults()
 
 	// Initializing the Note to nothing
 	fNote.SetTo( "" );
+	bNoteLoaded = true;
 	
 	// Initialize the Location to nothing
 	fLocation.SetTo( "" );
+	
+	// Nothing of a new Event was saved yet
+	fDirtyFields = kEventFieldAll;
 
 }	// <-- end of function EventData::_InitDefaults;
 
@@ -185,6 +276,11 @@ void 		EventData::_InitDefaults()
 
 /*!	\brief		Init from file.
  *		\param[in]	fileIn		Reference to the file to initialize the Event from.
+ *		\details		Files saved by this version keep most of the data in the single
+ *						"EVNT:record" attribute, which is read at once. Files of older
+ *						versions, or with a record this version doesn't understand, are
+ *						decoded attribute by attribute. The note is not read here;
+ *						see _LoadNote().
  *		\attention	The \c fileIn entry_ref structure used to initialize the EventData
  *						object is stored in the object itself ( \c fEventFile member).
  *						However, \c fEventFile is a new entry_ref initialized using the \c fileIn
@@ -194,16 +290,16 @@ void 		EventData::_InitDefaults()
  */
 void		EventData::InitFromFile( const entry_ref& fileIn )
 {
-	bool			bLocked = false;
-	attr_info	ai;
-	char			nameBuffer[ B_ATTR_NAME_LENGTH ];	// 255 bytes
-	uint8			*buffer = NULL;
-	uint32 		bufferSize = 0;
-	
-	// Temporary variables for reading the data
-	uint32		tempUint32;
-	BMessage		tempMessage;
-	size_t		tempSize = 0;
+	_InitFromRef( fileIn );
+}	// <-- end of function EventData::InitFromFile
+
+
+
+/*!	\brief		Same as InitFromFile(), but tells whether the file was opened.
+ */
+status_t		EventData::_InitFromRef( const entry_ref& fileIn )
+{
+	status_t		status;
 	
 	_InitDefaults();
 	
@@ -213,187 +309,127 @@ void		EventData::InitFromFile( const entry_ref& fileIn )
 		delete this->fEventFile;
 	}
 	fEventFile = new entry_ref( fileIn );
+	fStorage = NULL;
+	fStorageKey.SetTo( "" );
 	
-	// Pointer to the placeholder which will be filled with the read data
-	void*			placeholder = NULL;
-	
-	status_t		status = B_OK;
-		
-	BFile file;
-	file.SetTo( &fileIn, B_READ_ONLY );
-	if ( file.InitCheck() != B_OK )
+	BfsEventNode node( fileIn, B_READ_ONLY );
+	if ( ( status = node.InitCheck() ) != B_OK )
 	{
-		return;
+		return status;
 	}
 	
-	/* Here, "file" is set, and the file is opened for reading.
+	/* Here, "node" is set, and the file is opened for reading.
 	 */
+	_LoadFromNode( &node );
+	return B_OK;
+}	// <-- end of function EventData::_InitFromRef
+
+
+
+/*!	\brief		Load the Event from a storage.
+ *		\details		Same as InitFromFile(), for the Events that are not files. The
+ *						storage is remembered for Revert() and for reading the note; it
+ *						must live as long as the object uses it.
+ *		\param[in]	storage		Where the Event is.
+ *		\param[in]	key			The key of the Event in the storage.
+ */
+status_t		EventData::Load( EventStorage* storage, const char* key )
+{
+	EventNode*	node;
+	status_t		status;
+	BString		keyCopy( key );		// The key may be fStorageKey itself
+	
+	if ( !storage || !key ) { return B_BAD_VALUE; }
+	
+	_InitDefaults();
+	if ( this->fEventFile ) {
+		delete this->fEventFile;
+		this->fEventFile = NULL;
+	}
+	fStorage = storage;
+	fStorageKey = keyCopy;
+	
+	if ( ( node = storage->Open( keyCopy.String(), B_READ_ONLY ) ) == NULL ) {
+		return B_NO_MEMORY;
+	}
+	if ( ( status = node->InitCheck() ) == B_OK ) {
+		_LoadFromNode( node );
+	}
+	delete node;
+	return status;
+}	// <-- end of function EventData::Load
+
+
+
+/*---------------------------------------------------------------------------
+ *					Loading of many Events at once
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		The most threads LoadMany() uses, including the caller's.
+ */
+const		int32		kMaxLoaderThreads			= 8;
+
+
+/*!	\brief		The threads that load the Events for LoadMany(), one per CPU.
+ *		\details		They are started by the first call that needs them, and wait for
+ *						the next call afterwards.
+ */
+static WorkerPool	sLoaderPool( "Event loader", WorkerPool::LimitToCPUs( kMaxLoaderThreads ) );
+
+
+
+/*!	\brief		Load the Events from many files.
+ *		\details		The files are read by several threads - as many as there are
+ *						CPUs, but not many more than the number of files justifies.
+ *						The calling thread loads files too. See ObjectBatch.
+ *
+ *						The objects are constructed in place in the memory of the batch,
+ *						so loading them doesn't allocate each one separately. The object
+ *						at every index is loaded from the ref at the same index.
+ *		\param[in]	refs		The Event files; they must stay valid during the call.
+ *		\param[in]	count		Number of the files.
+ *		\param[out]	out		The loaded Events; its previous contents are deleted.
+ *		\returns		\c B_OK if the batch was filled. The files that couldn't be
+ *						opened are reported by EventDataBatch::StatusAt().
+ */
+status_t		EventData::LoadMany( const entry_ref* refs, int32 count, EventDataBatch* out )
+{
+	status_t		status;
+	
+	if ( !out || count < 0 || ( !refs && count > 0 ) ) { return B_BAD_VALUE; }
+	
+	out->fRefs = refs;
+	status = out->_Load( count, &sLoaderPool );
+	out->fRefs = NULL;
+	return status;
+}	// <-- end of function EventData::LoadMany
+
+
+
+/*!	\brief		Read the Event from an open node.
+ *		\details		Common part of InitFromFile() and Load().
+ */
+void		EventData::_LoadFromNode( EventNode* node )
+{
+	bool			bLocked = false;
 	
 	// Lock the node to prevent tampering with its attributes while I'm reading
-	if ( B_OK == file.Lock() ) {
+	if ( B_OK == node->Lock() ) {
 		bLocked = true;
 	}
 	
 	// If unsuccessful, still try to continue
 	
-	// Reading attributes is performed in the infinite loop.
-	// Breaking out of the loop when all attributes were read.
-	while ( true ) {
-		if ( ( ( status = file.GetNextAttrName( nameBuffer ) ) == B_ENTRY_NOT_FOUND ) ||
-		 	  ( status == B_FILE_ERROR ) )
-		{
-			break;
-		}
-		
-		// Allocating memory for reading the attribute
-		if ( file.GetAttrInfo( nameBuffer, &ai ) == B_OK )
-		{
-			// Maybe it's a constant-length type, and we have a placeholder for it.
-			if ( ( ai.size <= sizeof( uint32 ) ) && ( ai.type != B_STRING_TYPE ) )
-			{
-				placeholder = ( void* )&tempUint32;
-				tempSize = sizeof( uint32 );
-			}
-			else
-			{
-				// No placeholder suits the data.
-				// Allocate new buffer for the attribute's data, but
-				// only in case we actually need it
-				if ( buffer )
-					delete []buffer;	// Clearing the old buffer
-				buffer = new uint8[ ai.size + 1 ];
-				if ( !buffer ) {
-					// Did not succeed to allocate buffer - unlock and exit.
-					if ( bLocked ) { file.Unlock(); }
-				   file.Unset();	// Close the file.
-					return;
-				}
-					
-				tempSize = ( size_t )ai.size;			
-				
-				placeholder = ( void* )buffer;
-			}
-		}
-		else
-		{
-			// If we didn't succeed to get attribute-info for the attribute, we just continue
-			continue;
-		}
-		
-		memset( buffer, 0, ai.size + 1 );
-		
-		// Read the attribute
-		tempSize = file.ReadAttr( nameBuffer, ai.type, 0, placeholder, ai.size );
+	if ( _LoadRecord( node ) == B_OK ) {
+		fDirtyFields = 0;
+	} else {
+		// The record is missing or damaged - the values it could have set are reset
+		_InitDefaults();
+		_LoadAttributes( node );
 		
-		/* Ok, the attribute was read successfully. What is it?
-		 */
-		if ( strcmp( nameBuffer, "EVNT:name" ) == 0 )
-		{
-			fEventName.SetTo( ( char* )buffer );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:category" ) == 0 )
-		{
-			fCategory.SetTo( ( char* )buffer );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:where" ) == 0 )
-		{
-			fLocation.SetTo( ( char* )buffer );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:private" ) == 0 )
-		{
-			bPrivate = ( tempUint32 != 0 );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:verified" ) == 0 )
-		{
-			bVerified = ( tempUint32 != 0 );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:whole_day" ) == 0 )
-		{
-			bLastsWholeDays = ( tempUint32 != 0 );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:type" ) == 0 )
-		{
-			fEventType = ( EventType )tempUint32;
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:duration" ) == 0 )
-		{
-			fDuration = ( time_t )tempUint32;
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:next_occurrence" ) == 0 )
-		{
-			fNextOccurrence = ( time_t )tempUint32;
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:and_rules" ) == 0 )
-		{
-			// Now buffer holds the flattened message of "And" rules.
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:not_rules" ) == 0 )
-		{
-			// Now buffer holds the flattened message of "Not" rules.
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:start_TR" ) == 0 )
-		{
-			tempMessage.MakeEmpty();
-			tempMessage.Unflatten( ( char* )placeholder );
-			fStart.Unarchive( &tempMessage );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:event_activity" ) == 0 )
-		{
-			tempMessage.MakeEmpty();
-			tempMessage.Unflatten( ( char* )placeholder );
-			fEventActivity.Instantiate( &tempMessage );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:activity_fired" ) == 0 )
-		{
-			bEventActivityWasFired = ( tempUint32 != 0 );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:reminder_offset" ) == 0 )
-		{
-			fOffsetBetweenReminderAndEvent = ( time_t )abs( ( time_t )tempUint32 );
-			if ( tempUint32 < 0 ) {
-				bReminderIsFiredBeforeEvent = 0;
-			}
-			else
-			{
-				bReminderIsFiredBeforeEvent = 1;
-			}
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:reminder_activity" ) == 0 )
-		{
-			tempMessage.MakeEmpty();
-			tempMessage.Unflatten( ( char* )placeholder );
-			fReminderActivity.Instantiate( &tempMessage );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:reminder_fired" ) == 0 )
-		{
-			bReminderActivityWasFired = ( tempUint32 != 0 );
-			continue;
-		}
-		else if ( strcmp( nameBuffer, "EVNT:cal_module" ) == 0 )
-		{
-			BString tempString( ( char* )buffer );
-			fCalModule = utl_FindCalendarModule( tempString );
-			
-			// Note: the start time representation is not verified for
-			// consistency with the calendar module saved here.
-		}
-	};	// <-- end of "while ( not all attributes were read )"
+		// The next save writes the record, even if nothing else changed
+		fDirtyFields = kEventFieldRecord;
+	}
 	
 	/*!	\note		Note about reading attributes
 	 *					Not all attributes of the file are parsed - mostly because not
@@ -404,267 +440,956 @@ void		EventData::InitFromFile( const entry_ref& fileIn )
 	 *					Event, only with saving it.
 	 */
 	
-	// Now, last thing we should do is read the note.
-	BString note;
-	do {
-		memset( nameBuffer, 0, B_ATTR_NAME_LENGTH );
-		tempSize = file.Read( ( void* )nameBuffer, B_ATTR_NAME_LENGTH-1 );
-		if ( tempSize < 0 ) {
-			utl_Deb = new DebuggerPrintout( "Didn't succeed to read file's data!" );
-		} else {
-			nameBuffer[ tempSize ] = 0;
-			note.Append( ( char* )nameBuffer );
-		}
-	} while( tempSize > 0 );	
-	
-	SetNoteText( note );
+	// The note is read only if someone asks for it - the server never does.
+	bNoteLoaded = false;
 	
-	if ( bLocked ) { file.Unlock(); }
-	file.Unset();	// Close the file.	
-}	// <-- end of function EventData::InitFromFile
+	if ( bLocked ) { node->Unlock(); }
+}	// <-- end of function EventData::_LoadFromNode
 
 
 
-/*!	\brief		Saving the Event data into file.
- *		\details		This function is a gateway for another, private function,
- *						that actually performs saving.
+/*!	\brief		Read the Event from the "EVNT:record" attribute.
+ *		\details		The record is read with one call into a buffer on the stack; only
+ *						a record that doesn't fit is read again into the heap. The whole
+ *						record is decoded before anything is changed, so a damaged record
+ *						leaves the object as it was.
+ *
+ *						A few attributes are not in the record, because they are changed
+ *						without rewriting it: the "fired" flags are written by the server,
+ *						the name and the location may be edited in Tracker, and the
+ *						category is rewritten when categories are merged.
+ *		\param[in]	node		The Event file.
+ *		\returns		\c B_OK if the record was read.
+ *		\returns		\c B_ENTRY_NOT_FOUND if the file has no record (it's an old file).
+ *		\returns		\c B_BAD_DATA or \c B_NOT_SUPPORTED if the record can't be decoded.
  */
-status_t		EventData::SaveToFile( entry_ref* fileIn )
+status_t		EventData::_LoadRecord( EventNode* node )
 {
-	entry_ref* newRef;
+	uint8			stackBuffer[ kDecoderStackBufferSize ];
+	uint8			*buffer = stackBuffer;
+	ssize_t		readSize;
+	status_t		status;
 	
-	if ( fileIn == NULL ) {
-		fileIn = fEventFile;
-	} 
-	else
-	{ 
-		newRef = new entry_ref( *fileIn );
-		if ( !newRef ) {
-			return B_NO_MEMORY;	
-		}
-		if ( fEventFile )
-			delete this->fEventFile;
-		fEventFile = newRef;
-		fileIn = newRef;
-	}
-	if ( fileIn == NULL ) { return B_ENTRY_NOT_FOUND; }
-	BFile file( fileIn, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE );
-	status_t toReturn = _SaveToFile( &file );
-	file.Unset();
-	return toReturn;
-}	// <-- end of function EventData::SaveToFile
-
-
-
-/*!	\brief		Saving the Event data into file.
- *		\details		This function is a gateway for another, private function,
- *						that actually performs saving.
- *		\param[in]	fileIn 		Pointer to the (previously opened) file.
- */
-status_t		EventData::SaveToFile( BFile *fileIn )
-{
-	if ( !fileIn ) { return B_NAME_NOT_FOUND; }
-	if ( ( fileIn->InitCheck() != B_OK ) ||
-	     ( !fileIn->IsWritable() ) )
-	{
-		return B_BAD_VALUE;
-	}
-	status_t toReturn = _SaveToFile( fileIn );
-	fileIn->Unset();		// Close the file
-	return toReturn;
-}	// <-- end of function EventData::SaveToFile
+	// Fields of the record
+	uint32		magic = 0, totalSize = 0, flags = 0, duration = 0, reminderOffset = 0;
+	uint16		version = 0, headerSize = 0;
+	int32			eventType = 0;
+	BString		calModuleId;
+	TimeRepresentation	start( fStart );
+	ActivityData	eventActivity, reminderActivity;
+	BList			andRules, notRules;
 	
-
-/*!	\brief		The private function that actually performs saving.
- */
-status_t		EventData::_SaveToFile( BFile* file )
-{
-	BMessage tempMessage;
-	uint8		*buffer;
-	uint32	tempUint32 = 0;
-	bool		tempBool = true;		// For creating "verified" attribute
-	status_t	status 	= B_OK;
-	bool		bLocked 	= false;
-	ssize_t	size = 0;
-	time_t	currentMoment = time( NULL );
-	BNodeInfo		nodeInfo;
+	// Temporary variables for applying the data
+	CalendarModule*	calModule;
+	uint32		tempUint32;
 	
-	if ( !file || ( status = file->InitCheck() ) != B_OK )
-	{
-		// Did not succeed to create the file
-		return status;
-	}
+	if ( !node ) { return B_BAD_VALUE; }
 	
-	// Lock the file.
-	// From now on, every exit from this function should perform Unlock()
-	if ( file->Lock() ) {
-		bLocked = true;
-	}
-
-
-	// Time Representation of the starting moment
-	tempMessage.MakeEmpty();
-	TimeRepresentation toSave( fStart );
-	if ( bLastsWholeDays ) {
-		toSave.tm_hour = toSave.tm_min = 0;
+	readSize = node->ReadAttr( "EVNT:record", B_RAW_TYPE, stackBuffer, sizeof( stackBuffer ) );
+	if ( readSize < 0 ) {
+		return ( status_t )readSize;
 	}
-	fCalModule = utl_FindCalendarModule( fStart.GetCalendarModule() );
-	toSave.Archive( &tempMessage );
-	size = tempMessage.FlattenedSize();
-	buffer = new uint8[ size ];
-	if ( buffer ) {
-		status = tempMessage.Flatten( ( char* )buffer, size );
-		if ( status == B_OK ) {
-			file->WriteAttr( "EVNT:start_TR", B_RAW_TYPE, 0, buffer, size );
-		}
-		delete buffer;
-		buffer = NULL;
-	}
-	
-	// Calculate next occurrence
-	fNextOccurrence = fCalModule->FromLocalCalendarToTimeT( toSave );
 	
-	// Next occurrence
-	if ( fActivitySnoozedTime == 0 ) {
-		file->WriteAttr( "EVNT:next_occurrence", 	B_UINT32_TYPE,	0, ( uint32* )&fNextOccurrence,	sizeof( uint32 ) );
-	} else {
-		file->WriteAttr( "EVNT:next_occurrence", 	B_UINT32_TYPE,	0, ( uint32* )&fActivitySnoozedTime,	sizeof( uint32 ) );
+	// The fixed header tells the version and the full size of the record
+	RecordReader header( stackBuffer, ( size_t )readSize );
+	header.ReadUint32( &magic );
+	header.ReadUint16( &version );
+	header.ReadUint16( &headerSize );
+	header.ReadUint32( &totalSize );
+	if ( header.InitCheck() != B_OK || magic != kEventRecordMagic ||
+		  headerSize < kEventRecordHeaderSize || totalSize < headerSize )
+	{
+		return B_BAD_DATA;
+	}
+	if ( version == 0 || version > kEventRecordVersion ) {
+		return B_NOT_SUPPORTED;
 	}
 	
-	// Calculate next reminder
-	tempUint32 = ( uint32 )fNextOccurrence + ( bReminderIsFiredBeforeEvent ? ( -1 ) : 1 ) * ( uint32 )fOffsetBetweenReminderAndEvent;
-	
-	file->WriteAttr( "EVNT:name", 				B_STRING_TYPE,	0, fEventName.String(),				fEventName.Length() );
-	file->WriteAttr( "EVNT:category",			B_STRING_TYPE,	0, fCategory.String(),				fCategory.Length() );
-	file->WriteAttr( "EVNT:where", 				B_STRING_TYPE,	0, fLocation.String(),				fLocation.Length() );
-	file->WriteAttr( "EVNT:private", 			B_INT32_TYPE,	0, ( int32* )&bPrivate,				sizeof( int32 ) );
-	file->WriteAttr( "EVNT:verified",			B_INT32_TYPE,	0, ( int32* )&tempBool,				sizeof( int32 ) );
-	file->WriteAttr( "EVNT:type",	 				B_INT32_TYPE,	0, ( int32* )&fEventType,			sizeof( int32 ) );
-	file->WriteAttr( "EVNT:reminder_offset",	B_UINT32_TYPE, 0, ( uint32* )&fOffsetBetweenReminderAndEvent, sizeof( uint32 ) );
-	
-	// Next time of the reminder invocation
-	// This value doesn't depend on the reminder being enabled or disabled; it's written anyway
-	if ( fReminderSnoozedTime != 0 ) {
-		// The reminder was snoozed - calculate new time based on snooze time
-		file->WriteAttr( "EVNT:next_reminder",		B_UINT32_TYPE, 0, ( uint32* )&fReminderSnoozedTime, sizeof( uint32 ) );
-	} else {
-		// Else, calculate time based on start time and offset
-		file->WriteAttr( "EVNT:next_reminder",		B_UINT32_TYPE, 0, ( uint32* )&tempUint32, sizeof( uint32 ) );
-	}
-	
-	// Duration
-	file->WriteAttr( "EVNT:duration", B_UINT32_TYPE,	0, ( uint32* )&fDuration, sizeof( uint32 ) );	
-	
-	// "And" rules
-	tempMessage.MakeEmpty();
-//	CreateMessageFromRules( &fAndRules, &tempMessage );
-	size = tempMessage.FlattenedSize();
-	if ( size ) {
-		buffer = new uint8[ size ];
-		if ( buffer ) {
-			status = tempMessage.Flatten( ( char* )buffer, size );
-			if ( status == B_OK ) {
-				file->WriteAttr( "EVNT:and_rules", B_RAW_TYPE,	0, buffer, size );
-			}
+	if ( totalSize > ( uint32 )readSize ) {
+		buffer = new uint8[ totalSize ];
+		if ( !buffer ) {
+			return B_NO_MEMORY;
+		}
+		readSize = node->ReadAttr( "EVNT:record", B_RAW_TYPE, buffer, totalSize );
+		if ( readSize != ( ssize_t )totalSize ) {
 			delete [] buffer;
-			buffer = NULL;
+			return ( readSize < 0 ) ? ( status_t )readSize : B_BAD_DATA;
 		}
 	}
 	
-
+	// Decode the whole record into the local variables
+	RecordReader reader( buffer, totalSize );
+	reader.Seek( kEventRecordFlagsOffset );
+	reader.ReadUint32( &flags );
+	reader.ReadInt32( &eventType );
+	reader.ReadUint32( &duration );
+	reader.ReadUint32( &reminderOffset );
 	
-	// "Not" rules
-	tempMessage.MakeEmpty();
-//	CreateMessageFromRules( &fNotRules, &tempMessage );
-	size = tempMessage.FlattenedSize();
-	if ( size ) {
-		buffer = new uint8[ size ];
-		if ( buffer ) {
-			status = tempMessage.Flatten( ( char* )buffer, size );
-			if ( status == B_OK ) {
-				file->WriteAttr( "EVNT:not_rules", B_RAW_TYPE,	0, buffer, size );
-			}
-			delete buffer;
-			buffer = NULL;
-		}
+	// Fixed fields added by newer minor versions are skipped
+	reader.Seek( headerSize );
+	reader.ReadString( &calModuleId );
+	status = _LoadRecordBinaries( &reader, &start, &eventActivity, &reminderActivity );
+	start.SetCalendarModule( calModuleId );
+	if ( status == B_OK && reader.Remaining() > 0 ) {
+		status = _LoadRecordRules( &reader, &andRules, &notRules );
 	}
 	
-	// Calendar module
-	if ( fCalModule ) {
-		file->WriteAttr( "EVNT:cal_module", B_STRING_TYPE, 0, fCalModule->Identify().String(), fCalModule->Identify().Length() );
+	if ( buffer != stackBuffer ) {
+		delete [] buffer;
 	}
-	
-	// Event activity
-	tempMessage.MakeEmpty();
-	fEventActivity.Archive( &tempMessage );
-	size = tempMessage.FlattenedSize();
-	buffer = new uint8[ size ];
-	if ( buffer ) {
-		status = tempMessage.Flatten( ( char* )buffer, size );
-		if ( status == B_OK ) {
-			file->WriteAttr( "EVNT:event_activity", B_RAW_TYPE, 0, buffer, size );
-		}
-		delete buffer;
-		buffer = NULL;
-	}
-	
-	// Reminder activity
-	tempMessage.MakeEmpty();
-	fReminderActivity.Archive( &tempMessage );
-	size = tempMessage.FlattenedSize();
-	buffer = new uint8[ size ];
-	if ( buffer ) {
-		status = tempMessage.Flatten( ( char* )buffer, size );
-		if ( status == B_OK ) {
-			file->WriteAttr( "EVNT:reminder_activity", B_RAW_TYPE, 0, buffer, size );
-		}
-		delete buffer;
-		buffer = NULL;
+	if ( status != B_OK ) {
+		_DeleteRules( &andRules );
+		_DeleteRules( &notRules );
+		return B_BAD_DATA;
 	}
 	
-	// Was activity fired? 
-	// If it's schedulled to occur in the past - don't set the flag.
-	if ( !bEventActivityWasFired && ( currentMoment > fNextOccurrence ) ) {
-		tempUint32 = 0;
-	}
-	else
-	{
-		tempUint32 = 1;
+	// Everything was decoded - update the object
+	bPrivate = ( ( flags & kEventRecordPrivate ) != 0 );
+	bVerified = ( ( flags & kEventRecordVerified ) != 0 );
+	bLastsWholeDays = ( ( flags & kEventRecordWholeDay ) != 0 );
+	bReminderIsFiredBeforeEvent = ( ( flags & kEventRecordReminderBeforeEvent ) != 0 );
+	fEventType = ( EventType )eventType;
+	fDuration = ( time_t )duration;
+	fOffsetBetweenReminderAndEvent = ( time_t )reminderOffset;
+	if ( ( calModule = utl_FindCalendarModule( calModuleId ) ) != NULL ) {
+		fCalModule = calModule;
 	}
-	file->WriteAttr( "EVNT:activity_fired", B_INT32_TYPE, 0, &tempUint32, sizeof( uint32 ) );
+	fStart = start;
+	fEventActivity = eventActivity;
+	fReminderActivity = reminderActivity;
+	_DeleteRules( &fAndRules );
+	_DeleteRules( &fNotRules );
+	fAndRules.AddList( &andRules );
+	fNotRules.AddList( &notRules );
+	_InvalidateExclusions();
 	
-	// Was reminder fired? 
-	// If it's schedulled to occur in the past - don't set the flag.
-	if ( !bReminderActivityWasFired && ( currentMoment > fNextOccurrence + ( ( bReminderIsFiredBeforeEvent ? -1 : 1 ) * fOffsetBetweenReminderAndEvent ) ) ) {
-		tempUint32 = 0;
+	// The attributes that are written without the record
+	if ( node->ReadAttr( "EVNT:activity_fired", B_INT32_TYPE, &tempUint32, sizeof( uint32 ) ) == sizeof( uint32 ) ) {
+		bEventActivityWasFired = ( tempUint32 != 0 );
 	}
-	else
-	{
-		tempUint32 = 1;
+	if ( node->ReadAttr( "EVNT:reminder_fired", B_INT32_TYPE, &tempUint32, sizeof( uint32 ) ) == sizeof( uint32 ) ) {
+		bReminderActivityWasFired = ( tempUint32 != 0 );
 	}
-	// tempBool = ( !bReminderActivityWasFired ) && ( currentMoment > ( fCalModule->FromLocalCalendarToTimeT( toSave ) ) );
-	file->WriteAttr( "EVNT:reminder_fired", B_INT32_TYPE, 0, &tempUint32, sizeof( uint32 ) );
-
-	// Does the Event lasts full days?
-	file->WriteAttr( "EVNT:whole_day",		B_INT32_TYPE, 0, &bLastsWholeDays, sizeof( int32 ) );
+	node->ReadAttrString( "EVNT:name", &fEventName );
+	node->ReadAttrString( "EVNT:category", &fCategory );
+	node->ReadAttrString( "EVNT:where", &fLocation );
+	
+	return B_OK;
+}	// <-- end of function EventData::_LoadRecord
 
 
-	// Adding some general attributes
-	if ( B_OK == nodeInfo.SetTo( file ) )
+
+/*!	\brief		Decode the start time and the activities of the record.
+ *		\details		The start time is a fixed-size binary date; the activities are
+ *						decoded straight from the record.
+ */
+status_t		EventData::_LoadRecordBinaries( RecordReader* reader,
+														  TimeRepresentation* start,
+														  ActivityData* eventActivity,
+														  ActivityData* reminderActivity )
+{
+	const void	*startData;
+	status_t		status;
+	
+	if ( ( status = reader->ReadBytes( &startData, kTimeRepresentationBinarySize ) ) != B_OK ||
+		  ( status = start->FromBinary( startData, kTimeRepresentationBinarySize ) ) != B_OK ||
+		  ( status = eventActivity->Unflatten( reader ) ) != B_OK ||
+		  ( status = reminderActivity->Unflatten( reader ) ) != B_OK )
+	{
+		return status;
+	}
+	return B_OK;
+}	// <-- end of function EventData::_LoadRecordBinaries
+
+
+
+/*!	\brief		Decode the recurrence rules of the record.
+ *		\param[out]	andRules		Receives the inclusion rules.
+ *		\param[out]	notRules		Receives the exclusion rules.
+ *		\returns		\c B_OK, or \c B_BAD_DATA if a rule can't be decoded. The rules
+ *						that were decoded are left in the lists anyway.
+ */
+status_t		EventData::_LoadRecordRules( RecordReader* reader, BList* andRules, BList* notRules )
+{
+	BList*			lists[ 2 ] = { andRules, notRules };
+	const void*		data;
+	uint32			count, size;
+	RecurrenceRule*	rule;
+	
+	for ( int i = 0; i < 2; ++i )
+	{
+		if ( reader->ReadUint32( &count ) != B_OK ) {
+			return B_BAD_DATA;
+		}
+		for ( uint32 j = 0; j < count; ++j )
+		{
+			if ( reader->ReadData( &data, &size ) != B_OK ) {
+				return B_BAD_DATA;
+			}
+			RecordReader ruleReader( data, size );
+			rule = new RecurrenceRule();
+			if ( !rule ) {
+				return B_NO_MEMORY;
+			}
+			if ( rule->Unflatten( &ruleReader ) != B_OK ) {
+				delete rule;
+				return B_BAD_DATA;
+			}
+			lists[ i ]->AddItem( rule );
+		}
+	}
+	return B_OK;
+}	// <-- end of function EventData::_LoadRecordRules
+
+
+
+/*!	\brief		Read the Event from the separate attributes.
+ *		\details		This is how the files of the older versions are read. Every
+ *						attribute of the file is checked against the hash table, and
+ *						only the known ones are read.
+ *		\param[in]	node		The Event file.
+ */
+status_t		EventData::_LoadAttributes( EventNode* node )
+{
+	attr_info	ai;
+	char			nameBuffer[ B_ATTR_NAME_LENGTH ];	// 255 bytes
+	uint8			stackBuffer[ kDecoderStackBufferSize ];
+	uint8			*heapBuffer = NULL;
+	size_t		heapBufferSize = 0;
+	uint8			*buffer = NULL;
+	EventAttribute	attribute;
+	
+	// Temporary variables for reading the data
+	uint32		tempUint32;
+	int64			tempInt64;
+	BMessage		tempMessage;
+	ssize_t		tempSize = 0;
+	
+	if ( !node ) { return B_BAD_VALUE; }
+	
+	// Reading attributes is performed until all attributes were read.
+	node->RewindAttrs();
+	while ( node->GetNextAttrName( nameBuffer ) == B_OK )
+	{
+		// Attributes that are not decoded (icon, type...) are not even read
+		if ( EVNT_ATTR_UNKNOWN == ( attribute = LookupEventAttribute( nameBuffer ) ) ) {
+			continue;
+		}
+		
+		// If we didn't succeed to get attribute-info for the attribute, we just continue
+		if ( node->GetAttrInfo( nameBuffer, &ai ) != B_OK || ai.size < 0 ) {
+			continue;
+		}
+		
+		// Most attributes fit the buffer on the stack. The larger ones share a heap
+		// buffer, which only grows.
+		if ( ( size_t )ai.size < sizeof( stackBuffer ) ) {
+			buffer = stackBuffer;
+		} else {
+			if ( heapBufferSize < ( size_t )ai.size + 1 ) {
+				if ( heapBuffer ) {
+					delete [] heapBuffer;
+				}
+				heapBufferSize = ( size_t )ai.size + 1;
+				heapBuffer = new uint8[ heapBufferSize ];
+				if ( !heapBuffer ) {
+					// Did not succeed to allocate buffer - stop reading.
+					return B_NO_MEMORY;
+				}
+			}
+			buffer = heapBuffer;
+		}
+		
+		// Read the attribute
+		tempSize = node->ReadAttr( nameBuffer, ai.type, buffer, ai.size );
+		if ( tempSize < 0 ) {
+			continue;
+		}
+		buffer[ tempSize ] = 0;
+		
+		// Constant-length types are read as a number. The time attributes are
+		// 64-bit, unless they were written by an older version.
+		tempUint32 = 0;
+		tempInt64 = 0;
+		if ( ai.type != B_STRING_TYPE ) {
+			if ( ( size_t )tempSize == sizeof( int64 ) ) {
+				memcpy( &tempInt64, buffer, sizeof( int64 ) );
+				tempUint32 = ( uint32 )tempInt64;
+			} else if ( ( size_t )tempSize <= sizeof( uint32 ) ) {
+				memcpy( &tempUint32, buffer, tempSize );
+				tempInt64 = ( int64 )tempUint32;
+			}
+		}
+		
+		/* Ok, the attribute was read successfully. What is it?
+		 */
+		switch ( attribute )
+		{
+			case EVNT_ATTR_NAME:
+				fEventName.SetTo( ( char* )buffer );
+				break;
+			
+			case EVNT_ATTR_CATEGORY:
+				fCategory.SetTo( ( char* )buffer );
+				break;
+			
+			case EVNT_ATTR_WHERE:
+				fLocation.SetTo( ( char* )buffer );
+				break;
+			
+			case EVNT_ATTR_PRIVATE:
+				bPrivate = ( tempUint32 != 0 );
+				break;
+			
+			case EVNT_ATTR_VERIFIED:
+				bVerified = ( tempUint32 != 0 );
+				break;
+			
+			case EVNT_ATTR_WHOLE_DAY:
+				bLastsWholeDays = ( tempUint32 != 0 );
+				break;
+			
+			case EVNT_ATTR_TYPE:
+				fEventType = ( EventType )tempUint32;
+				break;
+			
+			case EVNT_ATTR_DURATION:
+				fDuration = ( time_t )tempInt64;
+				break;
+			
+			case EVNT_ATTR_NEXT_OCCURRENCE:
+				fNextOccurrence = ( time_t )tempInt64;
+				break;
+			
+			case EVNT_ATTR_START_TR:
+				tempMessage.MakeEmpty();
+				tempMessage.Unflatten( ( char* )buffer );
+				fStart.Unarchive( &tempMessage );
+				break;
+			
+			case EVNT_ATTR_EVENT_ACTIVITY:
+				tempMessage.MakeEmpty();
+				tempMessage.Unflatten( ( char* )buffer );
+				fEventActivity.Instantiate( &tempMessage );
+				break;
+			
+			case EVNT_ATTR_ACTIVITY_FIRED:
+				bEventActivityWasFired = ( tempUint32 != 0 );
+				break;
+			
+			case EVNT_ATTR_REMINDER_OFFSET:
+				// Negative offset means the reminder fires after the Event
+				fOffsetBetweenReminderAndEvent = ( time_t )( ( tempInt64 < 0 ) ? -tempInt64 : tempInt64 );
+				if ( tempInt64 < 0 ) {
+					bReminderIsFiredBeforeEvent = 0;
+				}
+				else
+				{
+					bReminderIsFiredBeforeEvent = 1;
+				}
+				break;
+			
+			case EVNT_ATTR_REMINDER_ACTIVITY:
+				tempMessage.MakeEmpty();
+				tempMessage.Unflatten( ( char* )buffer );
+				fReminderActivity.Instantiate( &tempMessage );
+				break;
+			
+			case EVNT_ATTR_REMINDER_FIRED:
+				bReminderActivityWasFired = ( tempUint32 != 0 );
+				break;
+			
+			case EVNT_ATTR_CAL_MODULE:
+			{
+				BString tempString( ( char* )buffer );
+				fCalModule = utl_FindCalendarModule( tempString );
+				
+				// Note: the start time representation is not verified for
+				// consistency with the calendar module saved here.
+				break;
+			}
+			
+			default:
+				break;
+		};
+	};	// <-- end of "while ( not all attributes were read )"
+	
+	if ( heapBuffer ) {
+		delete [] heapBuffer;
+	}
+	
+	return B_OK;
+}	// <-- end of function EventData::_LoadAttributes
+
+
+
+/*!	\brief		Read the note from the file, if it wasn't read yet.
+ *		\details		The whole data of the file is the note. It's read with one call
+ *						straight into the buffer of \c fNote, so the cost of loading an
+ *						Event that nobody reads the note of doesn't depend on its size.
+ *						A failure is not retried - the note is left empty.
+ */
+void		EventData::_LoadNote() const
+{
+	EventNode*	node;
+	
+	if ( bNoteLoaded ) { return; }
+	bNoteLoaded = true;
+	fNote.SetTo( "" );
+	
+	if ( fStorage ) {
+		if ( ( node = fStorage->Open( fStorageKey.String(), B_READ_ONLY ) ) != NULL ) {
+			_ReadNote( node );
+			delete node;
+		}
+	} else if ( fEventFile ) {
+		BfsEventNode	file( *fEventFile, B_READ_ONLY );
+		_ReadNote( &file );
+	}
+}	// <-- end of function EventData::_LoadNote
+
+
+
+/*!	\brief		Read the note from the data of the node into \c fNote.
+ */
+void		EventData::_ReadNote( EventNode* node ) const
+{
+	off_t		size = 0;
+	ssize_t	readSize;
+	char*		buffer;
+	
+	if ( node->InitCheck() != B_OK ||
+		  node->GetSize( &size ) != B_OK ||
+		  size <= 0 )
+	{
+		return;
+	}
+	if ( size >= INT_MAX ) {
+		utl_Deb = new DebuggerPrintout( "The note is too large!" );
+		return;
+	}
+	
+	if ( ( buffer = fNote.LockBuffer( ( int32 )size ) ) == NULL ) {
+		return;
+	}
+	readSize = node->ReadAt( 0, buffer, ( size_t )size );
+	fNote.UnlockBuffer( ( readSize > 0 ) ? ( int32 )readSize : 0 );
+	
+	if ( readSize < 0 ) {
+		utl_Deb = new DebuggerPrintout( "Didn't succeed to read file's data!" );
+	}
+}	// <-- end of function EventData::_ReadNote
+
+
+
+/*!	\brief		Saving the Event data into file.
+ *		\details		This function is a gateway for another, private function,
+ *						that actually performs saving.
+ *
+ *						If the Event is saved into the file it was read from, only the
+ *						fields that were changed are written; the file's data is kept as
+ *						is, unless the note was changed. A new file gets everything,
+ *						including a copy of the note, which is read first if needed.
+ */
+status_t		EventData::SaveToFile( entry_ref* fileIn )
+{
+	entry_ref* newRef;
+	uint32	openMode = B_WRITE_ONLY | B_CREATE_FILE;
+	uint32	fields = fDirtyFields;
+	status_t	status;
+	
+	if ( fileIn != NULL && ( !fEventFile || *fEventFile != *fileIn ) ) {
+		fields = kEventFieldAll;
+	}
+	if ( fields & kEventFieldNote ) {
+		_LoadNote();
+		openMode |= B_ERASE_FILE;
+	}
+	
+	if ( fileIn == NULL ) {
+		fileIn = fEventFile;
+	} 
+	else
+	{ 
+		newRef = new entry_ref( *fileIn );
+		if ( !newRef ) {
+			return B_NO_MEMORY;	
+		}
+		if ( fEventFile )
+			delete this->fEventFile;
+		fEventFile = newRef;
+		fileIn = newRef;
+	}
+	if ( fileIn == NULL ) { return B_ENTRY_NOT_FOUND; }
+	fStorage = NULL;
+	fStorageKey.SetTo( "" );
+	BfsEventNode file( *fileIn, openMode );
+	if ( ( status = _SaveToFile( &file, fields ) ) == B_OK ) {
+		fDirtyFields = 0;
+	}
+	return status;
+}	// <-- end of function EventData::SaveToFile
+
+
+
+/*!	\brief		Saving the Event data into file.
+ *		\details		This function is a gateway for another, private function,
+ *						that actually performs saving.
+ *		\param[in]	fileIn 		Pointer to the (previously opened) file.
+ *		\attention	The note is always written. If it wasn't read yet, it's read
+ *						from the original file first - therefore, if \c fileIn is the
+ *						original file, it should not be opened with \c B_ERASE_FILE.
+ */
+status_t		EventData::SaveToFile( BFile *fileIn )
+{
+	if ( !fileIn ) { return B_NAME_NOT_FOUND; }
+	if ( ( fileIn->InitCheck() != B_OK ) ||
+	     ( !fileIn->IsWritable() ) )
 	{
-		nodeInfo.SetType( kEventFileMIMEType );
-		nodeInfo.SetPreferredApp( kEventEditorApplicationSignature, B_OPEN );
+		return B_BAD_VALUE;
 	}
+	_LoadNote();
+	BfsEventNode node( fileIn );
+	status_t toReturn = _SaveToFile( &node );
+	fileIn->Unset();		// Close the file
+	return toReturn;
+}	// <-- end of function EventData::SaveToFile
+
+
+
+/*!	\brief		Save the Event into a storage.
+ *		\details		Same as SaveToFile(), for the Events that are not files.
+ *		\param[in]	storage		Where to save the Event.
+ *		\param[in]	key			The key of the Event in the storage. If \c NULL, the
+ *										Event is saved where it was loaded from.
+ */
+status_t		EventData::Save( EventStorage* storage, const char* key )
+{
+	EventNode*	node;
+	status_t		status;
+	uint32		openMode = B_READ_WRITE | B_CREATE_FILE;
+	uint32		fields = fDirtyFields;
+	BString		keyCopy( key ? key : fStorageKey.String() );
+	
+	if ( !storage || keyCopy.Length() == 0 ) { return B_BAD_VALUE; }
 	
-	// Saving the note
-	file->Write( fNote.String(), fNote.Length() );
+	// Same as in SaveToFile() - only the changes are saved in place
+	if ( storage != fStorage || keyCopy != fStorageKey ) {
+		fields = kEventFieldAll;
+	}
+	if ( fields & kEventFieldNote ) {
+		_LoadNote();
+		openMode |= B_ERASE_FILE;
+	}
+	
+	if ( ( node = storage->Open( keyCopy.String(), openMode ) ) == NULL ) {
+		return B_NO_MEMORY;
+	}
+	status = _SaveToFile( node, fields );
+	delete node;
+	if ( status == B_OK ) {
+		fDirtyFields = 0;
+	}
+	
+	if ( this->fEventFile ) {
+		delete this->fEventFile;
+		this->fEventFile = NULL;
+	}
+	fStorage = storage;
+	fStorageKey = keyCopy;
+	return status;
+}	// <-- end of function EventData::Save
+
+
+
+/*!	\brief		Load an Event from the storage.
+ *		\details		Same as EventData::Load(). It's implemented here, and not with
+ *						the rest of EventStorage, so that the storages don't need EventData.
+ */
+status_t		EventStorage::Load( const char* key, EventData* event )
+{
+	if ( !event ) { return B_BAD_VALUE; }
+	return event->Load( this, key );
+}	// <-- end of function EventStorage::Load
+
+
+
+/*!	\brief		Save an Event to the storage.
+ *		\details		Same as EventData::Save().
+ */
+status_t		EventStorage::Save( const char* key, EventData* event )
+{
+	if ( !event ) { return B_BAD_VALUE; }
+	return event->Save( this, key );
+}	// <-- end of function EventStorage::Save
+
+
+
+/*!	\brief		Update only the "fired" flag of the activity in the file.
+ *		\details		The rest of the file is not touched - this is what the server
+ *						uses after it fires an activity, instead of SaveToFile().
+ *		\param[in]	fileIn		The Event file.
+ *		\param[in]	bReminder	\c true for the reminder activity, \c false for the Event one.
+ *		\param[in]	bFired		New value of the flag.
+ */
+status_t		EventData::SaveFiredFlag( const entry_ref& fileIn, bool bReminder, bool bFired )
+{
+	BNode		node( &fileIn );
+	uint32	tempUint32 = ( bFired ? 1 : 0 );
+	ssize_t	written;
+	status_t	status;
+	
+	if ( ( status = node.InitCheck() ) != B_OK ) {
+		return status;
+	}
+	
+	written = node.WriteAttr( bReminder ? "EVNT:reminder_fired" : "EVNT:activity_fired",
+									  B_INT32_TYPE, 0, &tempUint32, sizeof( uint32 ) );
+	if ( written < 0 ) {
+		return ( status_t )written;
+	}
+	if ( written != sizeof( uint32 ) ) {
+		return B_IO_ERROR;
+	}
+	return UpdateNextDue( &node );
+}	// <-- end of function EventData::SaveFiredFlag
+
+
+
+/*!	\brief		Move a repeating Event to its next occurrence in the file.
+ *		\details		The server calls it right after it fires the last activity of an
+ *						occurrence, instead of SaveFiredFlag(). Both activities become
+ *						pending again; a reminder whose time has already passed is
+ *						treated as fired, the same way SaveToFile() does.
+ *		\param[in]	fileIn				The Event file.
+ *		\param[in]	nextOccurrence		Start of the next occurrence.
+ *		\param[in]	reminderOffset		Signed offset of the reminder, as in
+ *												"EVNT:reminder_offset"; 0 if it's disabled.
+ */
+status_t		EventData::SaveNextOccurrence( const entry_ref& fileIn, int64 nextOccurrence,
+														 int64 reminderOffset )
+{
+	BNode		node( &fileIn );
+	int64		nextReminder = nextOccurrence - reminderOffset;
+	uint32	activityFired = 0;
+	uint32	reminderFired = ( nextReminder < ( int64 )time( NULL ) ) ? 1 : 0;
+	bool		bLocked;
+	status_t	status;
+	
+	if ( ( status = node.InitCheck() ) != B_OK ) {
+		return status;
+	}
+	
+	bLocked = ( node.Lock() == B_OK );
+	utl_WriteTimeAttr( &node, "EVNT:next_reminder", nextReminder );
+	utl_WriteTimeAttr( &node, "EVNT:next_occurrence", nextOccurrence );
+	node.WriteAttr( "EVNT:activity_fired", B_INT32_TYPE, 0, &activityFired, sizeof( uint32 ) );
+	node.WriteAttr( "EVNT:reminder_fired", B_INT32_TYPE, 0, &reminderFired, sizeof( uint32 ) );
+	status = SaveNextDue( &node, true, nextOccurrence,
+								 ( reminderOffset != 0 && reminderFired == 0 ), nextReminder );
+	if ( bLocked ) { node.Unlock(); }
+	return status;
+}	// <-- end of function EventData::SaveNextOccurrence
+
+
+
+/*!	\brief		Write the "EVNT:next_due" attribute.
+ *		\details		The attribute holds the earliest deadline among the activities
+ *						that were not fired yet. If nothing is pending, the attribute is
+ *						removed - so the index of "EVNT:next_due" contains only the
+ *						Events the server should care about.
+ *		\param[in]	node					The Event file.
+ *		\param[in]	bActivityPending	\c true if the Event activity wasn't fired.
+ *		\param[in]	nextOccurrence		When the Event activity should fire.
+ *		\param[in]	bReminderPending	\c true if the reminder is enabled and wasn't fired.
+ *		\param[in]	nextReminder		When the reminder activity should fire.
+ */
+status_t		EventData::SaveNextDue( BNode* node,
+											 bool bActivityPending, int64 nextOccurrence,
+											 bool bReminderPending, int64 nextReminder )
+{
+	if ( !node ) { return B_BAD_VALUE; }
+	
+	BfsEventNode	eventNode( node );
+	return SaveNextDue( &eventNode, bActivityPending, nextOccurrence, bReminderPending, nextReminder );
+}	// <-- end of function EventData::SaveNextDue
+
+
+
+status_t		EventData::SaveNextDue( EventNode* node,
+											 bool bActivityPending, int64 nextOccurrence,
+											 bool bReminderPending, int64 nextReminder )
+{
+	int64		nextDue;
+	status_t	status;
+	
+	if ( !node ) { return B_BAD_VALUE; }
+	
+	if ( !bActivityPending && !bReminderPending ) {
+		status = node->RemoveAttr( "EVNT:next_due" );
+		return ( status == B_ENTRY_NOT_FOUND ) ? B_OK : status;
+	}
+	
+	if ( bActivityPending && bReminderPending ) {
+		nextDue = ( nextOccurrence < nextReminder ) ? nextOccurrence : nextReminder;
+	} else if ( bActivityPending ) {
+		nextDue = nextOccurrence;
+	} else {
+		nextDue = nextReminder;
+	}
+	
+	return node->WriteTimeAttr( "EVNT:next_due", nextDue );
+}	// <-- end of function EventData::SaveNextDue
+
+
+
+/*!	\brief		Recalculate "EVNT:next_due" from the other attributes of the file.
+ *		\details		Used when only a part of the attributes is written, and for Event
+ *						files created before "EVNT:next_due" existed.
+ */
+status_t		EventData::UpdateNextDue( BNode* node )
+{
+	if ( !node ) { return B_BAD_VALUE; }
+	
+	BfsEventNode	eventNode( node );
+	return UpdateNextDue( &eventNode );
+}	// <-- end of function EventData::UpdateNextDue
+
+
+
+status_t		EventData::UpdateNextDue( EventNode* node )
+{
+	uint32	activityFired = 1, reminderFired = 1;
+	int64		reminderOffset = 0, nextOccurrence = 0, nextReminder = 0;
+	status_t	status;
+	
+	if ( !node ) { return B_BAD_VALUE; }
+	if ( ( status = node->InitCheck() ) != B_OK ) { return status; }
+	
+	// Missing attributes leave the defaults - not pending
+	node->ReadAttr( "EVNT:activity_fired", B_UINT32_TYPE, &activityFired, sizeof( uint32 ) );
+	node->ReadAttr( "EVNT:reminder_fired", B_UINT32_TYPE, &reminderFired, sizeof( uint32 ) );
+	node->ReadTimeAttr( "EVNT:reminder_offset", &reminderOffset );
+	node->ReadTimeAttr( "EVNT:next_occurrence", &nextOccurrence );
+	node->ReadTimeAttr( "EVNT:next_reminder", &nextReminder );
+	
+	return SaveNextDue( node,
+							  ( activityFired == 0 ), nextOccurrence,
+							  ( reminderOffset != 0 && reminderFired == 0 ), nextReminder );
+}	// <-- end of function EventData::UpdateNextDue
+	
+
+/*!	\brief		Write the "EVNT:record" attribute.
+ *		\details		The record holds the fields that are not indexed and not shown in
+ *						Tracker. The separate attributes the older versions used for these
+ *						fields are left alone: they are no longer written, and they are
+ *						read only if the record is missing or damaged.
+ *		\param[in]	node		The Event file.
+ *		\param[in]	start		The start time, as it should be saved.
+ */
+status_t		EventData::_SaveRecord( EventNode* node, TimeRepresentation& start )
+{
+	RecordWriter	writer;
+	uint8				startData[ kTimeRepresentationBinarySize ];
+	uint32			flags = 0;
+	ssize_t			written;
+	status_t			status;
+	
+	if ( !node ) { return B_BAD_VALUE; }
+	
+	if ( bPrivate ) { flags |= kEventRecordPrivate; }
+	if ( bVerified ) { flags |= kEventRecordVerified; }
+	if ( bLastsWholeDays ) { flags |= kEventRecordWholeDay; }
+	if ( bReminderIsFiredBeforeEvent ) { flags |= kEventRecordReminderBeforeEvent; }
+	
+	// Fixed header
+	writer.AddUint32( kEventRecordMagic );
+	writer.AddUint16( kEventRecordVersion );
+	writer.AddUint16( kEventRecordHeaderSize );
+	writer.AddUint32( 0 );		// Size of the record - set when it's complete
+	writer.AddUint32( flags );
+	writer.AddInt32( ( int32 )fEventType );
+	writer.AddUint32( ( uint32 )fDuration );
+	writer.AddUint32( ( uint32 )fOffsetBetweenReminderAndEvent );
+	
+	// Variable-length fields
+	writer.AddString( fCalModule ? fCalModule->Identify() : BString( "" ) );
+	
+	if ( ( status = start.ToBinary( startData, sizeof( startData ) ) ) != B_OK ) {
+		return status;
+	}
+	writer.AddBytes( startData, sizeof( startData ) );
+	fEventActivity.Flatten( &writer );
+	fReminderActivity.Flatten( &writer );
+	
+	// The rules, only if there are any
+	if ( IsRecurring() || !fNotRules.IsEmpty() ) {
+		const BList*	lists[ 2 ] = { &fAndRules, &fNotRules };
+		for ( int i = 0; i < 2; ++i )
+		{
+			writer.AddUint32( ( uint32 )lists[ i ]->CountItems() );
+			for ( int32 j = 0; j < lists[ i ]->CountItems(); ++j )
+			{
+				RecordWriter	ruleWriter;
+				( ( RecurrenceRule* )lists[ i ]->ItemAt( j ) )->Flatten( &ruleWriter );
+				if ( ( status = ruleWriter.InitCheck() ) != B_OK ) {
+					return status;
+				}
+				writer.AddData( ruleWriter.Buffer(), ruleWriter.Size() );
+			}
+		}
+	}
+	
+	writer.SetUint32At( kEventRecordSizeOffset, ( uint32 )writer.Size() );
+	if ( ( status = writer.InitCheck() ) != B_OK ) {
+		return status;
+	}
+	
+	written = node->WriteAttr( "EVNT:record", B_RAW_TYPE, writer.Buffer(), writer.Size() );
+	if ( written < 0 ) {
+		return ( status_t )written;
+	}
+	if ( ( size_t )written != writer.Size() ) {
+		return B_IO_ERROR;
+	}
+	return B_OK;
+}	// <-- end of function EventData::_SaveRecord
+
+
+
+/*!	\brief		The private function that actually performs saving.
+ *		\details		The indexed attributes, and the ones shown in Tracker, are written
+ *						separately - the queries and the server depend on them. All the
+ *						rest goes into the "EVNT:record".
+ *
+ *						Only the attributes of the given fields are written. The "fired"
+ *						flags and "EVNT:next_due" are recalculated whenever the schedule
+ *						or the flags change; the type of the file is set only when
+ *						everything is saved.
+ *		\param[in]	node		The Event file.
+ *		\param[in]	fields	Which fields to write; see \c kEventFieldAll.
+ */
+status_t		EventData::_SaveToFile( EventNode* node, uint32 fields )
+{
+	uint32	tempUint32 = 0;
+	status_t	status 	= B_OK;
+	status_t	recordStatus = B_OK;
+	bool		bLocked 	= false;
+	int64		nextActivity, nextReminder, reminderOffset;
+	bool		bActivityPending, bReminderPending;
+	time_t	currentMoment = time( NULL );
+	
+	if ( !node || ( status = node->InitCheck() ) != B_OK )
+	{
+		// Did not succeed to create the file
+		return status;
+	}
+	
+	// Lock the file.
+	// From now on, every exit from this function should perform Unlock()
+	if ( node->Lock() == B_OK ) {
+		bLocked = true;
+	}
+
+
+	// Time Representation of the starting moment
+	TimeRepresentation toSave( fStart );
+	if ( bLastsWholeDays ) {
+		toSave.tm_hour = toSave.tm_min = 0;
+	}
+	fCalModule = utl_FindCalendarModule( fStart.GetCalendarModule() );
+	
+	// Everything that is not indexed nor public, in one attribute
+	if ( fields & kEventFieldRecord ) {
+		recordStatus = _SaveRecord( node, toSave );
+		
+		// Calendar module
+		if ( fCalModule ) {
+			node->WriteAttr( "EVNT:cal_module", B_STRING_TYPE, fCalModule->Identify().String(), fCalModule->Identify().Length() );
+		}
+	}
+	
+	if ( fields & kEventFieldName ) {
+		node->WriteAttr( "EVNT:name", 		B_STRING_TYPE,	fEventName.String(),	fEventName.Length() );
+	}
+	if ( fields & kEventFieldCategory ) {
+		node->WriteAttr( "EVNT:category",	B_STRING_TYPE,	fCategory.String(),	fCategory.Length() );
+	}
+	if ( fields & kEventFieldLocation ) {
+		node->WriteAttr( "EVNT:where", 		B_STRING_TYPE,	fLocation.String(),	fLocation.Length() );
+	}
+	
+	// Calculate next occurrence - for a recurring Event, the first one from now on
+	fNextOccurrence = fCalModule->FromLocalCalendarToTimeT( toSave );
+	if ( IsRepeating() && fNextOccurrence < currentMoment ) {
+		time_t	nextRepetition = NextOccurrenceAfter( currentMoment - 1 );
+		if ( nextRepetition != 0 ) {
+			fNextOccurrence = nextRepetition;
+		}
+	}
+	
+	// Next occurrence - the snoozed time, if the activity was snoozed
+	nextActivity = ( fActivitySnoozedTime ? ( int64 )fActivitySnoozedTime : ( int64 )fNextOccurrence );
+	
+	// Signed reminder offset: positive if the reminder fires before the Event
+	reminderOffset = ( int64 )fOffsetBetweenReminderAndEvent;
+	if ( !bReminderIsFiredBeforeEvent ) {
+		reminderOffset = -reminderOffset;
+	}
+	
+	// Next time of the reminder invocation - the snoozed time, or calculated from
+	// the start time and offset.
+	// This value doesn't depend on the reminder being enabled or disabled; it's written anyway
+	nextReminder = ( fReminderSnoozedTime ? ( int64 )fReminderSnoozedTime : ( int64 )fNextOccurrence - reminderOffset );
+	
+	if ( fields & kEventFieldSchedule ) {
+		node->WriteTimeAttr( "EVNT:next_occurrence", nextActivity );
+		node->WriteTimeAttr( "EVNT:reminder_offset", reminderOffset );
+		node->WriteTimeAttr( "EVNT:next_reminder", nextReminder );
+		node->WriteTimeAttr( "EVNT:duration", ( int64 )fDuration );
+	}
+	
+	if ( fields & ( kEventFieldSchedule | kEventFieldFired ) )
+	{
+		// Was activity fired? 
+		// An activity that is due in the past and was not fired stays pending -
+		// it will be fired as soon as the server sees it.
+		tempUint32 = bEventActivityWasFired ? 1 : 0;
+		bActivityPending = ( tempUint32 == 0 );
+		node->WriteAttr( "EVNT:activity_fired", B_INT32_TYPE, &tempUint32, sizeof( uint32 ) );
+		
+		// Was reminder fired? 
+		tempUint32 = bReminderActivityWasFired ? 1 : 0;
+		bReminderPending = ( tempUint32 == 0 ) && ( fOffsetBetweenReminderAndEvent != 0 );
+		node->WriteAttr( "EVNT:reminder_fired", B_INT32_TYPE, &tempUint32, sizeof( uint32 ) );
+		
+		// Earliest pending deadline - this is what the server queries for
+		SaveNextDue( node, bActivityPending, nextActivity, bReminderPending, nextReminder );
+	}
+
+
+	// Adding some general attributes
+	if ( fields == kEventFieldAll ) {
+		node->SetMimeType( kEventFileMIMEType, kEventEditorApplicationSignature );
+	}
+	
+	// Saving the note - unless it wasn't changed, and the file still has it
+	if ( ( fields & kEventFieldNote ) && bNoteLoaded ) {
+		node->SetData( fNote.String(), fNote.Length() );
+	}
+	
+	// Nothing may be written until now, depending on the storage
+	status = node->Commit();
+	if ( recordStatus == B_OK ) {
+		recordStatus = status;
+	}
 
 	// Unlock the node before exit
 	if ( bLocked ) {
-		file->Unlock();
+		node->Unlock();
 	}
 	
-	return B_OK;
+	return recordStatus;
 	
 }	// <-- end of function EventData::_SaveToFile
 
@@ -679,6 +1404,7 @@ status_t		EventData::SetDuration( time_t durIn, EventType* newType )
 	if ( newType ) {
 		this->fEventType = *newType;
 	}
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
 
 	switch ( fEventType ) {
 		case kEventType_Note:
@@ -707,6 +1433,7 @@ status_t		EventData::SetDuration( time_t durIn, EventType* newType )
 status_t		EventData::SetEventType( EventType newType )
 {
 	this->fEventType = newType;
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
 
 	switch ( fEventType ) {
 		case kEventType_Note:
@@ -736,6 +1463,8 @@ status_t		EventData::SetStartTime( int hour, int min )
 		
 	if ( min >= 0 && min <= 55 )
 		fStart.tm_min = min;
+	
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
 
 	return B_OK;	
 }	// <-- end of function EventData::SetStartTime
@@ -757,6 +1486,457 @@ status_t		EventData::SetStartDate( int day, int month, int year, BString calModu
 	fStart.tm_mday = day;
 	fStart.tm_mon = month;
 	fStart.tm_year = year;
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
 	return B_OK;
 }	// <-- end of function EventData::SetStartDate
 
+
+
+/*!	\brief		Add a copy of the rule.
+ *		\param[in]	rule			The rule to copy.
+ *		\param[in]	bExclusion	If \c true, the Event doesn't occur on the days of the rule.
+ */
+status_t		EventData::AddRule( const RecurrenceRule& rule, bool bExclusion )
+{
+	RecurrenceRule*	toAdd = new RecurrenceRule( rule );
+	if ( !toAdd ) {
+		return B_NO_MEMORY;
+	}
+	if ( !( bExclusion ? fNotRules : fAndRules ).AddItem( toAdd ) ) {
+		delete toAdd;
+		return B_NO_MEMORY;
+	}
+	if ( bExclusion ) {
+		_InvalidateExclusions();
+	}
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
+	return B_OK;
+}	// <-- end of function EventData::AddRule
+
+
+
+/*!	\brief		Remove and delete the rule.
+ */
+status_t		EventData::RemoveRule( int32 index, bool bExclusion )
+{
+	RecurrenceRule*	toRemove =
+		( RecurrenceRule* )( bExclusion ? fNotRules : fAndRules ).RemoveItem( index );
+	if ( !toRemove ) {
+		return B_BAD_INDEX;
+	}
+	delete toRemove;
+	if ( bExclusion ) {
+		_InvalidateExclusions();
+	}
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
+	return B_OK;
+}	// <-- end of function EventData::RemoveRule
+
+
+
+/*!	\brief		Remove all the rules; the Event occurs once.
+ */
+void		EventData::MakeRulesEmpty()
+{
+	if ( fAndRules.IsEmpty() && fNotRules.IsEmpty() ) { return; }
+	
+	_DeleteRules( &fAndRules );
+	_DeleteRules( &fNotRules );
+	_InvalidateExclusions();
+	fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
+}	// <-- end of function EventData::MakeRulesEmpty
+
+
+
+/*!	\brief		Delete the rules in the list, and empty it.
+ */
+void		EventData::_DeleteRules( BList* rules )
+{
+	if ( !rules ) { return; }
+	
+	for ( int32 i = rules->CountItems() - 1; i >= 0; --i ) {
+		delete ( RecurrenceRule* )rules->ItemAt( i );
+	}
+	rules->MakeEmpty();
+}	// <-- end of function EventData::_DeleteRules
+
+
+
+/*!	\brief		Forget the compiled exclusion rules.
+ *		\details		Called whenever the exclusion rules change. A change of the start
+ *						is noticed by _ExclusionMask() itself.
+ */
+void		EventData::_InvalidateExclusions()
+{
+	for ( int32 i = 0; i < kEventExclusionCacheYears; ++i ) {
+		fExclusionMasks[ i ].year = kRecurrenceNoDay;
+	}
+	fExclusionStartDay = kRecurrenceNoDay;
+	fNextExclusionMask = 0;
+}	// <-- end of function EventData::_InvalidateExclusions
+
+
+
+/*!	\brief		The days of the year all the exclusion rules together occur on.
+ *		\details		The mask is compiled from the rules the first time the year is
+ *						needed, and kept for the next calls. However many rules there
+ *						are, checking a day afterwards is testing one bit.
+ *		\returns		The mask; it stays valid until the next call.
+ */
+const RecurrenceYearMask*	EventData::_ExclusionMask( int32 startDay, int32 year ) const
+{
+	RecurrenceYearMask*	mask;
+	
+	if ( startDay != fExclusionStartDay ) {
+		for ( int32 i = 0; i < kEventExclusionCacheYears; ++i ) {
+			fExclusionMasks[ i ].year = kRecurrenceNoDay;
+		}
+		fExclusionStartDay = startDay;
+	}
+	
+	for ( int32 i = 0; i < kEventExclusionCacheYears; ++i ) {
+		if ( fExclusionMasks[ i ].year == year ) {
+			return &fExclusionMasks[ i ];
+		}
+	}
+	
+	// Replace the masks in turn
+	mask = &fExclusionMasks[ fNextExclusionMask ];
+	fNextExclusionMask = ( fNextExclusionMask + 1 ) % kEventExclusionCacheYears;
+	
+	RecurrenceRule::InitYearMask( year, mask );
+	for ( int32 i = 0; i < fNotRules.CountItems(); ++i ) {
+		( ( RecurrenceRule* )fNotRules.ItemAt( i ) )->AddToYearMask( startDay, mask );
+	}
+	return mask;
+}	// <-- end of function EventData::_ExclusionMask
+
+
+
+/*!	\brief		Check whether an exclusion rule occurs on the day.
+ */
+bool		EventData::_IsExcluded( int32 startDay, int32 day ) const
+{
+	const RecurrenceYearMask*	mask;
+	int32		year, offset;
+	
+	if ( fNotRules.IsEmpty() ) { return false; }
+	
+	RecurrenceRule::DateFromDay( day, &year, NULL, NULL );
+	mask = _ExclusionMask( startDay, year );
+	offset = day - mask->firstDay;
+	return ( ( mask->bits[ offset >> 5 ] >> ( offset & 31 ) ) & 1 ) != 0;
+}	// <-- end of function EventData::_IsExcluded
+
+
+
+/*!	\brief		The day the Event starts on, and the time of day it starts at.
+ *		\details		The rules work on Gregorian days in the local time zone, whatever
+ *						calendar the Event was created in - the start is converted
+ *						through \c time_t.
+ *		\param[out]	startDay			Day number; see RecurrenceRule::DayFromDate().
+ *		\param[out]	startSecond		Seconds since the local midnight.
+ *		\returns		\c false if the start can't be converted.
+ */
+bool		EventData::GetStartDay( int32* startDay, int32* startSecond ) const
+{
+	CalendarModule*	calModule = utl_FindCalendarModule( fStart.GetCalendarModule() );
+	TimeRepresentation	start( fStart );
+	time_t		startTime;
+	struct tm	local;
+	
+	if ( !calModule ) { calModule = fCalModule; }
+	if ( !calModule ) { return false; }
+	
+	if ( bLastsWholeDays ) {
+		start.tm_hour = start.tm_min = 0;
+	}
+	startTime = calModule->FromLocalCalendarToTimeT( start );
+	if ( localtime_r( &startTime, &local ) == NULL ) {
+		return false;
+	}
+	
+	if ( startDay ) {
+		*startDay = RecurrenceRule::DayFromDate( local.tm_year + 1900, local.tm_mon + 1, local.tm_mday );
+	}
+	if ( startSecond ) {
+		*startSecond = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+	}
+	return true;
+}	// <-- end of function EventData::GetStartDay
+
+
+
+/*!	\brief		The first day, not before the given one, the Event occurs on.
+ *		\details		The candidate day is the earliest day any inclusion rule occurs
+ *						on; if an exclusion rule occurs on it too, the search goes on from
+ *						the next day. Every rule jumps straight to its next day, so the
+ *						cost doesn't depend on how far the day is from the start.
+ *		\returns		The day, or \c kRecurrenceNoDay if there's none.
+ */
+int32		EventData::_NextOccurrenceDay( int32 startDay, int32 fromDay ) const
+{
+	int32		candidate, day;
+	
+	for ( int32 i = 0; i < kMaxExcludedOccurrences; ++i )
+	{
+		// The start is always an occurrence
+		candidate = ( fromDay <= startDay ) ? startDay : kRecurrenceNoDay;
+		for ( int32 j = 0; candidate != startDay && j < fAndRules.CountItems(); ++j ) {
+			day = ( ( RecurrenceRule* )fAndRules.ItemAt( j ) )->NextDayOnOrAfter( startDay, fromDay );
+			if ( day != kRecurrenceNoDay && ( candidate == kRecurrenceNoDay || day < candidate ) ) {
+				candidate = day;
+			}
+		}
+		if ( candidate == kRecurrenceNoDay ) {
+			return kRecurrenceNoDay;
+		}
+		
+		if ( !_IsExcluded( startDay, candidate ) ) {
+			return candidate;
+		}
+		fromDay = candidate + 1;
+	}
+	return kRecurrenceNoDay;
+}	// <-- end of function EventData::_NextOccurrenceDay
+
+
+
+/*!	\brief		The first occurrence of the Event that starts after the moment.
+ *		\param[in]	moment		UNIX time.
+ *		\returns		Start of the occurrence in UNIX time, or 0 if there's none.
+ */
+time_t		EventData::NextOccurrenceAfter( time_t moment ) const
+{
+	int32			startDay, startSecond, momentDay, momentSecond;
+	int32			day, year, month, monthDay;
+	struct tm	local;
+	
+	if ( !IsRecurring() && IsRepeating() ) {
+		return _NextAnniversaryAfter( moment );
+	}
+	
+	if ( !GetStartDay( &startDay, &startSecond ) ||
+		  localtime_r( &moment, &local ) == NULL )
+	{
+		return 0;
+	}
+	momentDay = RecurrenceRule::DayFromDate( local.tm_year + 1900, local.tm_mon + 1, local.tm_mday );
+	momentSecond = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+	
+	// On the day of the moment, the occurrence must start later than it
+	day = _NextOccurrenceDay( startDay, momentDay + ( ( momentSecond >= startSecond ) ? 1 : 0 ) );
+	if ( day == kRecurrenceNoDay ) {
+		return 0;
+	}
+	
+	RecurrenceRule::DateFromDay( day, &year, &month, &monthDay );
+	memset( &local, 0, sizeof( local ) );
+	local.tm_year = year - 1900;
+	local.tm_mon = month - 1;
+	local.tm_mday = monthDay;
+	local.tm_hour = startSecond / 3600;
+	local.tm_min = ( startSecond / 60 ) % 60;
+	local.tm_sec = startSecond % 60;
+	local.tm_isdst = -1;
+	return mktime( &local );
+}	// <-- end of function EventData::NextOccurrenceAfter
+
+
+
+/*!	\brief		The first anniversary of the start after the moment.
+ *		\details		The years are counted in the Event's own calendar, so an
+ *						anniversary in a lunar calendar moves in the Gregorian one.
+ *		\returns		Start of the anniversary in UNIX time, or 0 if there's none.
+ */
+time_t		EventData::_NextAnniversaryAfter( time_t moment ) const
+{
+	CalendarModule*	calModule = utl_FindCalendarModule( fStart.GetCalendarModule() );
+	TimeRepresentation	next( fStart );
+	time_t		toReturn;
+	
+	if ( !calModule ) { calModule = fCalModule; }
+	if ( !calModule ) { return 0; }
+	
+	if ( bLastsWholeDays ) {
+		next.tm_hour = next.tm_min = 0;
+	}
+	if ( ( toReturn = calModule->FromLocalCalendarToTimeT( next ) ) > moment ) {
+		return toReturn;
+	}
+	
+	// Start from the year of the moment; a date that doesn't exist every year
+	// may take a few more
+	next.tm_year = calModule->FromTimeTToLocalCalendar( moment ).tm_year;
+	for ( int i = 0; i < 8; ++i, ++next.tm_year ) {
+		if ( ( toReturn = calModule->FromLocalCalendarToTimeT( next ) ) > moment ) {
+			return toReturn;
+		}
+	}
+	return 0;
+}	// <-- end of function EventData::_NextAnniversaryAfter
+
+
+
+/*!	\brief		All the days in the range the Event occurs on.
+ *		\details		An Event with one inclusion rule and no exclusions is expanded
+ *						by the rule itself, which fills a simple periodic rule with one
+ *						arithmetic loop. Otherwise the days are combined year by year in
+ *						masks; see _ExpandYears().
+ *
+ *						All the occurrences start at the time of day of the start; see
+ *						GetStartDay().
+ *		\param[in]	fromDay		First day of the range; see RecurrenceRule::DayFromDate().
+ *		\param[in]	toDay			The day after the range.
+ *		\param[out]	out			Receives the days, in ascending order.
+ *		\param[in]	capacity		Size of \c out. If it's filled, the rest of the range
+ *										may be expanded from the day after the last one.
+ *		\returns		Number of the days written.
+ */
+int32		EventData::ExpandOccurrences( int32 fromDay, int32 toDay, int32* out, int32 capacity ) const
+{
+	int32		startDay, count = 0;
+	
+	if ( !out || capacity <= 0 || fromDay >= toDay ||
+		  !GetStartDay( &startDay, NULL ) )
+	{
+		return 0;
+	}
+	
+	if ( fAndRules.CountItems() == 1 && fNotRules.IsEmpty() )
+	{
+		// The rule's days are after the start, which is always an occurrence
+		if ( startDay >= fromDay && startDay < toDay ) {
+			out[ count++ ] = startDay;
+			fromDay = startDay + 1;
+		}
+		return count + ( ( RecurrenceRule* )fAndRules.ItemAt( 0 ) )->ExpandDays(
+						startDay, fromDay, toDay, out + count, capacity - count );
+	}
+	
+	return _ExpandYears( startDay, fromDay, toDay, out, capacity );
+}	// <-- end of function EventData::ExpandOccurrences
+
+
+
+/*!	\brief		Expand the occurrences year by year, through the masks of the days.
+ *		\details		The inclusion rules and the start are added into one mask of the
+ *						year; the compiled exclusion mask is removed from it word by word,
+ *						and the bits that are left are the occurrences. The years with no
+ *						included day are skipped over; the search gives up after many
+ *						years in a row whose every day was excluded.
+ */
+int32		EventData::_ExpandYears( int32 startDay, int32 fromDay, int32 toDay,
+											int32* out, int32 capacity ) const
+{
+	RecurrenceYearMask			inclusion;
+	const RecurrenceYearMask*	exclusion;
+	int32		count = 0, day, nextDay, year, lastDay, yearCount;
+	int32		emptyYears = 0;
+	uint32	bits;
+	
+	if ( fromDay < startDay ) { fromDay = startDay; }
+	
+	while ( fromDay < toDay && count < capacity && emptyYears < kMaxExcludedOccurrences )
+	{
+		// Go straight to the year of the next included day
+		nextDay = ( fromDay <= startDay ) ? startDay : kRecurrenceNoDay;
+		for ( int32 i = 0; nextDay != startDay && i < fAndRules.CountItems(); ++i ) {
+			day = ( ( RecurrenceRule* )fAndRules.ItemAt( i ) )->NextDayOnOrAfter( startDay, fromDay );
+			if ( day != kRecurrenceNoDay && ( nextDay == kRecurrenceNoDay || day < nextDay ) ) {
+				nextDay = day;
+			}
+		}
+		if ( nextDay == kRecurrenceNoDay || nextDay >= toDay ) { break; }
+		
+		RecurrenceRule::DateFromDay( nextDay, &year, NULL, NULL );
+		RecurrenceRule::InitYearMask( year, &inclusion );
+		if ( startDay >= inclusion.firstDay && startDay < inclusion.firstDay + inclusion.days ) {
+			day = startDay - inclusion.firstDay;
+			inclusion.bits[ day >> 5 ] |= ( uint32 )1 << ( day & 31 );
+		}
+		for ( int32 i = 0; i < fAndRules.CountItems(); ++i ) {
+			( ( RecurrenceRule* )fAndRules.ItemAt( i ) )->AddToYearMask( startDay, &inclusion );
+		}
+		if ( !fNotRules.IsEmpty() ) {
+			exclusion = _ExclusionMask( startDay, year );
+			for ( int32 i = 0; i < kRecurrenceYearMaskWords; ++i ) {
+				inclusion.bits[ i ] &= ~exclusion->bits[ i ];
+			}
+		}
+		
+		// The days of the year that are in the range
+		yearCount = count;
+		lastDay = inclusion.firstDay + inclusion.days;
+		if ( lastDay > toDay ) { lastDay = toDay; }
+		for ( int32 i = 0; i < kRecurrenceYearMaskWords && count < capacity; ++i )
+		{
+			day = inclusion.firstDay + i * 32;
+			for ( bits = inclusion.bits[ i ]; bits != 0 && count < capacity; bits >>= 1, ++day ) {
+				if ( ( bits & 1 ) && day >= nextDay && day < lastDay ) {
+					out[ count++ ] = day;
+				}
+			}
+		}
+		emptyYears = ( count == yearCount ) ? emptyYears + 1 : 0;
+		fromDay = inclusion.firstDay + inclusion.days;
+	}
+	return count;
+}	// <-- end of function EventData::_ExpandYears
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class EventDataBatch
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - an empty batch.
+ */
+EventDataBatch::EventDataBatch()
+	:
+	ObjectBatch( sizeof( EventData ) ),
+	fRefs( NULL )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - destroys the Events.
+ */
+EventDataBatch::~EventDataBatch()
+{
+	MakeEmpty();
+}	// <-- end of destructor
+
+
+
+/*!	\brief		The Event at the index, or \c NULL if it couldn't be loaded.
+ */
+EventData*		EventDataBatch::ItemAt( int32 index ) const
+{
+	return ( EventData* )_ItemAt( index );
+}	// <-- end of function EventDataBatch::ItemAt
+
+
+
+/*!	\brief		Construct the Event in the memory, and load it from its ref.
+ */
+status_t		EventDataBatch::_LoadItem( void* memory, int32 index )
+{
+	EventData*	event = new ( memory ) EventData( ( time_t )0 );
+	status_t		status = event->_InitFromRef( fRefs[ index ] );
+	
+	if ( status != B_OK ) {
+		event->~EventData();
+	}
+	return status;
+}	// <-- end of function EventDataBatch::_LoadItem
+
+
+
+/*!	\brief		Destroy the Event in the memory.
+ */
+void		EventDataBatch::_DestroyItem( void* memory )
+{
+	( ( EventData* )memory )->~EventData();
+}	// <-- end of function EventDataBatch::_DestroyItem
@@ -9,6 +9,7 @@
 #include <Entry.h>
 #include <File.h>
 #include <List.h>
+#include <Node.h>
 #include <Path.h>
 #include <String.h>
 #include <SupportDefs.h>
@@ -16,11 +17,18 @@
 
 // Project includes
 #include "ActivityData.h"
+#include "ObjectBatch.h"
+#include "RecurrenceRule.h"
 #include "TimeRepresentation.h"
 #include "Utilities.h"
 
 const uint32	kSaveRequested = 'SAV!';
 
+class EventDataBatch;
+class EventNode;
+class EventStorage;
+class RecordReader;
+
 /*---------------------------------------------------------------------------
  *					Declaration of enum EventType and corresponding strings
  *--------------------------------------------------------------------------*/
@@ -71,6 +79,35 @@ enum	EventType {
 
 
 
+/*!	\name		Fields of the Event, as they are saved.
+ *		\details		EventData remembers which of them were changed since the Event was
+ *						loaded or saved, and saving the Event in place writes only these.
+ *		\par			kEventFieldRecord
+ *						Everything in the "EVNT:record" attribute: the flags, the type, the
+ *						duration, the reminder offset, the start time, the calendar
+ *						module and the activities.
+ *		\par			kEventFieldSchedule
+ *						Everything the next occurrence and the next reminder depend on.
+ *		\par			kEventFieldFired
+ *						The "fired" flags of the activities.
+ */
+///@{
+const		uint32	kEventFieldName		= 0x00000001;
+const		uint32	kEventFieldCategory	= 0x00000002;
+const		uint32	kEventFieldLocation	= 0x00000004;
+const		uint32	kEventFieldRecord		= 0x00000008;
+const		uint32	kEventFieldSchedule	= 0x00000010;
+const		uint32	kEventFieldFired		= 0x00000020;
+const		uint32	kEventFieldNote		= 0x00000040;
+const		uint32	kEventFieldAll			= 0x0000007F;
+///@}
+
+/*!	\brief		How many years of the exclusion rules an Event keeps compiled.
+ */
+const		int32		kEventExclusionCacheYears	= 4;
+
+
+
 /*---------------------------------------------------------------------------
  *					Declaration of class EventData
  *--------------------------------------------------------------------------*/
@@ -88,6 +125,9 @@ protected:
 	BString		fEventName;			//!<  Duh
 	entry_ref*	fEventFile;			/*!<  May be NULL if a new Event is constructed.
 											 *		Used for "Save" and "Revert" features. */
+	EventStorage*	fStorage;		/*!<  The storage the Event was loaded from with Load(),
+											 *		or \c NULL if it's a file. Not owned.		*/
+	BString		fStorageKey;		//!<  Key of the Event in \c fStorage.
 	CalendarModule*	fCalModule;	//!< Calendar module used for creation of this Event.
 	BString		fCategory;			//!< Category of this Event. It \b must be set!
 	BString		fLocation;			//!< Where this Event will occur?
@@ -100,14 +140,16 @@ protected:
 	uint32		bLastsWholeDays;	/*!< If \c true, only start day matters, not time. \c fDuration
 											 *		defines how many whole days the Event lasts, rounding \b up
 											 *		to smallest number of days that can accomodate \c fDuration. */
-	BString		fNote;				//!< User's note (contents of the file).
+	mutable BString	fNote;		//!< User's note (contents of the file). Read on demand.
+	mutable bool		bNoteLoaded;	/*!< If \c false, \c fNote wasn't read from the file yet.
+												 *	  See _LoadNote().											*/
 
 	time_t		startTime;			//!< Used for "revert" feature
 
 	// When this Event starts, for how long does it last and what does it do.	
 	TimeRepresentation	fStart;	//!< Start time of the first occurrence of the Event.
 	time_t				fDuration;	//!< Duration of the Event in seconds. May be 0.
-	uint32	fActivitySnoozedTime;	//!< For Snooze activity only. When the Activity is schedulled to start, from UNIX epoch.
+	time_t	fActivitySnoozedTime;	//!< For Snooze activity only. When the Activity is schedulled to start, from UNIX epoch.
 	bool		bEventActivityWasFired;	//!< \c true if Event's activity was fired.
 	ActivityData		fEventActivity;
 	
@@ -115,7 +157,7 @@ protected:
 	ActivityData		fReminderActivity;		//!< Activity of the Reminder
 	bool		bReminderActivityWasFired;			//!< \c true if Reminder activity was fired
 	uint32	bReminderIsFiredBeforeEvent;		//!< \c true if Reminder starts before Event's start time.
-	uint32	fReminderSnoozedTime;				//!< For Snooze feature only. Seconds in UNIX time epoch until Reminder fires
+	time_t	fReminderSnoozedTime;				//!< For Snooze feature only. Seconds in UNIX time epoch until Reminder fires
 	time_t	fOffsetBetweenReminderAndEvent;	/*!< Difference in seconds between Reminder and Event.
 															 *   Offset of 0 means Reminder is disabled.		*/
 			
@@ -124,11 +166,45 @@ protected:
 	BList		fNotRules;				//!< Recurrence rules that define when this Event is \b NOT repeated.
 	
 	time_t	fNextOccurrence;		//!< When is the closest occurrence of this Event?
+	
+	uint32	fDirtyFields;			/*!< The fields changed since the Event was loaded or
+											 *	  saved; see \c kEventFieldAll.					*/
+	
+	// The exclusion rules, compiled into the days they exclude
+	mutable RecurrenceYearMask	fExclusionMasks[ kEventExclusionCacheYears ];
+	mutable int32	fExclusionStartDay;	//!< Start day the masks were compiled for.
+	mutable int32	fNextExclusionMask;	//!< The mask to be replaced next.
 
 	// Service functions
+	friend class EventDataBatch;
+	
 	virtual void		_InitDefaults( void );
-	virtual status_t	_SaveToFile( BFile* file );
+	virtual status_t	_InitFromRef( const entry_ref& fileIn );
+	virtual status_t	_SaveToFile( EventNode* node, uint32 fields = kEventFieldAll );
+	virtual status_t	_SaveRecord( EventNode* node, TimeRepresentation& start );
+	virtual void		_LoadFromNode( EventNode* node );
+	virtual status_t	_LoadRecord( EventNode* node );
+	virtual status_t	_LoadRecordBinaries( RecordReader* reader,
+													TimeRepresentation* start,
+													ActivityData* eventActivity,
+													ActivityData* reminderActivity );
+	virtual status_t	_LoadRecordRules( RecordReader* reader, BList* andRules, BList* notRules );
+	virtual status_t	_LoadAttributes( EventNode* node );
+	virtual void		_LoadNote() const;
+	virtual void		_ReadNote( EventNode* node ) const;
+	static  void		_DeleteRules( BList* rules );
+	virtual int32		_NextOccurrenceDay( int32 startDay, int32 fromDay ) const;
+	virtual time_t		_NextAnniversaryAfter( time_t moment ) const;
+	virtual void		_InvalidateExclusions();
+	virtual const RecurrenceYearMask*	_ExclusionMask( int32 startDay, int32 year ) const;
+	virtual bool		_IsExcluded( int32 startDay, int32 day ) const;
+	virtual int32		_ExpandYears( int32 startDay, int32 fromDay, int32 toDay,
+											  int32* out, int32 capacity ) const;
 
+private:
+	// The rules are owned; copying an Event is not supported
+	EventData( const EventData& other );
+	EventData&	operator= ( const EventData& other );
 	
 public:
 
@@ -146,30 +222,65 @@ public:
 	virtual void 		InitFromFile( const entry_ref& fileIn );		// Read the object data from file
 	virtual status_t	SaveToFile( entry_ref* fileIn = NULL );
 	virtual status_t	SaveToFile( BFile* fileIn );
+	virtual status_t	Load( EventStorage* storage, const char* key );
+	static  status_t	LoadMany( const entry_ref* refs, int32 count, EventDataBatch* out );
+	virtual status_t	Save( EventStorage* storage, const char* key = NULL );
+	static  status_t	SaveFiredFlag( const entry_ref& fileIn, bool bReminder, bool bFired = true );
+	static  status_t	SaveNextOccurrence( const entry_ref& fileIn, int64 nextOccurrence,
+													  int64 reminderOffset );
+	static  status_t	SaveNextDue( BNode* node,
+											 bool bActivityPending, int64 nextOccurrence,
+											 bool bReminderPending, int64 nextReminder );
+	static  status_t	SaveNextDue( EventNode* node,
+											 bool bActivityPending, int64 nextOccurrence,
+											 bool bReminderPending, int64 nextReminder );
+	static  status_t	UpdateNextDue( BNode* node );
+	static  status_t	UpdateNextDue( EventNode* node );
 	virtual void		Revert();
 	virtual entry_ref*	GetRef() { return fEventFile; }
 	///@}
+	
+	/*!	\name		Changed fields
+	 *		\details		The setters mark the fields they change. The activities and the
+	 *						note are returned as live data, so getting them for change marks
+	 *						them too.
+	 */
+	///@{
+	virtual uint32		GetDirtyFields() const { return fDirtyFields; }
+	virtual void		SetDirtyFields( uint32 fields ) { fDirtyFields |= fields; }
+	///@}
 
 	/* Setting and getting Event general data */
 	virtual BString	GetCategory() const { return fCategory; }
-	virtual void		SetCategory( const BString& toSet ) { fCategory.SetTo( toSet ); }
-	virtual void		SetCategory( const char* toSet ) { if ( toSet ) fCategory.SetTo( toSet ); }
+	virtual void		SetCategory( const BString& toSet ) {
+		fCategory.SetTo( toSet );
+		fDirtyFields |= kEventFieldCategory;
+	}
+	virtual void		SetCategory( const char* toSet ) { if ( toSet ) SetCategory( BString( toSet ) ); }
 	
 	virtual bool		GetPrivate() const { return ( bPrivate != 0 ); }
-	virtual void		SetPrivate( bool toSet ) { bPrivate = ( toSet ? 1 : 0 ); }
+	virtual void		SetPrivate( bool toSet ) { bPrivate = ( toSet ? 1 : 0 ); fDirtyFields |= kEventFieldRecord; }
 	
 	virtual EventType	GetEventType() const { return fEventType; }
 	virtual status_t	SetEventType( EventType etIn );
 	
 	virtual BString	GetEventName() const { return fEventName; }
-	virtual status_t	SetEventName( const BString& toSet ) { fEventName.SetTo( toSet ); return B_OK; }
+	virtual status_t	SetEventName( const BString& toSet ) {
+		fEventName.SetTo( toSet );
+		fDirtyFields |= kEventFieldName;
+		return B_OK;
+	}
 	virtual status_t	SetEventName( const char* toSet ) { if ( toSet ) return SetEventName( BString( toSet ) ); return B_ERROR; }
 	
 	//!	\name		Where the event will occur?
 	///@{
 	virtual BString	GetEventLocation() const { return fLocation; }
-	virtual status_t	SetEventLocation( const BString& toSet ) { fLocation.SetTo( toSet ); }
-	virtual status_t	SetEventLocation( const char* toSet ) { if ( toSet ) fLocation.SetTo( toSet ); }
+	virtual status_t	SetEventLocation( const BString& toSet ) {
+		fLocation.SetTo( toSet );
+		fDirtyFields |= kEventFieldLocation;
+		return B_OK;
+	}
+	virtual status_t	SetEventLocation( const char* toSet ) { if ( toSet ) return SetEventLocation( BString( toSet ) ); return B_ERROR; }
 	///@}
 	
 	//!	\name		File reference manipulations
@@ -192,6 +303,8 @@ public:
 	}
 	virtual status_t	SetStartTime( const TimeRepresentation& trIn ) {
 		fStart = trIn;
+		fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
+		return B_OK;
 	}	
 	virtual status_t	SetStartTime( int hour, int min );
 	virtual status_t	SetStartDate( int day, int month, int year, BString calendar = BString( "Gregorian" ) );
@@ -207,29 +320,35 @@ public:
 	///@}
 	
 	/*!	\name			Activity data access
-	 *		\attention	The following functions return pointers to
-	 *						the live data on purpose!
+	 *		\attention	The non-const functions return pointers to the live
+	 *						data on purpose! Since the caller may change it, they
+	 *						mark the record as changed; code which only reads the
+	 *						activities should use the \c const versions.
 	 */
 	///@{
-	virtual ActivityData*	GetEventActivity() { return &fEventActivity; }
-	virtual ActivityData*	GetReminderActivity() { return &fReminderActivity; }
+	virtual ActivityData*	GetEventActivity() { fDirtyFields |= kEventFieldRecord; return &fEventActivity; }
+	virtual ActivityData*	GetReminderActivity() { fDirtyFields |= kEventFieldRecord; return &fReminderActivity; }
+	virtual const ActivityData*	GetEventActivity() const { return &fEventActivity; }
+	virtual const ActivityData*	GetReminderActivity() const { return &fReminderActivity; }
 	
 	virtual	bool		WasEventActivityFired() const	{ return bEventActivityWasFired; }
-	virtual	void		SetEventActivityFired( bool toSet ) { bEventActivityWasFired = toSet; }
+	virtual	void		SetEventActivityFired( bool toSet ) { bEventActivityWasFired = toSet; fDirtyFields |= kEventFieldFired; }
 	
 	virtual	bool		WasReminderActivityFired() const	{ return bReminderActivityWasFired; }
-	virtual	void		SetReminderActivityFired( bool toSet ) { bReminderActivityWasFired = toSet; }
+	virtual	void		SetReminderActivityFired( bool toSet ) { bReminderActivityWasFired = toSet; fDirtyFields |= kEventFieldFired; }
 	
-	virtual uint32		GetReminderSnoozeTime() const { return fReminderSnoozedTime; }
-	virtual void		SetReminderSnoozeTime( uint32 toSet ) {
+	virtual time_t		GetReminderSnoozeTime() const { return fReminderSnoozedTime; }
+	virtual void		SetReminderSnoozeTime( time_t toSet ) {
 		fReminderSnoozedTime = toSet;
 		bReminderActivityWasFired = false;
+		fDirtyFields |= kEventFieldSchedule | kEventFieldFired;
 	}
 	
-	virtual uint32		GetActivtiySnoozeTime() const { return fActivitySnoozedTime; }
-	virtual void		SetActivitySnoozeTime( uint32 toSet ) {
+	virtual time_t		GetActivtiySnoozeTime() const { return fActivitySnoozedTime; }
+	virtual void		SetActivitySnoozeTime( time_t toSet ) {
 		fActivitySnoozedTime = toSet;
 		bEventActivityWasFired = false;
+		fDirtyFields |= kEventFieldSchedule | kEventFieldFired;
 	}
 	///@}
 	
@@ -244,25 +363,100 @@ public:
 	virtual status_t	SetReminderOffset( time_t newOffset, bool beforeEvent ) {
 		bReminderIsFiredBeforeEvent = ( beforeEvent ? 1 : 0 );
 		fOffsetBetweenReminderAndEvent = newOffset;
+		fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
+		return B_OK;
 	}
 	///@}
 	
 	virtual bool		GetLastsWholeDays() const { return ( bLastsWholeDays != 0 ); }
-	virtual void		SetLastsWholeDays( bool toSet ) { bLastsWholeDays = ( toSet ? 1 : 0 ); }
+	virtual void		SetLastsWholeDays( bool toSet ) {
+		bLastsWholeDays = ( toSet ? 1 : 0 );
+		fDirtyFields |= kEventFieldRecord | kEventFieldSchedule;
+	}
 	
 	/*!	\name			Note text manipulations.
 	 *		\note
 	 *				Since Note text may be quite long, I provide additional method
 	 *				that returns reference (and doesn't allocate another object).
-	 *				Hence this method is not \c const.
+	 *				The non-const version lets the caller change the note, so it
+	 *				marks the note as changed; the \c const one only reads it.
+	 *		\note
+	 *				The note is not read by InitFromFile(); it's read from the file
+	 *				when one of the getters is called for the first time.
 	 */
 	///@{
-	virtual BString& 	GetNoteTextReference() { return fNote; }
-	virtual BString	GetNoteText() const { return fNote; }
-	virtual void		SetNoteText( const BString& toSet ) { fNote.SetTo( toSet ); }
-	virtual void 		SetNoteText( const char* toSet ) { if ( toSet ) fNote.SetTo( toSet ); }
+	virtual BString& 	GetNoteTextReference() { _LoadNote(); fDirtyFields |= kEventFieldNote; return fNote; }
+	virtual const BString&	GetNoteTextReference() const { _LoadNote(); return fNote; }
+	virtual BString	GetNoteText() const { _LoadNote(); return fNote; }
+	virtual void		SetNoteText( const BString& toSet ) {
+		fNote.SetTo( toSet );
+		bNoteLoaded = true;
+		fDirtyFields |= kEventFieldNote;
+	}
+	virtual void 		SetNoteText( const char* toSet ) { if ( toSet ) SetNoteText( BString( toSet ) ); }
+	///@}
+	
+	/*!	\name			Recurrence
+	 *		\details		The Event occurs on its start day, and on every day any of the
+	 *						inclusion rules occurs on, except for the days any of the
+	 *						exclusion rules occurs on. All occurrences start at the time
+	 *						of day of the start. The rules are owned by the Event.
+	 *
+	 *						Anniversaries and holidays without rules repeat every year, on
+	 *						the date of the start in the Event's calendar.
+	 */
+	///@{
+	virtual status_t	AddRule( const RecurrenceRule& rule, bool bExclusion = false );
+	virtual int32		CountRules( bool bExclusion = false ) const {
+		return ( bExclusion ? fNotRules : fAndRules ).CountItems();
+	}
+	virtual const RecurrenceRule*	RuleAt( int32 index, bool bExclusion = false ) const {
+		return ( const RecurrenceRule* )( bExclusion ? fNotRules : fAndRules ).ItemAt( index );
+	}
+	virtual status_t	RemoveRule( int32 index, bool bExclusion = false );
+	virtual void		MakeRulesEmpty();
+	virtual bool		IsRecurring() const { return !fAndRules.IsEmpty(); }
+	//! Recurring, or repeated every year because of its type.
+	virtual bool		IsRepeating() const {
+		return ( IsRecurring() ||
+					fEventType == kEventType_Anniversary ||
+					fEventType == kEventType_Holiday );
+	}
+	virtual bool		GetStartDay( int32* startDay, int32* startSecond ) const;
+	virtual time_t		NextOccurrenceAfter( time_t moment ) const;
+	virtual int32		ExpandOccurrences( int32 fromDay, int32 toDay,
+												 int32* out, int32 capacity ) const;
 	///@}
 	
 };	// <-- end of class EventData
 
+
+
+/*---------------------------------------------------------------------------
+ *					Declaration of class EventDataBatch
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Events loaded together by EventData::LoadMany().
+ *		\details		All the objects are constructed in one block of memory, in the
+ *						order of the refs they were loaded from, and are destroyed with
+ *						the batch. The caller must not delete them.
+ */
+class EventDataBatch
+	: public ObjectBatch
+{
+public:
+	EventDataBatch();
+	virtual ~EventDataBatch();
+
+	virtual EventData*	ItemAt( int32 index ) const;
+
+protected:
+	friend class EventData;
+
+	virtual status_t		_LoadItem( void* memory, int32 index );
+	virtual void			_DestroyItem( void* memory );
+
+	const entry_ref*	fRefs;		//!< The files, while they are loaded.
+};	// <-- end of class EventDataBatch
+
 #endif // _EVENT_H_
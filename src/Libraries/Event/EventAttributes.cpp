@@ -0,0 +1,96 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "EventAttributes.h"
+
+// POSIX includes
+#include <string.h>
+
+
+
+/*!	\brief		A slot of the attributes' hash table.
+ */
+struct EventAttributeSlot {
+	const char*			name;		//!< Name of the attribute without the "EVNT:" prefix.
+	EventAttribute		id;
+};
+
+
+/*!	\brief		Size of the attributes' hash table - a power of two.
+ */
+const		uint32	kEventAttributesTableSize	= 32;
+
+
+/*!	\brief		Perfect hash of the attributes' names.
+ *		\details		The table is built by hand for the hash function below, which
+ *						has no collisions on these names. If an attribute is added, the
+ *						coefficients may need to change - check that no two names share
+ *						a slot. Attributes that are not decoded ("EVNT:next_reminder",
+ *						"EVNT:next_due", the rules) are left out, so they are never read.
+ */
+static const EventAttributeSlot		kEventAttributesTable[ kEventAttributesTableSize ] = {
+	/*  0 */	{	"verified",				EVNT_ATTR_VERIFIED				},
+	/*  1 */	{	"next_occurrence",	EVNT_ATTR_NEXT_OCCURRENCE		},
+	/*  2 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/*  3 */	{	"where",					EVNT_ATTR_WHERE					},
+	/*  4 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/*  5 */	{	"event_activity",		EVNT_ATTR_EVENT_ACTIVITY		},
+	/*  6 */	{	"reminder_offset",	EVNT_ATTR_REMINDER_OFFSET		},
+	/*  7 */	{	"whole_day",			EVNT_ATTR_WHOLE_DAY				},
+	/*  8 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/*  9 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 10 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 11 */	{	"name",					EVNT_ATTR_NAME						},
+	/* 12 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 13 */	{	"category",				EVNT_ATTR_CATEGORY				},
+	/* 14 */	{	"activity_fired",		EVNT_ATTR_ACTIVITY_FIRED		},
+	/* 15 */	{	"type",					EVNT_ATTR_TYPE						},
+	/* 16 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 17 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 18 */	{	"duration",				EVNT_ATTR_DURATION				},
+	/* 19 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 20 */	{	"reminder_fired",		EVNT_ATTR_REMINDER_FIRED		},
+	/* 21 */	{	"cal_module",			EVNT_ATTR_CAL_MODULE				},
+	/* 22 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 23 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 24 */	{	"start_TR",				EVNT_ATTR_START_TR				},
+	/* 25 */	{	"reminder_activity",	EVNT_ATTR_REMINDER_ACTIVITY	},
+	/* 26 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 27 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 28 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 29 */	{	"private",				EVNT_ATTR_PRIVATE					},
+	/* 30 */	{	NULL,						EVNT_ATTR_UNKNOWN					},
+	/* 31 */	{	NULL,						EVNT_ATTR_UNKNOWN					}
+};
+
+
+
+/*!	\brief		Find which attribute of the Event this is.
+ *		\details		One hash and at most one string comparison per attribute.
+ *		\param[in]	name		Full name of the attribute, e.g. "EVNT:name".
+ *		\returns		The attribute, or EVNT_ATTR_UNKNOWN if it's not decoded.
+ */
+EventAttribute		LookupEventAttribute( const char* name )
+{
+	const EventAttributeSlot*	slot;
+	size_t		length;
+	uint32		hash;
+
+	if ( strncmp( name, "EVNT:", 5 ) != 0 ) { return EVNT_ATTR_UNKNOWN; }
+	name += 5;
+	length = strlen( name );
+	if ( length == 0 ) { return EVNT_ATTR_UNKNOWN; }
+
+	hash = ( 2 * ( uint32 )length +
+				6 * ( uint8 )name[ 0 ] +
+				3 * ( uint8 )name[ length - 1 ] ) & ( kEventAttributesTableSize - 1 );
+	slot = &kEventAttributesTable[ hash ];
+
+	if ( !slot->name || strcmp( slot->name, name ) != 0 ) {
+		return EVNT_ATTR_UNKNOWN;
+	}
+	return slot->id;
+}	// <-- end of function LookupEventAttribute
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _EVENT_ATTRIBUTES_H_
+#define _EVENT_ATTRIBUTES_H_
+
+// OS includes
+#include <SupportDefs.h>
+
+
+/*!	\brief		Attributes of the Event file that EventData decodes.
+ *		\details		Only the separate attributes of the older files are decoded one
+ *						by one; the newer files keep the Event in "EVNT:record".
+ */
+enum EventAttribute {
+	EVNT_ATTR_UNKNOWN = 0,
+	EVNT_ATTR_NAME,
+	EVNT_ATTR_CATEGORY,
+	EVNT_ATTR_WHERE,
+	EVNT_ATTR_PRIVATE,
+	EVNT_ATTR_VERIFIED,
+	EVNT_ATTR_WHOLE_DAY,
+	EVNT_ATTR_TYPE,
+	EVNT_ATTR_DURATION,
+	EVNT_ATTR_NEXT_OCCURRENCE,
+	EVNT_ATTR_START_TR,
+	EVNT_ATTR_EVENT_ACTIVITY,
+	EVNT_ATTR_ACTIVITY_FIRED,
+	EVNT_ATTR_REMINDER_OFFSET,
+	EVNT_ATTR_REMINDER_ACTIVITY,
+	EVNT_ATTR_REMINDER_FIRED,
+	EVNT_ATTR_CAL_MODULE
+};
+
+
+
+EventAttribute		LookupEventAttribute( const char* name );
+
+
+#endif // _EVENT_ATTRIBUTES_H_
@@ -0,0 +1,655 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "BfsEventStorage.h"
+#include "CalendarModule.h"
+#include "Event.h"
+#include "EventCache.h"
+#include "Utilities.h"
+
+// OS includes
+#include <Autolock.h>
+#include <Directory.h>
+#include <Errors.h>
+#include <FindDirectory.h>
+#include <Node.h>
+#include <OS.h>
+
+// POSIX includes
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// C++ includes
+#include <new>
+
+
+
+/*---------------------------------------------------------------------------
+ *					Layout of the cache file
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Identifies the cache file.
+ */
+const		uint32	kEventCacheMagic			= 'EvCa';
+
+/*!	\brief		Version of the layout. A file of another version is recreated.
+ */
+const		uint32	kEventCacheVersion		= 1;
+
+/*!	\brief		Number of the slots in a new file.
+ *		\details		Enough for some 50000 Events; a slot takes 256 bytes.
+ */
+const		uint32	kEventCacheCapacity		= 65536;
+
+/*!	\brief		How many slots, starting with the one the node hashes to, may
+ *					hold its record.
+ */
+const		uint32	kEventCacheMaxProbes		= 32;
+
+/*!	\brief		How many times a reader retries a slot that is being written.
+ */
+const		int32		kEventCacheReadAttempts	= 64;
+
+/*!	\name		States of a slot.
+ */
+///@{
+const		int32		kEventCacheSlotEmpty		= 0;	//!< Never used - ends the search.
+const		int32		kEventCacheSlotUsed		= 1;
+const		int32		kEventCacheSlotRemoved	= 2;	//!< Invalidated - the search goes on.
+///@}
+
+
+/*!	\brief		The start of the file.
+ */
+struct EventCacheHeader {
+	uint32		magic;
+	uint32		version;
+	uint32		capacity;
+	uint32		slotSize;
+	uint8			reserved[ 48 ];
+};
+
+
+/*!	\brief		A slot of the hash table, as it's kept in the file.
+ *		\details		All numbers are native - the cache never leaves the computer.
+ */
+struct EventCache::Slot {
+	int32			sequence;			//!< Odd while the slot is written.
+	int32			state;				//!< See \c kEventCacheSlotUsed.
+	int32			device;
+	int32			reserved;
+	int64			node;
+	int64			modified;
+	int64			changed;
+	int64			start;
+	int64			duration;
+	int64			nextOccurrence;
+	int64			nextReminder;
+	int64			reminderOffset;
+	int32			type;
+	uint32		flags;
+	char			name[ kEventCacheNameLength ];
+	char			category[ kEventCacheCategoryLength ];
+	uint8			padding[ 8 ];
+};
+
+
+
+/*!	\brief		Make sure the memory operations before it are done before the
+ *					ones after it, as other processors see them.
+ */
+static inline void	EventCacheMemoryBarrier()
+{
+#if __GNUC__ >= 4
+	__sync_synchronize();
+#else
+	// A locked operation is a full barrier
+	int32	dummy = 0;
+	atomic_add( &dummy, 0 );
+#endif
+}	// <-- end of function EventCacheMemoryBarrier
+
+
+
+/*!	\brief		Copy a string into a field of the record.
+ *		\returns		\c false if the string had to be cut.
+ */
+static bool		EventCacheCopyString( char* field, size_t fieldSize, const BString& value )
+{
+	strncpy( field, value.String(), fieldSize - 1 );
+	field[ fieldSize - 1 ] = '\0';
+	return ( ( size_t )value.Length() < fieldSize );
+}	// <-- end of function EventCacheCopyString
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class EventCache
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - opens and maps the cache file.
+ *		\param[in]	bWritable	If \c true, the records may be stored and invalidated;
+ *										the file is created if it's missing. Otherwise the
+ *										file is mapped read-only, and must exist.
+ *		\param[in]	path			The cache file; if \c NULL, the default one.
+ */
+EventCache::EventCache( bool bWritable, const char* path )
+	:
+	fFD( -1 ),
+	fMap( NULL ),
+	fMapSize( 0 ),
+	fCapacity( 0 ),
+	bWritable( bWritable ),
+	fInitStatus( B_NO_INIT ),
+	fWriteLock( "Event cache" )
+{
+	BPath		defaultPath;
+	void*		map;
+
+	if ( !path ) {
+		if ( ( fInitStatus = GetDefaultPath( &defaultPath ) ) != B_OK ) {
+			return;
+		}
+		path = defaultPath.Path();
+	}
+
+	if ( ( fFD = open( path, bWritable ? ( O_RDWR | O_CREAT ) : O_RDONLY, 0644 ) ) < 0 ) {
+		fInitStatus = B_FROM_POSIX_ERROR( errno );
+		return;
+	}
+
+	// Another process may be creating the file
+	flock( fFD, bWritable ? LOCK_EX : LOCK_SH );
+	fInitStatus = _InitFile();
+	flock( fFD, LOCK_UN );
+	if ( fInitStatus != B_OK ) {
+		return;
+	}
+
+	fMapSize = sizeof( EventCacheHeader ) + fCapacity * sizeof( Slot );
+	map = mmap( NULL, fMapSize, bWritable ? ( PROT_READ | PROT_WRITE ) : PROT_READ,
+					MAP_SHARED, fFD, 0 );
+	if ( map == MAP_FAILED ) {
+		fInitStatus = B_FROM_POSIX_ERROR( errno );
+		return;
+	}
+	fMap = ( uint8* )map;
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - unmaps the file.
+ */
+EventCache::~EventCache()
+{
+	if ( fMap ) {
+		munmap( fMap, fMapSize );
+	}
+	if ( fFD >= 0 ) {
+		close( fFD );
+	}
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Check the header of the file, or create the file.
+ *		\attention	The file must be locked.
+ */
+status_t		EventCache::_InitFile()
+{
+	EventCacheHeader	header;
+	ssize_t				readSize;
+
+	readSize = pread( fFD, &header, sizeof( header ), 0 );
+	if ( readSize == ( ssize_t )sizeof( header ) &&
+		  header.magic == kEventCacheMagic &&
+		  header.version == kEventCacheVersion &&
+		  header.slotSize == sizeof( Slot ) &&
+		  header.capacity != 0 &&
+		  ( header.capacity & ( header.capacity - 1 ) ) == 0 )
+	{
+		fCapacity = header.capacity;
+		return B_OK;
+	}
+	if ( !bWritable ) {
+		return ( readSize == 0 ) ? B_NO_INIT : B_BAD_DATA;
+	}
+
+	// A new file, or one of another version - all the slots are emptied
+	memset( &header, 0, sizeof( header ) );
+	header.magic = kEventCacheMagic;
+	header.version = kEventCacheVersion;
+	header.capacity = kEventCacheCapacity;
+	header.slotSize = sizeof( Slot );
+	if ( ftruncate( fFD, 0 ) != 0 ||
+		  ftruncate( fFD, sizeof( header ) + ( off_t )kEventCacheCapacity * sizeof( Slot ) ) != 0 ||
+		  pwrite( fFD, &header, sizeof( header ), 0 ) != ( ssize_t )sizeof( header ) )
+	{
+		return B_FROM_POSIX_ERROR( errno );
+	}
+	fCapacity = kEventCacheCapacity;
+	return B_OK;
+}	// <-- end of function EventCache::_InitFile
+
+
+
+/*!	\brief		The default cache file, in the settings directory of the application.
+ */
+status_t		EventCache::GetDefaultPath( BPath* out )
+{
+	status_t		status;
+
+	if ( !out ) { return B_BAD_VALUE; }
+
+	if ( ( status = find_directory( B_USER_SETTINGS_DIRECTORY, out, true ) ) != B_OK ||
+		  ( status = out->Append( "Eventual" ) ) != B_OK )
+	{
+		return status;
+	}
+	create_directory( out->Path(), 0755 );
+	return out->Append( "EventCache" );
+}	// <-- end of function EventCache::GetDefaultPath
+
+
+
+EventCache::Slot*		EventCache::_SlotAt( uint32 index ) const
+{
+	return ( Slot* )( fMap + sizeof( EventCacheHeader ) + ( index & ( fCapacity - 1 ) ) * sizeof( Slot ) );
+}	// <-- end of function EventCache::_SlotAt
+
+
+
+/*!	\brief		Where the search for the node's record starts.
+ */
+uint32		EventCache::_Hash( const node_ref& node )
+{
+	uint32	hash = ( uint32 )node.node ^ ( uint32 )( ( uint64 )node.node >> 32 );
+
+	hash ^= ( uint32 )node.device * 0x9E3779B1U;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6BU;
+	hash ^= hash >> 13;
+	return hash;
+}	// <-- end of function EventCache::_Hash
+
+
+
+/*!	\brief		Copy the slot, which may be written by another process meanwhile.
+ *		\returns		\c false if the slot was being written all the time.
+ */
+bool		EventCache::_ReadSlot( const Slot* slot, Slot* out )
+{
+	const volatile int32*	sequence = &slot->sequence;
+	int32		before;
+
+	for ( int32 attempt = 0; attempt < kEventCacheReadAttempts; ++attempt )
+	{
+		if ( ( before = *sequence ) & 1 ) {
+			continue;
+		}
+		EventCacheMemoryBarrier();
+		memcpy( out, slot, sizeof( Slot ) );
+		EventCacheMemoryBarrier();
+		if ( *sequence == before ) {
+			return true;
+		}
+	}
+	return false;
+}	// <-- end of function EventCache::_ReadSlot
+
+
+
+/*!	\brief		Replace the contents of the slot.
+ *		\attention	The file must be locked.
+ */
+void		EventCache::_WriteSlot( Slot* slot, const Slot& value )
+{
+	atomic_add( &slot->sequence, 1 );
+	EventCacheMemoryBarrier();
+	memcpy( ( uint8* )slot + sizeof( int32 ), ( const uint8* )&value + sizeof( int32 ),
+			  sizeof( Slot ) - sizeof( int32 ) );
+	EventCacheMemoryBarrier();
+	atomic_add( &slot->sequence, 1 );
+}	// <-- end of function EventCache::_WriteSlot
+
+
+
+/*!	\brief		Find the record of the Event file.
+ *		\returns		\c B_OK if the record is there, and the file didn't change since.
+ *		\returns		\c B_ENTRY_NOT_FOUND otherwise.
+ */
+status_t		EventCache::Lookup( const entry_ref& ref, EventCacheRecord* out )
+{
+	BEntry			entry( &ref );
+	struct stat		info;
+	node_ref			node;
+	status_t			status;
+
+	if ( ( status = entry.GetStat( &info ) ) != B_OK ) {
+		return status;
+	}
+	node.device = info.st_dev;
+	node.node = info.st_ino;
+	return Lookup( node, info, out );
+}	// <-- end of function EventCache::Lookup
+
+
+
+/*!	\brief		Find the record of the node.
+ *		\param[in]	info		The current stat of the file.
+ */
+status_t		EventCache::Lookup( const node_ref& node, const struct stat& info,
+											 EventCacheRecord* out )
+{
+	Slot		copy;
+	uint32	home = _Hash( node );
+
+	if ( !out ) { return B_BAD_VALUE; }
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+
+	for ( uint32 i = 0; i < kEventCacheMaxProbes; ++i )
+	{
+		if ( !_ReadSlot( _SlotAt( home + i ), &copy ) ) {
+			continue;
+		}
+		if ( copy.state == kEventCacheSlotEmpty ) {
+			break;
+		}
+		if ( copy.state != kEventCacheSlotUsed ||
+			  copy.device != node.device || copy.node != node.node )
+		{
+			continue;
+		}
+
+		// The file was changed after the record was stored
+		if ( copy.modified != ( int64 )info.st_mtime || copy.changed != ( int64 )info.st_ctime ) {
+			return B_ENTRY_NOT_FOUND;
+		}
+
+		out->node = node;
+		out->modified = copy.modified;
+		out->changed = copy.changed;
+		out->start = copy.start;
+		out->duration = copy.duration;
+		out->nextOccurrence = copy.nextOccurrence;
+		out->nextReminder = copy.nextReminder;
+		out->reminderOffset = copy.reminderOffset;
+		out->type = copy.type;
+		out->flags = copy.flags;
+		memcpy( out->name, copy.name, sizeof( out->name ) );
+		memcpy( out->category, copy.category, sizeof( out->category ) );
+		return B_OK;
+	}
+	return B_ENTRY_NOT_FOUND;
+}	// <-- end of function EventCache::Lookup
+
+
+
+/*!	\brief		Find the record of the Event file, or decode the file.
+ *		\details		If the cache is writable, the decoded record is stored.
+ */
+status_t		EventCache::Fetch( const entry_ref& ref, EventCacheRecord* out )
+{
+	status_t		status;
+
+	if ( !out ) { return B_BAD_VALUE; }
+
+	if ( fInitStatus == B_OK && Lookup( ref, out ) == B_OK ) {
+		return B_OK;
+	}
+	if ( ( status = Decode( ref, out ) ) != B_OK ) {
+		return status;
+	}
+	if ( bWritable && fInitStatus == B_OK ) {
+		Store( *out );
+	}
+	return B_OK;
+}	// <-- end of function EventCache::Fetch
+
+
+
+/*!	\brief		Decode and store the Event files that are not in the cache yet.
+ *		\details		The Events are loaded together by EventData::LoadMany(), so they
+ *						are decoded in parallel. The following Fetch() of any of the files
+ *						finds its record. A cache that is not writable does nothing.
+ *		\param[in]	refs		The Event files.
+ *		\param[in]	count		Number of the files.
+ *		\returns		How many files were decoded and stored.
+ */
+int32		EventCache::Prefetch( const entry_ref* refs, int32 count )
+{
+	EventCacheRecord*	records;
+	entry_ref*			missed;
+	EventCacheRecord	cached;
+	EventDataBatch		batch;
+	int32					missedCount = 0, stored = 0;
+
+	if ( !refs || count <= 0 || !bWritable || fInitStatus != B_OK ) { return 0; }
+
+	records = new ( std::nothrow ) EventCacheRecord[ count ];
+	missed = new ( std::nothrow ) entry_ref[ count ];
+	if ( !records || !missed ) {
+		delete [] records;
+		delete [] missed;
+		return 0;
+	}
+
+	// The times of the files are taken before the Events are read
+	for ( int32 i = 0; i < count; ++i )
+	{
+		if ( Lookup( refs[ i ], &cached ) != B_OK &&
+			  _DecodeAttributes( refs[ i ], &records[ missedCount ] ) == B_OK )
+		{
+			missed[ missedCount++ ] = refs[ i ];
+		}
+	}
+
+	if ( missedCount > 0 && EventData::LoadMany( missed, missedCount, &batch ) == B_OK )
+	{
+		for ( int32 i = 0; i < missedCount; ++i )
+		{
+			if ( batch.ItemAt( i ) != NULL ) {
+				_DecodeEvent( *batch.ItemAt( i ), &records[ i ] );
+				if ( Store( records[ i ] ) == B_OK ) {
+					++stored;
+				}
+			}
+		}
+	}
+
+	delete [] records;
+	delete [] missed;
+	return stored;
+}	// <-- end of function EventCache::Prefetch
+
+
+
+/*!	\brief		Store the record, replacing the previous one of the same node.
+ *		\details		If all the slots the node may use are taken, the first one is
+ *						reused - it's only a cache.
+ */
+status_t		EventCache::Store( const EventCacheRecord& record )
+{
+	Slot		value;
+	Slot		*slot, *target = NULL, *freeSlot = NULL;
+	uint32	home = _Hash( record.node );
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !bWritable ) { return B_NOT_ALLOWED; }
+	if ( record.flags & kEventCacheTruncated ) { return B_NAME_TOO_LONG; }
+
+	memset( &value, 0, sizeof( value ) );
+	value.state = kEventCacheSlotUsed;
+	value.device = record.node.device;
+	value.node = record.node.node;
+	value.modified = record.modified;
+	value.changed = record.changed;
+	value.start = record.start;
+	value.duration = record.duration;
+	value.nextOccurrence = record.nextOccurrence;
+	value.nextReminder = record.nextReminder;
+	value.reminderOffset = record.reminderOffset;
+	value.type = record.type;
+	value.flags = record.flags;
+	memcpy( value.name, record.name, sizeof( value.name ) );
+	memcpy( value.category, record.category, sizeof( value.category ) );
+
+	BAutolock	lock( fWriteLock );
+	flock( fFD, LOCK_EX );
+
+	for ( uint32 i = 0; i < kEventCacheMaxProbes; ++i )
+	{
+		slot = _SlotAt( home + i );
+		if ( slot->state == kEventCacheSlotUsed ) {
+			if ( slot->device == value.device && slot->node == value.node ) {
+				target = slot;
+				break;
+			}
+			continue;
+		}
+		if ( !freeSlot ) {
+			freeSlot = slot;
+		}
+		if ( slot->state == kEventCacheSlotEmpty ) {
+			break;
+		}
+	}
+	if ( !target ) {
+		target = freeSlot ? freeSlot : _SlotAt( home );
+	}
+	_WriteSlot( target, value );
+
+	flock( fFD, LOCK_UN );
+	return B_OK;
+}	// <-- end of function EventCache::Store
+
+
+
+/*!	\brief		Drop the record of the node - its file was changed or removed.
+ */
+status_t		EventCache::Invalidate( const node_ref& node )
+{
+	Slot*		slot;
+	Slot		value;
+	uint32	home = _Hash( node );
+	status_t	status = B_ENTRY_NOT_FOUND;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !bWritable ) { return B_NOT_ALLOWED; }
+
+	BAutolock	lock( fWriteLock );
+	flock( fFD, LOCK_EX );
+
+	for ( uint32 i = 0; i < kEventCacheMaxProbes; ++i )
+	{
+		slot = _SlotAt( home + i );
+		if ( slot->state == kEventCacheSlotEmpty ) {
+			break;
+		}
+		if ( slot->state == kEventCacheSlotUsed &&
+			  slot->device == node.device && slot->node == node.node )
+		{
+			memset( &value, 0, sizeof( value ) );
+			value.state = kEventCacheSlotRemoved;
+			_WriteSlot( slot, value );
+			status = B_OK;
+			break;
+		}
+	}
+
+	flock( fFD, LOCK_UN );
+	return status;
+}	// <-- end of function EventCache::Invalidate
+
+
+
+/*!	\brief		Decode the record from the Event file.
+ *		\details		The deadlines and the "fired" flags are read from the attributes
+ *						the server maintains; the rest is decoded by EventData. The times
+ *						of the file are taken first, so if the file changes meanwhile,
+ *						the record is already outdated when it's stored.
+ */
+status_t		EventCache::Decode( const entry_ref& ref, EventCacheRecord* out )
+{
+	status_t				status;
+
+	if ( !out ) { return B_BAD_VALUE; }
+
+	if ( ( status = _DecodeAttributes( ref, out ) ) != B_OK ) {
+		return status;
+	}
+	EventData	event( ref );
+	_DecodeEvent( event, out );
+	return B_OK;
+}	// <-- end of function EventCache::Decode
+
+
+
+/*!	\brief		Decode the times of the file and the attributes the server maintains.
+ *		\details		The first part of Decode().
+ */
+status_t		EventCache::_DecodeAttributes( const entry_ref& ref, EventCacheRecord* out )
+{
+	BNode					node;
+	struct stat			info;
+	uint32				fired;
+	int64					value;
+	status_t				status;
+
+	if ( ( status = node.SetTo( &ref ) ) != B_OK ||
+		  ( status = node.GetStat( &info ) ) != B_OK ||
+		  ( status = node.GetNodeRef( &out->node ) ) != B_OK )
+	{
+		return status;
+	}
+	out->modified = ( int64 )info.st_mtime;
+	out->changed = ( int64 )info.st_ctime;
+	out->flags = 0;
+
+	// Missing deadlines mean there's nothing to schedule; missing flags mean fired
+	BfsEventNode	eventNode( &node );
+	out->nextOccurrence = ( eventNode.ReadTimeAttr( "EVNT:next_occurrence", &value ) == B_OK ) ? value : 0;
+	out->nextReminder = ( eventNode.ReadTimeAttr( "EVNT:next_reminder", &value ) == B_OK ) ? value : 0;
+	out->reminderOffset = ( eventNode.ReadTimeAttr( "EVNT:reminder_offset", &value ) == B_OK ) ? value : 0;
+	if ( eventNode.ReadAttr( "EVNT:activity_fired", B_INT32_TYPE, &fired, sizeof( uint32 ) ) != sizeof( uint32 ) || fired != 0 ) {
+		out->flags |= kEventCacheActivityFired;
+	}
+	if ( eventNode.ReadAttr( "EVNT:reminder_fired", B_INT32_TYPE, &fired, sizeof( uint32 ) ) != sizeof( uint32 ) || fired != 0 ) {
+		out->flags |= kEventCacheReminderFired;
+	}
+	if ( out->reminderOffset != 0 ) {
+		out->flags |= kEventCacheReminderEnabled;
+	}
+	return B_OK;
+}	// <-- end of function EventCache::_DecodeAttributes
+
+
+
+/*!	\brief		Decode the fields of the Event that only EventData can read.
+ *		\details		The second part of Decode().
+ */
+void		EventCache::_DecodeEvent( const EventData& event, EventCacheRecord* out )
+{
+	TimeRepresentation	start = event.GetStartTime();
+	CalendarModule*		calModule;
+
+	calModule = utl_FindCalendarModule( start.GetCalendarModule() );
+	out->start = calModule ? ( int64 )calModule->FromLocalCalendarToTimeT( start ) : 0;
+	out->duration = ( int64 )event.GetDuration();
+	out->type = ( int32 )event.GetEventType();
+	if ( event.GetPrivate() ) { out->flags |= kEventCachePrivate; }
+	if ( event.GetLastsWholeDays() ) { out->flags |= kEventCacheWholeDay; }
+
+	if ( !EventCacheCopyString( out->name, sizeof( out->name ), event.GetEventName() ) ||
+		  !EventCacheCopyString( out->category, sizeof( out->category ), event.GetCategory() ) )
+	{
+		out->flags |= kEventCacheTruncated;
+	}
+}	// <-- end of function EventCache::_DecodeEvent
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _EVENT_CACHE_H_
+#define _EVENT_CACHE_H_
+
+// OS includes
+#include <Entry.h>
+#include <Locker.h>
+#include <Path.h>
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <sys/stat.h>
+
+class EventData;
+
+
+/*!	\name		Lengths of the strings in the cache, including the terminating 0.
+ *		\details		An Event whose name or category is longer is not cached.
+ */
+///@{
+const		size_t	kEventCacheNameLength		= 96;
+const		size_t	kEventCacheCategoryLength	= 64;
+///@}
+
+/*!	\name		Flags of EventCacheRecord.
+ */
+///@{
+const		uint32	kEventCachePrivate				= 0x00000001;
+const		uint32	kEventCacheWholeDay				= 0x00000002;
+const		uint32	kEventCacheActivityFired		= 0x00000004;
+const		uint32	kEventCacheReminderFired		= 0x00000008;
+const		uint32	kEventCacheReminderEnabled		= 0x00000010;
+const		uint32	kEventCacheTruncated				= 0x80000000;	//!< A string was cut; not stored.
+///@}
+
+
+
+/*!	\brief		The decoded scalar fields of an Event file.
+ *		\details		The node and the times of the file are the key: the record
+ *						is valid only while the file's modification and status change
+ *						times are the ones it was decoded at.
+ */
+struct EventCacheRecord {
+	node_ref		node;
+	int64			modified;			//!< Modification time of the file.
+	int64			changed;				//!< Status change time - writing an attribute changes it.
+	int64			start;				//!< Start time of the first occurrence.
+	int64			duration;
+	int64			nextOccurrence;	//!< Value of "EVNT:next_occurrence".
+	int64			nextReminder;		//!< Value of "EVNT:next_reminder".
+	int64			reminderOffset;	//!< Value of "EVNT:reminder_offset".
+	int32			type;					//!< The EventType.
+	uint32		flags;				//!< See \c kEventCacheReminderEnabled.
+	char			name[ kEventCacheNameLength ];
+	char			category[ kEventCacheCategoryLength ];
+};
+
+
+
+/*---------------------------------------------------------------------------
+ *					Declaration of class EventCache
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Decoded Events, kept in a mapped file between the runs of the server.
+ *		\details		The file is a fixed hash table of the records, keyed by the
+ *						node of the Event file; finding an Event is a lookup in the
+ *						mapped memory instead of decoding the file. Now only the server
+ *						maps it, writable. The editor needs the whole Event, which the
+ *						record doesn't hold, and the preferences read a single attribute
+ *						per file. The file may be mapped read-only by other processes,
+ *						though: their lookups are safe while the server writes.
+ *
+ *						Every slot has a sequence number, which is odd while the slot
+ *						is written. A reader copies the slot and checks that the number
+ *						was even and didn't change meanwhile - so the readers never
+ *						lock, and never see a half-written record. The writers, in all
+ *						processes, are serialized by a lock on the file.
+ *
+ *						A record is dropped when the Event file changes: a lookup
+ *						compares the times of the file with the ones in the record, and
+ *						the server invalidates the files it's notified about.
+ */
+class EventCache
+{
+public:
+	EventCache( bool bWritable = false, const char* path = NULL );
+	virtual ~EventCache();
+
+	virtual status_t		InitCheck() const { return fInitStatus; }
+	virtual bool			IsWritable() const { return bWritable; }
+
+	virtual status_t		Lookup( const entry_ref& ref, EventCacheRecord* out );
+	virtual status_t		Lookup( const node_ref& node, const struct stat& info,
+										  EventCacheRecord* out );
+	virtual status_t		Fetch( const entry_ref& ref, EventCacheRecord* out );
+	virtual int32			Prefetch( const entry_ref* refs, int32 count );
+	virtual status_t		Store( const EventCacheRecord& record );
+	virtual status_t		Invalidate( const node_ref& node );
+
+	static  status_t		Decode( const entry_ref& ref, EventCacheRecord* out );
+	static  status_t		GetDefaultPath( BPath* out );
+
+protected:
+	struct Slot;
+
+	virtual Slot*			_SlotAt( uint32 index ) const;
+	static  uint32			_Hash( const node_ref& node );
+	static  bool			_ReadSlot( const Slot* slot, Slot* out );
+	static  status_t		_DecodeAttributes( const entry_ref& ref, EventCacheRecord* out );
+	static  void			_DecodeEvent( const EventData& event, EventCacheRecord* out );
+	virtual void			_WriteSlot( Slot* slot, const Slot& value );
+	virtual status_t		_InitFile();
+
+	int					fFD;
+	uint8*				fMap;				//!< The mapped file.
+	size_t				fMapSize;
+	uint32				fCapacity;		//!< Number of the slots; a power of two.
+	bool					bWritable;
+	status_t				fInitStatus;
+	BLocker				fWriteLock;		//!< Serializes the writers of this process.
+};	// <-- end of class EventCache
+
+
+#endif // _EVENT_CACHE_H_
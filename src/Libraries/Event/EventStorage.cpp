@@ -0,0 +1,207 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "EventStorage.h"
+
+// OS includes
+#include <TypeConstants.h>
+
+// POSIX includes
+#include <string.h>
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class EventNode
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ */
+EventNode::EventNode()
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+EventNode::~EventNode()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Read a string attribute.
+ *		\details		The attribute may be stored with or without the terminating zero.
+ */
+status_t		EventNode::ReadAttrString( const char* name, BString* out )
+{
+	attr_info	info;
+	ssize_t		readSize;
+	char*			buffer;
+	status_t		status;
+
+	if ( !name || !out ) { return B_BAD_VALUE; }
+	if ( ( status = GetAttrInfo( name, &info ) ) != B_OK ) { return status; }
+
+	if ( ( buffer = out->LockBuffer( ( int32 )info.size + 1 ) ) == NULL ) {
+		return B_NO_MEMORY;
+	}
+	readSize = ReadAttr( name, info.type, buffer, ( size_t )info.size );
+	if ( readSize < 0 ) {
+		out->UnlockBuffer( 0 );
+		return ( status_t )readSize;
+	}
+	buffer[ readSize ] = '\0';
+	out->UnlockBuffer( strlen( buffer ) );
+	return B_OK;
+}	// <-- end of function EventNode::ReadAttrString
+
+
+
+/*!	\brief		Read an attribute that holds time or time difference, in seconds.
+ *		\details		Same as utl_ReadTimeAttr(): 32-bit attributes of the older
+ *						versions are extended.
+ */
+status_t		EventNode::ReadTimeAttr( const char* name, int64* out )
+{
+	int64		value = 0;
+	uint32	legacyValue;
+	ssize_t	readSize;
+
+	if ( !name || !out ) { return B_BAD_VALUE; }
+
+	readSize = ReadAttr( name, B_INT64_TYPE, &value, sizeof( int64 ) );
+	if ( readSize < 0 ) {
+		return ( status_t )readSize;
+	}
+	if ( readSize == sizeof( int64 ) ) {
+		*out = value;
+	} else if ( readSize == sizeof( uint32 ) ) {
+		memcpy( &legacyValue, &value, sizeof( uint32 ) );
+		*out = ( int64 )legacyValue;
+	} else {
+		return B_BAD_DATA;
+	}
+	return B_OK;
+}	// <-- end of function EventNode::ReadTimeAttr
+
+
+
+/*!	\brief		Write an attribute that holds time or time difference, in seconds.
+ *		\details		Same as utl_WriteTimeAttr(): an attribute of another type is
+ *						removed first.
+ */
+status_t		EventNode::WriteTimeAttr( const char* name, int64 value )
+{
+	attr_info	info;
+	ssize_t		written;
+
+	if ( !name ) { return B_BAD_VALUE; }
+
+	if ( GetAttrInfo( name, &info ) == B_OK && info.type != B_INT64_TYPE ) {
+		RemoveAttr( name );
+	}
+	written = WriteAttr( name, B_INT64_TYPE, &value, sizeof( int64 ) );
+	if ( written < 0 ) {
+		return ( status_t )written;
+	}
+	return ( written == sizeof( int64 ) ) ? B_OK : B_IO_ERROR;
+}	// <-- end of function EventNode::WriteTimeAttr
+
+
+
+/*!	\brief		Set the MIME type of the Event and the application that opens it.
+ *		\details		Written as the attributes BNodeInfo uses, so the storages that
+ *						are copied to BFS keep them.
+ */
+status_t		EventNode::SetMimeType( const char* type, const char* preferredApp )
+{
+	ssize_t		written;
+
+	if ( !type ) { return B_BAD_VALUE; }
+
+	written = WriteAttr( "BEOS:TYPE", B_MIME_STRING_TYPE, type, strlen( type ) + 1 );
+	if ( written < 0 ) { return ( status_t )written; }
+
+	if ( preferredApp ) {
+		written = WriteAttr( "BEOS:PREF_APP", B_MIME_STRING_TYPE,
+									preferredApp, strlen( preferredApp ) + 1 );
+		if ( written < 0 ) { return ( status_t )written; }
+	}
+	return B_OK;
+}	// <-- end of function EventNode::SetMimeType
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class EventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ */
+EventStorage::EventStorage()
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+EventStorage::~EventStorage()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Write a single attribute of a stored Event.
+ *		\details		The rest of the Event is not read or written. Used for the
+ *						updates that don't need the whole Event, like the "fired" flags.
+ */
+status_t		EventStorage::UpdateAttr( const char* key, const char* name, type_code type,
+												  const void* buffer, size_t size )
+{
+	EventNode*	node;
+	ssize_t		written;
+	status_t		status;
+
+	if ( !key || !name ) { return B_BAD_VALUE; }
+	if ( ( node = Open( key, B_READ_WRITE ) ) == NULL ) { return B_NO_MEMORY; }
+
+	if ( ( status = node->InitCheck() ) == B_OK ) {
+		written = node->WriteAttr( name, type, buffer, size );
+		if ( written < 0 ) {
+			status = ( status_t )written;
+		} else if ( ( size_t )written != size ) {
+			status = B_IO_ERROR;
+		} else {
+			status = node->Commit();
+		}
+	}
+	delete node;
+	return status;
+}	// <-- end of function EventStorage::UpdateAttr
+
+
+
+/*!	\brief		Write a single time attribute of a stored Event.
+ */
+status_t		EventStorage::UpdateTimeAttr( const char* key, const char* name, int64 value )
+{
+	EventNode*	node;
+	status_t		status;
+
+	if ( !key || !name ) { return B_BAD_VALUE; }
+	if ( ( node = Open( key, B_READ_WRITE ) ) == NULL ) { return B_NO_MEMORY; }
+
+	if ( ( status = node->InitCheck() ) == B_OK &&
+		  ( status = node->WriteTimeAttr( name, value ) ) == B_OK )
+	{
+		status = node->Commit();
+	}
+	delete node;
+	return status;
+}	// <-- end of function EventStorage::UpdateTimeAttr
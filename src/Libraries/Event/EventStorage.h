@@ -0,0 +1,119 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _EVENT_STORAGE_H_
+#define _EVENT_STORAGE_H_
+
+// OS includes
+#include <StorageDefs.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <fs_attr.h>
+
+// STL includes
+#include <vector>
+
+
+class EventData;
+
+
+/*---------------------------------------------------------------------------
+ *					Declaration of class EventNode
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		A single stored Event: named, typed attributes and the data.
+ *		\details		This is all EventData needs from the place the Event is kept.
+ *						The interface follows BNode and BFile, so the code that decodes
+ *						and encodes the Events is the same for all storages. The data
+ *						of the node is the note of the Event.
+ *
+ *						Nodes are created by EventStorage::Open(), and deleted by the
+ *						caller. The storages that write the changes later, and not when
+ *						they're made, do it in Commit(); EventData calls it when the
+ *						Event is saved.
+ */
+class EventNode
+{
+public:
+	EventNode();
+	virtual ~EventNode();
+
+	virtual status_t	InitCheck() const = 0;
+	virtual status_t	Lock() { return B_OK; }
+	virtual status_t	Unlock() { return B_OK; }
+	virtual status_t	Commit() { return B_OK; }
+
+	/*!	\name		Attributes
+	 *		\details		Attributes are always read and written as a whole, from offset 0.
+	 */
+	///@{
+	virtual ssize_t	ReadAttr( const char* name, type_code type, void* buffer, size_t size ) = 0;
+	virtual ssize_t	WriteAttr( const char* name, type_code type, const void* buffer, size_t size ) = 0;
+	virtual status_t	RemoveAttr( const char* name ) = 0;
+	virtual status_t	GetAttrInfo( const char* name, attr_info* info ) = 0;
+	virtual status_t	RewindAttrs() = 0;
+	virtual status_t	GetNextAttrName( char* buffer ) = 0;
+
+	virtual status_t	ReadAttrString( const char* name, BString* out );
+	virtual status_t	ReadTimeAttr( const char* name, int64* out );
+	virtual status_t	WriteTimeAttr( const char* name, int64 value );
+	virtual status_t	SetMimeType( const char* type, const char* preferredApp );
+	///@}
+
+	/*!	\name		Data
+	 */
+	///@{
+	virtual status_t	GetSize( off_t* size ) = 0;
+	virtual ssize_t	ReadAt( off_t position, void* buffer, size_t size ) = 0;
+	virtual status_t	SetData( const void* buffer, size_t size ) = 0;
+	///@}
+};
+
+
+
+/*---------------------------------------------------------------------------
+ *					Declaration of class EventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		The place where the Events are kept.
+ *		\details		Every Event has a key, which is unique in its storage. What the
+ *						key is depends on the storage: BfsEventStorage uses the path of
+ *						the file, for example.
+ *
+ *						The open modes are the ones of BFile: \c B_READ_ONLY,
+ *						\c B_READ_WRITE, \c B_CREATE_FILE, \c B_ERASE_FILE; the last
+ *						one erases the data (the note), but not the attributes.
+ *
+ *						EventData is loaded from and saved to the storage with
+ *						EventData::Load() and EventData::Save(); the Events saved as
+ *						files with EventData::SaveToFile() are in BFS.
+ *
+ *						Nothing here depends on BFS or on EventData, so the storages
+ *						can be built and tested on other systems. BfsEventStorage is
+ *						declared in BfsEventStorage.h, and Load() and Save() are
+ *						implemented in Event.cpp, next to the EventData functions
+ *						they call.
+ */
+class EventStorage
+{
+public:
+	EventStorage();
+	virtual ~EventStorage();
+
+	virtual EventNode*	Open( const char* key, uint32 openMode ) = 0;
+	virtual status_t		Remove( const char* key ) = 0;
+	virtual status_t		ListByRange( const char* attribute, int64 from, int64 to,
+												 std::vector< BString >* keys ) = 0;
+
+	//! Shortcuts to EventData::Load() and EventData::Save(); not virtual, so the
+	//! storages may be linked without EventData.
+	status_t					Load( const char* key, EventData* event );
+	status_t					Save( const char* key, EventData* event );
+	virtual status_t		UpdateAttr( const char* key, const char* name, type_code type,
+												const void* buffer, size_t size );
+	virtual status_t		UpdateTimeAttr( const char* key, const char* name, int64 value );
+};
+
+
+#endif // _EVENT_STORAGE_H_
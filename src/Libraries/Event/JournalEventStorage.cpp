@@ -0,0 +1,859 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "BinaryRecord.h"
+#include "JournalEventStorage.h"
+
+// OS includes
+#include <Autolock.h>
+#include <ByteOrder.h>
+#include <Errors.h>
+#include <TypeConstants.h>
+
+// POSIX includes
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STL includes
+#include <algorithm>
+
+
+
+/*---------------------------------------------------------------------------
+ *					Layout of the journal
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		The journal starts with \c uint32 magic and \c uint32 version.
+ */
+const		uint32	kJournalMagic				= 'EvJl';
+const		uint32	kJournalVersion			= 1;
+const		off_t		kJournalFileHeaderSize	= 8;
+
+/*!	\brief		Every record starts with \c uint32 magic, \c uint32 size of the
+ *					whole record and \c uint32 checksum of the rest of the record.
+ *		\details		The rest is \c uint8 kind and the key as a string. An Event
+ *						record continues with \c uint32 number of attributes; every
+ *						attribute is its name as a string, \c uint32 type and the value
+ *						as data. The note, as data, comes last. All numbers are
+ *						little-endian; see RecordWriter.
+ */
+const		uint32	kJournalRecordMagic		= 'EvJr';
+const		size_t	kJournalRecordSizeOffset		= 4;
+const		size_t	kJournalRecordChecksumOffset	= 8;
+const		size_t	kJournalRecordHeaderSize		= 12;
+
+/*!	\name		Kinds of the records.
+ */
+///@{
+const		uint8		kJournalRecordEvent		= 1;
+const		uint8		kJournalRecordTombstone	= 2;
+///@}
+
+/*!	\brief		The journal isn't compacted while the dead records take less.
+ */
+const		off_t		kMinCompactionBytes		= 1024 * 1024;
+
+/*!	\brief		Size of the blocks in which the journal is copied.
+ */
+const		size_t	kJournalCopyBlockSize	= 64 * 1024;
+
+
+
+/*!	\brief		FNV-1a hash of the bytes - detects the records that were not
+ *					written completely.
+ */
+static uint32	JournalChecksum( const uint8* data, size_t length )
+{
+	uint32	hash = 2166136261U;
+
+	for ( size_t i = 0; i < length; ++i ) {
+		hash ^= data[ i ];
+		hash *= 16777619U;
+	}
+	return hash;
+}	// <-- end of function JournalChecksum
+
+
+
+/*!	\brief		Check the header of the record at the start of the buffer.
+ *		\param[out]	size		The size of the record.
+ *		\returns		\c true if the whole record is in the buffer and isn't damaged.
+ */
+static bool		JournalRecordIsValid( const uint8* data, size_t available, uint32* size )
+{
+	uint32	magic, recordSize, checksum;
+
+	if ( available < kJournalRecordHeaderSize ) { return false; }
+
+	memcpy( &magic, data, sizeof( uint32 ) );
+	memcpy( &recordSize, data + kJournalRecordSizeOffset, sizeof( uint32 ) );
+	memcpy( &checksum, data + kJournalRecordChecksumOffset, sizeof( uint32 ) );
+	magic = B_LENDIAN_TO_HOST_INT32( magic );
+	recordSize = B_LENDIAN_TO_HOST_INT32( recordSize );
+	checksum = B_LENDIAN_TO_HOST_INT32( checksum );
+
+	if ( magic != kJournalRecordMagic ||
+		  recordSize <= kJournalRecordHeaderSize ||
+		  recordSize > available ||
+		  checksum != JournalChecksum( data + kJournalRecordHeaderSize,
+												 recordSize - kJournalRecordHeaderSize ) )
+	{
+		return false;
+	}
+	*size = recordSize;
+	return true;
+}	// <-- end of function JournalRecordIsValid
+
+
+
+/*!	\brief		Decode the Event that follows the key of the record.
+ *		\param[out]	entry		The Event; may be \c NULL.
+ *		\param[out]	times		The 64-bit attributes; may be \c NULL.
+ */
+static status_t	JournalDecodeEvent( RecordReader* reader,
+												  MemoryEventEntry* entry,
+												  std::map< std::string, int64 >* times )
+{
+	uint32			count, type, length;
+	BString			name;
+	const void*		value;
+	int64				time;
+
+	if ( reader->ReadUint32( &count ) != B_OK ) { return reader->InitCheck(); }
+
+	for ( uint32 i = 0; i < count; ++i )
+	{
+		reader->ReadString( &name );
+		reader->ReadUint32( &type );
+		if ( reader->ReadData( &value, &length ) != B_OK ) { return reader->InitCheck(); }
+
+		if ( entry ) {
+			MemoryEventAttribute&	attribute = entry->attributes[ name.String() ];
+			attribute.type = type;
+			attribute.value.assign( ( const char* )value, length );
+		}
+		if ( times && type == B_INT64_TYPE && length == sizeof( int64 ) ) {
+			memcpy( &time, value, sizeof( int64 ) );
+			( *times )[ name.String() ] = time;
+		}
+	}
+
+	if ( reader->ReadData( &value, &length ) != B_OK ) { return reader->InitCheck(); }
+	if ( entry ) {
+		entry->data.assign( ( const char* )value, length );
+	}
+	return B_OK;
+}	// <-- end of function JournalDecodeEvent
+
+
+
+/*!	\brief		Start a record: the header, to be completed, the kind and the key.
+ */
+static void		JournalStartRecord( RecordWriter* writer, uint8 kind, const std::string& key )
+{
+	writer->AddUint32( kJournalRecordMagic );
+	writer->AddUint32( 0 );		// Size - set when the record is complete
+	writer->AddUint32( 0 );		// Checksum - the same
+	writer->AddUint8( kind );
+	writer->AddData( key.data(), ( uint32 )key.size() );
+}	// <-- end of function JournalStartRecord
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class JournalEventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - opens the journal and builds the index.
+ *		\param[in]	path				The journal; created if it's missing.
+ *		\param[in]	bSyncOnCommit	If \c true, every commit waits until the record
+ *											is on the disk.
+ */
+JournalEventStorage::JournalEventStorage( const char* path, bool bSyncOnCommit )
+	:
+	fPath( path ? path : "" ),
+	fFD( -1 ),
+	fInitStatus( B_NO_INIT ),
+	bSyncOnCommit( bSyncOnCommit ),
+	fLock( "Event journal" ),
+	fEnd( 0 ),
+	fLiveBytes( 0 ),
+	fCompactionLock( "Event journal compaction" ),
+	fCompactionRequest( -1 ),
+	fCompactionThread( -1 ),
+	fQuitRequested( 0 ),
+	bCompactionPending( false )
+{
+	if ( !path ) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+	if ( ( fFD = open( path, O_RDWR | O_CREAT, 0644 ) ) < 0 ) {
+		fInitStatus = B_FROM_POSIX_ERROR( errno );
+		return;
+	}
+	if ( ( fInitStatus = _Scan() ) != B_OK ) {
+		return;
+	}
+
+	fCompactionRequest = create_sem( 0, "Event journal compaction request" );
+	fCompactionThread = spawn_thread( _CompactionThread, "Event journal compactor",
+												 B_LOW_PRIORITY, this );
+	if ( fCompactionRequest < B_OK || fCompactionThread < B_OK ) {
+		// The journal works without compaction
+		return;
+	}
+	resume_thread( fCompactionThread );
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - stops the compaction and closes the journal.
+ *		\attention	The nodes of the storage must be deleted before it.
+ */
+JournalEventStorage::~JournalEventStorage()
+{
+	status_t		threadStatus;
+
+	atomic_set( &fQuitRequested, 1 );
+	if ( fCompactionThread >= B_OK ) {
+		release_sem( fCompactionRequest );
+		wait_for_thread( fCompactionThread, &threadStatus );
+	}
+	if ( fCompactionRequest >= B_OK ) {
+		delete_sem( fCompactionRequest );
+	}
+	if ( fFD >= 0 ) {
+		close( fFD );
+	}
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Build the index from the journal.
+ *		\details		The journal is mapped and read in one pass; every record replaces
+ *						the previous one with the same key. Reading stops at the first
+ *						damaged record, and the journal is cut there.
+ */
+status_t		JournalEventStorage::_Scan()
+{
+	struct stat		info;
+	uint8*			journal;
+	uint32			magic, version, recordSize;
+	uint8				kind;
+	BString			key;
+	off_t				position;
+
+	fIndex.clear();
+	fLiveBytes = 0;
+
+	if ( fstat( fFD, &info ) != 0 ) { return B_FROM_POSIX_ERROR( errno ); }
+
+	if ( info.st_size < kJournalFileHeaderSize ) {
+		// A new journal
+		magic = B_HOST_TO_LENDIAN_INT32( kJournalMagic );
+		version = B_HOST_TO_LENDIAN_INT32( kJournalVersion );
+		if ( ftruncate( fFD, 0 ) != 0 ||
+			  pwrite( fFD, &magic, sizeof( uint32 ), 0 ) != sizeof( uint32 ) ||
+			  pwrite( fFD, &version, sizeof( uint32 ), sizeof( uint32 ) ) != sizeof( uint32 ) )
+		{
+			return B_IO_ERROR;
+		}
+		fEnd = kJournalFileHeaderSize;
+		return B_OK;
+	}
+
+	journal = ( uint8* )mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fFD, 0 );
+	if ( journal == MAP_FAILED ) { return B_FROM_POSIX_ERROR( errno ); }
+
+	memcpy( &magic, journal, sizeof( uint32 ) );
+	memcpy( &version, journal + sizeof( uint32 ), sizeof( uint32 ) );
+	if ( B_LENDIAN_TO_HOST_INT32( magic ) != kJournalMagic ) {
+		munmap( journal, info.st_size );
+		return B_BAD_DATA;
+	}
+	if ( B_LENDIAN_TO_HOST_INT32( version ) > kJournalVersion ) {
+		munmap( journal, info.st_size );
+		return B_NOT_SUPPORTED;
+	}
+
+	position = kJournalFileHeaderSize;
+	while ( JournalRecordIsValid( journal + position, ( size_t )( info.st_size - position ), &recordSize ) )
+	{
+		RecordReader	reader( journal + position + kJournalRecordHeaderSize,
+									  recordSize - kJournalRecordHeaderSize );
+		reader.ReadUint8( &kind );
+		reader.ReadString( &key );
+		if ( reader.InitCheck() != B_OK ) { break; }
+
+		std::map< std::string, JournalIndexEntry >::iterator	previous = fIndex.find( key.String() );
+		if ( previous != fIndex.end() ) {
+			fLiveBytes -= previous->second.size;
+		}
+
+		if ( kind == kJournalRecordEvent ) {
+			JournalIndexEntry&	entry = fIndex[ key.String() ];
+			entry.offset = position;
+			entry.size = recordSize;
+			entry.times.clear();
+			if ( JournalDecodeEvent( &reader, NULL, &entry.times ) != B_OK ) {
+				fIndex.erase( key.String() );
+				break;
+			}
+			fLiveBytes += recordSize;
+		} else if ( previous != fIndex.end() ) {
+			fIndex.erase( previous );
+		}
+		position += recordSize;
+	}
+	munmap( journal, info.st_size );
+
+	// Whatever follows the last good record was not written completely
+	fEnd = position;
+	if ( position < info.st_size && ftruncate( fFD, position ) != 0 ) {
+		return B_FROM_POSIX_ERROR( errno );
+	}
+	return B_OK;
+}	// <-- end of function JournalEventStorage::_Scan
+
+
+
+EventNode*		JournalEventStorage::Open( const char* key, uint32 openMode )
+{
+	if ( !key ) { return NULL; }
+	return new JournalEventNode( this, key, openMode );
+}	// <-- end of function JournalEventStorage::Open
+
+
+
+/*!	\brief		Delete an Event - append a tombstone.
+ */
+status_t		JournalEventStorage::Remove( const char* key )
+{
+	RecordWriter	writer;
+
+	if ( !key ) { return B_BAD_VALUE; }
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	{
+		BAutolock	lock( fLock );
+		if ( fIndex.find( key ) == fIndex.end() ) { return B_ENTRY_NOT_FOUND; }
+	}
+
+	JournalStartRecord( &writer, kJournalRecordTombstone, key );
+	return _AppendRecord( &writer, key, NULL );
+}	// <-- end of function JournalEventStorage::Remove
+
+
+
+/*!	\brief		Find the Events whose time attribute is in the range.
+ *		\details		The index has the 64-bit attributes of the current records, so
+ *						the journal is not read.
+ */
+status_t		JournalEventStorage::ListByRange( const char* attribute, int64 from, int64 to,
+														  std::vector< BString >* keys )
+{
+	BAutolock	lock( fLock );
+	std::map< std::string, JournalIndexEntry >::const_iterator	entry;
+	std::map< std::string, int64 >::const_iterator	time;
+
+	if ( !attribute || !keys ) { return B_BAD_VALUE; }
+
+	for ( entry = fIndex.begin(); entry != fIndex.end(); ++entry )
+	{
+		time = entry->second.times.find( attribute );
+		if ( time != entry->second.times.end() &&
+			  time->second >= from && time->second < to )
+		{
+			keys->push_back( BString( entry->first.c_str() ) );
+		}
+	}
+	return B_OK;
+}	// <-- end of function JournalEventStorage::ListByRange
+
+
+
+int32		JournalEventStorage::CountEvents()
+{
+	BAutolock	lock( fLock );
+
+	return ( int32 )fIndex.size();
+}	// <-- end of function JournalEventStorage::CountEvents
+
+
+
+/*!	\brief		Read the current record of the Event.
+ */
+status_t		JournalEventStorage::_Read( const std::string& key, MemoryEventEntry* entry )
+{
+	std::vector< uint8 >	buffer;
+	std::map< std::string, JournalIndexEntry >::const_iterator	indexEntry;
+	uint32		recordSize;
+	uint8			kind;
+	BString		recordKey;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	{
+		BAutolock	lock( fLock );
+
+		indexEntry = fIndex.find( key );
+		if ( indexEntry == fIndex.end() ) { return B_ENTRY_NOT_FOUND; }
+
+		// The compaction moves the records - read while the lock is held
+		buffer.resize( indexEntry->second.size );
+		if ( pread( fFD, &buffer[ 0 ], buffer.size(), indexEntry->second.offset ) != ( ssize_t )buffer.size() ) {
+			return B_IO_ERROR;
+		}
+	}
+
+	if ( !JournalRecordIsValid( &buffer[ 0 ], buffer.size(), &recordSize ) ) {
+		return B_BAD_DATA;
+	}
+	RecordReader	reader( &buffer[ kJournalRecordHeaderSize ], recordSize - kJournalRecordHeaderSize );
+	reader.ReadUint8( &kind );
+	reader.ReadString( &recordKey );
+	if ( reader.InitCheck() != B_OK || kind != kJournalRecordEvent || key != recordKey.String() ) {
+		return B_BAD_DATA;
+	}
+
+	entry->attributes.clear();
+	return JournalDecodeEvent( &reader, entry, NULL );
+}	// <-- end of function JournalEventStorage::_Read
+
+
+
+/*!	\brief		Append the new version of the Event.
+ */
+status_t		JournalEventStorage::_Append( const std::string& key, const MemoryEventEntry* entry )
+{
+	RecordWriter		writer;
+	JournalIndexEntry	indexEntry;
+	int64					time;
+	std::map< std::string, MemoryEventAttribute >::const_iterator	attribute;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+
+	JournalStartRecord( &writer, kJournalRecordEvent, key );
+	writer.AddUint32( ( uint32 )entry->attributes.size() );
+	for ( attribute = entry->attributes.begin(); attribute != entry->attributes.end(); ++attribute )
+	{
+		writer.AddData( attribute->first.data(), ( uint32 )attribute->first.size() );
+		writer.AddUint32( attribute->second.type );
+		writer.AddData( attribute->second.value.data(), ( uint32 )attribute->second.value.size() );
+
+		if ( attribute->second.type == B_INT64_TYPE && attribute->second.value.size() == sizeof( int64 ) ) {
+			memcpy( &time, attribute->second.value.data(), sizeof( int64 ) );
+			indexEntry.times[ attribute->first ] = time;
+		}
+	}
+	writer.AddData( entry->data.data(), ( uint32 )entry->data.size() );
+
+	return _AppendRecord( &writer, key, &indexEntry );
+}	// <-- end of function JournalEventStorage::_Append
+
+
+
+/*!	\brief		Complete the record, append it to the journal and update the index.
+ *		\param[in]	indexEntry	The index entry of an Event record, or \c NULL for a
+ *										tombstone.
+ */
+status_t		JournalEventStorage::_AppendRecord( RecordWriter* writer, const std::string& key,
+																JournalIndexEntry* indexEntry )
+{
+	std::map< std::string, JournalIndexEntry >::iterator	previous;
+	uint32		size = ( uint32 )writer->Size();
+	status_t		status;
+
+	if ( size <= kJournalRecordHeaderSize ) { return B_BAD_VALUE; }
+	writer->SetUint32At( kJournalRecordSizeOffset, size );
+	writer->SetUint32At( kJournalRecordChecksumOffset,
+								JournalChecksum( ( const uint8* )writer->Buffer() + kJournalRecordHeaderSize,
+													  size - kJournalRecordHeaderSize ) );
+	if ( ( status = writer->InitCheck() ) != B_OK ) { return status; }
+
+	BAutolock	lock( fLock );
+
+	if ( pwrite( fFD, writer->Buffer(), size, fEnd ) != ( ssize_t )size ) {
+		// Whatever was written is overwritten by the next record
+		return B_IO_ERROR;
+	}
+	if ( bSyncOnCommit && fsync( fFD ) != 0 ) {
+		return B_FROM_POSIX_ERROR( errno );
+	}
+
+	previous = fIndex.find( key );
+	if ( previous != fIndex.end() ) {
+		fLiveBytes -= previous->second.size;
+	}
+	if ( indexEntry ) {
+		indexEntry->offset = fEnd;
+		indexEntry->size = size;
+		fIndex[ key ] = *indexEntry;
+		fLiveBytes += size;
+	} else if ( previous != fIndex.end() ) {
+		fIndex.erase( previous );
+	}
+	fEnd += size;
+
+	_CheckCompaction();
+	return B_OK;
+}	// <-- end of function JournalEventStorage::_AppendRecord
+
+
+
+/*!	\brief		Wake the compaction thread up, if the journal is worth compacting.
+ *		\attention	The lock of the index must be held.
+ */
+void		JournalEventStorage::_CheckCompaction()
+{
+	off_t		deadBytes = fEnd - kJournalFileHeaderSize - fLiveBytes;
+
+	if ( bCompactionPending || fCompactionThread < B_OK ) { return; }
+	if ( deadBytes < kMinCompactionBytes || deadBytes < fLiveBytes ) { return; }
+
+	bCompactionPending = true;
+	release_sem( fCompactionRequest );
+}	// <-- end of function JournalEventStorage::_CheckCompaction
+
+
+
+/*!	\brief		Main function of the compaction thread.
+ */
+int32		JournalEventStorage::_CompactionThread( void* data )
+{
+	JournalEventStorage*	me = ( JournalEventStorage* )data;
+
+	while ( acquire_sem( me->fCompactionRequest ) == B_OK )
+	{
+		if ( atomic_get( &me->fQuitRequested ) != 0 ) { break; }
+
+		me->Compact();
+
+		BAutolock	lock( me->fLock );
+		me->bCompactionPending = false;
+	}
+	return B_OK;
+}	// <-- end of function JournalEventStorage::_CompactionThread
+
+
+
+/*!	\brief		Write the current records into a new journal, and replace the old one.
+ *		\details		The records are copied without the lock, so the Events may be
+ *						saved meanwhile. Only the records appended during the copy are
+ *						copied with the lock held, before the journals are switched.
+ *						If the compaction fails, the old journal is kept.
+ */
+status_t		JournalEventStorage::Compact()
+{
+	BAutolock	compactionLock( fCompactionLock );
+	std::vector< std::pair< off_t, uint32 > >	records;
+	std::map< off_t, off_t >	moved;
+	std::map< std::string, JournalIndexEntry >::iterator	entry;
+	std::vector< uint8 >	buffer;
+	std::string		newPath = fPath + ".compacting";
+	off_t				snapshotEnd, newEnd, position;
+	uint32			header[ 2 ];
+	size_t			chunk;
+	int				newFD;
+	status_t			status = B_OK;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+
+	// The current records, in the order of the journal
+	fLock.Lock();
+	snapshotEnd = fEnd;
+	records.reserve( fIndex.size() );
+	for ( entry = fIndex.begin(); entry != fIndex.end(); ++entry ) {
+		records.push_back( std::make_pair( entry->second.offset, entry->second.size ) );
+	}
+	fLock.Unlock();
+	std::sort( records.begin(), records.end() );
+
+	if ( ( newFD = open( newPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) ) < 0 ) {
+		return B_FROM_POSIX_ERROR( errno );
+	}
+	header[ 0 ] = B_HOST_TO_LENDIAN_INT32( kJournalMagic );
+	header[ 1 ] = B_HOST_TO_LENDIAN_INT32( kJournalVersion );
+	if ( pwrite( newFD, header, sizeof( header ), 0 ) != sizeof( header ) ) {
+		status = B_IO_ERROR;
+	}
+	newEnd = kJournalFileHeaderSize;
+
+	// Only this thread replaces fFD, so the old journal may be read without the lock
+	for ( size_t i = 0; status == B_OK && i < records.size(); ++i )
+	{
+		if ( atomic_get( &fQuitRequested ) != 0 ) {
+			status = B_INTERRUPTED;
+			break;
+		}
+		buffer.resize( records[ i ].second );
+		if ( pread( fFD, &buffer[ 0 ], buffer.size(), records[ i ].first ) != ( ssize_t )buffer.size() ||
+			  pwrite( newFD, &buffer[ 0 ], buffer.size(), newEnd ) != ( ssize_t )buffer.size() )
+		{
+			status = B_IO_ERROR;
+			break;
+		}
+		moved[ records[ i ].first ] = newEnd;
+		newEnd += records[ i ].second;
+	}
+	if ( status != B_OK ) {
+		close( newFD );
+		unlink( newPath.c_str() );
+		return status;
+	}
+
+	BAutolock	lock( fLock );
+
+	// The records appended meanwhile are copied as they are
+	buffer.resize( kJournalCopyBlockSize );
+	for ( position = snapshotEnd; status == B_OK && position < fEnd; position += chunk )
+	{
+		chunk = ( size_t )std::min( ( off_t )kJournalCopyBlockSize, fEnd - position );
+		if ( pread( fFD, &buffer[ 0 ], chunk, position ) != ( ssize_t )chunk ||
+			  pwrite( newFD, &buffer[ 0 ], chunk, newEnd + ( position - snapshotEnd ) ) != ( ssize_t )chunk )
+		{
+			status = B_IO_ERROR;
+		}
+	}
+
+	// Every record that was current at the snapshot, and still is, was moved
+	for ( entry = fIndex.begin(); status == B_OK && entry != fIndex.end(); ++entry ) {
+		if ( entry->second.offset < snapshotEnd && moved.find( entry->second.offset ) == moved.end() ) {
+			status = B_ERROR;
+		}
+	}
+	if ( status == B_OK && ( fsync( newFD ) != 0 || rename( newPath.c_str(), fPath.c_str() ) != 0 ) ) {
+		status = B_FROM_POSIX_ERROR( errno );
+	}
+	if ( status != B_OK ) {
+		close( newFD );
+		unlink( newPath.c_str() );
+		return status;
+	}
+
+	// The new journal is in place - switch to it
+	for ( entry = fIndex.begin(); entry != fIndex.end(); ++entry ) {
+		if ( entry->second.offset < snapshotEnd ) {
+			entry->second.offset = moved[ entry->second.offset ];
+		} else {
+			entry->second.offset = newEnd + ( entry->second.offset - snapshotEnd );
+		}
+	}
+	fEnd = newEnd + ( fEnd - snapshotEnd );
+	close( fFD );
+	fFD = newFD;
+	return B_OK;
+}	// <-- end of function JournalEventStorage::Compact
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class JournalEventNode
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - reads the current version of the Event.
+ */
+JournalEventNode::JournalEventNode( JournalEventStorage* storage,
+												const std::string& key,
+												uint32 openMode )
+	:
+	fStorage( storage ),
+	fKey( key ),
+	fInitStatus( B_NO_INIT ),
+	bWritable( ( openMode & O_ACCMODE ) != B_READ_ONLY ),
+	bDirty( false ),
+	bWritten( false ),
+	fNextAttr( 0 )
+{
+	if ( !storage ) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+
+	fInitStatus = storage->_Read( key, &fEntry );
+	if ( fInitStatus == B_ENTRY_NOT_FOUND && bWritable && ( openMode & B_CREATE_FILE ) ) {
+		// A new Event - it exists when it's committed
+		fInitStatus = B_OK;
+		bDirty = true;
+	}
+	if ( fInitStatus == B_OK && bWritable && ( openMode & B_ERASE_FILE ) ) {
+		fEntry.data.clear();
+		bDirty = true;
+	}
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - appends the changes that were not committed.
+ *		\details		A node which was created, or erased, but never written to is
+ *						left alone - otherwise merely opening a new Event would add
+ *						an empty one to the journal.
+ */
+JournalEventNode::~JournalEventNode()
+{
+	if ( fInitStatus == B_OK && bDirty && bWritten ) {
+		Commit();
+	}
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Append the Event to the journal, if it was changed.
+ */
+status_t		JournalEventNode::Commit()
+{
+	status_t		status;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !bDirty ) { return B_OK; }
+
+	if ( ( status = fStorage->_Append( fKey, &fEntry ) ) == B_OK ) {
+		bDirty = false;
+	}
+	return status;
+}	// <-- end of function JournalEventNode::Commit
+
+
+
+ssize_t		JournalEventNode::ReadAttr( const char* name, type_code type, void* buffer, size_t size )
+{
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+	size_t		toCopy;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !name || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	value = fEntry.attributes.find( name );
+	if ( value == fEntry.attributes.end() ) { return B_ENTRY_NOT_FOUND; }
+
+	toCopy = ( value->second.value.size() < size ) ? value->second.value.size() : size;
+	memcpy( buffer, value->second.value.data(), toCopy );
+	return ( ssize_t )toCopy;
+}	// <-- end of function JournalEventNode::ReadAttr
+
+
+
+ssize_t		JournalEventNode::WriteAttr( const char* name, type_code type, const void* buffer, size_t size )
+{
+	MemoryEventAttribute*	value;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !bWritable ) { return B_NOT_ALLOWED; }
+	if ( !name || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	value = &( fEntry.attributes[ name ] );
+	value->type = type;
+	value->value.assign( ( const char* )buffer, size );
+	bDirty = true;
+	bWritten = true;
+	return ( ssize_t )size;
+}	// <-- end of function JournalEventNode::WriteAttr
+
+
+
+status_t		JournalEventNode::RemoveAttr( const char* name )
+{
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !bWritable ) { return B_NOT_ALLOWED; }
+	if ( !name ) { return B_BAD_VALUE; }
+
+	if ( fEntry.attributes.erase( name ) == 0 ) { return B_ENTRY_NOT_FOUND; }
+	bDirty = true;
+	bWritten = true;
+	return B_OK;
+}	// <-- end of function JournalEventNode::RemoveAttr
+
+
+
+status_t		JournalEventNode::GetAttrInfo( const char* name, attr_info* info )
+{
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !name || !info ) { return B_BAD_VALUE; }
+
+	value = fEntry.attributes.find( name );
+	if ( value == fEntry.attributes.end() ) { return B_ENTRY_NOT_FOUND; }
+
+	info->type = value->second.type;
+	info->size = ( off_t )value->second.value.size();
+	return B_OK;
+}	// <-- end of function JournalEventNode::GetAttrInfo
+
+
+
+status_t		JournalEventNode::RewindAttrs()
+{
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+
+	fAttrNames.clear();
+	fNextAttr = 0;
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+
+	fAttrNames.reserve( fEntry.attributes.size() );
+	for ( value = fEntry.attributes.begin(); value != fEntry.attributes.end(); ++value ) {
+		fAttrNames.push_back( value->first );
+	}
+	return B_OK;
+}	// <-- end of function JournalEventNode::RewindAttrs
+
+
+
+status_t		JournalEventNode::GetNextAttrName( char* buffer )
+{
+	if ( !buffer ) { return B_BAD_VALUE; }
+	if ( fNextAttr >= fAttrNames.size() ) { return B_ENTRY_NOT_FOUND; }
+
+	strncpy( buffer, fAttrNames[ fNextAttr ].c_str(), B_ATTR_NAME_LENGTH - 1 );
+	buffer[ B_ATTR_NAME_LENGTH - 1 ] = '\0';
+	++fNextAttr;
+	return B_OK;
+}	// <-- end of function JournalEventNode::GetNextAttrName
+
+
+
+status_t		JournalEventNode::GetSize( off_t* size )
+{
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !size ) { return B_BAD_VALUE; }
+
+	*size = ( off_t )fEntry.data.size();
+	return B_OK;
+}	// <-- end of function JournalEventNode::GetSize
+
+
+
+ssize_t		JournalEventNode::ReadAt( off_t position, void* buffer, size_t size )
+{
+	size_t		toCopy;
+
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( position < 0 || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	if ( ( size_t )position >= fEntry.data.size() ) { return 0; }
+	toCopy = fEntry.data.size() - ( size_t )position;
+	if ( toCopy > size ) { toCopy = size; }
+	memcpy( buffer, fEntry.data.data() + position, toCopy );
+	return ( ssize_t )toCopy;
+}	// <-- end of function JournalEventNode::ReadAt
+
+
+
+status_t		JournalEventNode::SetData( const void* buffer, size_t size )
+{
+	if ( fInitStatus != B_OK ) { return fInitStatus; }
+	if ( !bWritable ) { return B_NOT_ALLOWED; }
+	if ( !buffer && size != 0 ) { return B_BAD_VALUE; }
+
+	fEntry.data.assign( ( const char* )buffer, size );
+	bDirty = true;
+	bWritten = true;
+	return B_OK;
+}	// <-- end of function JournalEventNode::SetData
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _JOURNAL_EVENT_STORAGE_H_
+#define _JOURNAL_EVENT_STORAGE_H_
+
+// Project includes
+#include "EventStorage.h"
+#include "MemoryEventStorage.h"
+
+// OS includes
+#include <Locker.h>
+#include <OS.h>
+
+// STL includes
+#include <map>
+#include <string>
+#include <vector>
+
+
+class RecordReader;
+class RecordWriter;
+
+
+/*!	\brief		Place of the current version of an Event in the journal.
+ *		\details		The 64-bit attributes are kept here as well, so ListByRange()
+ *						doesn't read the journal.
+ */
+struct JournalIndexEntry {
+	off_t		offset;
+	uint32	size;
+	std::map< std::string, int64 >	times;
+};
+
+
+
+/*!	\brief		All Events in one append-only file.
+ *		\details		Every save of an Event appends the whole Event - attributes and
+ *						note - as one record; deleting appends a tombstone. The index
+ *						of the current records is kept in memory. It's rebuilt when the
+ *						storage is opened, by a single pass over the mapped journal;
+ *						a torn record at the end (the system crashed while it was
+ *						written) is cut off.
+ *
+ *						The replaced records and the tombstones are removed by the
+ *						compaction thread, which writes the current records into a new
+ *						journal and replaces the old one. It runs when the dead records
+ *						take more space than the live ones.
+ *
+ *						Nodes keep the Event in memory; the changes are appended by
+ *						Commit(), or when a changed node is deleted.
+ */
+class JournalEventStorage
+	: public EventStorage
+{
+public:
+	JournalEventStorage( const char* path, bool bSyncOnCommit = false );
+	virtual ~JournalEventStorage();
+
+	virtual status_t		InitCheck() const { return fInitStatus; }
+
+	virtual EventNode*	Open( const char* key, uint32 openMode );
+	virtual status_t		Remove( const char* key );
+	virtual status_t		ListByRange( const char* attribute, int64 from, int64 to,
+												 std::vector< BString >* keys );
+
+	virtual int32			CountEvents();
+	virtual status_t		Compact();
+
+protected:
+	friend class JournalEventNode;
+
+	virtual status_t		_Scan();
+	virtual status_t		_Read( const std::string& key, MemoryEventEntry* entry );
+	virtual status_t		_Append( const std::string& key, const MemoryEventEntry* entry );
+	virtual status_t		_AppendRecord( RecordWriter* writer, const std::string& key,
+												  JournalIndexEntry* indexEntry );
+	virtual void			_CheckCompaction();
+	static  int32			_CompactionThread( void* data );
+
+	std::string		fPath;
+	int				fFD;
+	status_t			fInitStatus;
+	bool				bSyncOnCommit;
+	BLocker			fLock;		//!< Guards the index and the end of the journal.
+	std::map< std::string, JournalIndexEntry >	fIndex;
+	off_t				fEnd;			//!< Size of the valid part of the journal.
+	off_t				fLiveBytes;	//!< Size of the current records.
+	BLocker			fCompactionLock;	//!< Only one compaction at a time.
+	sem_id			fCompactionRequest;
+	thread_id		fCompactionThread;
+	int32				fQuitRequested;
+	bool				bCompactionPending;
+};
+
+
+
+/*!	\brief		A node of JournalEventStorage - a copy of the Event in memory.
+ */
+class JournalEventNode
+	: public EventNode
+{
+public:
+	JournalEventNode( JournalEventStorage* storage, const std::string& key, uint32 openMode );
+	virtual ~JournalEventNode();
+
+	virtual status_t	InitCheck() const { return fInitStatus; }
+	virtual status_t	Commit();
+
+	virtual ssize_t	ReadAttr( const char* name, type_code type, void* buffer, size_t size );
+	virtual ssize_t	WriteAttr( const char* name, type_code type, const void* buffer, size_t size );
+	virtual status_t	RemoveAttr( const char* name );
+	virtual status_t	GetAttrInfo( const char* name, attr_info* info );
+	virtual status_t	RewindAttrs();
+	virtual status_t	GetNextAttrName( char* buffer );
+
+	virtual status_t	GetSize( off_t* size );
+	virtual ssize_t	ReadAt( off_t position, void* buffer, size_t size );
+	virtual status_t	SetData( const void* buffer, size_t size );
+
+protected:
+	JournalEventStorage*		fStorage;
+	std::string					fKey;
+	status_t						fInitStatus;
+	bool							bWritable;
+	bool							bDirty;		//!< \c true if there are changes to append.
+	bool							bWritten;	//!< \c true if an attribute or the data was written.
+	MemoryEventEntry			fEntry;
+	std::vector< std::string >	fAttrNames;		//!< Filled by RewindAttrs().
+	size_t						fNextAttr;
+};
+
+
+#endif // _JOURNAL_EVENT_STORAGE_H_
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "MemoryEventStorage.h"
+
+// OS includes
+#include <Autolock.h>
+
+// POSIX includes
+#include <string.h>
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class MemoryEventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ */
+MemoryEventStorage::MemoryEventStorage()
+	:
+	fLock( "Memory Event storage" )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ *		\attention	The nodes of the storage must be deleted before it.
+ */
+MemoryEventStorage::~MemoryEventStorage()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Open an Event; with \c B_CREATE_FILE, create it if it's missing.
+ */
+EventNode*		MemoryEventStorage::Open( const char* key, uint32 openMode )
+{
+	BAutolock	lock( fLock );
+	std::map< std::string, MemoryEventEntry >::iterator	entry;
+
+	if ( !key ) { return NULL; }
+
+	entry = fEntries.find( key );
+	if ( entry == fEntries.end() ) {
+		if ( ( openMode & B_CREATE_FILE ) == 0 ) {
+			// The node is returned anyway - its InitCheck() fails
+			return new MemoryEventNode( this, key );
+		}
+		entry = fEntries.insert( std::make_pair( std::string( key ), MemoryEventEntry() ) ).first;
+	}
+	if ( openMode & B_ERASE_FILE ) {
+		entry->second.data.clear();
+	}
+	return new MemoryEventNode( this, key );
+}	// <-- end of function MemoryEventStorage::Open
+
+
+
+status_t		MemoryEventStorage::Remove( const char* key )
+{
+	BAutolock	lock( fLock );
+
+	if ( !key ) { return B_BAD_VALUE; }
+	if ( fEntries.erase( key ) == 0 ) { return B_ENTRY_NOT_FOUND; }
+	return B_OK;
+}	// <-- end of function MemoryEventStorage::Remove
+
+
+
+/*!	\brief		Find the Events whose time attribute is in the range.
+ *		\details		There's no index - every Event is checked.
+ */
+status_t		MemoryEventStorage::ListByRange( const char* attribute, int64 from, int64 to,
+														  std::vector< BString >* keys )
+{
+	BAutolock	lock( fLock );
+	std::map< std::string, MemoryEventEntry >::const_iterator	entry;
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+	int64			time;
+	uint32		legacyTime;
+
+	if ( !attribute || !keys ) { return B_BAD_VALUE; }
+
+	for ( entry = fEntries.begin(); entry != fEntries.end(); ++entry )
+	{
+		value = entry->second.attributes.find( attribute );
+		if ( value == entry->second.attributes.end() ) { continue; }
+
+		if ( value->second.value.size() == sizeof( int64 ) ) {
+			memcpy( &time, value->second.value.data(), sizeof( int64 ) );
+		} else if ( value->second.value.size() == sizeof( uint32 ) ) {
+			memcpy( &legacyTime, value->second.value.data(), sizeof( uint32 ) );
+			time = ( int64 )legacyTime;
+		} else {
+			continue;
+		}
+
+		if ( time >= from && time < to ) {
+			keys->push_back( BString( entry->first.c_str() ) );
+		}
+	}
+	return B_OK;
+}	// <-- end of function MemoryEventStorage::ListByRange
+
+
+
+int32		MemoryEventStorage::CountEvents()
+{
+	BAutolock	lock( fLock );
+
+	return ( int32 )fEntries.size();
+}	// <-- end of function MemoryEventStorage::CountEvents
+
+
+
+void		MemoryEventStorage::MakeEmpty()
+{
+	BAutolock	lock( fLock );
+
+	fEntries.clear();
+}	// <-- end of function MemoryEventStorage::MakeEmpty
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class MemoryEventNode
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ */
+MemoryEventNode::MemoryEventNode( MemoryEventStorage* storage, const std::string& key )
+	:
+	fStorage( storage ),
+	fKey( key ),
+	fNextAttr( 0 )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+MemoryEventNode::~MemoryEventNode()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		The entry of the node.
+ *		\attention	The lock of the storage must be held.
+ */
+MemoryEventEntry*		MemoryEventNode::_Entry()
+{
+	std::map< std::string, MemoryEventEntry >::iterator	entry;
+
+	if ( !fStorage ) { return NULL; }
+	entry = fStorage->fEntries.find( fKey );
+	return ( entry != fStorage->fEntries.end() ) ? &( entry->second ) : NULL;
+}	// <-- end of function MemoryEventNode::_Entry
+
+
+
+status_t		MemoryEventNode::InitCheck() const
+{
+	if ( !fStorage ) { return B_NO_INIT; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( fStorage->fEntries.count( fKey ) == 0 ) { return B_ENTRY_NOT_FOUND; }
+	return B_OK;
+}	// <-- end of function MemoryEventNode::InitCheck
+
+
+
+ssize_t		MemoryEventNode::ReadAttr( const char* name, type_code type, void* buffer, size_t size )
+{
+	MemoryEventEntry*	entry;
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+	size_t		toCopy;
+
+	if ( !fStorage || !name || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	value = entry->attributes.find( name );
+	if ( value == entry->attributes.end() ) { return B_ENTRY_NOT_FOUND; }
+
+	toCopy = ( value->second.value.size() < size ) ? value->second.value.size() : size;
+	memcpy( buffer, value->second.value.data(), toCopy );
+	return ( ssize_t )toCopy;
+}	// <-- end of function MemoryEventNode::ReadAttr
+
+
+
+ssize_t		MemoryEventNode::WriteAttr( const char* name, type_code type, const void* buffer, size_t size )
+{
+	MemoryEventEntry*	entry;
+	MemoryEventAttribute*	value;
+
+	if ( !fStorage || !name || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	value = &( entry->attributes[ name ] );
+	value->type = type;
+	value->value.assign( ( const char* )buffer, size );
+	return ( ssize_t )size;
+}	// <-- end of function MemoryEventNode::WriteAttr
+
+
+
+status_t		MemoryEventNode::RemoveAttr( const char* name )
+{
+	MemoryEventEntry*	entry;
+
+	if ( !fStorage || !name ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	if ( entry->attributes.erase( name ) == 0 ) { return B_ENTRY_NOT_FOUND; }
+	return B_OK;
+}	// <-- end of function MemoryEventNode::RemoveAttr
+
+
+
+status_t		MemoryEventNode::GetAttrInfo( const char* name, attr_info* info )
+{
+	MemoryEventEntry*	entry;
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+
+	if ( !fStorage || !name || !info ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	value = entry->attributes.find( name );
+	if ( value == entry->attributes.end() ) { return B_ENTRY_NOT_FOUND; }
+
+	info->type = value->second.type;
+	info->size = ( off_t )value->second.value.size();
+	return B_OK;
+}	// <-- end of function MemoryEventNode::GetAttrInfo
+
+
+
+/*!	\brief		Start listing the attributes.
+ *		\details		The names are copied, so the node may be changed while they're
+ *						listed - as it may in BFS.
+ */
+status_t		MemoryEventNode::RewindAttrs()
+{
+	MemoryEventEntry*	entry;
+	std::map< std::string, MemoryEventAttribute >::const_iterator	value;
+
+	fAttrNames.clear();
+	fNextAttr = 0;
+	if ( !fStorage ) { return B_NO_INIT; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	fAttrNames.reserve( entry->attributes.size() );
+	for ( value = entry->attributes.begin(); value != entry->attributes.end(); ++value ) {
+		fAttrNames.push_back( value->first );
+	}
+	return B_OK;
+}	// <-- end of function MemoryEventNode::RewindAttrs
+
+
+
+/*!	\brief		Get the name of the next attribute.
+ *		\param[out]	buffer	At least \c B_ATTR_NAME_LENGTH bytes.
+ */
+status_t		MemoryEventNode::GetNextAttrName( char* buffer )
+{
+	if ( !buffer ) { return B_BAD_VALUE; }
+	if ( fNextAttr >= fAttrNames.size() ) { return B_ENTRY_NOT_FOUND; }
+
+	strncpy( buffer, fAttrNames[ fNextAttr ].c_str(), B_ATTR_NAME_LENGTH - 1 );
+	buffer[ B_ATTR_NAME_LENGTH - 1 ] = '\0';
+	++fNextAttr;
+	return B_OK;
+}	// <-- end of function MemoryEventNode::GetNextAttrName
+
+
+
+status_t		MemoryEventNode::GetSize( off_t* size )
+{
+	MemoryEventEntry*	entry;
+
+	if ( !fStorage || !size ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	*size = ( off_t )entry->data.size();
+	return B_OK;
+}	// <-- end of function MemoryEventNode::GetSize
+
+
+
+ssize_t		MemoryEventNode::ReadAt( off_t position, void* buffer, size_t size )
+{
+	MemoryEventEntry*	entry;
+	size_t		toCopy;
+
+	if ( !fStorage || position < 0 || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	if ( ( size_t )position >= entry->data.size() ) { return 0; }
+	toCopy = entry->data.size() - ( size_t )position;
+	if ( toCopy > size ) { toCopy = size; }
+	memcpy( buffer, entry->data.data() + position, toCopy );
+	return ( ssize_t )toCopy;
+}	// <-- end of function MemoryEventNode::ReadAt
+
+
+
+status_t		MemoryEventNode::SetData( const void* buffer, size_t size )
+{
+	MemoryEventEntry*	entry;
+
+	if ( !fStorage || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	BAutolock	lock( fStorage->fLock );
+	if ( ( entry = _Entry() ) == NULL ) { return B_ENTRY_NOT_FOUND; }
+
+	entry->data.assign( ( const char* )buffer, size );
+	return B_OK;
+}	// <-- end of function MemoryEventNode::SetData
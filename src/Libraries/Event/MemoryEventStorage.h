@@ -0,0 +1,101 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _MEMORY_EVENT_STORAGE_H_
+#define _MEMORY_EVENT_STORAGE_H_
+
+// Project includes
+#include "EventStorage.h"
+
+// OS includes
+#include <Locker.h>
+
+// STL includes
+#include <map>
+#include <string>
+#include <vector>
+
+
+/*!	\brief		A stored attribute: its type and its value.
+ */
+struct MemoryEventAttribute {
+	type_code		type;
+	std::string		value;
+};
+
+
+/*!	\brief		A stored Event.
+ */
+struct MemoryEventEntry {
+	std::map< std::string, MemoryEventAttribute >	attributes;
+	std::string		data;		//!< The note.
+};
+
+
+
+/*!	\brief		Events kept in memory only.
+ *		\details		Used to run the Event code without a file system - for example,
+ *						to measure encoding and decoding without the disk. All nodes
+ *						share the lock of the storage, so it may be used from several
+ *						threads.
+ */
+class MemoryEventStorage
+	: public EventStorage
+{
+public:
+	MemoryEventStorage();
+	virtual ~MemoryEventStorage();
+
+	virtual EventNode*	Open( const char* key, uint32 openMode );
+	virtual status_t		Remove( const char* key );
+	virtual status_t		ListByRange( const char* attribute, int64 from, int64 to,
+												 std::vector< BString >* keys );
+
+	virtual int32			CountEvents();
+	virtual void			MakeEmpty();
+
+protected:
+	friend class MemoryEventNode;
+
+	BLocker		fLock;
+	std::map< std::string, MemoryEventEntry >	fEntries;
+};
+
+
+
+/*!	\brief		A node of MemoryEventStorage.
+ *		\details		The node refers to the entry in the storage by its key, so it
+ *						sees the entry removed by another thread.
+ */
+class MemoryEventNode
+	: public EventNode
+{
+public:
+	MemoryEventNode( MemoryEventStorage* storage, const std::string& key );
+	virtual ~MemoryEventNode();
+
+	virtual status_t	InitCheck() const;
+
+	virtual ssize_t	ReadAttr( const char* name, type_code type, void* buffer, size_t size );
+	virtual ssize_t	WriteAttr( const char* name, type_code type, const void* buffer, size_t size );
+	virtual status_t	RemoveAttr( const char* name );
+	virtual status_t	GetAttrInfo( const char* name, attr_info* info );
+	virtual status_t	RewindAttrs();
+	virtual status_t	GetNextAttrName( char* buffer );
+
+	virtual status_t	GetSize( off_t* size );
+	virtual ssize_t	ReadAt( off_t position, void* buffer, size_t size );
+	virtual status_t	SetData( const void* buffer, size_t size );
+
+protected:
+	virtual MemoryEventEntry*	_Entry();
+
+	MemoryEventStorage*			fStorage;
+	std::string						fKey;
+	std::vector< std::string >	fAttrNames;		//!< Filled by RewindAttrs().
+	size_t							fNextAttr;
+};
+
+
+#endif // _MEMORY_EVENT_STORAGE_H_
@@ -0,0 +1,749 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "BinaryRecord.h"
+#include "RecurrenceRule.h"
+
+
+
+/*!	\brief		How many periods in a row may have no occurrence.
+ *		\details		A rule that wants the 29th of February every 4 years, starting
+ *						in 2096, skips 2100; a rule that can't occur at all (the 31st of
+ *						April) is given up on after this number of periods.
+ */
+const		int32		kRecurrenceMaxEmptyPeriods	= 100;
+
+
+/*!	\brief		Version of the code of the rules written by Flatten().
+ *		\details		It changes only when older code can't read the new one.
+ */
+const		uint8		kRuleCodeVersion				= 1;
+
+/*!	\name		Opcodes of the code of a rule, with their operands.
+ */
+///@{
+const		uint8		kRuleOpEnd						= 0x00;	//!< No operand; ends the code.
+const		uint8		kRuleOpPeriod					= 0x01;	//!< \c uint8 RecurrenceFrequency.
+const		uint8		kRuleOpInterval				= 0x02;	//!< \c uint16 interval.
+const		uint8		kRuleOpWeekdays				= 0x03;	//!< \c uint8 mask of the weekdays.
+const		uint8		kRuleOpMonthDays				= 0x04;	//!< \c uint32 mask of the days of month.
+const		uint8		kRuleOpNthWeekday				= 0x05;	//!< \c int8 position of the weekday.
+const		uint8		kRuleOpMonths					= 0x06;	//!< \c uint16 mask of the months.
+const		uint8		kRuleOpCount					= 0x07;	//!< \c int32 number of occurrences.
+const		uint8		kRuleOpUntil					= 0x08;	//!< \c int32 last day.
+const		uint8		kRuleOpSkippable				= 0x80;	/*!< Flag of the opcodes followed by
+																		 *	  a \c uint8 operand length.	*/
+///@}
+
+/*!	\brief		Size of the operand of every opcode up to \c kRuleOpUntil.
+ */
+static const uint8	kRuleOperandSize[ kRuleOpUntil + 1 ] = { 0, 1, 2, 1, 4, 1, 2, 4, 4 };
+
+
+
+/*!	\brief		Division that rounds towards minus infinity.
+ *		\param[in]	divisor		Must be positive.
+ */
+static inline int32	FloorDiv( int32 dividend, int32 divisor )
+{
+	return ( dividend >= 0 ) ? ( dividend / divisor ) : -( ( -dividend + divisor - 1 ) / divisor );
+}	// <-- end of function FloorDiv
+
+
+
+/*!	\brief		Division that rounds towards plus infinity.
+ *		\param[in]	divisor		Must be positive.
+ */
+static inline int32	CeilDiv( int32 dividend, int32 divisor )
+{
+	return -FloorDiv( -dividend, divisor );
+}	// <-- end of function CeilDiv
+
+
+
+/*!	\brief		Little-endian operands of the code.
+ */
+static inline uint16	CodeUint16( const uint8* data )
+{
+	return ( uint16 )( data[ 0 ] | ( data[ 1 ] << 8 ) );
+}	// <-- end of function CodeUint16
+
+static inline uint32	CodeUint32( const uint8* data )
+{
+	return ( uint32 )data[ 0 ] | ( ( uint32 )data[ 1 ] << 8 ) |
+			 ( ( uint32 )data[ 2 ] << 16 ) | ( ( uint32 )data[ 3 ] << 24 );
+}	// <-- end of function CodeUint32
+
+
+
+/*!	\brief		Number of the lowest bit that is set.
+ *		\details		The bit is isolated and multiplied by a de Bruijn sequence, whose
+ *						top five bits are then different for each of the 32 bits.
+ *		\param[in]	mask		Must not be 0.
+ */
+static inline int32	LowestBit( uint32 mask )
+{
+	static const int32	kBitOfProduct[ 32 ] = {
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+
+	return kBitOfProduct[ ( ( mask & ( ~mask + 1 ) ) * 0x077CB531U ) >> 27 ];
+}	// <-- end of function LowestBit
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class RecurrenceRule
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - a rule with no limits.
+ */
+RecurrenceRule::RecurrenceRule( RecurrenceFrequency frequency, uint16 interval )
+	:
+	fFrequency( frequency ),
+	fInterval( interval ? interval : 1 ),
+	fWeekdays( 0 ),
+	fNthWeekday( 0 ),
+	fMonthDays( 0 ),
+	fMonths( 0 ),
+	fCount( 0 ),
+	fUntil( kRecurrenceForever ),
+	fCountAnchor( kRecurrenceNoDay ),
+	fCountLastDay( kRecurrenceNoDay )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+RecurrenceRule::~RecurrenceRule()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Day number of the Gregorian date.
+ *		\param[in]	year		Full year, e.g. 2011.
+ *		\param[in]	month		1 to 12.
+ *		\param[in]	day		1 to 31.
+ *		\returns		Number of days since January 1st, 1970; negative before it.
+ */
+int32		RecurrenceRule::DayFromDate( int32 year, int32 month, int32 day )
+{
+	int32		era, yearOfEra, dayOfYear, dayOfEra;
+
+	// The year starts in March, so the leap day is the last one
+	year -= ( month <= 2 ) ? 1 : 0;
+	era = FloorDiv( year, 400 );
+	yearOfEra = year - era * 400;
+	dayOfYear = ( 153 * ( month + ( month > 2 ? -3 : 9 ) ) + 2 ) / 5 + day - 1;
+	dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}	// <-- end of function RecurrenceRule::DayFromDate
+
+
+
+/*!	\brief		Gregorian date of the day number; the reverse of DayFromDate().
+ */
+void		RecurrenceRule::DateFromDay( int32 dayNumber, int32* year, int32* month, int32* day )
+{
+	int32		era, dayOfEra, yearOfEra, dayOfYear, shiftedMonth, tempMonth;
+
+	dayNumber += 719468;
+	era = FloorDiv( dayNumber, 146097 );
+	dayOfEra = dayNumber - era * 146097;
+	yearOfEra = ( dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096 ) / 365;
+	dayOfYear = dayOfEra - ( 365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100 );
+	shiftedMonth = ( 5 * dayOfYear + 2 ) / 153;
+	tempMonth = shiftedMonth + ( shiftedMonth < 10 ? 3 : -9 );
+
+	if ( year ) { *year = yearOfEra + era * 400 + ( tempMonth <= 2 ? 1 : 0 ); }
+	if ( month ) { *month = tempMonth; }
+	if ( day ) { *day = dayOfYear - ( 153 * shiftedMonth + 2 ) / 5 + 1; }
+}	// <-- end of function RecurrenceRule::DateFromDay
+
+
+
+/*!	\brief		Weekday of the day number: 0 is Sunday, 6 is Saturday.
+ */
+int32		RecurrenceRule::WeekdayOfDay( int32 dayNumber )
+{
+	// January 1st, 1970 was Thursday
+	return dayNumber - FloorDiv( dayNumber + 4, 7 ) * 7 + 4;
+}	// <-- end of function RecurrenceRule::WeekdayOfDay
+
+
+
+/*!	\brief		Number of days in the Gregorian month.
+ */
+int32		RecurrenceRule::DaysInMonth( int32 year, int32 month )
+{
+	static const int32	kDays[ 12 ] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	if ( month == 2 && ( year % 4 == 0 ) && ( year % 100 != 0 || year % 400 == 0 ) ) {
+		return 29;
+	}
+	return kDays[ ( month - 1 ) % 12 ];
+}	// <-- end of function RecurrenceRule::DaysInMonth
+
+
+
+/*!	\brief		Set the mask to the year, with no day set.
+ */
+void		RecurrenceRule::InitYearMask( int32 year, RecurrenceYearMask* mask )
+{
+	if ( !mask ) { return; }
+
+	mask->year = year;
+	mask->firstDay = DayFromDate( year, 1, 1 );
+	mask->days = DayFromDate( year + 1, 1, 1 ) - mask->firstDay;
+	for ( int32 i = 0; i < kRecurrenceYearMaskWords; ++i ) {
+		mask->bits[ i ] = 0;
+	}
+}	// <-- end of function RecurrenceRule::InitYearMask
+
+
+
+/*!	\brief		The first occurrence on the day or after it.
+ *		\param[in]	startDay		The start of the Event.
+ *		\param[in]	fromDay		The first day that may be returned.
+ *		\returns		The day of the occurrence, or \c kRecurrenceNoDay if the rule
+ *						ended before it.
+ */
+int32		RecurrenceRule::NextDayOnOrAfter( int32 startDay, int32 fromDay ) const
+{
+	int32		day;
+
+	if ( fromDay > fUntil ) { return kRecurrenceNoDay; }
+	if ( fromDay < startDay ) { fromDay = startDay; }
+
+	day = _NextDay( startDay, fromDay );
+	if ( day == kRecurrenceNoDay || day > fUntil ) {
+		return kRecurrenceNoDay;
+	}
+	if ( fCount > 0 && day > _LastCountedDay( startDay ) ) {
+		return kRecurrenceNoDay;
+	}
+	return day;
+}	// <-- end of function RecurrenceRule::NextDayOnOrAfter
+
+
+
+/*!	\brief		Check whether the rule occurs on the day.
+ */
+bool		RecurrenceRule::Matches( int32 startDay, int32 day ) const
+{
+	return ( day >= startDay && NextDayOnOrAfter( startDay, day ) == day );
+}	// <-- end of function RecurrenceRule::Matches
+
+
+
+/*!	\brief		All the days in the range the rule occurs on.
+ *		\details		The days of a rule with a fixed step are filled by one loop with
+ *						no dependency between the iterations, which the compiler may
+ *						vectorize. The days of the other rules are found one by one.
+ *		\param[in]	fromDay		First day of the range.
+ *		\param[in]	toDay			The day after the range.
+ *		\param[out]	out			Receives the days, in ascending order.
+ *		\param[in]	capacity		Size of \c out.
+ *		\returns		Number of the days written.
+ */
+int32		RecurrenceRule::ExpandDays( int32 startDay, int32 fromDay, int32 toDay,
+										 int32* out, int32 capacity ) const
+{
+	int32		day, lastDay, step, count = 0;
+
+	if ( !out || capacity <= 0 || fromDay >= toDay ) { return 0; }
+
+	day = NextDayOnOrAfter( startDay, fromDay );
+	if ( day == kRecurrenceNoDay || day >= toDay ) { return 0; }
+
+	if ( ( step = _FixedStep() ) > 0 )
+	{
+		lastDay = toDay - 1;
+		if ( fUntil < lastDay ) { lastDay = fUntil; }
+		if ( fCount > 0 && _LastCountedDay( startDay ) < lastDay ) {
+			lastDay = _LastCountedDay( startDay );
+		}
+
+		count = ( lastDay - day ) / step + 1;
+		if ( count > capacity ) { count = capacity; }
+		for ( int32 i = 0; i < count; ++i ) {
+			out[ i ] = day + i * step;
+		}
+		return count;
+	}
+
+	while ( day != kRecurrenceNoDay && day < toDay && count < capacity ) {
+		out[ count++ ] = day;
+		day = NextDayOnOrAfter( startDay, day + 1 );
+	}
+	return count;
+}	// <-- end of function RecurrenceRule::ExpandDays
+
+
+
+/*!	\brief		Set the bits of the days of the mask's year the rule occurs on.
+ *		\details		The bits that are already set stay set, so the mask of several
+ *						rules is built by adding them one after another.
+ */
+void		RecurrenceRule::AddToYearMask( int32 startDay, RecurrenceYearMask* mask ) const
+{
+	int32		days[ 366 ];
+	int32		count, offset;
+
+	if ( !mask || mask->year == kRecurrenceNoDay ) { return; }
+
+	count = ExpandDays( startDay, mask->firstDay, mask->firstDay + mask->days, days, 366 );
+	for ( int32 i = 0; i < count; ++i ) {
+		offset = days[ i ] - mask->firstDay;
+		mask->bits[ offset >> 5 ] |= ( uint32 )1 << ( offset & 31 );
+	}
+}	// <-- end of function RecurrenceRule::AddToYearMask
+
+
+
+/*!	\brief		The first occurrence on the day or after it, without the limits.
+ */
+int32		RecurrenceRule::_NextDay( int32 startDay, int32 fromDay ) const
+{
+	switch ( fFrequency )
+	{
+		case kRecurrenceDaily:
+			return _NextDaily( startDay, fromDay );
+		case kRecurrenceWeekly:
+			return _NextWeekly( startDay, fromDay );
+		case kRecurrenceMonthly:
+			return _NextMonthly( startDay, fromDay );
+		case kRecurrenceYearly:
+			return _NextYearly( startDay, fromDay );
+		default:
+			return kRecurrenceNoDay;
+	};
+}	// <-- end of function RecurrenceRule::_NextDay
+
+
+
+/*!	\brief		Every \c fInterval days, optionally only on some weekdays.
+ *		\details		The weekdays of the days the rule steps on repeat every 7 steps.
+ */
+int32		RecurrenceRule::_NextDaily( int32 startDay, int32 fromDay ) const
+{
+	int32		day = startDay + CeilDiv( fromDay - startDay, fInterval ) * fInterval;
+
+	if ( fWeekdays == 0 ) { return day; }
+
+	for ( int32 i = 0; i < 7; ++i, day += fInterval ) {
+		if ( fWeekdays & ( 1 << WeekdayOfDay( day ) ) ) {
+			return day;
+		}
+	}
+	return kRecurrenceNoDay;
+}	// <-- end of function RecurrenceRule::_NextDaily
+
+
+
+/*!	\brief		Some weekdays of every \c fInterval weeks.
+ *		\details		The weeks start on Monday; the first week is the one of the start.
+ */
+int32		RecurrenceRule::_NextWeekly( int32 startDay, int32 fromDay ) const
+{
+	uint8		weekdays = fWeekdays ? fWeekdays : ( uint8 )( 1 << WeekdayOfDay( startDay ) );
+	int32		firstWeek = startDay - ( WeekdayOfDay( startDay ) + 6 ) % 7;
+	int32		week = FloorDiv( fromDay - firstWeek, 7 );
+	int32		weekStart, day;
+
+	// The week of the day, if it's one of the rule, and the next one of the rule
+	for ( int32 i = 0; i < 2; ++i )
+	{
+		if ( week % fInterval != 0 ) {
+			week = CeilDiv( week, fInterval ) * fInterval;
+		}
+		weekStart = firstWeek + week * 7;
+		for ( day = ( fromDay > weekStart ) ? fromDay : weekStart; day < weekStart + 7; ++day ) {
+			if ( weekdays & ( 1 << WeekdayOfDay( day ) ) ) {
+				return day;
+			}
+		}
+		week += fInterval;
+	}
+	return kRecurrenceNoDay;
+}	// <-- end of function RecurrenceRule::_NextWeekly
+
+
+
+/*!	\brief		Some days of every \c fInterval months.
+ */
+int32		RecurrenceRule::_NextMonthly( int32 startDay, int32 fromDay ) const
+{
+	int32		startYear, startMonth, startMonthDay, fromYear, fromMonth, fromMonthDay;
+	int32		firstMonth, fromMonthIndex, monthIndex, year, month, day;
+	uint8		weekdays;
+	uint32	monthDays;
+
+	DateFromDay( startDay, &startYear, &startMonth, &startMonthDay );
+	DateFromDay( fromDay, &fromYear, &fromMonth, &fromMonthDay );
+	_MonthDefaults( startDay, startMonthDay, &weekdays, &monthDays );
+
+	// Months are counted from year 0, so they may be simply added
+	firstMonth = startYear * 12 + startMonth - 1;
+	fromMonthIndex = fromYear * 12 + fromMonth - 1;
+	monthIndex = firstMonth + CeilDiv( fromMonthIndex - firstMonth, fInterval ) * fInterval;
+	if ( monthIndex != fromMonthIndex ) {
+		fromMonthDay = 1;
+	}
+
+	for ( int32 i = 0; i < kRecurrenceMaxEmptyPeriods; ++i )
+	{
+		year = FloorDiv( monthIndex, 12 );
+		month = monthIndex - year * 12 + 1;
+		day = _FirstDayInMonth( year, month, fromMonthDay, weekdays, monthDays );
+		if ( day != kRecurrenceNoDay ) {
+			return day;
+		}
+		monthIndex += fInterval;
+		fromMonthDay = 1;
+	}
+	return kRecurrenceNoDay;
+}	// <-- end of function RecurrenceRule::_NextMonthly
+
+
+
+/*!	\brief		Some days of some months of every \c fInterval years.
+ */
+int32		RecurrenceRule::_NextYearly( int32 startDay, int32 fromDay ) const
+{
+	int32		startYear, startMonth, startMonthDay, fromYear, fromMonth, fromMonthDay;
+	int32		year, month, day, firstMonthDay;
+	uint8		weekdays;
+	uint16	months;
+	uint32	monthDays;
+
+	DateFromDay( startDay, &startYear, &startMonth, &startMonthDay );
+	DateFromDay( fromDay, &fromYear, &fromMonth, &fromMonthDay );
+	_MonthDefaults( startDay, startMonthDay, &weekdays, &monthDays );
+	months = fMonths ? fMonths : ( uint16 )( 1 << ( startMonth - 1 ) );
+
+	year = startYear + CeilDiv( fromYear - startYear, fInterval ) * fInterval;
+	for ( int32 i = 0; i < kRecurrenceMaxEmptyPeriods; ++i, year += fInterval )
+	{
+		for ( month = 1; month <= 12; ++month )
+		{
+			if ( !( months & ( 1 << ( month - 1 ) ) ) ) { continue; }
+			if ( year == fromYear && month < fromMonth ) { continue; }
+
+			firstMonthDay = ( year == fromYear && month == fromMonth ) ? fromMonthDay : 1;
+			day = _FirstDayInMonth( year, month, firstMonthDay, weekdays, monthDays );
+			if ( day != kRecurrenceNoDay ) {
+				return day;
+			}
+		}
+	}
+	return kRecurrenceNoDay;
+}	// <-- end of function RecurrenceRule::_NextYearly
+
+
+
+/*!	\brief		The weekdays and the days of month of a monthly or yearly rule,
+ *					with the ones of the start if they are not set.
+ *		\details		They are found once per query, not once per month.
+ */
+void		RecurrenceRule::_MonthDefaults( int32 startDay, int32 startMonthDay,
+												  uint8* weekdays, uint32* monthDays ) const
+{
+	*weekdays = fWeekdays ? fWeekdays : ( uint8 )( 1 << WeekdayOfDay( startDay ) );
+	*monthDays = fMonthDays ? fMonthDays : ( uint32 )1 << startMonthDay;
+}	// <-- end of function RecurrenceRule::_MonthDefaults
+
+
+
+/*!	\brief		The first day of the month, not before the given one, the rule
+ *					occurs on.
+ *		\details		The days of month are found in the mask without a loop: the
+ *						days before \c fromDay and after the end of the month are
+ *						cleared, and the lowest bit left is the day.
+ *		\param[in]	fromDay		Day of the month, 1 to 31.
+ *		\param[in]	weekdays		The weekdays of the nth weekday; see _MonthDefaults().
+ *		\param[in]	monthDays	The days of month; see _MonthDefaults().
+ *		\returns		Day number, or \c kRecurrenceNoDay if there's none.
+ */
+int32		RecurrenceRule::_FirstDayInMonth( int32 year, int32 month, int32 fromDay,
+														uint8 weekdays, uint32 monthDays ) const
+{
+	int32		daysInMonth = DaysInMonth( year, month );
+	int32		monthStart = DayFromDate( year, month, 1 );
+	int32		firstWeekday, lastWeekday, day, best = 0;
+	uint32	candidates;
+
+	if ( fromDay > daysInMonth ) { return kRecurrenceNoDay; }
+
+	if ( fNthWeekday != 0 )
+	{
+		// The nth (or the last) of each weekday of the rule - the earliest one wins
+		firstWeekday = WeekdayOfDay( monthStart );
+		lastWeekday = ( firstWeekday + daysInMonth - 1 ) % 7;
+		for ( int32 weekday = 0; weekday < 7; ++weekday )
+		{
+			if ( !( weekdays & ( 1 << weekday ) ) ) { continue; }
+			if ( fNthWeekday > 0 ) {
+				day = 1 + ( weekday - firstWeekday + 7 ) % 7 + ( fNthWeekday - 1 ) * 7;
+			} else {
+				day = daysInMonth - ( lastWeekday - weekday + 7 ) % 7 + ( fNthWeekday + 1 ) * 7;
+			}
+			if ( day >= fromDay && day >= 1 && day <= daysInMonth && ( best == 0 || day < best ) ) {
+				best = day;
+			}
+		}
+		return ( best != 0 ) ? monthStart + best - 1 : kRecurrenceNoDay;
+	}
+
+	// Bits fromDay to daysInMonth; bit 0, the last day, is cleared as well
+	candidates = monthDays & ~( ( ( uint32 )1 << fromDay ) - 1 );
+	if ( daysInMonth < 31 ) {
+		candidates &= ( ( uint32 )1 << ( daysInMonth + 1 ) ) - 1;
+	}
+	if ( candidates != 0 ) {
+		return monthStart + LowestBit( candidates ) - 1;
+	}
+	if ( monthDays & kRecurrenceLastDayOfMonth ) {
+		return monthStart + daysInMonth - 1;
+	}
+	return kRecurrenceNoDay;
+}	// <-- end of function RecurrenceRule::_FirstDayInMonth
+
+
+
+/*!	\brief		The day of the last occurrence the count allows.
+ *		\details		The occurrences are walked once per start day; the result is
+ *						remembered until the rule or the start day change.
+ */
+int32		RecurrenceRule::_LastCountedDay( int32 startDay ) const
+{
+	int32		day;
+
+	if ( fCountAnchor == startDay ) { return fCountLastDay; }
+
+	day = _NextDay( startDay, startDay );
+	for ( int32 i = 1; i < fCount && day != kRecurrenceNoDay && day <= fUntil; ++i ) {
+		day = _NextDay( startDay, day + 1 );
+	}
+	fCountAnchor = startDay;
+	fCountLastDay = day;
+	return day;
+}	// <-- end of function RecurrenceRule::_LastCountedDay
+
+
+
+/*!	\brief		Distance between the days of a rule that occurs on every nth day.
+ *		\returns		The distance, or 0 if the days are not evenly spaced.
+ */
+int32		RecurrenceRule::_FixedStep() const
+{
+	switch ( fFrequency )
+	{
+		case kRecurrenceDaily:
+			if ( fWeekdays == 0 || fWeekdays == 0x7F ) { return fInterval; }
+			break;
+		case kRecurrenceWeekly:
+			// One weekday - the one of the start, if none is set
+			if ( ( fWeekdays & ( fWeekdays - 1 ) ) == 0 ) { return 7 * fInterval; }
+			break;
+		default:
+			break;
+	};
+	return 0;
+}	// <-- end of function RecurrenceRule::_FixedStep
+
+
+
+/*!	\brief		Write the rule into the record, as its code.
+ *		\details		The code is the version byte, then one instruction per field
+ *						that differs from the default, then \c kRuleOpEnd. Every
+ *						instruction is an opcode followed by its operand. The period is
+ *						always written.
+ */
+status_t		RecurrenceRule::Flatten( RecordWriter* out ) const
+{
+	if ( !out ) { return B_NO_INIT; }
+
+	out->AddUint8( kRuleCodeVersion );
+	out->AddUint8( kRuleOpPeriod );
+	out->AddUint8( ( uint8 )fFrequency );
+	if ( fInterval != 1 ) {
+		out->AddUint8( kRuleOpInterval );
+		out->AddUint16( fInterval );
+	}
+	if ( fWeekdays != 0 ) {
+		out->AddUint8( kRuleOpWeekdays );
+		out->AddUint8( fWeekdays );
+	}
+	if ( fMonthDays != 0 ) {
+		out->AddUint8( kRuleOpMonthDays );
+		out->AddUint32( fMonthDays );
+	}
+	if ( fNthWeekday != 0 ) {
+		out->AddUint8( kRuleOpNthWeekday );
+		out->AddUint8( ( uint8 )fNthWeekday );
+	}
+	if ( fMonths != 0 ) {
+		out->AddUint8( kRuleOpMonths );
+		out->AddUint16( fMonths );
+	}
+	if ( fCount != 0 ) {
+		out->AddUint8( kRuleOpCount );
+		out->AddInt32( fCount );
+	}
+	if ( fUntil != kRecurrenceForever ) {
+		out->AddUint8( kRuleOpUntil );
+		out->AddInt32( fUntil );
+	}
+	out->AddUint8( kRuleOpEnd );
+	return out->InitCheck();
+}	// <-- end of function RecurrenceRule::Flatten
+
+
+
+/*!	\brief		Read the rule from its code, written by Flatten().
+ *		\details		The code is run once, into the fields of the rule; evaluating the
+ *						rule afterwards doesn't touch the code. See _RunCode().
+ *		\returns		\c B_OK, \c B_NOT_SUPPORTED for a newer version of the code, or
+ *						\c B_BAD_DATA if the code is damaged. The rule is left as it was
+ *						if the code can't be read.
+ */
+status_t		RecurrenceRule::Unflatten( RecordReader* in )
+{
+	RecurrenceRule	decoded;
+	const void*	code;
+	size_t		position, size, used = 0;
+	status_t		status;
+
+	if ( !in ) { return B_NO_INIT; }
+
+	position = in->Position();
+	size = in->Remaining();
+	if ( in->ReadBytes( &code, size ) != B_OK || size == 0 ) { return B_BAD_DATA; }
+
+	status = decoded._RunCode( ( const uint8* )code, size, &used );
+	if ( status != B_OK ) {
+		in->Seek( position );
+		return status;
+	}
+	in->Seek( position + used );
+
+	fFrequency = decoded.fFrequency;
+	fInterval = decoded.fInterval;
+	fWeekdays = decoded.fWeekdays;
+	fNthWeekday = decoded.fNthWeekday;
+	fMonthDays = decoded.fMonthDays;
+	fMonths = decoded.fMonths;
+	fCount = decoded.fCount;
+	fUntil = decoded.fUntil;
+	_Changed();
+	return B_OK;
+}	// <-- end of function RecurrenceRule::Unflatten
+
+
+
+/*!	\brief		The first occurrence on the day or after it, straight from the code.
+ *		\details		The code is interpreted on every call, so the rules may be
+ *						evaluated right where they are stored - in the Event record -
+ *						without creating the rules. It's the same as Unflatten()
+ *						followed by NextDayOnOrAfter(), but with no reader and no copy.
+ *
+ *						A rule limited by count walks its occurrences on every call,
+ *						since there's nowhere to remember its last day; such rules
+ *						should be unflattened if they are evaluated often.
+ *		\param[in]	code		The code, written by Flatten().
+ *		\param[in]	size		Size of the code.
+ *		\returns		The day of the occurrence, or \c kRecurrenceNoDay if the rule
+ *						ended before it or the code can't be read.
+ */
+int32		RecurrenceRule::NextDayInCode( const void* code, size_t size,
+												  int32 startDay, int32 fromDay )
+{
+	RecurrenceRule	rule;
+	size_t			used;
+
+	if ( !code ) { return kRecurrenceNoDay; }
+	if ( rule._RunCode( ( const uint8* )code, size, &used ) != B_OK ) {
+		return kRecurrenceNoDay;
+	}
+	return rule.NextDayOnOrAfter( startDay, fromDay );
+}	// <-- end of function RecurrenceRule::NextDayInCode
+
+
+
+/*!	\brief		Run the code of a rule, setting the fields of this one.
+ *		\details		Every instruction sets one field; \c kRuleOpEnd stops. Unknown
+ *						instructions with an operand length are skipped, so newer code
+ *						may add them without changing the version. The fields the code
+ *						doesn't set are not touched - the code is run on a new rule.
+ *		\param[out]	used		Size of the code, up to and including \c kRuleOpEnd.
+ *		\returns		\c B_OK, \c B_NOT_SUPPORTED for a newer version of the code, or
+ *						\c B_BAD_DATA if the code is damaged.
+ */
+status_t		RecurrenceRule::_RunCode( const uint8* code, size_t size, size_t* used )
+{
+	const uint8*	operand;
+	size_t		position = 1;
+	uint8			opcode;
+
+	if ( size == 0 ) { return B_BAD_DATA; }
+	if ( code[ 0 ] != kRuleCodeVersion ) { return B_NOT_SUPPORTED; }
+
+	while ( position < size )
+	{
+		opcode = code[ position++ ];
+		if ( opcode > kRuleOpUntil ) {
+			// Skip the operand of an unknown instruction
+			if ( !( opcode & kRuleOpSkippable ) || position >= size ) { return B_BAD_DATA; }
+			position += 1 + code[ position ];
+			continue;
+		}
+		if ( position + kRuleOperandSize[ opcode ] > size ) { return B_BAD_DATA; }
+		operand = code + position;
+		position += kRuleOperandSize[ opcode ];
+
+		switch ( opcode )
+		{
+			case kRuleOpEnd:
+				*used = position;
+				return B_OK;
+			case kRuleOpPeriod:
+				if ( operand[ 0 ] > kRecurrenceYearly ) { return B_BAD_DATA; }
+				fFrequency = ( RecurrenceFrequency )operand[ 0 ];
+				break;
+			case kRuleOpInterval:
+				fInterval = CodeUint16( operand );
+				if ( fInterval == 0 ) { fInterval = 1; }
+				break;
+			case kRuleOpWeekdays:
+				fWeekdays = operand[ 0 ] & 0x7F;
+				break;
+			case kRuleOpMonthDays:
+				fMonthDays = CodeUint32( operand );
+				break;
+			case kRuleOpNthWeekday:
+				fNthWeekday = ( int8 )operand[ 0 ];
+				break;
+			case kRuleOpMonths:
+				fMonths = CodeUint16( operand ) & 0x0FFF;
+				break;
+			case kRuleOpCount:
+				fCount = ( int32 )CodeUint32( operand );
+				if ( fCount < 0 ) { fCount = 0; }
+				break;
+			case kRuleOpUntil:
+				fUntil = ( int32 )CodeUint32( operand );
+				break;
+		};
+	}
+	// The code ended without kRuleOpEnd
+	return B_BAD_DATA;
+}	// <-- end of function RecurrenceRule::_RunCode
+
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _RECURRENCE_RULE_H_
+#define _RECURRENCE_RULE_H_
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <limits.h>
+
+
+class RecordReader;
+class RecordWriter;
+
+
+/*!	\brief		How often the rule repeats.
+ */
+enum RecurrenceFrequency {
+	kRecurrenceDaily = 0,
+	kRecurrenceWeekly,
+	kRecurrenceMonthly,
+	kRecurrenceYearly
+};
+
+
+/*!	\brief		Returned instead of a day when there's no such occurrence.
+ */
+const		int32		kRecurrenceNoDay				= INT_MIN;
+
+/*!	\brief		The "until" of a rule that never ends.
+ */
+const		int32		kRecurrenceForever			= INT_MAX;
+
+/*!	\brief		In the mask of the days of month - the last day, whatever its number.
+ *		\details		Bits 1 to 31 of the mask are the days with these numbers.
+ */
+const		uint32	kRecurrenceLastDayOfMonth	= 0x00000001;
+
+/*!	\brief		The nth weekday that means "the last one in the month".
+ */
+const		int8		kRecurrenceLastWeek			= -1;
+
+/*!	\brief		Number of the 32-bit words in RecurrenceYearMask - enough for 366 days.
+ */
+const		int32		kRecurrenceYearMaskWords	= 12;
+
+
+
+/*!	\brief		The days of one year a rule, or a set of rules, occurs on.
+ *		\details		Bit \c n (bit \c n % 32 of word \c n / 32) is the day
+ *						\c firstDay + \c n. Masks of the same year are combined word by
+ *						word.
+ */
+struct RecurrenceYearMask {
+	int32		year;			//!< \c kRecurrenceNoDay if the mask is not set.
+	int32		firstDay;	//!< Day number of January 1st.
+	int32		days;			//!< 365 or 366.
+	uint32	bits[ kRecurrenceYearMaskWords ];
+};
+
+
+
+/*---------------------------------------------------------------------------
+ *					Declaration of class RecurrenceRule
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		A rule that repeats an Event.
+ *		\details		The rule is anchored to the start day of the Event: the periods
+ *						are counted from it, and no occurrence is before it. The fields
+ *						that are not set take their value from the start day:
+ *						\li	Weekly rules repeat on the weekday of the start.
+ *						\li	Monthly and yearly rules repeat on the day of month of the
+ *							start, unless the days of month or the nth weekday are set.
+ *						\li	Yearly rules repeat in the month of the start.
+ *						The weekdays of a daily rule only filter its days.
+ *
+ *						The days are numbered from January 1st, 1970, in the Gregorian
+ *						calendar. The next occurrence is calculated from the day, not
+ *						found by stepping over the days: a rule that can't occur in a
+ *						period (the 31st in a month of 30 days) skips it.
+ *
+ *						A rule limited by count ends on the day of its last occurrence;
+ *						the day is calculated once, and remembered.
+ */
+class RecurrenceRule
+{
+public:
+	RecurrenceRule( RecurrenceFrequency frequency = kRecurrenceDaily, uint16 interval = 1 );
+	virtual ~RecurrenceRule();
+
+	/*!	\name		Definition of the rule
+	 */
+	///@{
+	virtual RecurrenceFrequency	GetFrequency() const { return fFrequency; }
+	virtual void		SetFrequency( RecurrenceFrequency frequency ) { fFrequency = frequency; _Changed(); }
+	virtual uint16		GetInterval() const { return fInterval; }
+	virtual void		SetInterval( uint16 interval ) { fInterval = ( interval ? interval : 1 ); _Changed(); }
+
+	//! Bit 0 is Sunday, bit 6 is Saturday.
+	virtual uint8		GetWeekdays() const { return fWeekdays; }
+	virtual void		SetWeekdays( uint8 mask ) { fWeekdays = ( mask & 0x7F ); _Changed(); }
+	//! See \c kRecurrenceLastDayOfMonth.
+	virtual uint32		GetMonthDays() const { return fMonthDays; }
+	virtual void		SetMonthDays( uint32 mask ) { fMonthDays = mask; _Changed(); }
+	//! 1 to 5, or \c kRecurrenceLastWeek; 0 if not used. The weekdays are set separately.
+	virtual int8		GetNthWeekday() const { return fNthWeekday; }
+	virtual void		SetNthWeekday( int8 nth ) { fNthWeekday = nth; _Changed(); }
+	//! Bit 0 is January.
+	virtual uint16		GetMonths() const { return fMonths; }
+	virtual void		SetMonths( uint16 mask ) { fMonths = ( mask & 0x0FFF ); _Changed(); }
+
+	//! Number of the occurrences; 0 if not limited.
+	virtual int32		GetCount() const { return fCount; }
+	virtual void		SetCount( int32 count ) { fCount = ( count > 0 ? count : 0 ); _Changed(); }
+	//! The last day the rule may occur on; \c kRecurrenceForever if not limited.
+	virtual int32		GetUntil() const { return fUntil; }
+	virtual void		SetUntil( int32 day ) { fUntil = day; _Changed(); }
+	///@}
+
+	/*!	\name		Evaluation
+	 */
+	///@{
+	virtual int32		NextDayOnOrAfter( int32 startDay, int32 fromDay ) const;
+	virtual bool		Matches( int32 startDay, int32 day ) const;
+	virtual int32		ExpandDays( int32 startDay, int32 fromDay, int32 toDay,
+										int32* out, int32 capacity ) const;
+	virtual void		AddToYearMask( int32 startDay, RecurrenceYearMask* mask ) const;
+	///@}
+
+	/*!	\name		Storage
+	 */
+	///@{
+	virtual status_t	Flatten( RecordWriter* out ) const;
+	virtual status_t	Unflatten( RecordReader* in );
+	static  int32		NextDayInCode( const void* code, size_t size,
+											  int32 startDay, int32 fromDay );
+	///@}
+
+	/*!	\name		Day arithmetic
+	 */
+	///@{
+	static  int32		DayFromDate( int32 year, int32 month, int32 day );
+	static  void		DateFromDay( int32 dayNumber, int32* year, int32* month, int32* day );
+	static  int32		WeekdayOfDay( int32 dayNumber );
+	static  int32		DaysInMonth( int32 year, int32 month );
+	static  void		InitYearMask( int32 year, RecurrenceYearMask* mask );
+	///@}
+
+protected:
+	virtual void		_Changed() { fCountAnchor = kRecurrenceNoDay; }
+	virtual int32		_NextDay( int32 startDay, int32 fromDay ) const;
+	virtual int32		_NextDaily( int32 startDay, int32 fromDay ) const;
+	virtual int32		_NextWeekly( int32 startDay, int32 fromDay ) const;
+	virtual int32		_NextMonthly( int32 startDay, int32 fromDay ) const;
+	virtual int32		_NextYearly( int32 startDay, int32 fromDay ) const;
+	virtual void		_MonthDefaults( int32 startDay, int32 startMonthDay,
+											 uint8* weekdays, uint32* monthDays ) const;
+	virtual int32		_FirstDayInMonth( int32 year, int32 month, int32 fromDay,
+												uint8 weekdays, uint32 monthDays ) const;
+	virtual int32		_LastCountedDay( int32 startDay ) const;
+	virtual int32		_FixedStep() const;
+	virtual status_t	_RunCode( const uint8* code, size_t size, size_t* used );
+
+	RecurrenceFrequency	fFrequency;
+	uint16		fInterval;
+	uint8			fWeekdays;
+	int8			fNthWeekday;
+	uint32		fMonthDays;
+	uint16		fMonths;
+	int32			fCount;
+	int32			fUntil;
+
+	mutable int32	fCountAnchor;		//!< Start day \c fCountLastDay was calculated for.
+	mutable int32	fCountLastDay;		//!< Day of the last occurrence allowed by the count.
+};	// <-- end of class RecurrenceRule
+
+
+#endif // _RECURRENCE_RULE_H_
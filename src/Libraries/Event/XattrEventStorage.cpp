@@ -0,0 +1,435 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+#ifdef __linux__
+
+// Project includes
+#include "XattrEventStorage.h"
+
+// OS includes
+#include <ByteOrder.h>
+#include <Errors.h>
+
+// POSIX includes
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+
+
+/*!	\brief		Prefix of the extended attributes that belong to the user.
+ */
+static const char		kXattrPrefix[] = "user.";
+static const size_t	kXattrPrefixLength = sizeof( kXattrPrefix ) - 1;
+
+
+/*!	\brief		Size of the type that precedes every value.
+ */
+static const size_t	kXattrTypeSize = sizeof( uint32 );
+
+
+
+/*!	\brief		Translate the last error of a system call.
+ */
+static status_t	XattrError()
+{
+	if ( errno == ENODATA ) {
+		return B_ENTRY_NOT_FOUND;
+	}
+	return B_FROM_POSIX_ERROR( errno );
+}	// <-- end of function XattrError
+
+
+
+/*!	\brief		Name of the extended attribute of an Event attribute.
+ */
+static std::string	XattrName( const char* name )
+{
+	return std::string( kXattrPrefix ) + name;
+}	// <-- end of function XattrName
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class XattrEventStorage
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\param[in]	directory	Where the Event files are.
+ */
+XattrEventStorage::XattrEventStorage( const char* directory )
+	:
+	fDirectory( directory ? directory : "." )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+XattrEventStorage::~XattrEventStorage()
+{
+}	// <-- end of destructor
+
+
+
+std::string		XattrEventStorage::_PathOf( const char* key ) const
+{
+	return fDirectory + "/" + key;
+}	// <-- end of function XattrEventStorage::_PathOf
+
+
+
+EventNode*		XattrEventStorage::Open( const char* key, uint32 openMode )
+{
+	if ( !key ) { return NULL; }
+	return new XattrEventNode( _PathOf( key ).c_str(), openMode );
+}	// <-- end of function XattrEventStorage::Open
+
+
+
+status_t		XattrEventStorage::Remove( const char* key )
+{
+	if ( !key ) { return B_BAD_VALUE; }
+	if ( unlink( _PathOf( key ).c_str() ) != 0 ) {
+		return XattrError();
+	}
+	return B_OK;
+}	// <-- end of function XattrEventStorage::Remove
+
+
+
+/*!	\brief		Find the Events whose time attribute is in the range.
+ *		\details		Every regular file in the directory is checked.
+ */
+status_t		XattrEventStorage::ListByRange( const char* attribute, int64 from, int64 to,
+														  std::vector< BString >* keys )
+{
+	DIR*				directory;
+	struct dirent*	entry;
+	int64				time;
+
+	if ( !attribute || !keys ) { return B_BAD_VALUE; }
+	if ( ( directory = opendir( fDirectory.c_str() ) ) == NULL ) {
+		return XattrError();
+	}
+
+	while ( ( entry = readdir( directory ) ) != NULL )
+	{
+		if ( entry->d_name[ 0 ] == '.' ) { continue; }
+
+		XattrEventNode	node( _PathOf( entry->d_name ).c_str(), B_READ_ONLY );
+		if ( node.InitCheck() != B_OK ) { continue; }
+
+		if ( node.ReadTimeAttr( attribute, &time ) == B_OK &&
+			  time >= from && time < to )
+		{
+			keys->push_back( BString( entry->d_name ) );
+		}
+	}
+	closedir( directory );
+	return B_OK;
+}	// <-- end of function XattrEventStorage::ListByRange
+
+
+
+/*---------------------------------------------------------------------------
+ *					Implementation of class XattrEventNode
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - opens the file.
+ */
+XattrEventNode::XattrEventNode( const char* path, uint32 openMode )
+	:
+	fFD( -1 ),
+	fInitStatus( B_NO_INIT ),
+	fNextAttr( 0 )
+{
+	struct stat		info;
+	int				flags;
+
+	switch ( openMode & O_ACCMODE )
+	{
+		case B_READ_WRITE:
+			flags = O_RDWR;
+			break;
+		case B_WRITE_ONLY:
+			flags = O_WRONLY;
+			break;
+		default:
+			flags = O_RDONLY;
+			break;
+	};
+	if ( openMode & B_CREATE_FILE ) { flags |= O_CREAT; }
+	if ( openMode & B_ERASE_FILE ) { flags |= O_TRUNC; }
+
+	if ( !path ) {
+		fInitStatus = B_BAD_VALUE;
+		return;
+	}
+	if ( ( fFD = open( path, flags, 0644 ) ) < 0 ) {
+		fInitStatus = XattrError();
+		return;
+	}
+	if ( fstat( fFD, &info ) != 0 || !S_ISREG( info.st_mode ) ) {
+		close( fFD );
+		fFD = -1;
+		fInitStatus = B_BAD_TYPE;
+		return;
+	}
+	fInitStatus = B_OK;
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - closes the file.
+ */
+XattrEventNode::~XattrEventNode()
+{
+	if ( fFD >= 0 ) {
+		close( fFD );
+	}
+}	// <-- end of destructor
+
+
+
+status_t		XattrEventNode::InitCheck() const
+{
+	return fInitStatus;
+}	// <-- end of function XattrEventNode::InitCheck
+
+
+
+status_t		XattrEventNode::Lock()
+{
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	return ( flock( fFD, LOCK_EX ) == 0 ) ? B_OK : XattrError();
+}	// <-- end of function XattrEventNode::Lock
+
+
+
+status_t		XattrEventNode::Unlock()
+{
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	return ( flock( fFD, LOCK_UN ) == 0 ) ? B_OK : XattrError();
+}	// <-- end of function XattrEventNode::Unlock
+
+
+
+/*!	\brief		Read an attribute.
+ *		\details		As in BFS, a value larger than the buffer is cut.
+ */
+ssize_t		XattrEventNode::ReadAttr( const char* name, type_code type, void* buffer, size_t size )
+{
+	std::string		xattrName;
+	ssize_t			readSize;
+
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	if ( !name || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	xattrName = XattrName( name );
+	fValueBuffer.resize( size + kXattrTypeSize );
+	readSize = fgetxattr( fFD, xattrName.c_str(), &fValueBuffer[ 0 ], fValueBuffer.size() );
+	if ( readSize < 0 && errno == ERANGE ) {
+		// The value is larger than the buffer - read all of it
+		if ( ( readSize = fgetxattr( fFD, xattrName.c_str(), NULL, 0 ) ) < 0 ) {
+			return XattrError();
+		}
+		fValueBuffer.resize( readSize );
+		readSize = fgetxattr( fFD, xattrName.c_str(), &fValueBuffer[ 0 ], fValueBuffer.size() );
+	}
+	if ( readSize < 0 ) {
+		return XattrError();
+	}
+	if ( ( size_t )readSize < kXattrTypeSize ) {
+		return B_BAD_DATA;
+	}
+
+	readSize -= kXattrTypeSize;
+	if ( ( size_t )readSize > size ) {
+		readSize = size;
+	}
+	memcpy( buffer, &fValueBuffer[ kXattrTypeSize ], readSize );
+	return readSize;
+}	// <-- end of function XattrEventNode::ReadAttr
+
+
+
+ssize_t		XattrEventNode::WriteAttr( const char* name, type_code type, const void* buffer, size_t size )
+{
+	uint32		storedType = B_HOST_TO_LENDIAN_INT32( ( uint32 )type );
+
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	if ( !name || ( !buffer && size != 0 ) ) { return B_BAD_VALUE; }
+
+	fValueBuffer.resize( size + kXattrTypeSize );
+	memcpy( &fValueBuffer[ 0 ], &storedType, kXattrTypeSize );
+	if ( size != 0 ) {
+		memcpy( &fValueBuffer[ kXattrTypeSize ], buffer, size );
+	}
+
+	if ( fsetxattr( fFD, XattrName( name ).c_str(), &fValueBuffer[ 0 ], fValueBuffer.size(), 0 ) != 0 ) {
+		return XattrError();
+	}
+	return ( ssize_t )size;
+}	// <-- end of function XattrEventNode::WriteAttr
+
+
+
+status_t		XattrEventNode::RemoveAttr( const char* name )
+{
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	if ( !name ) { return B_BAD_VALUE; }
+
+	if ( fremovexattr( fFD, XattrName( name ).c_str() ) != 0 ) {
+		return XattrError();
+	}
+	return B_OK;
+}	// <-- end of function XattrEventNode::RemoveAttr
+
+
+
+status_t		XattrEventNode::GetAttrInfo( const char* name, attr_info* info )
+{
+	uint32		storedType;
+	ssize_t		readSize;
+
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	if ( !name || !info ) { return B_BAD_VALUE; }
+
+	std::string	xattrName = XattrName( name );
+	if ( ( readSize = fgetxattr( fFD, xattrName.c_str(), NULL, 0 ) ) < 0 ) {
+		return XattrError();
+	}
+	if ( ( size_t )readSize < kXattrTypeSize ) {
+		return B_BAD_DATA;
+	}
+
+	// Only the type is read
+	fValueBuffer.resize( readSize );
+	if ( fgetxattr( fFD, xattrName.c_str(), &fValueBuffer[ 0 ], fValueBuffer.size() ) < 0 ) {
+		return XattrError();
+	}
+	memcpy( &storedType, &fValueBuffer[ 0 ], kXattrTypeSize );
+
+	info->type = B_LENDIAN_TO_HOST_INT32( storedType );
+	info->size = ( off_t )( readSize - kXattrTypeSize );
+	return B_OK;
+}	// <-- end of function XattrEventNode::GetAttrInfo
+
+
+
+/*!	\brief		Start listing the attributes.
+ *		\details		The whole list is read at once.
+ */
+status_t		XattrEventNode::RewindAttrs()
+{
+	ssize_t		listSize;
+
+	fAttrNames.clear();
+	fNextAttr = 0;
+	if ( fFD < 0 ) { return B_NO_INIT; }
+
+	if ( ( listSize = flistxattr( fFD, NULL, 0 ) ) < 0 ) {
+		return XattrError();
+	}
+	if ( listSize == 0 ) { return B_OK; }
+
+	fAttrNames.resize( listSize );
+	if ( ( listSize = flistxattr( fFD, &fAttrNames[ 0 ], fAttrNames.size() ) ) < 0 ) {
+		fAttrNames.clear();
+		return XattrError();
+	}
+	fAttrNames.resize( listSize );
+	return B_OK;
+}	// <-- end of function XattrEventNode::RewindAttrs
+
+
+
+/*!	\brief		Get the name of the next attribute.
+ *		\details		Only "user." attributes are listed, without the prefix.
+ *		\param[out]	buffer	At least \c B_ATTR_NAME_LENGTH bytes.
+ */
+status_t		XattrEventNode::GetNextAttrName( char* buffer )
+{
+	const char*		name;
+	size_t			length;
+
+	if ( !buffer ) { return B_BAD_VALUE; }
+
+	while ( fNextAttr < fAttrNames.size() )
+	{
+		name = &fAttrNames[ fNextAttr ];
+		length = strnlen( name, fAttrNames.size() - fNextAttr );
+		fNextAttr += length + 1;
+
+		if ( length <= kXattrPrefixLength ||
+			  length - kXattrPrefixLength >= B_ATTR_NAME_LENGTH ||
+			  strncmp( name, kXattrPrefix, kXattrPrefixLength ) != 0 )
+		{
+			continue;
+		}
+		memcpy( buffer, name + kXattrPrefixLength, length - kXattrPrefixLength );
+		buffer[ length - kXattrPrefixLength ] = '\0';
+		return B_OK;
+	}
+	return B_ENTRY_NOT_FOUND;
+}	// <-- end of function XattrEventNode::GetNextAttrName
+
+
+
+status_t		XattrEventNode::GetSize( off_t* size )
+{
+	struct stat		info;
+
+	if ( fFD < 0 ) { return B_NO_INIT; }
+	if ( !size ) { return B_BAD_VALUE; }
+
+	if ( fstat( fFD, &info ) != 0 ) {
+		return XattrError();
+	}
+	*size = ( off_t )info.st_size;
+	return B_OK;
+}	// <-- end of function XattrEventNode::GetSize
+
+
+
+ssize_t		XattrEventNode::ReadAt( off_t position, void* buffer, size_t size )
+{
+	ssize_t		readSize;
+
+	if ( fFD < 0 ) { return B_NO_INIT; }
+
+	if ( ( readSize = pread( fFD, buffer, size, position ) ) < 0 ) {
+		return XattrError();
+	}
+	return readSize;
+}	// <-- end of function XattrEventNode::ReadAt
+
+
+
+status_t		XattrEventNode::SetData( const void* buffer, size_t size )
+{
+	ssize_t		written;
+
+	if ( fFD < 0 ) { return B_NO_INIT; }
+
+	if ( ftruncate( fFD, ( off_t )size ) != 0 ) {
+		return XattrError();
+	}
+	if ( size == 0 ) { return B_OK; }
+
+	if ( ( written = pwrite( fFD, buffer, size, 0 ) ) < 0 ) {
+		return XattrError();
+	}
+	return ( ( size_t )written == size ) ? B_OK : B_IO_ERROR;
+}	// <-- end of function XattrEventNode::SetData
+
+#endif // __linux__
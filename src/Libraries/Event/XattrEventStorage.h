@@ -0,0 +1,80 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _XATTR_EVENT_STORAGE_H_
+#define _XATTR_EVENT_STORAGE_H_
+
+#ifdef __linux__
+
+// Project includes
+#include "EventStorage.h"
+
+// STL includes
+#include <string>
+#include <vector>
+
+
+/*!	\brief		Event files in a directory of a Linux file system.
+ *		\details		The attributes are kept as "user." extended attributes. Since
+ *						extended attributes have no type, every value starts with its
+ *						\c type_code, as a little-endian \c uint32.
+ *
+ *						The keys are the names of the files in the directory. There's
+ *						no index: ListByRange() reads the attribute of every file.
+ */
+class XattrEventStorage
+	: public EventStorage
+{
+public:
+	XattrEventStorage( const char* directory );
+	virtual ~XattrEventStorage();
+
+	virtual EventNode*	Open( const char* key, uint32 openMode );
+	virtual status_t		Remove( const char* key );
+	virtual status_t		ListByRange( const char* attribute, int64 from, int64 to,
+												 std::vector< BString >* keys );
+
+protected:
+	virtual std::string	_PathOf( const char* key ) const;
+
+	std::string		fDirectory;
+};
+
+
+
+/*!	\brief		A node of XattrEventStorage - an open file.
+ */
+class XattrEventNode
+	: public EventNode
+{
+public:
+	XattrEventNode( const char* path, uint32 openMode );
+	virtual ~XattrEventNode();
+
+	virtual status_t	InitCheck() const;
+	virtual status_t	Lock();
+	virtual status_t	Unlock();
+
+	virtual ssize_t	ReadAttr( const char* name, type_code type, void* buffer, size_t size );
+	virtual ssize_t	WriteAttr( const char* name, type_code type, const void* buffer, size_t size );
+	virtual status_t	RemoveAttr( const char* name );
+	virtual status_t	GetAttrInfo( const char* name, attr_info* info );
+	virtual status_t	RewindAttrs();
+	virtual status_t	GetNextAttrName( char* buffer );
+
+	virtual status_t	GetSize( off_t* size );
+	virtual ssize_t	ReadAt( off_t position, void* buffer, size_t size );
+	virtual status_t	SetData( const void* buffer, size_t size );
+
+protected:
+	int					fFD;
+	status_t				fInitStatus;
+	std::vector< char >	fAttrNames;		//!< The list of listxattr(), filled by RewindAttrs().
+	size_t				fNextAttr;		//!< Offset of the next name in \c fAttrNames.
+	std::vector< char >	fValueBuffer;	//!< Reused for the value and its type.
+};
+
+#endif // __linux__
+
+#endif // _XATTR_EVENT_STORAGE_H_
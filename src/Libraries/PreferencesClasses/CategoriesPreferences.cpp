@@ -265,19 +265,9 @@ void			SearchFilesystemForAdditionalCategories( void )
 		return;
 	}
 	
-		// For initialization of the BQuery, we need to find the Volume with user's data.
+		// Events may be stored on any volume that supports queries.
 	BVolumeRoster volumeRoster;
-	BVolume bootVolume;
-	volumeRoster.GetBootVolume( &bootVolume );
-	
-		// Setting the query to look in the boot volume
-	categoryQuery->SetVolume( &bootVolume );
-	
-	/* First item of the predicate is the type of the file.
-	 */
-	categoryQuery->PushAttr( "BEOS:TYPE" );
-	categoryQuery->PushString( kEventFileMIMEType );
-	categoryQuery->PushOp( B_EQ );
+	BVolume volume;
 	
 	/* Check the category attribute type's name.
 	 */
@@ -293,68 +283,82 @@ void			SearchFilesystemForAdditionalCategories( void )
 		++i;
 	}
 	
-	/* Build the query predicate.
-	 * This is meaningful only if global list of categories contains any items,
-	 *	and if we succeeded to find the attribute with human-readable name "Category".
-	 */
-	if ( ! global_ListOfCategories.IsEmpty() &&
-		  ( AttributesArray[ i ].internalName != NULL ) )
+	while ( volumeRoster.GetNextVolume( &volume ) == B_OK )
 	{
-		for ( int j = 0, limit = global_ListOfCategories.CountItems();
-				j < limit;
-				++j )
+		if ( !volume.KnowsQuery() ) { continue; }
+		
+		categoryQuery->Clear();
+		categoryQuery->SetVolume( &volume );
+		
+		/* First item of the predicate is the type of the file.
+		 */
+		categoryQuery->PushAttr( "BEOS:TYPE" );
+		categoryQuery->PushString( kEventFileMIMEType );
+		categoryQuery->PushOp( B_EQ );
+	
+		/* Build the query predicate.
+		 * This is meaningful only if global list of categories contains any items,
+		 *	and if we succeeded to find the attribute with human-readable name "Category".
+		 */
+		if ( ! global_ListOfCategories.IsEmpty() &&
+			  ( AttributesArray[ i ].internalName != NULL ) )
 		{
-			pCategory = ( Category* )global_ListOfCategories.ItemAt( j );
-			if ( !pCategory )
-				continue;
+			for ( int j = 0, limit = global_ListOfCategories.CountItems();
+					j < limit;
+					++j )
+			{
+				pCategory = ( Category* )global_ListOfCategories.ItemAt( j );
+				if ( !pCategory )
+					continue;
 				
-			categoryQuery->PushAttr( AttributesArray[ i ].internalName );
-			categoryQuery->PushString( pCategory->categoryName.String(), true );
-			categoryQuery->PushOp( B_NE );
+				categoryQuery->PushAttr( AttributesArray[ i ].internalName );
+				categoryQuery->PushString( pCategory->categoryName.String(), true );
+				categoryQuery->PushOp( B_NE );
 			
-			categoryQuery->PushOp( B_AND );
-		}	// <-- end of "for ( all currently known categories )"
+				categoryQuery->PushOp( B_AND );
+			}	// <-- end of "for ( all currently known categories )"
 		
-	}	// <-- end of "if ( there are any items in the list of known categories )"
+		}	// <-- end of "if ( there are any items in the list of known categories )"
 	
-	/* The predicate that we currently have looks like this:
-	 * ((( type is Eventual ) && ( category != "Cat1" )) && ( category != "Cat2" )) && ...
-	 * The order does not matter, since we're using "AND".
-	 *
-	 * Well, let's fire and see what comes...
-	 */
-	categoryQuery->Fetch();
+		/* The predicate that we currently have looks like this:
+		 * ((( type is Eventual ) && ( category != "Cat1" )) && ( category != "Cat2" )) && ...
+		 * The order does not matter, since we're using "AND".
+		 *
+		 * Well, let's fire and see what comes...
+		 */
+		categoryQuery->Fetch();
 	
-	while ( ( status = categoryQuery->GetNextRef( &fileToReadAttributesFrom ) ) == B_OK )
-	{
-		// Successfully retrieved next entry
+		while ( ( status = categoryQuery->GetNextRef( &fileToReadAttributesFrom ) ) == B_OK )
+		{
+			// Successfully retrieved next entry
 		
-		file = new BFile( &fileToReadAttributesFrom, B_READ_ONLY );
-		if ( !file || file->InitCheck() != B_OK )
-			continue;
+			file = new BFile( &fileToReadAttributesFrom, B_READ_ONLY );
+			if ( !file || file->InitCheck() != B_OK )
+				continue;
 		
-		status = file->GetAttrInfo( AttributesArray[ i ].internalName,
-											 &attribute_info );
-		if ( status != B_OK )
-			continue;
+			status = file->GetAttrInfo( AttributesArray[ i ].internalName,
+												 &attribute_info );
+			if ( status != B_OK )
+				continue;
 		
-		status = file->ReadAttr( AttributesArray[ i ].internalName,
-										 attribute_info.type,
-										 0,
-										 buffer,
-										 ( attribute_info.size > 255 ) ? 255 : attribute_info.size );
-		if ( status != B_OK )
-			continue;
+			status = file->ReadAttr( AttributesArray[ i ].internalName,
+											 attribute_info.type,
+											 0,
+											 buffer,
+											 ( attribute_info.size > 255 ) ? 255 : attribute_info.size );
+			if ( status != B_OK )
+				continue;
 		
-		// Succeeded to read the category name, it's in "buffer". Create the color...
-		catColor = CreateRandomColor();
+			// Succeeded to read the category name, it's in "buffer". Create the color...
+			catColor = CreateRandomColor();
 		
-		// ...and add the category to the list of categories.
-		AddCategoryToGlobalList( BString( buffer ), catColor );
+			// ...and add the category to the list of categories.
+			AddCategoryToGlobalList( BString( buffer ), catColor );
 		
-		// We don't need the file anymore.
-		delete file;
-	}
+			// We don't need the file anymore.
+			delete file;
+		}
+	}	// <-- end of "while ( there are volumes )"
 	
 	delete categoryQuery;
 	
@@ -14,6 +14,7 @@
 
 // OS includes
 #include <Directory.h>
+#include <Entry.h>
 #include <Path.h>
 #include <File.h>
 #include <FindDirectory.h>
@@ -25,6 +26,7 @@
 // General includes
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 
 
@@ -55,6 +57,17 @@ static status_t		ReadFileWithPreferences( BFile* in );
 	/* Writes the BMessage with preferences into previously opened file. */
 static status_t		WriteFileWithPreferences( BFile* in );
 
+	/* Tells to which section a field of the preferences message belongs */
+static uint32			SectionOfField( const char* name );
+
+	/* Copies the fields of one section into another message */
+static status_t		ExtractSection( const BMessage* from, uint32 section, BMessage* to );
+
+	/* Checks if a section is the same in two preferences messages */
+static bool				SectionsAreEqual( const BMessage* first,
+												  const BMessage* second,
+												  uint32 section );
+
 /*****************************************************************************
  *				Definitions of global functions
  ****************************************************************************/
@@ -150,6 +163,103 @@ status_t		pref_ReloadAllPreferences( void )
 
 
 
+/*!	\brief		Reloads only the sections of the preferences that were changed.
+ *		\details		The file is read into a separate message and compared with the
+ *						current one, section by section. Only the sections that differ are
+ *						parsed again - for example, the categories are not rebuilt (and
+ *						the file system is not queried for them) when only the time
+ *						preferences were changed.
+ *						If the file can't be read - for example, it's being written right
+ *						now - the current preferences are kept.
+ *		\param[out]	changedOut	If not \c NULL, receives the PreferencesSection bits
+ *										of the sections that were reloaded.
+ */
+status_t		pref_ReloadChangedPreferences( uint32* changedOut )
+{
+	status_t status = B_OK;
+	BFile preferencesFile;
+	BMessage fresh( kOverallPreferences );
+	uint32 changed = PREF_SECTION_NONE;
+	uint32 section;
+	
+	if ( changedOut ) { *changedOut = PREF_SECTION_NONE; }
+	
+	status = OpenFileWithPreferences( &preferencesFile, B_READ_ONLY );
+	if ( status != B_OK ) { return status; }
+	
+	status = fresh.Unflatten( &preferencesFile );
+	preferencesFile.Unset();
+	if ( status != B_OK ) { return status; }
+	
+	for ( section = PREF_SECTION_EMAIL; section <= PREF_SECTION_CATEGORIES; section <<= 1 )
+	{
+		if ( !global_PreferencesMessage ||
+			  !SectionsAreEqual( global_PreferencesMessage, &fresh, section ) )
+		{
+			changed |= section;
+		}
+	}
+	if ( changed == PREF_SECTION_NONE ) { return B_OK; }
+	
+	if ( !global_PreferencesMessage ) {
+		global_PreferencesMessage = new BMessage( fresh );
+		if ( !global_PreferencesMessage ) { return B_NO_MEMORY; }
+	} else {
+		*global_PreferencesMessage = fresh;
+	}
+	
+	if ( changed & PREF_SECTION_CALENDAR_MODULES ) {
+		pref_PopulateCalendarModulePreferences( global_PreferencesMessage );
+	}
+	if ( changed & PREF_SECTION_EMAIL ) {
+		pref_PopulateEmailPreferences( global_PreferencesMessage );
+	}
+	if ( changed & PREF_SECTION_TIME ) {
+		pref_PopulateTimePreferences( global_PreferencesMessage );
+	}
+	if ( changed & PREF_SECTION_CATEGORIES ) {
+		pref_PopulateCategories( global_PreferencesMessage );
+	}
+	
+	if ( changedOut ) { *changedOut = changed; }
+	return B_OK;
+}	// <-- end of function pref_ReloadChangedPreferences
+
+
+
+/*!	\brief		Returns the nodes of the preferences file and of its directory.
+ *		\details		Used to watch the preferences with node monitor. The directory is
+ *						needed to notice the file being replaced or created.
+ *		\param[out]	fileOut			Node of the preferences file.
+ *		\param[out]	directoryOut	Node of the directory which contains it.
+ */
+status_t		pref_GetPreferencesFileNodes( node_ref* fileOut, node_ref* directoryOut )
+{
+	status_t		status;
+	BFile			preferencesFile;
+	BPath			path;
+	BDirectory	directory;
+	
+	if ( !fileOut || !directoryOut ) { return B_BAD_VALUE; }
+	
+	// This also creates the directory, if needed
+	status = OpenFileWithPreferences( &preferencesFile, B_READ_ONLY | B_CREATE_FILE );
+	if ( status != B_OK ) { return status; }
+	status = preferencesFile.GetNodeRef( fileOut );
+	preferencesFile.Unset();
+	if ( status != B_OK ) { return status; }
+	
+	status = find_directory( B_USER_SETTINGS_DIRECTORY, &path );
+	if ( status != B_OK ) { return status; }
+	path.Append( "Eventual" );
+	status = directory.SetTo( path.Path() );
+	if ( status != B_OK ) { return status; }
+	
+	return directory.GetNodeRef( directoryOut );
+}	// <-- end of function pref_GetPreferencesFileNodes
+
+
+
 /*!	\brief		Saves all preferences into a file.
  */
 status_t		pref_SaveAllPreferences( void )
@@ -349,3 +459,108 @@ status_t		WriteFileWithPreferences( BFile* in )
 	return toReturn;
 	
 }	// <-- end of function WriteFileWithPreferences
+
+
+
+/*!	\brief		Returns the section a field of the preferences message belongs to.
+ *		\param[in]	name		Name of the field.
+ *		\returns		One of the PreferencesSection values.
+ */
+static
+uint32		SectionOfField( const char* name )
+{
+	if ( !name ) { return PREF_SECTION_NONE; }
+	
+	if ( strcmp( name, "Email Preferences" ) == 0 ) {
+		return PREF_SECTION_EMAIL;
+	}
+	if ( strcmp( name, "Time Preferences" ) == 0 ) {
+		return PREF_SECTION_TIME;
+	}
+	if ( strncmp( name, "CalendarModulePreferences", 25 ) == 0 ) {
+		return PREF_SECTION_CALENDAR_MODULES;
+	}
+	if ( ( strncmp( name, "Category", 8 ) == 0 ) ||
+		  ( strncmp( name, "Color", 5 ) == 0 ) )
+	{
+		return PREF_SECTION_CATEGORIES;
+	}
+	return PREF_SECTION_NONE;
+	
+}	// <-- end of function SectionOfField
+
+
+
+/*!	\brief		Copies all fields of one section into another message.
+ *		\param[in]	from		The preferences message.
+ *		\param[in]	section	The PreferencesSection to copy.
+ *		\param[out]	to			The message to which the fields are added.
+ */
+static
+status_t		ExtractSection( const BMessage* from, uint32 section, BMessage* to )
+{
+	char*			name;
+	type_code	type;
+	int32			count, index, item;
+	const void*	data;
+	ssize_t		size;
+	status_t		status;
+	
+	if ( !from || !to ) { return B_BAD_VALUE; }
+	
+	for ( index = 0;
+			from->GetInfo( B_ANY_TYPE, index, &name, &type, &count ) == B_OK;
+			++index )
+	{
+		if ( SectionOfField( name ) != section ) { continue; }
+		
+		for ( item = 0; item < count; ++item )
+		{
+			status = from->FindData( name, type, item, &data, &size );
+			if ( status != B_OK ) { return status; }
+			status = to->AddData( name, type, data, size, false );
+			if ( status != B_OK ) { return status; }
+		}
+	}
+	return B_OK;
+	
+}	// <-- end of function ExtractSection
+
+
+
+/*!	\brief		Checks if a section is the same in two preferences messages.
+ *		\details		The fields of the section are copied out of each message, and
+ *						the flattened copies are compared.
+ */
+static
+bool			SectionsAreEqual( const BMessage* first, const BMessage* second, uint32 section )
+{
+	BMessage	firstSection, secondSection;
+	ssize_t	size;
+	char*		firstBuffer;
+	char*		secondBuffer;
+	bool		toReturn = false;
+	
+	if ( ( ExtractSection( first, section, &firstSection ) != B_OK ) ||
+		  ( ExtractSection( second, section, &secondSection ) != B_OK ) )
+	{
+		return false;
+	}
+	
+	size = firstSection.FlattenedSize();
+	if ( size != secondSection.FlattenedSize() ) { return false; }
+	
+	firstBuffer = new char[ size ];
+	secondBuffer = new char[ size ];
+	if ( firstBuffer && secondBuffer &&
+		  ( firstSection.Flatten( firstBuffer, size ) == B_OK ) &&
+		  ( secondSection.Flatten( secondBuffer, size ) == B_OK ) )
+	{
+		toReturn = ( memcmp( firstBuffer, secondBuffer, size ) == 0 );
+	}
+	
+	if ( firstBuffer ) { delete[] firstBuffer; }
+	if ( secondBuffer ) { delete[] secondBuffer; }
+	return toReturn;
+	
+}	// <-- end of function SectionsAreEqual
@@ -6,6 +6,7 @@
 #define _PREFERENCES_H_
 
 #include <Message.h>
+#include <Node.h>
 #include <SupportDefs.h>
 
 #include "EmailPreferences.h"
@@ -20,6 +21,19 @@
 const uint32	kOverallPreferences		= 'GLPR';
 
 
+/*!	\brief		Sections of the preferences file.
+ *		\details		Used as bits, to tell which sections were changed on reload.
+ */
+enum PreferencesSection {
+	PREF_SECTION_NONE					= 0,
+	PREF_SECTION_EMAIL				= 0x01,
+	PREF_SECTION_TIME					= 0x02,
+	PREF_SECTION_CALENDAR_MODULES	= 0x04,
+	PREF_SECTION_CATEGORIES			= 0x08,
+	PREF_SECTION_ALL					= 0x0F
+};
+
+
 /*----------------------------------------------------------------------------
  *							Declaration of class 
  *---------------------------------------------------------------------------*/
@@ -44,6 +58,10 @@ status_t		pref_SaveAllPreferences( void );
 
 status_t		pref_ReloadAllPreferences( void );
 
+status_t		pref_ReloadChangedPreferences( uint32* changedOut = NULL );
+
+status_t		pref_GetPreferencesFileNodes( node_ref* fileOut, node_ref* directoryOut );
+
 inline BMessage*	pref_GetOverallPreferencesMessage() { return global_PreferencesMessage; }
 
 
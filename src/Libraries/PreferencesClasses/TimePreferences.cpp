@@ -144,6 +144,7 @@ status_t		pref_SaveTimePreferences( BMessage* out )
 TimePreferences::TimePreferences( BMessage* in )
 {
 	uint8 temp1, temp2;
+	int32 temp3;
 	
 	// Get the 24h clock usage
 	if ( ( !in ) || B_OK != in->FindBool( "Use 24 Hours Clock", &use24hClock ) )
@@ -187,6 +188,14 @@ TimePreferences::TimePreferences( BMessage* in )
 	}	
 	SetDefaultSnoozeTime( temp1, temp2 );
 	
+	// Get the overdue activities policy
+	if ( ( !in ) || ( B_OK != in->FindInt32( "Overdue Activities Policy", &temp3 ) ) ||
+		  ( temp3 < OVERDUE_SUMMARY_ONLY ) || ( temp3 > OVERDUE_RUN_ALL ) )
+	{
+		temp3 = OVERDUE_SUMMARY_ONLY;
+	}
+	overduePolicy = ( OverduePolicy )temp3;
+	
 }	// <-- end of constructor from BMessage
 
 
@@ -207,6 +216,7 @@ TimePreferences	TimePreferences::operator= ( const TimePreferences& other )
 	this->defaultReminderTime = other.defaultReminderTime;
 	this->defaultSnoozeTime = other.defaultSnoozeTime;
 	this->use24hClock = other.use24hClock;
+	this->overduePolicy = other.overduePolicy;
 
 	return *this;	
 }	// <-- end of assignment operator.
@@ -222,6 +232,7 @@ TimePreferences::TimePreferences( const TimePreferences* other )
 		this->defaultReminderTime = other->defaultReminderTime;
 		this->defaultSnoozeTime = other->defaultSnoozeTime;
 		this->use24hClock  = other->use24hClock;
+		this->overduePolicy = other->overduePolicy;
 	}
 	else		// Setting default preferences
 	{
@@ -229,6 +240,7 @@ TimePreferences::TimePreferences( const TimePreferences* other )
 		SetDefaultReminderTime( 0, 15 );
 		SetDefaultSnoozeTime( 0, 10 );
 		this->use24hClock  = true;
+		this->overduePolicy = OVERDUE_SUMMARY_ONLY;
 	}
 }	// <-- end of copy constructor
 
@@ -288,6 +300,13 @@ status_t		TimePreferences::Archive( BMessage* out ) const
 	} else {
 		status = out->AddInt8( "Default Snooze Time - Minutes", ( uint8 )this->defaultSnoozeTime.tm_min );
 	}
+	
+	// Pack the overdue activities policy
+	if ( out->HasInt32( "Overdue Activities Policy" ) ) {
+		status = out->ReplaceInt32( "Overdue Activities Policy", ( int32 )this->overduePolicy );
+	} else {
+		status = out->AddInt32( "Overdue Activities Policy", ( int32 )this->overduePolicy );
+	}
 
 	return status;	
 	
@@ -307,7 +326,8 @@ bool		TimePreferences::operator== ( const TimePreferences& other ) const
 		  ( this->defaultReminderTime.tm_min == other.defaultReminderTime.tm_min ) &&
 		  ( this->defaultSnoozeTime.tm_hour == other.defaultSnoozeTime.tm_hour ) &&
 		  ( this->defaultSnoozeTime.tm_min == other.defaultSnoozeTime.tm_min ) &&
-		  ( this->use24hClock == other.use24hClock ) )
+		  ( this->use24hClock == other.use24hClock ) &&
+		  ( this->overduePolicy == other.overduePolicy ) )
 	{
 		return true;
 	}
@@ -328,7 +348,8 @@ bool		TimePreferences::Compare ( const TimePreferences* other ) const
 		  ( this->defaultReminderTime.tm_min == other->defaultReminderTime.tm_min ) &&
 		  ( this->defaultSnoozeTime.tm_hour == other->defaultSnoozeTime.tm_hour ) &&
 		  ( this->defaultSnoozeTime.tm_min == other->defaultSnoozeTime.tm_min ) &&
-		  ( this->use24hClock == other->use24hClock ) )
+		  ( this->use24hClock == other->use24hClock ) &&
+		  ( this->overduePolicy == other->overduePolicy ) )
 	{
 		return true;
 	}
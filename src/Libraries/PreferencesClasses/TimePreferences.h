@@ -20,6 +20,23 @@
 const uint32	kTimePreferences		= 'TPRF';
 
 
+/*----------------------------------------------------------------------------
+ *							Overdue activities policy
+ *---------------------------------------------------------------------------*/
+
+/*!	\brief		What should the server do with activities that became overdue
+ *					while the computer was off, suspended, or the clock jumped?
+ *		\details		In any case, the overdue activities are collapsed into a single
+ *						summary notification; this policy selects which of them still run
+ *						their programs and sounds.
+ */
+enum OverduePolicy {
+	OVERDUE_SUMMARY_ONLY = 0,		//!< Nothing runs, only the summary is shown.
+	OVERDUE_RUN_EVENTS,				//!< Run the Event activities, skip the reminders.
+	OVERDUE_RUN_ALL					//!< Run everything, at a limited rate.
+};
+
+
 /*----------------------------------------------------------------------------
  *							Declaration of class TimePreferences
  *---------------------------------------------------------------------------*/
@@ -31,6 +48,7 @@ class TimePreferences
 		TimeRepresentation		defaultAppointmentDuration;
 		TimeRepresentation		defaultReminderTime;
 		TimeRepresentation		defaultSnoozeTime;
+		OverduePolicy				overduePolicy;
 	
 	public:
 		TimePreferences( BMessage* in = NULL );
@@ -84,6 +102,10 @@ class TimePreferences
 		}		
 		virtual void				SetDefaultSnoozeTime( int hours, int minutes );
 		
+		// Get and set routines for the overdue activities policy
+		inline virtual OverduePolicy	GetOverduePolicy() const { return overduePolicy; }
+		inline virtual void		SetOverduePolicy( OverduePolicy in ) { overduePolicy = in; }
+		
 		virtual TimePreferences operator= ( const TimePreferences& other );
 		virtual bool	Compare( const TimePreferences* other ) const;
 		virtual bool	operator== ( const TimePreferences& other ) const;
@@ -1,6 +1,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <ByteOrder.h>
+
 #include "TimeRepresentation.h"
 
 BList listOfCalendarModules;
@@ -373,3 +375,90 @@ void		TimeRepresentation::Unarchive( BMessage* in ) {
 	// Time zones are currently not supported
 	tm_zone = NULL;
 }	// <-- end of function TimeRepresentation::Unarchive
+
+
+
+/*!	\brief		Layout of the binary form.
+ *		\details		All numbers are little-endian. The calendar module is not a
+ *						part of it - it's the same for all dates of an Event, and is
+ *						stored once by the caller.
+ */
+struct TimeRepresentationBinary {
+	int16		year;
+	uint8		month;
+	uint8		day;
+	uint8		hour;
+	uint8		min;
+	uint8		sec;
+	uint8		wday;
+	uint16	yday;
+	int8		isDST;
+	uint8		flags;		//!< Bit 0 is set if the object represents a real date.
+	int32		gmtOff;
+} _PACKED;
+
+// Fails to compile if the layout doesn't match the declared size
+typedef char	TimeRepresentationBinarySizeCheck[
+	( sizeof( TimeRepresentationBinary ) == kTimeRepresentationBinarySize ) ? 1 : -1 ];
+
+
+
+/*!	\brief		Write the date into a fixed-size binary record.
+ *		\details		This is a compact alternative to Archive(): it takes
+ *						\c kTimeRepresentationBinarySize bytes, instead of a flattened
+ *						BMessage with twelve named fields.
+ *		\param[out]	out		The buffer to fill.
+ *		\param[in]	size		Size of the buffer; at least \c kTimeRepresentationBinarySize.
+ */
+status_t		TimeRepresentation::ToBinary( void* out, size_t size ) const
+{
+	TimeRepresentationBinary	binary;
+
+	if ( !out || size < sizeof( binary ) ) { return B_BAD_VALUE; }
+
+	binary.year = B_HOST_TO_LENDIAN_INT16( ( int16 )tm_year );
+	binary.month = ( uint8 )tm_mon;
+	binary.day = ( uint8 )tm_mday;
+	binary.hour = ( uint8 )tm_hour;
+	binary.min = ( uint8 )tm_min;
+	binary.sec = ( uint8 )tm_sec;
+	binary.wday = ( uint8 )tm_wday;
+	binary.yday = B_HOST_TO_LENDIAN_INT16( ( uint16 )tm_yday );
+	binary.isDST = ( int8 )tm_isdst;
+	binary.flags = ( fIsRepresentingRealDate ? 1 : 0 );
+	binary.gmtOff = B_HOST_TO_LENDIAN_INT32( ( int32 )tm_gmtoff );
+
+	memcpy( out, &binary, sizeof( binary ) );
+	return B_OK;
+}	// <-- end of function TimeRepresentation::ToBinary
+
+
+
+/*!	\brief		Read the date from the binary record written by ToBinary().
+ *		\details		The calendar module is not changed.
+ *		\param[in]	in			The record.
+ *		\param[in]	size		Size of the record.
+ */
+status_t		TimeRepresentation::FromBinary( const void* in, size_t size )
+{
+	TimeRepresentationBinary	binary;
+
+	if ( !in || size < sizeof( binary ) ) { return B_BAD_VALUE; }
+
+	memcpy( &binary, in, sizeof( binary ) );
+	tm_year = ( int16 )B_LENDIAN_TO_HOST_INT16( binary.year );
+	tm_mon = binary.month;
+	tm_mday = binary.day;
+	tm_hour = binary.hour;
+	tm_min = binary.min;
+	tm_sec = binary.sec;
+	tm_wday = binary.wday;
+	tm_yday = B_LENDIAN_TO_HOST_INT16( binary.yday );
+	tm_isdst = binary.isDST;
+	fIsRepresentingRealDate = ( ( binary.flags & 1 ) != 0 );
+	tm_gmtoff = ( int32 )B_LENDIAN_TO_HOST_INT32( binary.gmtOff );
+
+	// Time zones are currently not supported
+	tm_zone = NULL;
+	return B_OK;
+}	// <-- end of function TimeRepresentation::FromBinary
@@ -37,6 +37,11 @@ const uint32	kInvalid	= 0xFF;
 
 class CalendarModule;
 
+/*!	\brief		Size of the binary form of TimeRepresentation.
+ *		\sa			TimeRepresentation::ToBinary()
+ */
+const size_t	kTimeRepresentationBinarySize	= 16;
+
 /*!
 	\brief	This class is an expansion of the struct tm.
 
@@ -70,6 +75,9 @@ public:
 	void Archive( BMessage* in );
 	void Unarchive( BMessage* in );
 
+	status_t ToBinary( void* out, size_t size ) const;
+	status_t FromBinary( const void* in, size_t size );
+
 	// Operators
 	virtual TimeRepresentation& operator= (const TimeRepresentation& in);
 	virtual bool operator== (const TimeRepresentation &in) const;
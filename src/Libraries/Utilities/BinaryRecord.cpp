@@ -0,0 +1,299 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "BinaryRecord.h"
+
+// OS includes
+#include <ByteOrder.h>
+
+// POSIX includes
+#include <string.h>
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class RecordWriter
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ */
+RecordWriter::RecordWriter()
+	:
+	fLastError( B_OK )
+{
+	// The records are small - grow the buffer by small steps
+	fBuffer.SetBlockSize( 256 );
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+RecordWriter::~RecordWriter()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Append bytes to the end of the record.
+ */
+void		RecordWriter::Append( const void* data, size_t length )
+{
+	ssize_t	written;
+
+	if ( fLastError != B_OK || length == 0 ) { return; }
+
+	written = fBuffer.Write( data, length );
+	if ( written < 0 ) {
+		fLastError = ( status_t )written;
+	} else if ( ( size_t )written != length ) {
+		fLastError = B_NO_MEMORY;
+	}
+}	// <-- end of function RecordWriter::Append
+
+
+
+void		RecordWriter::AddUint8( uint8 value )
+{
+	Append( &value, sizeof( uint8 ) );
+}	// <-- end of function RecordWriter::AddUint8
+
+
+
+void		RecordWriter::AddUint16( uint16 value )
+{
+	value = B_HOST_TO_LENDIAN_INT16( value );
+	Append( &value, sizeof( uint16 ) );
+}	// <-- end of function RecordWriter::AddUint16
+
+
+
+void		RecordWriter::AddUint32( uint32 value )
+{
+	value = B_HOST_TO_LENDIAN_INT32( value );
+	Append( &value, sizeof( uint32 ) );
+}	// <-- end of function RecordWriter::AddUint32
+
+
+
+/*!	\brief		Add a string as length and characters.
+ */
+void		RecordWriter::AddString( const BString& value )
+{
+	AddData( value.String(), ( uint32 )value.Length() );
+}	// <-- end of function RecordWriter::AddString
+
+
+
+/*!	\brief		Add a block of raw data as length and bytes.
+ */
+void		RecordWriter::AddData( const void* data, uint32 length )
+{
+	if ( !data && length != 0 ) {
+		if ( fLastError == B_OK ) { fLastError = B_BAD_VALUE; }
+		return;
+	}
+	AddUint32( length );
+	Append( data, length );
+}	// <-- end of function RecordWriter::AddData
+
+
+
+/*!	\brief		Add a block of raw data of known size, without its length.
+ */
+void		RecordWriter::AddBytes( const void* data, size_t length )
+{
+	if ( !data && length != 0 ) {
+		if ( fLastError == B_OK ) { fLastError = B_BAD_VALUE; }
+		return;
+	}
+	Append( data, length );
+}	// <-- end of function RecordWriter::AddBytes
+
+
+
+/*!	\brief		Overwrite a number that was already added.
+ *		\details		Used for fields that are known only when the record is complete,
+ *						like its total size.
+ *		\param[in]	offset	Position of the number from the start of the record.
+ */
+void		RecordWriter::SetUint32At( size_t offset, uint32 value )
+{
+	ssize_t	written;
+
+	if ( fLastError != B_OK ) { return; }
+	if ( offset + sizeof( uint32 ) > Size() ) {
+		fLastError = B_BAD_VALUE;
+		return;
+	}
+
+	value = B_HOST_TO_LENDIAN_INT32( value );
+	written = fBuffer.WriteAt( offset, &value, sizeof( uint32 ) );
+	if ( written != sizeof( uint32 ) ) {
+		fLastError = ( written < 0 ) ? ( status_t )written : B_IO_ERROR;
+	}
+}	// <-- end of function RecordWriter::SetUint32At
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class RecordReader
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor.
+ *		\param[in]	buffer	The record. It's not copied.
+ *		\param[in]	size		Size of the record in bytes.
+ */
+RecordReader::RecordReader( const void* buffer, size_t size )
+	:
+	fBuffer( ( const uint8* )buffer ),
+	fSize( buffer ? size : 0 ),
+	fPosition( 0 ),
+	fLastError( buffer ? B_OK : B_BAD_VALUE )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor.
+ */
+RecordReader::~RecordReader()
+{
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Consume the next bytes of the record.
+ *		\returns		Pointer to the bytes, or \c NULL if the record is too short.
+ */
+const uint8*		RecordReader::Take( size_t length )
+{
+	const uint8*	toReturn;
+
+	if ( fLastError != B_OK ) { return NULL; }
+	if ( length > Remaining() ) {
+		fLastError = B_BAD_DATA;
+		return NULL;
+	}
+
+	toReturn = fBuffer + fPosition;
+	fPosition += length;
+	return toReturn;
+}	// <-- end of function RecordReader::Take
+
+
+
+status_t		RecordReader::ReadUint8( uint8* out )
+{
+	const uint8*	data = Take( sizeof( uint8 ) );
+
+	if ( !data ) { return fLastError; }
+	if ( out ) { *out = *data; }
+	return B_OK;
+}	// <-- end of function RecordReader::ReadUint8
+
+
+
+status_t		RecordReader::ReadUint16( uint16* out )
+{
+	const uint8*	data = Take( sizeof( uint16 ) );
+	uint16			value;
+
+	if ( !data ) { return fLastError; }
+	memcpy( &value, data, sizeof( uint16 ) );
+	if ( out ) { *out = B_LENDIAN_TO_HOST_INT16( value ); }
+	return B_OK;
+}	// <-- end of function RecordReader::ReadUint16
+
+
+
+status_t		RecordReader::ReadUint32( uint32* out )
+{
+	const uint8*	data = Take( sizeof( uint32 ) );
+	uint32			value;
+
+	if ( !data ) { return fLastError; }
+	memcpy( &value, data, sizeof( uint32 ) );
+	if ( out ) { *out = B_LENDIAN_TO_HOST_INT32( value ); }
+	return B_OK;
+}	// <-- end of function RecordReader::ReadUint32
+
+
+
+status_t		RecordReader::ReadInt32( int32* out )
+{
+	uint32		value;
+	status_t		status = ReadUint32( &value );
+
+	if ( status == B_OK && out ) { *out = ( int32 )value; }
+	return status;
+}	// <-- end of function RecordReader::ReadInt32
+
+
+
+/*!	\brief		Read a string added by RecordWriter::AddString().
+ */
+status_t		RecordReader::ReadString( BString* out )
+{
+	const void*	data;
+	uint32		length;
+	status_t		status = ReadData( &data, &length );
+
+	if ( status == B_OK && out ) {
+		out->SetTo( ( const char* )data, length );
+	}
+	return status;
+}	// <-- end of function RecordReader::ReadString
+
+
+
+/*!	\brief		Read a block of raw data added by RecordWriter::AddData().
+ *		\param[out]	out		Set to the data inside the record - it's not copied.
+ *		\param[out]	length	Set to the length of the data.
+ */
+status_t		RecordReader::ReadData( const void** out, uint32* length )
+{
+	uint32			size;
+	const uint8*	data;
+
+	if ( ReadUint32( &size ) != B_OK ) { return fLastError; }
+	if ( ( data = Take( size ) ) == NULL ) { return fLastError; }
+
+	if ( out ) { *out = data; }
+	if ( length ) { *length = size; }
+	return B_OK;
+}	// <-- end of function RecordReader::ReadData
+
+
+
+/*!	\brief		Read a block of raw data added by RecordWriter::AddBytes().
+ *		\param[out]	out		Set to the data inside the record - it's not copied.
+ *		\param[in]	length	Size of the block.
+ */
+status_t		RecordReader::ReadBytes( const void** out, size_t length )
+{
+	const uint8*	data = Take( length );
+
+	if ( !data ) { return fLastError; }
+	if ( out ) { *out = data; }
+	return B_OK;
+}	// <-- end of function RecordReader::ReadBytes
+
+
+
+/*!	\brief		Continue reading from another position in the record.
+ *		\details		Used to skip the fields added by newer versions of the record.
+ */
+status_t		RecordReader::Seek( size_t position )
+{
+	if ( fLastError != B_OK ) { return fLastError; }
+	if ( position > fSize ) {
+		fLastError = B_BAD_DATA;
+		return fLastError;
+	}
+	fPosition = position;
+	return B_OK;
+}	// <-- end of function RecordReader::Seek
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _BINARY_RECORD_H_
+#define _BINARY_RECORD_H_
+
+// OS includes
+#include <DataIO.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+
+/*!	\brief		Builds a binary record in memory.
+ *		\details		All numbers are stored little-endian, whatever the host is.
+ *						Strings and raw data are stored as a \c uint32 length followed by
+ *						the bytes, without terminating zero. The first error is remembered
+ *						and returned by InitCheck(); the following calls do nothing.
+ */
+class RecordWriter
+{
+public:
+	RecordWriter();
+	virtual ~RecordWriter();
+
+	virtual void		AddUint8( uint8 value );
+	virtual void		AddUint16( uint16 value );
+	virtual void		AddUint32( uint32 value );
+	virtual void		AddInt32( int32 value ) { AddUint32( ( uint32 )value ); }
+	virtual void		AddString( const BString& value );
+	virtual void		AddData( const void* data, uint32 length );
+	virtual void		AddBytes( const void* data, size_t length );
+	virtual void		SetUint32At( size_t offset, uint32 value );
+
+	virtual const void*	Buffer() const { return fBuffer.Buffer(); }
+	virtual size_t			Size() const { return fBuffer.BufferLength(); }
+	virtual status_t		InitCheck() const { return fLastError; }
+
+protected:
+	virtual void		Append( const void* data, size_t length );
+
+	BMallocIO		fBuffer;
+	status_t			fLastError;
+};
+
+
+
+/*!	\brief		Reads a binary record created by RecordWriter.
+ *		\details		The reader doesn't copy the buffer - it must stay valid while the
+ *						reader is used. Every read is checked against the end of the
+ *						buffer; reading past it sets the error to \c B_BAD_DATA, and all
+ *						the following reads fail.
+ */
+class RecordReader
+{
+public:
+	RecordReader( const void* buffer, size_t size );
+	virtual ~RecordReader();
+
+	virtual status_t	ReadUint8( uint8* out );
+	virtual status_t	ReadUint16( uint16* out );
+	virtual status_t	ReadUint32( uint32* out );
+	virtual status_t	ReadInt32( int32* out );
+	virtual status_t	ReadString( BString* out );
+	virtual status_t	ReadData( const void** out, uint32* length );
+	virtual status_t	ReadBytes( const void** out, size_t length );
+	virtual status_t	Seek( size_t position );
+
+	virtual size_t		Position() const { return fPosition; }
+	virtual size_t		Remaining() const { return fSize - fPosition; }
+	virtual status_t	InitCheck() const { return fLastError; }
+
+protected:
+	virtual const uint8*	Take( size_t length );
+
+	const uint8*		fBuffer;
+	size_t				fSize;
+	size_t				fPosition;
+	status_t				fLastError;
+};
+
+
+#endif // _BINARY_RECORD_H_
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "ObjectBatch.h"
+#include "WorkerPool.h"
+
+// OS includes
+#include <OS.h>
+
+// POSIX includes
+#include <stdlib.h>
+
+// C++ includes
+#include <new>
+
+
+
+/*!	\brief		A thread isn't used for fewer objects than this.
+ */
+const		int32		kMinObjectsPerThread		= 32;
+
+/*!	\brief		How many objects a thread takes at once.
+ *		\details		Large enough that the threads rarely touch the shared counter,
+ *						small enough that they finish at about the same time.
+ */
+const		int32		kObjectChunkSize			= 8;
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class ObjectBatch
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - an empty batch.
+ *		\param[in]	objectSize		Size of every object, as \c sizeof() tells it.
+ */
+ObjectBatch::ObjectBatch( size_t objectSize )
+	:
+	fObjectSize( objectSize ),
+	fArena( NULL ),
+	fStatus( NULL ),
+	fCount( 0 ),
+	fNext( 0 )
+{
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - frees the memory.
+ *		\details		The objects were destroyed by the derived class already.
+ */
+ObjectBatch::~ObjectBatch()
+{
+	free( fArena );
+	delete [] fStatus;
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Result of loading the object at the index.
+ */
+status_t		ObjectBatch::StatusAt( int32 index ) const
+{
+	if ( index < 0 || index >= fCount ) {
+		return B_BAD_INDEX;
+	}
+	return fStatus[ index ];
+}	// <-- end of function ObjectBatch::StatusAt
+
+
+
+/*!	\brief		Destroy the objects and free the memory.
+ */
+void		ObjectBatch::MakeEmpty()
+{
+	void*		item;
+
+	for ( int32 i = 0; i < fCount; ++i ) {
+		if ( ( item = _ItemAt( i ) ) != NULL ) {
+			_DestroyItem( item );
+		}
+	}
+	free( fArena );
+	delete [] fStatus;
+	fArena = NULL;
+	fStatus = NULL;
+	fCount = 0;
+}	// <-- end of function ObjectBatch::MakeEmpty
+
+
+
+/*!	\brief		The memory of the object at the index, or \c NULL if it wasn't loaded.
+ */
+void*		ObjectBatch::_ItemAt( int32 index ) const
+{
+	if ( index < 0 || index >= fCount || fStatus[ index ] != B_OK ) {
+		return NULL;
+	}
+	return fArena + index * fObjectSize;
+}	// <-- end of function ObjectBatch::_ItemAt
+
+
+
+/*!	\brief		Load the objects; the previous ones are destroyed.
+ *		\details		The objects are loaded by the threads of the pool - not many
+ *						more than the number of the objects justifies - and by the
+ *						calling thread. Every thread takes the next few objects that no
+ *						other thread took yet, until none are left.
+ *		\param[in]	count		Number of the objects.
+ *		\param[in]	pool		The threads; if \c NULL, the calling thread loads all.
+ *		\returns		\c B_OK if the batch was filled, even if some objects failed.
+ */
+status_t		ObjectBatch::_Load( int32 count, WorkerPool* pool )
+{
+	status_t		status;
+	int32			threads;
+
+	if ( ( status = _Allocate( count ) ) != B_OK ) { return status; }
+	if ( count == 0 ) { return B_OK; }
+
+	fNext = 0;
+	threads = ( count + kMinObjectsPerThread - 1 ) / kMinObjectsPerThread;
+	if ( pool && threads > 1 ) {
+		pool->Run( _LoadThread, this, threads );
+	} else {
+		_LoadThread( this );
+	}
+	return B_OK;
+}	// <-- end of function ObjectBatch::_Load
+
+
+
+/*!	\brief		Make room for the objects; no object is constructed.
+ */
+status_t		ObjectBatch::_Allocate( int32 count )
+{
+	MakeEmpty();
+	if ( count < 0 ) { return B_BAD_VALUE; }
+	if ( count == 0 ) { return B_OK; }
+
+	fArena = ( uint8* )malloc( count * fObjectSize );
+	fStatus = new ( std::nothrow ) status_t[ count ];
+	if ( !fArena || !fStatus ) {
+		free( fArena );
+		delete [] fStatus;
+		fArena = NULL;
+		fStatus = NULL;
+		return B_NO_MEMORY;
+	}
+	for ( int32 i = 0; i < count; ++i ) {
+		fStatus[ i ] = B_NO_INIT;
+	}
+	fCount = count;
+	return B_OK;
+}	// <-- end of function ObjectBatch::_Allocate
+
+
+
+/*!	\brief		Work of every loading thread.
+ */
+void		ObjectBatch::_LoadThread( void* data )
+{
+	ObjectBatch*	me = ( ObjectBatch* )data;
+	int32				first, last;
+
+	while ( ( first = atomic_add( &me->fNext, kObjectChunkSize ) ) < me->fCount )
+	{
+		last = first + kObjectChunkSize;
+		if ( last > me->fCount ) {
+			last = me->fCount;
+		}
+		for ( int32 i = first; i < last; ++i ) {
+			me->fStatus[ i ] = me->_LoadItem( me->fArena + i * me->fObjectSize, i );
+		}
+	}
+}	// <-- end of function ObjectBatch::_LoadThread
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _OBJECT_BATCH_H_
+#define _OBJECT_BATCH_H_
+
+// OS includes
+#include <SupportDefs.h>
+
+class WorkerPool;
+
+
+/*!	\brief		Objects of one class, loaded together by a WorkerPool.
+ *		\details		All the objects are constructed in place in one block of memory,
+ *						and the object at every index is loaded from the input at the
+ *						same index, whichever thread loads it. The loading of every object
+ *						may fail separately; StatusAt() tells the result.
+ *
+ *						A derived class tells how an object is loaded and destroyed. It
+ *						must call MakeEmpty() in its destructor - the objects can't be
+ *						destroyed by this class's destructor any more.
+ */
+class ObjectBatch
+{
+public:
+	ObjectBatch( size_t objectSize );
+	virtual ~ObjectBatch();
+
+	virtual int32			CountItems() const { return fCount; }
+	virtual status_t		StatusAt( int32 index ) const;
+	virtual void			MakeEmpty();
+
+protected:
+	virtual status_t		_Load( int32 count, WorkerPool* pool );
+	virtual status_t		_Allocate( int32 count );
+	virtual void*			_ItemAt( int32 index ) const;
+
+	/*!	\brief		Construct and load the object at the index, in the memory.
+	 *		\details		Called by several threads at once, for different indexes. If the
+	 *						object can't be loaded, nothing may stay constructed there.
+	 */
+	virtual status_t		_LoadItem( void* memory, int32 index ) = 0;
+
+	/*!	\brief		Destroy the object that was loaded in the memory.
+	 */
+	virtual void			_DestroyItem( void* memory ) = 0;
+
+	static  void			_LoadThread( void* data );
+
+	size_t		fObjectSize;
+	uint8*		fArena;		//!< Room for \c fCount objects.
+	status_t*	fStatus;		//!< Result of loading every object; the object exists if \c B_OK.
+	int32			fCount;
+	int32			fNext;		//!< The first object no thread took yet.
+};	// <-- end of class ObjectBatch
+
+
+#endif // _OBJECT_BATCH_H_
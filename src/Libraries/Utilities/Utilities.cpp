@@ -14,6 +14,7 @@
 #include <List.h>
 #include <Message.h>
 #include <MimeType.h>
+#include <Node.h>
 #include <Roster.h>
 #include <Size.h>
 #include <String.h>
@@ -22,6 +23,7 @@
 #include <Volume.h>
 #include <VolumeRoster.h>
 
+#include <fs_attr.h>
 #include <fs_index.h>
 
 // Project includes
@@ -272,6 +274,10 @@ BMessage global_Preferences( kGlobalPreferences );
  *--------------------------------------------------------------------------------*/
 
 /*!	\brief		This array is the array of the defined attributes.
+ *		\details		"EVNT:private", "EVNT:verified", "EVNT:whole_day", "EVNT:type",
+ *						"EVNT:start_TR", "EVNT:event_activity", "EVNT:reminder_activity"
+ *						and the rules are kept in "EVNT:record" now. They are still
+ *						registered, because the files of the older versions have them.
  */
 struct DefaultAttribute AttributesArray[] = {
 	// internalName				humanReadable			type					public	editable	indexed		width
@@ -283,17 +289,19 @@ struct DefaultAttribute AttributesArray[] = {
 	{  "EVNT:whole_day",			"Lasts whole days",	B_UINT32_TYPE,		false,	false,	false,		70		},
 	{	"EVNT:type",				"Event type",			B_UINT32_TYPE,		false,	false,	false,		70		},
 	{	"EVNT:cal_module",		"Calendar module ID",B_STRING_TYPE,		true,		false,	false,		255	},
-	{	"EVNT:duration",			"Duration",				B_UINT32_TYPE,		true,		false,	true,			50	},
-	{	"EVNT:next_occurrence",	"Next occurrence",	B_UINT32_TYPE,		false,	false,	true,			70	},
+	{	"EVNT:duration",			"Duration",				B_INT64_TYPE,		true,		false,	true,			50	},
+	{	"EVNT:next_occurrence",	"Next occurrence",	B_INT64_TYPE,		false,	false,	true,			70	},
 	{	"EVNT:and_rules",			"Inclusion rules",	B_RAW_TYPE,			false,	false,	false,		70	},
 	{	"EVNT:not_rules",			"Exclusion rules",	B_RAW_TYPE,			false,	false,	false,		70	},
 	{	"EVNT:start_TR",			"Start time",			B_RAW_TYPE,			false,	false,	false,		70	},
 	{	"EVNT:event_activity",	"Event Activity",		B_RAW_TYPE,			false,	false,	false,		70	},
 	{	"EVNT:activity_fired",	"Activity fired",		B_UINT32_TYPE,		true,		false,	true,			70	},
-	{	"EVNT:reminder_offset",	"Reminder offset",	B_UINT32_TYPE,		true,		false,	false,		70 },
-	{	"EVNT:next_reminder",	"Next reminder",		B_UINT32_TYPE,		false,	false,	true,			70	},
+	{	"EVNT:reminder_offset",	"Reminder offset",	B_INT64_TYPE,		true,		false,	false,		70 },
+	{	"EVNT:next_reminder",	"Next reminder",		B_INT64_TYPE,		false,	false,	true,			70	},
 	{	"EVNT:reminder_activity","Reminder Acitivty",B_RAW_TYPE,			false,	false,	false,		70	},
 	{	"EVNT:reminder_fired",	"Reminder fired",		B_UINT32_TYPE,		true,		false,	true,			70	},
+	{	"EVNT:next_due",			"Next due",				B_INT64_TYPE,		false,	false,	true,			70	},
+	{	"EVNT:record",				"Event record",		B_RAW_TYPE,			false,	false,	false,		70	},
 	
 	{	NULL,							NULL,						B_ANY_TYPE,			false,	false,	false,		0	}
 };	// <-- end of AttributesArray
@@ -470,27 +478,54 @@ void 		utl_RegisterFileType( void )
 	
 	mimeType.SetAttrInfo( &attributes );
 	
-	// Index all indexable attributes on boot volume only
-	BVolume bootVolume;
+	// Index all indexable attributes on every volume that supports queries -
+	// Events may be stored on any of them
+	BVolume volume;
 	BVolumeRoster volumeRoster;
-	volumeRoster.GetBootVolume( &bootVolume );
-	i = 0;
+	while ( volumeRoster.GetNextVolume( &volume ) == B_OK )
+	{
+		if ( volume.KnowsQuery() ) {
+			utl_CreateIndexesOnVolume( volume );
+		}
+	}
+
+}	// <-- end of function utl_RegisterFileType
+
+
+
+/*!	\brief		Creates the indexes of the indexable Event attributes on a volume.
+ *		\details		Indexes that already exist with the right type are not touched.
+ *						An index of another type (the time attributes used to be 32-bit)
+ *						is removed and created again. The new index contains only the
+ *						attributes written after it was created - the Event server
+ *						rewrites the old ones; see VolumeQuery::MigrateTimeAttributes().
+ *		\param[in]	volume		The volume to work on.
+ */
+void		utl_CreateIndexesOnVolume( const BVolume& volume )
+{
+	int i = 0;
+	BString sb;
+	status_t	error;
 	index_info		checkIfIndexIsInstalled;
+	
 	while ( AttributesArray[ i ].internalName != NULL )
 	{
 		if ( AttributesArray[ i ].indexedAttr )
 		{
 			// Check - if this index is already installed, no need to install it again.
-			error = fs_stat_index( bootVolume.Device(),
+			error = fs_stat_index( volume.Device(),
 							 			  AttributesArray[ i ].internalName,
 							 			  &checkIfIndexIsInstalled	);
 			if ( error == B_OK ) {
-				++i;
-				continue;
+				if ( checkIfIndexIsInstalled.type == AttributesArray[ i ].type ) {
+					++i;
+					continue;
+				}
+				fs_remove_index( volume.Device(), AttributesArray[ i ].internalName );
 			}
 
 			// The index was not installed, so try to install it
-			if ( 0 != ( error = fs_create_index( bootVolume.Device(),
+			if ( 0 != ( error = fs_create_index( volume.Device(),
 															 AttributesArray[ i ].internalName,
 															 AttributesArray[ i ].type,
 															 0 ) ) ) 		// Flags are always 0
@@ -520,4 +555,61 @@ void 		utl_RegisterFileType( void )
 		++i;
 	}
 
-}	// <-- end of function utl_RegisterFileType
+}	// <-- end of function utl_CreateIndexesOnVolume
+
+
+
+/*!	\brief		Read an attribute that holds time or time difference, in seconds.
+ *		\details		The time attributes are 64-bit. Files saved by the older versions
+ *						have them as 32-bit unsigned numbers; such values are extended.
+ *						The type of the attribute isn't checked: its size tells which
+ *						one it is, so only one call is needed.
+ *		\param[in]	node		The Event file.
+ *		\param[in]	name		Name of the attribute.
+ *		\param[out]	out		The value.
+ */
+status_t		utl_ReadTimeAttr( BNode* node, const char* name, int64* out )
+{
+	int64		value = 0;
+	uint32	legacyValue;
+	ssize_t	readSize;
+	
+	if ( !node || !name || !out ) { return B_BAD_VALUE; }
+	
+	readSize = node->ReadAttr( name, B_INT64_TYPE, 0, &value, sizeof( int64 ) );
+	if ( readSize < 0 ) {
+		return ( status_t )readSize;
+	}
+	if ( readSize == sizeof( int64 ) ) {
+		*out = value;
+	} else if ( readSize == sizeof( uint32 ) ) {
+		memcpy( &legacyValue, &value, sizeof( uint32 ) );
+		*out = ( int64 )legacyValue;
+	} else {
+		return B_BAD_DATA;
+	}
+	return B_OK;
+}	// <-- end of function utl_ReadTimeAttr
+
+
+
+/*!	\brief		Write an attribute that holds time or time difference, in seconds.
+ *		\details		A 32-bit attribute of the older versions is removed first, so the
+ *						new value gets into the 64-bit index.
+ */
+status_t		utl_WriteTimeAttr( BNode* node, const char* name, int64 value )
+{
+	attr_info	info;
+	ssize_t		written;
+	
+	if ( !node || !name ) { return B_BAD_VALUE; }
+	
+	if ( node->GetAttrInfo( name, &info ) == B_OK && info.type != B_INT64_TYPE ) {
+		node->RemoveAttr( name );
+	}
+	written = node->WriteAttr( name, B_INT64_TYPE, 0, &value, sizeof( int64 ) );
+	if ( written < 0 ) {
+		return ( status_t )written;
+	}
+	return ( written == sizeof( int64 ) ) ? B_OK : B_IO_ERROR;
+}	// <-- end of function utl_WriteTimeAttr
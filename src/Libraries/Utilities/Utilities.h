@@ -7,7 +7,9 @@
 
 #include <Alert.h>
 #include <GraphicsDefs.h>
+#include <Node.h>
 #include <SupportDefs.h>
+#include <Volume.h>
 
 //  #include "TimeRepresentation.h"
 // #include "CalendarModule.h"
@@ -59,6 +61,13 @@ extern BMessage global_Preferences;		//!< Message with all existing preferences.
 	/* Register the application's filetype if it isn't already registered. */
 void	utl_RegisterFileType( void );
 
+	/* Create the indexes of the Event attributes on a volume, if they're missing. */
+void	utl_CreateIndexesOnVolume( const BVolume& volume );
+
+	/* Read and write the 64-bit time attributes of the Event files. */
+status_t	utl_ReadTimeAttr( BNode* node, const char* name, int64* out );
+status_t	utl_WriteTimeAttr( BNode* node, const char* name, int64 value );
+
 	/* Check if the string is valid */
 bool 	utl_CheckStringValidity( BString& input );
 
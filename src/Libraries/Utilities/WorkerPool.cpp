@@ -0,0 +1,175 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Project includes
+#include "WorkerPool.h"
+
+// OS includes
+#include <Autolock.h>
+
+// C++ includes
+#include <new>
+
+
+
+/*---------------------------------------------------------------------------
+ *			Implementation of class WorkerPool
+ *--------------------------------------------------------------------------*/
+
+/*!	\brief		Constructor - no thread is started yet.
+ *		\param[in]	name			Name of the threads.
+ *		\param[in]	maxThreads	The most threads a job may use, including the one
+ *										that runs it. See LimitToCPUs().
+ *		\param[in]	priority		Priority of the threads.
+ */
+WorkerPool::WorkerPool( const char* name, int32 maxThreads, int32 priority )
+	:
+	fRunLock( "Worker pool" ),
+	fName( name ),
+	fPriority( priority ),
+	fMaxThreads( maxThreads ),
+	fThreads( NULL ),
+	fThreadsCount( 0 ),
+	fStartSem( -1 ),
+	fDoneSem( -1 ),
+	fFunction( NULL ),
+	fJob( NULL )
+{
+	if ( fMaxThreads < 1 ) {
+		fMaxThreads = 1;
+	}
+	if ( fMaxThreads > 1 ) {
+		fThreads = new ( std::nothrow ) thread_id[ fMaxThreads - 1 ];
+		if ( !fThreads ) {
+			fMaxThreads = 1;
+		}
+	}
+}	// <-- end of constructor
+
+
+
+/*!	\brief		Destructor - stops the threads.
+ *		\details		Deleting the semaphore wakes the waiting threads up with an error,
+ *						which tells them to quit.
+ */
+WorkerPool::~WorkerPool()
+{
+	status_t		threadStatus;
+
+	if ( fStartSem >= B_OK ) {
+		delete_sem( fStartSem );
+	}
+	for ( int32 i = 0; i < fThreadsCount; ++i ) {
+		wait_for_thread( fThreads[ i ], &threadStatus );
+	}
+	if ( fDoneSem >= B_OK ) {
+		delete_sem( fDoneSem );
+	}
+	delete [] fThreads;
+}	// <-- end of destructor
+
+
+
+/*!	\brief		Run the job in several threads, and wait until it's done.
+ *		\param[in]	function		Called by every thread that works on the job.
+ *		\param[in]	job			Passed to the function.
+ *		\param[in]	threads		How many threads should work, including the calling
+ *										one. There may be less of them - at least the calling
+ *										thread runs the job.
+ *		\returns		The number of threads that worked on the job.
+ */
+int32		WorkerPool::Run( WorkerFunction function, void* job, int32 threads )
+{
+	int32		helpers;
+
+	if ( !function ) { return 0; }
+	if ( threads > fMaxThreads ) {
+		threads = fMaxThreads;
+	}
+
+	BAutolock	lock( fRunLock );
+
+	helpers = ( threads > 1 ) ? _StartThreads( threads - 1 ) : 0;
+	fFunction = function;
+	fJob = job;
+	for ( int32 i = 0; i < helpers; ++i ) {
+		release_sem( fStartSem );
+	}
+
+	function( job );
+
+	for ( int32 i = 0; i < helpers; ++i ) {
+		acquire_sem( fDoneSem );
+	}
+	return helpers + 1;
+}	// <-- end of function WorkerPool::Run
+
+
+
+/*!	\brief		The number of threads, but not more than there are CPUs.
+ *		\details		Threads that only compute don't help when there are more of them
+ *						than CPUs.
+ */
+int32		WorkerPool::LimitToCPUs( int32 threads )
+{
+	system_info		info;
+
+	if ( get_system_info( &info ) == B_OK && ( int32 )info.cpu_count < threads ) {
+		threads = ( int32 )info.cpu_count;
+	}
+	return ( threads < 1 ) ? 1 : threads;
+}	// <-- end of function WorkerPool::LimitToCPUs
+
+
+
+/*!	\brief		Make sure there are enough threads waiting for a job.
+ *		\returns		How many threads are there, up to the count.
+ */
+int32		WorkerPool::_StartThreads( int32 count )
+{
+	thread_id	thread;
+
+	if ( fStartSem < B_OK ) {
+		fStartSem = create_sem( 0, "Worker pool start" );
+		fDoneSem = create_sem( 0, "Worker pool done" );
+		if ( fStartSem < B_OK || fDoneSem < B_OK ) {
+			if ( fStartSem >= B_OK ) { delete_sem( fStartSem ); }
+			if ( fDoneSem >= B_OK ) { delete_sem( fDoneSem ); }
+			fStartSem = fDoneSem = -1;
+			return 0;
+		}
+	}
+
+	while ( fThreadsCount < count )
+	{
+		thread = spawn_thread( _WorkerThread, fName.String(), fPriority, this );
+		if ( thread < B_OK ) {
+			// The job is done by the threads that did start
+			break;
+		}
+		if ( resume_thread( thread ) != B_OK ) {
+			kill_thread( thread );
+			break;
+		}
+		fThreads[ fThreadsCount++ ] = thread;
+	}
+	return ( fThreadsCount < count ) ? fThreadsCount : count;
+}	// <-- end of function WorkerPool::_StartThreads
+
+
+
+/*!	\brief		Main function of the threads: work on a job every time they are woken.
+ */
+int32		WorkerPool::_WorkerThread( void* data )
+{
+	WorkerPool*		me = ( WorkerPool* )data;
+
+	while ( acquire_sem( me->fStartSem ) == B_OK )
+	{
+		me->fFunction( me->fJob );
+		release_sem( me->fDoneSem );
+	}
+	return B_OK;
+}	// <-- end of function WorkerPool::_WorkerThread
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+// OS includes
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+
+/*!	\brief		Function that works on a job of a WorkerPool.
+ *		\details		Every thread that works on the job calls it with the same
+ *						argument, so the threads must share the work between them -
+ *						usually by taking the next part of it from an atomic counter.
+ */
+typedef void	( *WorkerFunction )( void* job );
+
+
+
+/*!	\brief		Threads that work on a job together, and wait for the next one.
+ *		\details		The threads are started when a job needs them for the first time,
+ *						and are kept until the pool is deleted, so a job doesn't pay for
+ *						starting them. Between the jobs they wait on a semaphore.
+ *
+ *						The thread that runs the job works on it too, and Run() returns
+ *						when all threads are done with it. The jobs run one at a time;
+ *						a thread that calls Run() while another job runs waits for it.
+ */
+class WorkerPool
+{
+public:
+	WorkerPool( const char* name, int32 maxThreads, int32 priority = B_NORMAL_PRIORITY );
+	virtual ~WorkerPool();
+
+	virtual int32		Run( WorkerFunction function, void* job, int32 threads );
+	virtual int32		MaxThreads() const { return fMaxThreads; }
+	virtual int32		CountThreads() const { return fThreadsCount; }
+
+	static  int32		LimitToCPUs( int32 threads );
+
+protected:
+	static int32		_WorkerThread( void* data );
+	virtual int32		_StartThreads( int32 count );
+
+	BLocker			fRunLock;			//!< Lets one job run at a time.
+	BString			fName;
+	int32				fPriority;
+	int32				fMaxThreads;		//!< Including the thread that runs the job.
+	thread_id*		fThreads;			//!< The started threads; room for \c fMaxThreads - 1.
+	int32				fThreadsCount;
+	sem_id			fStartSem;			//!< Released once for every thread that should work.
+	sem_id			fDoneSem;			//!< Released by every thread that is done.
+	WorkerFunction	fFunction;			//!< The job that runs now.
+	void*				fJob;
+};	// <-- end of class WorkerPool
+
+
+#endif // _WORKER_POOL_H_
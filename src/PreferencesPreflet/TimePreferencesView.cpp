@@ -15,6 +15,8 @@
 #include <Layout.h>
 #include <LayoutItem.h>
 #include <InterfaceDefs.h>
+#include <MenuItem.h>
+#include <PopUpMenu.h>
 #include <Rect.h>
 #include <SeparatorItem.h>
 #include <View.h>
@@ -40,7 +42,9 @@ TimePreferencesView::TimePreferencesView( BRect frame )
 		   B_WILL_DRAW | B_FRAME_EVENTS ),
 	use24hClock( NULL ),
 	defaultAppointmentDuration( NULL ),
-	defaultReminderTime( NULL )
+	defaultReminderTime( NULL ),
+	defaultSnoozeTime( NULL ),
+	overduePolicy( NULL )
 {
 	int time1, time2;
 	TimePreferences* TimePrefs = pref_GetTimePreferences();
@@ -152,6 +156,46 @@ TimePreferencesView::TimePreferencesView( BRect frame )
 		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_LEFT, B_ALIGN_TOP ) );
 	}
 	
+	// Overdue activities policy
+	const char* policyNames[] = { "Show only the summary",
+											"Run the Event activities",
+											"Run all activities" };
+	BPopUpMenu* policyMenu = new BPopUpMenu( "OverduePolicyChooser" );
+	BMenuItem* toAdd = NULL;
+	if ( ! policyMenu ) {
+		/* Panic! */
+		exit( 1 );
+	}
+	for ( int32 i = OVERDUE_SUMMARY_ONLY; i <= OVERDUE_RUN_ALL; ++i ) {
+		toSend = new BMessage( kOverduePolicyChanged );
+		if ( ! toSend ) {
+			/* Panic! */
+			exit( 1 );
+		}
+		toSend->AddInt32( "Policy", i );
+		toAdd = new BMenuItem( policyNames[ i ], toSend );
+		if ( ! toAdd ) {
+			/* Panic! */
+			exit( 1 );
+		}
+		policyMenu->AddItem( toAdd );
+		if ( i == ( int32 )TimePrefs->GetOverduePolicy() ) {
+			toAdd->SetMarked( true );
+		}
+	}
+	this->overduePolicy = new BMenuField( BRect( 0, 0, 1, 1 ),
+													  "Overdue policy chooser",
+													  "Activities that were missed:",
+													  policyMenu );
+	if ( ! this->overduePolicy ) {
+		/* Panic! */
+		exit( 1 );
+	}
+	this->overduePolicy->ResizeToPreferred();
+	if ( ( layoutItem = groupLayout->AddView( this->overduePolicy ) ) != NULL )
+	{
+		layoutItem->SetExplicitAlignment( BAlignment( B_ALIGN_LEFT, B_ALIGN_TOP ) );
+	}
 	
 }	// <-- end of constructor for TimePreferencesView
 
@@ -189,6 +233,12 @@ TimePreferencesView::~TimePreferencesView()
 		delete defaultSnoozeTime;
 		defaultSnoozeTime = NULL;
 	}
+	
+	if ( overduePolicy ) {
+		overduePolicy->RemoveSelf();
+		delete overduePolicy;
+		overduePolicy = NULL;
+	}
 }	// <-- end of destructor	   
 
 
@@ -208,6 +258,7 @@ void		TimePreferencesView::AttachedToWindow()
 	defaultAppointmentDuration->SetTarget( this );
 	defaultReminderTime->SetTarget( this );
 	defaultSnoozeTime->SetTarget( this );
+	overduePolicy->Menu()->SetTargetForItems( this );
 }	// <-- end of function TimePreferencesView::AttachedToWindow()
 
 
@@ -218,6 +269,7 @@ void		TimePreferencesView::MessageReceived( BMessage* in )
 {
 	TimePreferences* prefs = pref_GetTimePreferences();
 	int hours = 0, mins = 0;
+	int32 policy;
 	if ( !prefs )
 	{
 		/* Panic! */
@@ -259,6 +311,12 @@ void		TimePreferencesView::MessageReceived( BMessage* in )
 			prefs->SetDefaultSnoozeTime( hours, mins );
 			break;
 		
+		case kOverduePolicyChanged:
+			if ( in->FindInt32( "Policy", &policy ) == B_OK ) {
+				prefs->SetOverduePolicy( ( OverduePolicy )policy );
+			}
+			break;
+		
 		default:
 			BView::MessageReceived( in );	
 	}
@@ -11,6 +11,7 @@
 
 // OS includes
 #include <CheckBox.h>
+#include <MenuField.h>
 #include <GraphicsDefs.h>
 #include <InterfaceDefs.h>
 #include <Message.h>
@@ -28,6 +29,7 @@ const uint32	k24hClockToggled					= '24CI';
 const	uint32	kAppointmentDurationChanged	= 'ApDC';
 const uint32	kReminderTimeChanged				= 'RmTC';
 const uint32	kSnoozeTimeChanged				= 'SnTC';
+const uint32	kOverduePolicyChanged			= 'OvPC';
 
 
 class TimePreferencesView
@@ -47,6 +49,7 @@ class TimePreferencesView
 		GeneralHourMinControl* defaultAppointmentDuration;
 		GeneralHourMinControl* defaultReminderTime;
 		GeneralHourMinControl* defaultSnoozeTime;
+		BMenuField* overduePolicy;
 
 };
 
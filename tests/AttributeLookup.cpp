@@ -0,0 +1,187 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		AttributeLookup.cpp
+ *	\brief		The perfect-hash lookup of the Event attributes, against the strcmp chain.
+ *	\details		EventData reads the Event files attribute by attribute, and every
+ *					attribute name is looked up in LookupEventAttribute(). The
+ *					chain of strcmp() calls it replaced is kept here as the reference:
+ *					- every name the chain knows, and many names it doesn't, must get the
+ *					  same answer from both;
+ *					- both are timed over the attribute names of 50,000 Event files.
+ *					Reading the attributes themselves needs BFS, so only the lookup is
+ *					measured.
+ */
+
+// Project includes
+#include "EventAttributes.h"
+#include "TestUtilities.h"
+
+// POSIX includes
+#include <stdio.h>
+#include <string.h>
+
+
+/*!	\brief		Number of Event files in the corpus.
+ */
+const		int32		kCorpusEvents		= 50000;
+
+
+/*!	\brief		Number of random names checked against the chain.
+ */
+const		int32		kRandomNames		= 200000;
+
+
+/*!	\brief		The attributes of an Event file of the older versions, in the order
+ *					they were written.
+ */
+static const char*	kFileAttributes[] = {
+	"BEOS:TYPE",
+	"EVNT:start_TR",
+	"EVNT:next_occurrence",
+	"EVNT:name",
+	"EVNT:category",
+	"EVNT:where",
+	"EVNT:private",
+	"EVNT:verified",
+	"EVNT:type",
+	"EVNT:reminder_offset",
+	"EVNT:next_reminder",
+	"EVNT:duration",
+	"EVNT:and_rules",
+	"EVNT:not_rules",
+	"EVNT:cal_module",
+	"EVNT:event_activity",
+	"EVNT:reminder_activity",
+	"EVNT:activity_fired",
+	"EVNT:reminder_fired",
+	"EVNT:whole_day",
+	"EVNT:next_due"
+};
+const		int32		kFileAttributesCount = sizeof( kFileAttributes ) / sizeof( const char* );
+
+
+/*!	\brief		Names which are close to the decoded ones, but are not.
+ */
+static const char*	kNearMisses[] = {
+	"", "EVNT", "EVNT:", "EVNT:nam", "EVNT:names", "EVNT:Name", "evnt:name",
+	"EVNT:start_tr", "EVNT:record", "EVNT:typ", "EVNT:type ", "XEVNT:type",
+	"EVNT:reminder", "EVNT:activity", "EVNT:private_", "BEOS:M:STD_ICON",
+	"META:name", "EVNT:cal_modulE", "EVNT:wherE", "EVNT:ywe"
+};
+const		int32		kNearMissesCount = sizeof( kNearMisses ) / sizeof( const char* );
+
+
+
+/*!	\brief		The lookup EventData used before - a chain of string comparisons.
+ *		\details		"EVNT:and_rules" and "EVNT:not_rules" were compared too, but they
+ *						are not decoded any more.
+ */
+static EventAttribute	ChainLookup( const char* name )
+{
+	if ( strcmp( name, "EVNT:name" ) == 0 ) { return EVNT_ATTR_NAME; }
+	else if ( strcmp( name, "EVNT:category" ) == 0 ) { return EVNT_ATTR_CATEGORY; }
+	else if ( strcmp( name, "EVNT:where" ) == 0 ) { return EVNT_ATTR_WHERE; }
+	else if ( strcmp( name, "EVNT:private" ) == 0 ) { return EVNT_ATTR_PRIVATE; }
+	else if ( strcmp( name, "EVNT:verified" ) == 0 ) { return EVNT_ATTR_VERIFIED; }
+	else if ( strcmp( name, "EVNT:whole_day" ) == 0 ) { return EVNT_ATTR_WHOLE_DAY; }
+	else if ( strcmp( name, "EVNT:type" ) == 0 ) { return EVNT_ATTR_TYPE; }
+	else if ( strcmp( name, "EVNT:duration" ) == 0 ) { return EVNT_ATTR_DURATION; }
+	else if ( strcmp( name, "EVNT:next_occurrence" ) == 0 ) { return EVNT_ATTR_NEXT_OCCURRENCE; }
+	else if ( strcmp( name, "EVNT:and_rules" ) == 0 ) { return EVNT_ATTR_UNKNOWN; }
+	else if ( strcmp( name, "EVNT:not_rules" ) == 0 ) { return EVNT_ATTR_UNKNOWN; }
+	else if ( strcmp( name, "EVNT:start_TR" ) == 0 ) { return EVNT_ATTR_START_TR; }
+	else if ( strcmp( name, "EVNT:event_activity" ) == 0 ) { return EVNT_ATTR_EVENT_ACTIVITY; }
+	else if ( strcmp( name, "EVNT:activity_fired" ) == 0 ) { return EVNT_ATTR_ACTIVITY_FIRED; }
+	else if ( strcmp( name, "EVNT:reminder_offset" ) == 0 ) { return EVNT_ATTR_REMINDER_OFFSET; }
+	else if ( strcmp( name, "EVNT:reminder_activity" ) == 0 ) { return EVNT_ATTR_REMINDER_ACTIVITY; }
+	else if ( strcmp( name, "EVNT:reminder_fired" ) == 0 ) { return EVNT_ATTR_REMINDER_FIRED; }
+	else if ( strcmp( name, "EVNT:cal_module" ) == 0 ) { return EVNT_ATTR_CAL_MODULE; }
+	return EVNT_ATTR_UNKNOWN;
+}	// <-- end of function ChainLookup
+
+
+
+/*!	\brief		Compare the two lookups on a name.
+ */
+static bool		Check( const char* name )
+{
+	if ( LookupEventAttribute( name ) != ChainLookup( name ) ) {
+		printf( "FAILED: \"%s\" is %d, the chain says %d\n",
+				  name, ( int )LookupEventAttribute( name ), ( int )ChainLookup( name ) );
+		return false;
+	}
+	return true;
+}	// <-- end of function Check
+
+
+
+/*!	\brief		Look up all names of the corpus, as EventData does it.
+ *		\details		Every name is copied to the buffer first, like GetNextAttrName()
+ *						does.
+ *		\returns		Time it took, in microseconds.
+ */
+static bigtime_t	TimeCorpus( EventAttribute ( *lookup )( const char* ), uint32* checksum )
+{
+	char			nameBuffer[ 256 ];
+	bigtime_t	start = NowUsecs();
+	uint32		sum = 0;
+
+	for ( int32 event = 0; event < kCorpusEvents; ++event ) {
+		for ( int32 i = 0; i < kFileAttributesCount; ++i ) {
+			strcpy( nameBuffer, kFileAttributes[ ( i + event ) % kFileAttributesCount ] );
+			sum = sum * 31 + ( uint32 )lookup( nameBuffer );
+		}
+	}
+	*checksum = sum;
+	return NowUsecs() - start;
+}	// <-- end of function TimeCorpus
+
+
+
+int		main()
+{
+	static const char	kAlphabet[] = "abcdefghijklmnopqrstuvwxyz_TR";
+	char			name[ 64 ];
+	uint32		state = 1, hashSum, chainSum;
+	int32			length;
+	bigtime_t	hashTime, chainTime;
+
+	// Every known name, and the near misses
+	for ( int32 i = 0; i < kFileAttributesCount; ++i ) {
+		if ( !Check( kFileAttributes[ i ] ) ) { return 1; }
+	}
+	for ( int32 i = 0; i < kNearMissesCount; ++i ) {
+		if ( !Check( kNearMisses[ i ] ) ) { return 1; }
+	}
+
+	// Random names, which hit all slots of the table
+	for ( int32 i = 0; i < kRandomNames; ++i ) {
+		strcpy( name, "EVNT:" );
+		state = state * 1103515245 + 12345;
+		length = 1 + ( int32 )( ( state >> 16 ) % 20 );
+		for ( int32 j = 0; j < length; ++j ) {
+			state = state * 1103515245 + 12345;
+			name[ 5 + j ] = kAlphabet[ ( state >> 16 ) % ( sizeof( kAlphabet ) - 1 ) ];
+		}
+		name[ 5 + length ] = '\0';
+		if ( !Check( name ) ) { return 1; }
+	}
+
+	chainTime = TimeCorpus( ChainLookup, &chainSum );
+	hashTime = TimeCorpus( LookupEventAttribute, &hashSum );
+	if ( hashSum != chainSum ) {
+		printf( "FAILED: the lookups disagree on the corpus\n" );
+		return 1;
+	}
+
+	printf( "lookup over %d files of %d attributes:\n", ( int )kCorpusEvents,
+			  ( int )kFileAttributesCount );
+	printf( "  strcmp chain: %.0f ns per file, %.0f files per second\n",
+			  chainTime * 1000.0 / kCorpusEvents, kCorpusEvents * 1000000.0 / chainTime );
+	printf( "  perfect hash: %.0f ns per file, %.0f files per second\n",
+			  hashTime * 1000.0 / kCorpusEvents, kCorpusEvents * 1000000.0 / hashTime );
+	return 0;
+}	// <-- end of function main
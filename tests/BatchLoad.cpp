@@ -0,0 +1,257 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		BatchLoad.cpp
+ *	\brief		Loading of many objects at once, as EventData::LoadMany() does it.
+ *	\details		EventDataBatch is an ObjectBatch that constructs EventData from a
+ *					ref. Here the same batch constructs small objects from numbers, and
+ *					fails on some of them, so that the checks don't depend on files:
+ *					- every object is loaded from the input at its own index;
+ *					- the objects that failed are reported, and are not destroyed;
+ *					- every object that was constructed is destroyed exactly once, by
+ *					  MakeEmpty(), by the next load and by the destructor;
+ *					- the pool starts its threads once, and reuses them.
+ *					Then the time of loading small batches with the pool is compared
+ *					with starting the threads for every batch.
+ */
+
+// Project includes
+#include "ObjectBatch.h"
+#include "TestUtilities.h"
+#include "WorkerPool.h"
+
+// OS includes
+#include <OS.h>
+
+// POSIX includes
+#include <pthread.h>
+#include <stdio.h>
+
+// STL includes
+#include <set>
+#include <vector>
+
+
+/*!	\brief		Number of batches of the checks, and the most objects in one.
+ */
+const		int32		kCheckedBatches		= 200;
+const		int32		kMaxBatchSize			= 2000;
+
+
+/*!	\brief		Number and size of the timed batches.
+ */
+const		int32		kTimedBatches			= 2000;
+const		int32		kTimedBatchSize		= 128;
+
+
+/*!	\brief		The inputs that fail to load.
+ */
+static bool		Fails( int32 input ) { return input % 7 == 3; }
+
+
+/*!	\brief		Objects alive now, and all objects ever constructed and destroyed.
+ */
+static int32		sAlive = 0;
+static int32		sConstructed = 0;
+static int32		sDestroyed = 0;
+
+
+/*!	\brief		Threads that loaded objects since the last reset.
+ */
+static pthread_mutex_t				sThreadsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::set< pthread_t >		sThreads;
+
+
+
+/*!	\brief		The loaded object: the input, and a mark of a live object.
+ */
+struct Item {
+	Item( int32 input ) : value( input ), magic( kAliveMagic ) {
+		atomic_add( &sAlive, 1 );
+		atomic_add( &sConstructed, 1 );
+	}
+	~Item() { magic = 0; atomic_add( &sAlive, -1 ); atomic_add( &sDestroyed, 1 ); }
+
+	static const uint32	kAliveMagic = 0x4974656D;
+
+	int32		value;
+	uint32	magic;
+};
+
+
+
+/*!	\brief		Batch of the items, loaded like EventDataBatch loads the Events.
+ */
+class ItemBatch
+	: public ObjectBatch
+{
+public:
+	ItemBatch() : ObjectBatch( sizeof( Item ) ), fInputs( NULL ) {}
+	virtual ~ItemBatch() { MakeEmpty(); }
+
+	Item*			ItemAt( int32 index ) const { return ( Item* )_ItemAt( index ); }
+
+	status_t		Load( const int32* inputs, int32 count, WorkerPool* pool ) {
+		status_t	status;
+
+		fInputs = inputs;
+		status = _Load( count, pool );
+		fInputs = NULL;
+		return status;
+	}
+
+protected:
+	virtual status_t	_LoadItem( void* memory, int32 index ) {
+		Item*		item = new ( memory ) Item( fInputs[ index ] );
+
+		pthread_mutex_lock( &sThreadsLock );
+		sThreads.insert( pthread_self() );
+		pthread_mutex_unlock( &sThreadsLock );
+
+		// As the Events that can't be opened - constructed, and destroyed at once
+		if ( Fails( item->value ) ) {
+			item->~Item();
+			return B_ENTRY_NOT_FOUND;
+		}
+		return B_OK;
+	}
+
+	virtual void		_DestroyItem( void* memory ) {
+		( ( Item* )memory )->~Item();
+	}
+
+	const int32*		fInputs;
+};
+
+
+
+/*!	\brief		Check the batch against its inputs.
+ */
+static bool		CheckBatch( const ItemBatch& batch, const std::vector< int32 >& inputs )
+{
+	int32		loaded = 0;
+
+	CHECK( batch.CountItems() == ( int32 )inputs.size() );
+	for ( int32 i = 0; i < batch.CountItems(); ++i )
+	{
+		if ( Fails( inputs[ i ] ) ) {
+			CHECK( batch.StatusAt( i ) == B_ENTRY_NOT_FOUND );
+			CHECK( batch.ItemAt( i ) == NULL );
+		} else {
+			CHECK( batch.StatusAt( i ) == B_OK );
+			CHECK( batch.ItemAt( i ) != NULL );
+			CHECK( batch.ItemAt( i )->magic == Item::kAliveMagic );
+			CHECK( batch.ItemAt( i )->value == inputs[ i ] );
+			++loaded;
+		}
+	}
+	CHECK( batch.StatusAt( -1 ) == B_BAD_INDEX );
+	CHECK( batch.StatusAt( batch.CountItems() ) == B_BAD_INDEX );
+	CHECK( batch.ItemAt( batch.CountItems() ) == NULL );
+	CHECK( atomic_get( &sAlive ) == loaded );
+	return true;
+}	// <-- end of function CheckBatch
+
+
+
+/*!	\brief		Batches of random sizes, with and without the pool.
+ */
+static bool		CheckBatches()
+{
+	WorkerPool	pool( "Loader", 8 );
+	std::vector< int32 >	inputs;
+	int32			threads = -1, loaded = 0;
+
+	{
+		ItemBatch	batch;
+
+		for ( int32 n = 0; n < kCheckedBatches; ++n )
+		{
+			inputs.resize( ( n == 0 ) ? 0 : Random() % kMaxBatchSize );
+			for ( size_t i = 0; i < inputs.size(); ++i ) {
+				inputs[ i ] = ( int32 )( Random() % 1000000 );
+				if ( !Fails( inputs[ i ] ) ) { ++loaded; }
+			}
+
+			// The previous objects are destroyed by the next load
+			CHECK( batch.Load( inputs.empty() ? NULL : &inputs[ 0 ], inputs.size(),
+									 ( n % 5 == 0 ) ? NULL : &pool ) == B_OK );
+			if ( !CheckBatch( batch, inputs ) ) {
+				printf( "FAILED: batch %d of %d objects\n", ( int )n, ( int )inputs.size() );
+				return false;
+			}
+
+			// The threads are started once, and reused
+			if ( threads < 0 && pool.CountThreads() > 0 ) {
+				threads = pool.CountThreads();
+			}
+			CHECK( threads < 0 || pool.CountThreads() == threads );
+			CHECK( pool.CountThreads() < pool.MaxThreads() );
+
+			if ( n % 7 == 0 ) {
+				batch.MakeEmpty();
+				CHECK( batch.CountItems() == 0 && atomic_get( &sAlive ) == 0 );
+			}
+		}
+	}
+
+	// The destructor destroyed the last batch
+	CHECK( atomic_get( &sAlive ) == 0 );
+	CHECK( atomic_get( &sDestroyed ) == atomic_get( &sConstructed ) );
+	CHECK( ( int32 )sThreads.size() <= pool.MaxThreads() );
+	printf( "%d batches loaded in order by up to %d threads; %d objects loaded, %d failed\n",
+			  ( int )kCheckedBatches, ( int )sThreads.size(), ( int )loaded,
+			  ( int )( atomic_get( &sConstructed ) - loaded ) );
+	return true;
+}	// <-- end of function CheckBatches
+
+
+
+/*!	\brief		Time small batches with a pool that is kept, and with a new one.
+ *		\details		A new pool starts its threads for the batch and stops them after
+ *						it, as LoadMany() did before it kept its threads.
+ */
+static bool		TimeBatches()
+{
+	WorkerPool		pool( "Timed loader", 4 );
+	ItemBatch		batch;
+	std::vector< int32 >	inputs( kTimedBatchSize );
+	bigtime_t		start, keptTime, newTime;
+
+	for ( int32 i = 0; i < kTimedBatchSize; ++i ) {
+		inputs[ i ] = 7 * i + 1;
+	}
+
+	start = NowUsecs();
+	for ( int32 n = 0; n < kTimedBatches; ++n ) {
+		CHECK( batch.Load( &inputs[ 0 ], kTimedBatchSize, &pool ) == B_OK );
+	}
+	keptTime = NowUsecs() - start;
+	CHECK( CheckBatch( batch, inputs ) );
+
+	start = NowUsecs();
+	for ( int32 n = 0; n < kTimedBatches; ++n ) {
+		WorkerPool	newPool( "New loader", 4 );
+		CHECK( batch.Load( &inputs[ 0 ], kTimedBatchSize, &newPool ) == B_OK );
+	}
+	newTime = NowUsecs() - start;
+	CHECK( CheckBatch( batch, inputs ) );
+
+	printf( "%d batches of %d objects, up to %d threads:\n", ( int )kTimedBatches,
+			  ( int )kTimedBatchSize, ( int )pool.MaxThreads() );
+	printf( "  threads kept:    %.1f us per batch\n", ( double )keptTime / kTimedBatches );
+	printf( "  threads started: %.1f us per batch\n", ( double )newTime / kTimedBatches );
+	return true;
+}	// <-- end of function TimeBatches
+
+
+
+int		main()
+{
+	if ( !CheckBatches() || !TimeBatches() ) {
+		return 1;
+	}
+	return 0;
+}	// <-- end of function main
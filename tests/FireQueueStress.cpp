@@ -0,0 +1,268 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		FireQueueStress.cpp
+ *	\brief		The queue between the stages of the FirePipeline, under load.
+ *	\details		Several producers push numbered jobs through the queue to several
+ *					consumers; a small queue is often full and often empty:
+ *					- every job is taken exactly once;
+ *					- every consumer takes the jobs of a producer in the order they
+ *					  were pushed;
+ *					- a closed queue wakes up the blocked threads, refuses new jobs,
+ *					  and gives the jobs left in it to TakeLeftover().
+ *					The time per job and the number of wake-ups are printed.
+ */
+
+// Project includes
+#include "FireQueue.h"
+#include "TestUtilities.h"
+
+// OS includes
+#include <OS.h>
+
+// POSIX includes
+#include <stdio.h>
+
+// STL includes
+#include <vector>
+
+
+/*!	\brief		The job the queue passes; the pipeline's one holds an Event.
+ */
+struct FireJob {
+	int32		producer;
+	int32		sequence;
+};
+
+
+/*!	\brief		Threads, jobs and the size of the queue of the stress run.
+ */
+const		int32		kProducers			= 4;
+const		int32		kConsumers			= 3;
+const		int32		kJobsPerProducer	= 200000;
+
+
+/*!	\brief		Sizes of the queue: one that is always full or empty, and the one
+ *					of the decoding stage.
+ */
+const		int32		kSmallQueueSize	= 16;
+const		int32		kLargeQueueSize	= 256;
+
+
+
+/*!	\brief		The queue, which counts how many times it woke a thread up.
+ */
+class CountingQueue
+	: public FireQueue
+{
+public:
+	CountingQueue( int32 capacity ) : FireQueue( capacity ), fWakes( 0 ) {}
+
+	int32				fWakes;
+
+protected:
+	virtual void		Wake( int32* waiters, sem_id sem ) {
+		int32		before = atomic_get( waiters );
+
+		FireQueue::Wake( waiters, sem );
+		if ( before > 0 ) {
+			atomic_add( &fWakes, 1 );
+		}
+	}
+};
+
+
+
+/*!	\brief		What the threads of the stress run share.
+ */
+struct StressRun {
+	CountingQueue*			queue;
+	std::vector< FireJob >	jobs;				//!< All jobs, by producer and sequence.
+	std::vector< int32 >		taken;			//!< How many times every job was taken.
+	int32							nextProducer;
+	int32							takenCount;
+	int32							orderErrors;
+};
+
+
+
+/*!	\brief		Push the jobs of one producer.
+ */
+static int32		ProducerThread( void* data )
+{
+	StressRun*	run = ( StressRun* )data;
+	int32			producer = atomic_add( &run->nextProducer, 1 );
+
+	for ( int32 i = 0; i < kJobsPerProducer; ++i ) {
+		if ( run->queue->Push( &run->jobs[ producer * kJobsPerProducer + i ] ) != B_OK ) {
+			return B_ERROR;
+		}
+	}
+	return B_OK;
+}	// <-- end of function ProducerThread
+
+
+
+/*!	\brief		Take the jobs until the queue is closed, checking their order.
+ */
+static int32		ConsumerThread( void* data )
+{
+	StressRun*	run = ( StressRun* )data;
+	FireJob*		job;
+	int32			last[ kProducers ];
+
+	for ( int32 i = 0; i < kProducers; ++i ) {
+		last[ i ] = -1;
+	}
+	while ( NULL != ( job = run->queue->Pop() ) )
+	{
+		if ( job->sequence <= last[ job->producer ] ) {
+			atomic_add( &run->orderErrors, 1 );
+		}
+		last[ job->producer ] = job->sequence;
+		atomic_add( &run->taken[ job->producer * kJobsPerProducer + job->sequence ], 1 );
+		atomic_add( &run->takenCount, 1 );
+	}
+	return B_OK;
+}	// <-- end of function ConsumerThread
+
+
+
+/*!	\brief		Many producers and consumers on a queue of the size.
+ */
+static bool		CheckStress( int32 queueSize )
+{
+	CountingQueue	queue( queueSize );
+	StressRun		run;
+	thread_id		producers[ kProducers ], consumers[ kConsumers ];
+	status_t			status;
+	bigtime_t		start, elapsed;
+	int32				total = kProducers * kJobsPerProducer;
+
+	CHECK( queue.InitCheck() == B_OK );
+	run.queue = &queue;
+	run.jobs.resize( total );
+	run.taken.assign( total, 0 );
+	run.nextProducer = 0;
+	run.takenCount = 0;
+	run.orderErrors = 0;
+	for ( int32 i = 0; i < total; ++i ) {
+		run.jobs[ i ].producer = i / kJobsPerProducer;
+		run.jobs[ i ].sequence = i % kJobsPerProducer;
+	}
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kConsumers; ++i ) {
+		consumers[ i ] = spawn_thread( ConsumerThread, "Consumer", B_NORMAL_PRIORITY, &run );
+		resume_thread( consumers[ i ] );
+	}
+	for ( int32 i = 0; i < kProducers; ++i ) {
+		producers[ i ] = spawn_thread( ProducerThread, "Producer", B_NORMAL_PRIORITY, &run );
+		resume_thread( producers[ i ] );
+	}
+	for ( int32 i = 0; i < kProducers; ++i ) {
+		wait_for_thread( producers[ i ], &status );
+		CHECK( status == B_OK );
+	}
+
+	// Let the consumers drain the queue before it's closed
+	while ( atomic_get( &run.takenCount ) < total ) {
+		snooze( 1000 );
+	}
+	elapsed = NowUsecs() - start;
+
+	queue.Close();
+	for ( int32 i = 0; i < kConsumers; ++i ) {
+		wait_for_thread( consumers[ i ], &status );
+	}
+
+	CHECK( run.orderErrors == 0 );
+	for ( int32 i = 0; i < total; ++i ) {
+		CHECK( run.taken[ i ] == 1 );
+	}
+	CHECK( queue.TakeLeftover() == NULL );
+
+	printf( "%d jobs through a queue of %d by %d producers and %d consumers: %.0f ns each\n",
+			  ( int )total, ( int )queueSize, ( int )kProducers, ( int )kConsumers,
+			  ( double )elapsed * 1000.0 / total );
+	printf( "  %d wake-ups on the semaphores, %.2f per job\n",
+			  ( int )queue.fWakes, ( double )queue.fWakes / total );
+	return true;
+}	// <-- end of function CheckStress
+
+
+
+/*!	\brief		A blocked thread is woken up by Close().
+ */
+static int32		BlockedPushThread( void* data )
+{
+	static FireJob	job = { 0, 0 };
+
+	return ( ( FireQueue* )data )->Push( &job );
+}	// <-- end of function BlockedPushThread
+
+static int32		BlockedPopThread( void* data )
+{
+	return ( ( FireQueue* )data )->Pop() == NULL ? B_OK : B_ERROR;
+}	// <-- end of function BlockedPopThread
+
+
+
+/*!	\brief		The edges of the queue: empty, full and closed.
+ */
+static bool		CheckEdges()
+{
+	FireQueue		empty( 4 ), full( 4 ), bad( 6 );
+	FireJob			jobs[ 4 ];
+	thread_id		thread;
+	status_t			status;
+	int32				left = 0;
+
+	CHECK( bad.InitCheck() == B_BAD_VALUE );
+	CHECK( empty.Pop( false ) == NULL );
+
+	// An empty queue blocks its consumer until it's closed
+	thread = spawn_thread( BlockedPopThread, "Blocked consumer", B_NORMAL_PRIORITY, &empty );
+	resume_thread( thread );
+	snooze( 20000 );
+	empty.Close();
+	wait_for_thread( thread, &status );
+	CHECK( status == B_OK );
+	CHECK( empty.Push( &jobs[ 0 ] ) == B_NOT_ALLOWED );
+
+	// A full queue blocks its producer until it's closed
+	for ( int32 i = 0; i < 4; ++i ) {
+		CHECK( full.Push( &jobs[ i ] ) == B_OK );
+	}
+	CHECK( full.Pop( false ) == &jobs[ 0 ] );
+	CHECK( full.Push( &jobs[ 0 ] ) == B_OK );
+	thread = spawn_thread( BlockedPushThread, "Blocked producer", B_NORMAL_PRIORITY, &full );
+	resume_thread( thread );
+	snooze( 20000 );
+	full.Close();
+	wait_for_thread( thread, &status );
+	CHECK( status == B_NOT_ALLOWED );
+	CHECK( full.Pop() == NULL );
+
+	// The jobs left in the queue are taken in order
+	CHECK( full.TakeLeftover() == &jobs[ 1 ] );
+	while ( full.TakeLeftover() != NULL ) { ++left; }
+	CHECK( left == 3 );
+
+	printf( "empty, full and closed queues behave\n" );
+	return true;
+}	// <-- end of function CheckEdges
+
+
+
+int		main()
+{
+	if ( !CheckEdges() || !CheckStress( kSmallQueueSize ) ||
+		  !CheckStress( kLargeQueueSize ) )
+	{
+		return 1;
+	}
+	return 0;
+}	// <-- end of function main
@@ -0,0 +1,375 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		JournalTest.cpp
+ *	\brief		JournalEventStorage: recovery, tombstones, compaction and the cold start.
+ *	\details		The journal must give back exactly what was committed, also after
+ *					it's reopened:
+ *					- the last version of every Event, and no deleted ones;
+ *					- nothing for a node that was created but never written;
+ *					- everything before a record that was torn by a crash, which is
+ *					  cut off;
+ *					- the same Events after a compaction, explicit or in the background,
+ *					  in a smaller journal.
+ *					Then a journal of 100,000 Events is opened and its index is built,
+ *					as the server does when it starts.
+ */
+
+// Project includes
+#include "JournalEventStorage.h"
+#include "TestUtilities.h"
+
+// OS includes
+#include <OS.h>
+#include <TypeConstants.h>
+
+// POSIX includes
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+
+/*!	\brief		Number of Events in the recovery checks.
+ */
+const		int32		kEvents					= 200;
+
+
+/*!	\brief		Number of Events in the cold start.
+ */
+const		int32		kColdStartEvents		= 100000;
+
+
+/*!	\brief		How long the background compaction may take, in microseconds.
+ */
+const		bigtime_t	kCompactionTimeout	= 10000000;
+
+
+/*!	\brief		Same as in JournalEventStorage.cpp - the journal isn't compacted
+ *					while the dead records take less.
+ */
+const		off_t		kMinCompactionBytes	= 1024 * 1024;
+
+
+/*!	\brief		Key of the n-th Event.
+ */
+static std::string	KeyOf( int32 n )
+{
+	char		buffer[ 32 ];
+
+	snprintf( buffer, sizeof( buffer ), "event-%d", ( int )n );
+	return std::string( buffer );
+}	// <-- end of function KeyOf
+
+
+
+/*!	\brief		Size of a file, or -1.
+ */
+static off_t		FileSize( const std::string& path )
+{
+	struct stat		info;
+
+	if ( stat( path.c_str(), &info ) != 0 ) { return -1; }
+	return info.st_size;
+}	// <-- end of function FileSize
+
+
+
+/*!	\brief		Write the n-th Event, in its given version.
+ *		\details		Attributes like the ones of a real Event, and a note.
+ */
+static bool		WriteEvent( EventStorage* storage, int32 n, int32 version )
+{
+	EventNode*		node;
+	char				name[ 64 ];
+	int32				type = n % 3;
+	bool				bOk;
+
+	snprintf( name, sizeof( name ), "Event %d, version %d", ( int )n, ( int )version );
+	node = storage->Open( KeyOf( n ).c_str(), B_READ_WRITE | B_CREATE_FILE );
+	bOk = ( node && node->InitCheck() == B_OK &&
+			  node->WriteAttr( "EVNT:name", B_STRING_TYPE, name, strlen( name ) + 1 ) > 0 &&
+			  node->WriteAttr( "EVNT:category", B_STRING_TYPE, "Work", 5 ) == 5 &&
+			  node->WriteAttr( "EVNT:where", B_STRING_TYPE, "Office", 7 ) == 7 &&
+			  node->WriteAttr( "EVNT:type", B_INT32_TYPE, &type, sizeof( type ) ) == sizeof( type ) &&
+			  node->WriteTimeAttr( "EVNT:start", 1300000000LL + n * 3600 ) == B_OK &&
+			  node->WriteTimeAttr( "EVNT:next_due", 1300000000LL + n * 3600 + version ) == B_OK &&
+			  node->SetData( name, strlen( name ) ) == B_OK &&
+			  node->Commit() == B_OK );
+	delete node;
+	return bOk;
+}	// <-- end of function WriteEvent
+
+
+
+/*!	\brief		Check that the n-th Event is there, in its given version.
+ */
+static bool		CheckEvent( EventStorage* storage, int32 n, int32 version )
+{
+	EventNode*		node;
+	BString			name;
+	char				expected[ 64 ], note[ 64 ];
+	int64				time = 0;
+	off_t				size = 0;
+	bool				bOk;
+
+	snprintf( expected, sizeof( expected ), "Event %d, version %d", ( int )n, ( int )version );
+	node = storage->Open( KeyOf( n ).c_str(), B_READ_ONLY );
+	bOk = ( node && node->InitCheck() == B_OK &&
+			  node->ReadAttrString( "EVNT:name", &name ) == B_OK &&
+			  name == expected &&
+			  node->ReadTimeAttr( "EVNT:next_due", &time ) == B_OK &&
+			  time == 1300000000LL + n * 3600 + version &&
+			  node->GetSize( &size ) == B_OK &&
+			  size == ( off_t )strlen( expected ) &&
+			  node->ReadAt( 0, note, sizeof( note ) ) == size &&
+			  memcmp( note, expected, size ) == 0 );
+	if ( !bOk ) {
+		printf( "FAILED: %s is not in version %d\n", KeyOf( n ).c_str(), ( int )version );
+	}
+	delete node;
+	return bOk;
+}	// <-- end of function CheckEvent
+
+
+
+/*!	\brief		Check that the n-th Event is not there.
+ */
+static bool		CheckMissing( EventStorage* storage, int32 n )
+{
+	EventNode*		node = storage->Open( KeyOf( n ).c_str(), B_READ_ONLY );
+	bool				bMissing = ( node && node->InitCheck() != B_OK );
+
+	if ( !bMissing ) {
+		printf( "FAILED: %s was not deleted\n", KeyOf( n ).c_str() );
+	}
+	delete node;
+	return bMissing;
+}	// <-- end of function CheckMissing
+
+
+
+/*!	\brief		Saves, deletions and reopening.
+ *		\details		Every Event is saved twice; every fifth is deleted.
+ */
+static bool		CheckReopen( const std::string& path )
+{
+	JournalEventStorage*	storage;
+	EventNode*		node;
+	std::vector< BString >	keys;
+	off_t				size;
+
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	for ( int32 i = 0; i < kEvents; ++i ) {
+		CHECK( WriteEvent( storage, i, 1 ) );
+	}
+	for ( int32 i = 0; i < kEvents; ++i ) {
+		CHECK( WriteEvent( storage, i, 2 ) );
+	}
+	for ( int32 i = 0; i < kEvents; i += 5 ) {
+		CHECK( storage->Remove( KeyOf( i ).c_str() ) == B_OK );
+	}
+	CHECK( storage->Remove( KeyOf( 0 ).c_str() ) == B_ENTRY_NOT_FOUND );
+
+	// A node that is created, or opened for writing, and never written
+	// adds nothing to the journal
+	size = FileSize( path );
+	node = storage->Open( "never-written", B_READ_WRITE | B_CREATE_FILE );
+	CHECK( node && node->InitCheck() == B_OK );
+	delete node;
+	node = storage->Open( KeyOf( 1 ).c_str(), B_READ_WRITE );
+	CHECK( node && node->InitCheck() == B_OK );
+	delete node;
+	CHECK( FileSize( path ) == size );
+	CHECK( storage->CountEvents() == kEvents - kEvents / 5 );
+	delete storage;
+
+	// The same after reopening
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	CHECK( storage->CountEvents() == kEvents - kEvents / 5 );
+	for ( int32 i = 0; i < kEvents; ++i ) {
+		if ( i % 5 == 0 ) {
+			CHECK( CheckMissing( storage, i ) );
+		} else {
+			CHECK( CheckEvent( storage, i, 2 ) );
+		}
+	}
+	node = storage->Open( "never-written", B_READ_ONLY );
+	CHECK( node && node->InitCheck() != B_OK );
+	delete node;
+
+	// The index has the times, for the ranges
+	CHECK( storage->ListByRange( "EVNT:start", 1300000000LL, 1300000000LL + 10 * 3600, &keys ) == B_OK );
+	CHECK( keys.size() == 8 );
+	delete storage;
+	return true;
+}	// <-- end of function CheckReopen
+
+
+
+/*!	\brief		A record torn by a crash is cut off.
+ *		\details		The last record is cut in the middle; then a record's checksum
+ *						is damaged. Only the Events before the damage are read, and new
+ *						records are appended right after them.
+ */
+static bool		CheckTornTail( const std::string& path )
+{
+	JournalEventStorage*	storage;
+	off_t				goodSize, tornSize;
+	int				fd;
+	char				garbage = 0x55;
+
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	goodSize = FileSize( path );
+	CHECK( WriteEvent( storage, 1, 3 ) );
+	tornSize = FileSize( path );
+	delete storage;
+
+	CHECK( truncate( path.c_str(), tornSize - 10 ) == 0 );
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	CHECK( FileSize( path ) == goodSize );
+	CHECK( CheckEvent( storage, 1, 2 ) );
+	CHECK( CheckEvent( storage, 2, 2 ) );
+
+	// Appending still works, and the damaged record is overwritten
+	CHECK( WriteEvent( storage, 1, 4 ) );
+	CHECK( FileSize( path ) == tornSize );
+	delete storage;
+
+	// A byte changed inside the last record
+	CHECK( ( fd = open( path.c_str(), O_RDWR ) ) >= 0 );
+	CHECK( pwrite( fd, &garbage, 1, tornSize - 3 ) == 1 );
+	close( fd );
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	CHECK( FileSize( path ) == goodSize );
+	CHECK( CheckEvent( storage, 1, 2 ) );
+	CHECK( storage->CountEvents() == kEvents - kEvents / 5 );
+	delete storage;
+	return true;
+}	// <-- end of function CheckTornTail
+
+
+
+/*!	\brief		Compaction, explicit and in the background.
+ */
+static bool		CheckCompaction( const std::string& path )
+{
+	JournalEventStorage*	storage;
+	off_t				before;
+	int32				version = 10;
+	bigtime_t		start;
+
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+
+	before = FileSize( path );
+	CHECK( storage->Compact() == B_OK );
+	CHECK( FileSize( path ) < before );
+	CHECK( access( ( path + ".compacting" ).c_str(), F_OK ) != 0 );
+	for ( int32 i = 1; i < kEvents; i += 5 ) {
+		CHECK( CheckEvent( storage, i, 2 ) );
+	}
+
+	// Save the Events again and again, until the compaction thread shrinks the journal
+	start = system_time();
+	before = FileSize( path );
+	while ( FileSize( path ) >= before ) {
+		CHECK( system_time() - start < kCompactionTimeout );
+		before = FileSize( path );
+		++version;
+		for ( int32 i = 1; i < kEvents; ++i ) {
+			if ( i % 5 != 0 ) { CHECK( WriteEvent( storage, i, version ) ); }
+		}
+	}
+	CHECK( before >= kMinCompactionBytes );
+	for ( int32 i = 1; i < kEvents; ++i ) {
+		if ( i % 5 != 0 ) { CHECK( CheckEvent( storage, i, version ) ); }
+	}
+	delete storage;
+
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	CHECK( storage->CountEvents() == kEvents - kEvents / 5 );
+	for ( int32 i = 1; i < kEvents; ++i ) {
+		if ( i % 5 != 0 ) { CHECK( CheckEvent( storage, i, version ) ); }
+	}
+	delete storage;
+	return true;
+}	// <-- end of function CheckCompaction
+
+
+
+/*!	\brief		Open a journal of many Events, and find a day of them.
+ */
+static bool		TimeColdStart( const std::string& path )
+{
+	JournalEventStorage*	storage;
+	std::vector< BString >	keys;
+	bigtime_t		start, writeTime, openTime, rangeTime;
+
+	start = system_time();
+	storage = new JournalEventStorage( path.c_str() );
+	CHECK( storage->InitCheck() == B_OK );
+	for ( int32 i = 0; i < kColdStartEvents; ++i ) {
+		CHECK( WriteEvent( storage, i, 1 ) );
+	}
+	delete storage;
+	writeTime = system_time() - start;
+
+	start = system_time();
+	storage = new JournalEventStorage( path.c_str() );
+	openTime = system_time() - start;
+	CHECK( storage->InitCheck() == B_OK );
+	CHECK( storage->CountEvents() == kColdStartEvents );
+
+	start = system_time();
+	CHECK( storage->ListByRange( "EVNT:start", 1300000000LL, 1300000000LL + 24 * 3600, &keys ) == B_OK );
+	rangeTime = system_time() - start;
+	CHECK( keys.size() == 24 );
+	CHECK( CheckEvent( storage, kColdStartEvents - 1, 1 ) );
+	delete storage;
+
+	printf( "%d Events, %.1f MB: %.1f us to save one; opened in %.0f ms, a day found in %.1f ms\n",
+			  ( int )kColdStartEvents, FileSize( path ) / ( 1024.0 * 1024.0 ),
+			  ( double )writeTime / kColdStartEvents, openTime / 1000.0, rangeTime / 1000.0 );
+	return true;
+}	// <-- end of function TimeColdStart
+
+
+
+int		main()
+{
+	char			directory[] = "/tmp/JournalTest.XXXXXX";
+	std::string	path, coldPath;
+	bool			bPassed;
+
+	if ( !mkdtemp( directory ) ) {
+		printf( "FAILED: can't create a temporary directory\n" );
+		return 1;
+	}
+	path = std::string( directory ) + "/Events.journal";
+	coldPath = std::string( directory ) + "/Large.journal";
+
+	bPassed = CheckReopen( path ) &&
+				 CheckTornTail( path ) &&
+				 CheckCompaction( path ) &&
+				 TimeColdStart( coldPath );
+
+	unlink( path.c_str() );
+	unlink( coldPath.c_str() );
+	rmdir( directory );
+	return bPassed ? 0 : 1;
+}	// <-- end of function main
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		RecurrenceExpansion.cpp
+ *	\brief		Expanding 10,000 recurring Events over 10 years, against day-by-day
+ *					checking.
+ *	\details		RecurrenceRule::ExpandDays() calculates the days of a rule from the
+ *					rule. The reference here doesn't calculate anything: it walks the
+ *					days one by one and checks each of them against the definition of
+ *					the rule. Both must give the same days for every rule of a mix like
+ *					a real calendar's - daily, weekly, monthly and yearly rules, with
+ *					intervals, weekdays, days of month, nth weekdays, counts and
+ *					"until" days. Both are timed; the day arithmetic they share is
+ *					checked against gmtime() first.
+ */
+
+// Project includes
+#include "RecurrenceRule.h"
+#include "TestUtilities.h"
+
+// POSIX includes
+#include <stdio.h>
+#include <time.h>
+
+// STL includes
+#include <algorithm>
+#include <vector>
+
+
+/*!	\brief		Number of rules, and the length of the range in years.
+ */
+const		int32		kRules					= 10000;
+const		int32		kRangeYears				= 10;
+
+
+/*!	\brief		Size of the buffer of a rule - enough for a daily rule.
+ */
+const		int32		kCapacity				= kRangeYears * 366 + 1;
+
+
+
+/*!	\brief		A rule with its start, as an Event has it.
+ */
+struct TestRule {
+	RecurrenceRule	rule;
+	int32				startDay;
+};
+
+
+
+/*!	\brief		A random rule, like the ones people create.
+ */
+static void		MakeRule( TestRule* test, int32 firstDay )
+{
+	RecurrenceRule&	rule = test->rule;
+	uint32		kind = Random() % 100;
+	uint8			weekdays;
+
+	test->startDay = firstDay - 730 + ( int32 )( Random() % 1000 );
+
+	if ( kind < 30 ) {
+		rule.SetFrequency( kRecurrenceDaily );
+		rule.SetInterval( 1 + Random() % 3 );
+		if ( Random() % 3 == 0 ) { rule.SetWeekdays( 0x3E ); }		// Monday to Friday
+	} else if ( kind < 65 ) {
+		rule.SetFrequency( kRecurrenceWeekly );
+		rule.SetInterval( 1 + Random() % 2 );
+		if ( Random() % 2 == 0 ) {
+			do { weekdays = ( uint8 )( Random() & 0x7F ); } while ( weekdays == 0 );
+			rule.SetWeekdays( weekdays );
+		}
+	} else if ( kind < 85 ) {
+		rule.SetFrequency( kRecurrenceMonthly );
+		rule.SetInterval( 1 + Random() % 3 );
+		switch ( Random() % 4 ) {
+			case 0:
+				rule.SetMonthDays( ( ( uint32 )1 << ( 1 + Random() % 28 ) ) |
+										 ( ( uint32 )1 << ( 1 + Random() % 28 ) ) );
+				break;
+			case 1:
+				rule.SetMonthDays( kRecurrenceLastDayOfMonth );
+				break;
+			case 2:
+				rule.SetNthWeekday( ( Random() % 5 == 0 ) ? kRecurrenceLastWeek : 1 + Random() % 4 );
+				rule.SetWeekdays( ( uint8 )( 1 << ( Random() % 7 ) ) );
+				break;
+			default:
+				break;		// The day of the start
+		};
+	} else {
+		rule.SetFrequency( kRecurrenceYearly );
+		if ( Random() % 3 == 0 ) { rule.SetMonths( ( uint16 )( ( 1 << ( Random() % 12 ) ) | 1 ) ); }
+		if ( Random() % 4 == 0 ) {
+			rule.SetNthWeekday( 1 + Random() % 4 );
+			rule.SetWeekdays( ( uint8 )( 1 << ( Random() % 7 ) ) );
+		}
+	}
+
+	if ( Random() % 10 == 0 ) { rule.SetCount( 1 + Random() % 200 ); }
+	if ( Random() % 10 == 0 ) { rule.SetUntil( firstDay + ( int32 )( Random() % ( kRangeYears * 365 ) ) ); }
+}	// <-- end of function MakeRule
+
+
+
+/*!	\brief		Check whether the day of month is one of the rule's, by the definition.
+ */
+static bool		IsRuleMonthDay( const RecurrenceRule& rule, int32 startDay, int32 day )
+{
+	int32		year, month, monthDay, startMonthDay, daysInMonth;
+	uint8		weekdays;
+	uint32	monthDays;
+
+	RecurrenceRule::DateFromDay( day, &year, &month, &monthDay );
+	daysInMonth = RecurrenceRule::DaysInMonth( year, month );
+
+	if ( rule.GetNthWeekday() != 0 ) {
+		weekdays = rule.GetWeekdays() ? rule.GetWeekdays()
+												: ( uint8 )( 1 << RecurrenceRule::WeekdayOfDay( startDay ) );
+		if ( !( weekdays & ( 1 << RecurrenceRule::WeekdayOfDay( day ) ) ) ) { return false; }
+		if ( rule.GetNthWeekday() == kRecurrenceLastWeek ) { return monthDay + 7 > daysInMonth; }
+		return ( monthDay - 1 ) / 7 + 1 == rule.GetNthWeekday();
+	}
+
+	if ( ( monthDays = rule.GetMonthDays() ) == 0 ) {
+		RecurrenceRule::DateFromDay( startDay, NULL, NULL, &startMonthDay );
+		monthDays = ( uint32 )1 << startMonthDay;
+	}
+	return ( monthDays & ( ( uint32 )1 << monthDay ) ) ||
+			 ( monthDay == daysInMonth && ( monthDays & kRecurrenceLastDayOfMonth ) );
+}	// <-- end of function IsRuleMonthDay
+
+
+
+/*!	\brief		Check whether the rule occurs on the day, by the definition, without
+ *					the count and the "until".
+ */
+static bool		IsRuleDay( const RecurrenceRule& rule, int32 startDay, int32 day )
+{
+	int32		interval = rule.GetInterval();
+	int32		weekday = RecurrenceRule::WeekdayOfDay( day );
+	int32		startYear, startMonth, year, month, firstWeek;
+	uint8		weekdays;
+	uint16	months;
+
+	if ( day < startDay ) { return false; }
+	RecurrenceRule::DateFromDay( startDay, &startYear, &startMonth, NULL );
+	RecurrenceRule::DateFromDay( day, &year, &month, NULL );
+
+	switch ( rule.GetFrequency() )
+	{
+		case kRecurrenceDaily:
+			return ( day - startDay ) % interval == 0 &&
+					 ( rule.GetWeekdays() == 0 || ( rule.GetWeekdays() & ( 1 << weekday ) ) );
+		case kRecurrenceWeekly:
+			// Weeks start on Monday
+			firstWeek = startDay - ( RecurrenceRule::WeekdayOfDay( startDay ) + 6 ) % 7;
+			weekdays = rule.GetWeekdays() ? rule.GetWeekdays()
+													: ( uint8 )( 1 << RecurrenceRule::WeekdayOfDay( startDay ) );
+			return ( ( day - firstWeek ) / 7 ) % interval == 0 && ( weekdays & ( 1 << weekday ) );
+		case kRecurrenceMonthly:
+			return ( ( year * 12 + month ) - ( startYear * 12 + startMonth ) ) % interval == 0 &&
+					 IsRuleMonthDay( rule, startDay, day );
+		case kRecurrenceYearly:
+			months = rule.GetMonths() ? rule.GetMonths() : ( uint16 )( 1 << ( startMonth - 1 ) );
+			return ( year - startYear ) % interval == 0 &&
+					 ( months & ( 1 << ( month - 1 ) ) ) &&
+					 IsRuleMonthDay( rule, startDay, day );
+	};
+	return false;
+}	// <-- end of function IsRuleDay
+
+
+
+/*!	\brief		The days of the rule in the range, found by checking every day.
+ *		\details		A rule with a count is walked from its start, to count the
+ *						occurrences before the range.
+ */
+static void		ReferenceDays( const TestRule& test, int32 fromDay, int32 toDay,
+										std::vector< int32 >* out )
+{
+	const RecurrenceRule&	rule = test.rule;
+	int32		count = 0;
+	int32		day = ( rule.GetCount() > 0 || fromDay < test.startDay ) ? test.startDay : fromDay;
+
+	out->clear();
+	for ( ; day < toDay && day <= rule.GetUntil(); ++day )
+	{
+		if ( !IsRuleDay( rule, test.startDay, day ) ) { continue; }
+		if ( rule.GetCount() > 0 && ++count > rule.GetCount() ) { break; }
+		if ( day >= fromDay ) { out->push_back( day ); }
+	}
+}	// <-- end of function ReferenceDays
+
+
+
+/*!	\brief		Check the day arithmetic against the C library.
+ */
+static bool		CheckDayArithmetic()
+{
+	struct tm	date;
+	time_t		seconds;
+	int32			year, month, day;
+
+	for ( int32 dayNumber = -25567; dayNumber < 47482; ++dayNumber )		// 1900 to 2100
+	{
+		seconds = ( time_t )dayNumber * 24 * 60 * 60;
+		gmtime_r( &seconds, &date );
+		RecurrenceRule::DateFromDay( dayNumber, &year, &month, &day );
+		if ( year != date.tm_year + 1900 || month != date.tm_mon + 1 || day != date.tm_mday ||
+			  RecurrenceRule::WeekdayOfDay( dayNumber ) != date.tm_wday ||
+			  RecurrenceRule::DayFromDate( year, month, day ) != dayNumber )
+		{
+			printf( "FAILED: day %d is %d-%d-%d, expected %d-%d-%d\n", ( int )dayNumber,
+					  ( int )year, ( int )month, ( int )day,
+					  date.tm_year + 1900, date.tm_mon + 1, date.tm_mday );
+			return false;
+		}
+	}
+	return true;
+}	// <-- end of function CheckDayArithmetic
+
+
+
+int		main()
+{
+	std::vector< TestRule >	rules( kRules );
+	std::vector< int32 >		buffer( kCapacity ), reference;
+	int32			fromDay = RecurrenceRule::DayFromDate( 2012, 1, 1 );
+	int32			toDay = RecurrenceRule::DayFromDate( 2012 + kRangeYears, 1, 1 );
+	int32			count;
+	int64			total = 0, referenceTotal = 0;
+	bigtime_t	start, expandTime, referenceTime = 0;
+
+	if ( !CheckDayArithmetic() ) { return 1; }
+
+	for ( int32 i = 0; i < kRules; ++i ) {
+		MakeRule( &rules[ i ], fromDay );
+	}
+
+	// The rules with a count remember their last day; it's calculated once,
+	// before the timing, as it is for the Events in memory
+	for ( int32 i = 0; i < kRules; ++i ) {
+		rules[ i ].rule.NextDayOnOrAfter( rules[ i ].startDay, fromDay );
+	}
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kRules; ++i ) {
+		total += rules[ i ].rule.ExpandDays( rules[ i ].startDay, fromDay, toDay,
+														 &buffer[ 0 ], kCapacity );
+	}
+	expandTime = NowUsecs() - start;
+
+	for ( int32 i = 0; i < kRules; ++i )
+	{
+		count = rules[ i ].rule.ExpandDays( rules[ i ].startDay, fromDay, toDay, &buffer[ 0 ], kCapacity );
+
+		start = NowUsecs();
+		ReferenceDays( rules[ i ], fromDay, toDay, &reference );
+		referenceTime += NowUsecs() - start;
+		referenceTotal += reference.size();
+
+		if ( count != ( int32 )reference.size() ||
+			  !std::equal( reference.begin(), reference.end(), buffer.begin() ) )
+		{
+			printf( "FAILED: rule %d (frequency %d, interval %d, weekdays 0x%x, month days 0x%x,"
+					  " nth %d, months 0x%x, count %d, until %d, start %d): %d days, expected %d\n",
+					  ( int )i, ( int )rules[ i ].rule.GetFrequency(), ( int )rules[ i ].rule.GetInterval(),
+					  ( unsigned )rules[ i ].rule.GetWeekdays(), ( unsigned )rules[ i ].rule.GetMonthDays(),
+					  ( int )rules[ i ].rule.GetNthWeekday(), ( unsigned )rules[ i ].rule.GetMonths(),
+					  ( int )rules[ i ].rule.GetCount(), ( int )rules[ i ].rule.GetUntil(),
+					  ( int )rules[ i ].startDay, ( int )count, ( int )reference.size() );
+			return 1;
+		}
+	}
+
+	printf( "%d rules over %d years: %lld occurrences\n", ( int )kRules, ( int )kRangeYears,
+			  ( long long )total );
+	printf( "  ExpandDays: %.1f ms, %.1f ns per occurrence\n",
+			  expandTime / 1000.0, expandTime * 1000.0 / total );
+	printf( "  day by day: %.1f ms, %.1f ns per occurrence\n",
+			  referenceTime / 1000.0, referenceTime * 1000.0 / referenceTotal );
+	return 0;
+}	// <-- end of function main
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		RuleCode.cpp
+ *	\brief		The stored code of the recurrence rules: reading, and the speed of
+ *					the queries run straight on it.
+ *	\details		- Every rule written by Flatten() is read back the same, and
+ *					  NextDayInCode() on its code gives the same days as the rule.
+ *					- Damaged code, code of a newer version and unknown instructions
+ *					  are handled as documented.
+ *					Then the next-occurrence queries of typical rules are timed four
+ *					ways: on the rules in memory, on their code with NextDayInCode(),
+ *					by reading the rule from the code before every query, and - the
+ *					form the code replaces - by unflattening the rule from an archived
+ *					BMessage and finding its fields before every query.
+ */
+
+// Project includes
+#include "BinaryRecord.h"
+#include "RecurrenceRule.h"
+#include "TestUtilities.h"
+
+// OS includes
+#include <Message.h>
+
+// POSIX includes
+#include <stdio.h>
+#include <string.h>
+
+// STL includes
+#include <vector>
+
+
+/*!	\brief		Number of random rules in the checks.
+ */
+const		int32		kCheckedRules			= 20000;
+
+
+/*!	\brief		Number of rules and queries in the timed part.
+ */
+const		int32		kTimedRules				= 1000;
+const		int32		kQueries					= 2000000;
+
+
+/*!	\brief		Next-occurrence time the code was designed for, in nanoseconds.
+ */
+const		double	kTargetNanoseconds	= 100.0;
+
+
+/*!	\brief		A random rule; with \c bTypical, one without a count.
+ */
+static void		MakeRule( RecurrenceRule* rule, bool bTypical )
+{
+	switch ( Random() % 4 )
+	{
+		case 0:
+			rule->SetFrequency( kRecurrenceDaily );
+			if ( Random() % 3 == 0 ) { rule->SetWeekdays( 0x3E ); }
+			break;
+		case 1:
+			rule->SetFrequency( kRecurrenceWeekly );
+			if ( Random() % 2 == 0 ) { rule->SetWeekdays( ( uint8 )( 1 + Random() % 0x7F ) ); }
+			break;
+		case 2:
+			rule->SetFrequency( kRecurrenceMonthly );
+			if ( Random() % 3 == 0 ) {
+				rule->SetNthWeekday( ( Random() % 5 == 0 ) ? kRecurrenceLastWeek : 1 + Random() % 4 );
+				rule->SetWeekdays( ( uint8 )( 1 << ( Random() % 7 ) ) );
+			} else if ( Random() % 2 == 0 ) {
+				rule->SetMonthDays( ( ( uint32 )1 << ( 1 + Random() % 31 ) ) | ( Random() & 1 ) );
+			}
+			break;
+		default:
+			rule->SetFrequency( kRecurrenceYearly );
+			if ( Random() % 3 == 0 ) { rule->SetMonths( ( uint16 )( 1 + Random() % 0x0FFF ) ); }
+			break;
+	};
+	if ( Random() % 3 == 0 ) { rule->SetInterval( ( uint16 )( 1 + Random() % 4 ) ); }
+	if ( Random() % 5 == 0 ) { rule->SetUntil( 15000 + ( int32 )( Random() % 5000 ) ); }
+	if ( !bTypical && Random() % 5 == 0 ) { rule->SetCount( 1 + Random() % 50 ); }
+}	// <-- end of function MakeRule
+
+
+
+/*!	\brief		Check whether two rules are the same.
+ */
+static bool		SameRule( const RecurrenceRule& a, const RecurrenceRule& b )
+{
+	return a.GetFrequency() == b.GetFrequency() && a.GetInterval() == b.GetInterval() &&
+			 a.GetWeekdays() == b.GetWeekdays() && a.GetMonthDays() == b.GetMonthDays() &&
+			 a.GetNthWeekday() == b.GetNthWeekday() && a.GetMonths() == b.GetMonths() &&
+			 a.GetCount() == b.GetCount() && a.GetUntil() == b.GetUntil();
+}	// <-- end of function SameRule
+
+
+
+/*!	\brief		Every rule is read back from its code, and queried on it.
+ */
+static bool		CheckRoundTrip()
+{
+	RecurrenceRule	rule, decoded;
+	RecordWriter*	writer;
+	int32				startDay, fromDay;
+	size_t			maxSize = 0;
+
+	for ( int32 i = 0; i < kCheckedRules; ++i )
+	{
+		rule = RecurrenceRule();
+		MakeRule( &rule, false );
+		writer = new RecordWriter();
+		CHECK( rule.Flatten( writer ) == B_OK );
+		if ( writer->Size() > maxSize ) { maxSize = writer->Size(); }
+
+		RecordReader	reader( writer->Buffer(), writer->Size() );
+		decoded = RecurrenceRule();
+		CHECK( decoded.Unflatten( &reader ) == B_OK );
+		CHECK( reader.Remaining() == 0 );
+		CHECK( SameRule( rule, decoded ) );
+
+		startDay = 14000 + ( int32 )( Random() % 2000 );
+		for ( int32 j = 0; j < 5; ++j ) {
+			fromDay = startDay - 10 + ( int32 )( Random() % 3000 );
+			CHECK( RecurrenceRule::NextDayInCode( writer->Buffer(), writer->Size(), startDay, fromDay ) ==
+					 rule.NextDayOnOrAfter( startDay, fromDay ) );
+		}
+		delete writer;
+	}
+	printf( "%d rules read back from their code; the longest code is %d bytes\n",
+			  ( int )kCheckedRules, ( int )maxSize );
+	return true;
+}	// <-- end of function CheckRoundTrip
+
+
+
+/*!	\brief		Damaged code, newer code and unknown instructions.
+ */
+static bool		CheckDamagedCode()
+{
+	RecurrenceRule	rule( kRecurrenceMonthly, 2 ), decoded, untouched( kRecurrenceYearly, 3 );
+	RecordWriter	writer;
+	std::vector< uint8 >	code;
+	static const uint8	kNewerVersion[] = { 2, 0x01, 1, 0x00 };
+	static const uint8	kUnknownOpcode[] = { 1, 0x01, 1, 0x09, 0, 0x00 };
+	static const uint8	kSkippable[] = { 1, 0x01, 1, 0x81, 2, 0xAA, 0xBB, 0x03, 0x04, 0x00, 0x5A };
+	static const uint8	kNoEnd[] = { 1, 0x01, 1, 0x03, 0x04 };
+	static const uint8	kBadPeriod[] = { 1, 0x01, 7, 0x00 };
+
+	rule.SetMonthDays( 0x00010001 );
+	rule.SetCount( 12 );
+	CHECK( rule.Flatten( &writer ) == B_OK );
+	code.assign( ( const uint8* )writer.Buffer(), ( const uint8* )writer.Buffer() + writer.Size() );
+
+	// Every cut of the code is refused, and the rule is left as it was
+	for ( size_t size = 0; size < code.size(); ++size ) {
+		RecordReader	reader( size ? &code[ 0 ] : NULL, size );
+		decoded = untouched;
+		CHECK( decoded.Unflatten( &reader ) == B_BAD_DATA );
+		CHECK( SameRule( decoded, untouched ) );
+		CHECK( RecurrenceRule::NextDayInCode( &code[ 0 ], size, 15000, 15000 ) == kRecurrenceNoDay );
+	}
+
+	{
+		RecordReader	reader( kNewerVersion, sizeof( kNewerVersion ) );
+		CHECK( decoded.Unflatten( &reader ) == B_NOT_SUPPORTED );
+	}
+	{
+		RecordReader	reader( kUnknownOpcode, sizeof( kUnknownOpcode ) );
+		CHECK( decoded.Unflatten( &reader ) == B_BAD_DATA );
+	}
+	{
+		RecordReader	reader( kNoEnd, sizeof( kNoEnd ) );
+		CHECK( decoded.Unflatten( &reader ) == B_BAD_DATA );
+	}
+	{
+		RecordReader	reader( kBadPeriod, sizeof( kBadPeriod ) );
+		CHECK( decoded.Unflatten( &reader ) == B_BAD_DATA );
+	}
+	{
+		// The unknown instruction is skipped; the reader stops after the end
+		RecordReader	reader( kSkippable, sizeof( kSkippable ) );
+		decoded = RecurrenceRule();
+		CHECK( decoded.Unflatten( &reader ) == B_OK );
+		CHECK( decoded.GetFrequency() == kRecurrenceWeekly && decoded.GetWeekdays() == 0x04 );
+		CHECK( reader.Remaining() == 1 );
+	}
+	return true;
+}	// <-- end of function CheckDamagedCode
+
+
+
+/*!	\brief		Archive the rule into the message, one field per member.
+ */
+static void		ArchiveRule( const RecurrenceRule& rule, BMessage* archive )
+{
+	archive->AddInt8( "frequency", ( int8 )rule.GetFrequency() );
+	archive->AddInt16( "interval", ( int16 )rule.GetInterval() );
+	archive->AddInt8( "weekdays", ( int8 )rule.GetWeekdays() );
+	archive->AddInt8( "nth_weekday", rule.GetNthWeekday() );
+	archive->AddInt32( "month_days", ( int32 )rule.GetMonthDays() );
+	archive->AddInt16( "months", ( int16 )rule.GetMonths() );
+	archive->AddInt32( "count", rule.GetCount() );
+	archive->AddInt32( "until", rule.GetUntil() );
+}	// <-- end of function ArchiveRule
+
+
+
+/*!	\brief		Read the rule back from the message written by ArchiveRule().
+ */
+static status_t	InstantiateRule( const BMessage& archive, RecurrenceRule* rule )
+{
+	int8		frequency, weekdays, nthWeekday;
+	int16		interval, months;
+	int32		monthDays, count, until;
+
+	if ( archive.FindInt8( "frequency", &frequency ) != B_OK ||
+		  archive.FindInt16( "interval", &interval ) != B_OK ||
+		  archive.FindInt8( "weekdays", &weekdays ) != B_OK ||
+		  archive.FindInt8( "nth_weekday", &nthWeekday ) != B_OK ||
+		  archive.FindInt32( "month_days", &monthDays ) != B_OK ||
+		  archive.FindInt16( "months", &months ) != B_OK ||
+		  archive.FindInt32( "count", &count ) != B_OK ||
+		  archive.FindInt32( "until", &until ) != B_OK )
+	{
+		return B_BAD_DATA;
+	}
+	*rule = RecurrenceRule( ( RecurrenceFrequency )frequency, ( uint16 )interval );
+	rule->SetWeekdays( ( uint8 )weekdays );
+	rule->SetNthWeekday( nthWeekday );
+	rule->SetMonthDays( ( uint32 )monthDays );
+	rule->SetMonths( ( uint16 )months );
+	rule->SetCount( count );
+	rule->SetUntil( until );
+	return B_OK;
+}	// <-- end of function InstantiateRule
+
+
+
+/*!	\brief		Time the queries of typical rules.
+ */
+static bool		TimeQueries()
+{
+	std::vector< RecurrenceRule >	rules( kTimedRules );
+	std::vector< std::vector< uint8 > >	codes( kTimedRules );
+	std::vector< std::vector< char > >	archives( kTimedRules );
+	std::vector< int32 >	startDays( kTimedRules ), fromDays( kQueries );
+	RecurrenceRule	decoded;
+	BMessage		archive;
+	bigtime_t	start, structuredTime, codeTime, unflattenTime, messageTime;
+	int64			structuredSum = 0, codeSum = 0, unflattenSum = 0, messageSum = 0;
+	size_t		codeBytes = 0, archiveBytes = 0;
+	int32			n;
+
+	for ( int32 i = 0; i < kTimedRules; ++i )
+	{
+		MakeRule( &rules[ i ], true );
+		RecordWriter	writer;
+		CHECK( rules[ i ].Flatten( &writer ) == B_OK );
+		codes[ i ].assign( ( const uint8* )writer.Buffer(), ( const uint8* )writer.Buffer() + writer.Size() );
+		codeBytes += codes[ i ].size();
+
+		archive.MakeEmpty();
+		ArchiveRule( rules[ i ], &archive );
+		archives[ i ].resize( archive.FlattenedSize() );
+		CHECK( archive.Flatten( &archives[ i ][ 0 ], archives[ i ].size() ) == B_OK );
+		archiveBytes += archives[ i ].size();
+		startDays[ i ] = 14000 + ( int32 )( Random() % 2000 );
+	}
+	for ( int32 i = 0; i < kQueries; ++i ) {
+		fromDays[ i ] = 15000 + ( int32 )( Random() % 2000 );
+	}
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kQueries; ++i ) {
+		n = i % kTimedRules;
+		structuredSum += rules[ n ].NextDayOnOrAfter( startDays[ n ], fromDays[ i ] );
+	}
+	structuredTime = NowUsecs() - start;
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kQueries; ++i ) {
+		n = i % kTimedRules;
+		codeSum += RecurrenceRule::NextDayInCode( &codes[ n ][ 0 ], codes[ n ].size(),
+																startDays[ n ], fromDays[ i ] );
+	}
+	codeTime = NowUsecs() - start;
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kQueries; ++i ) {
+		n = i % kTimedRules;
+		RecordReader	reader( &codes[ n ][ 0 ], codes[ n ].size() );
+		decoded.Unflatten( &reader );
+		unflattenSum += decoded.NextDayOnOrAfter( startDays[ n ], fromDays[ i ] );
+	}
+	unflattenTime = NowUsecs() - start;
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kQueries; ++i ) {
+		n = i % kTimedRules;
+		archive.Unflatten( &archives[ n ][ 0 ] );
+		InstantiateRule( archive, &decoded );
+		messageSum += decoded.NextDayOnOrAfter( startDays[ n ], fromDays[ i ] );
+	}
+	messageTime = NowUsecs() - start;
+
+	CHECK( codeSum == structuredSum && unflattenSum == structuredSum && messageSum == structuredSum );
+
+	printf( "next occurrence of %d typical rules, %d queries (target %.0f ns):\n",
+			  ( int )kTimedRules, ( int )kQueries, kTargetNanoseconds );
+	printf( "  rules in memory:     %.1f ns per query\n", structuredTime * 1000.0 / kQueries );
+	printf( "  code, per query:     %.1f ns per query\n", codeTime * 1000.0 / kQueries );
+	printf( "  Unflatten and query: %.1f ns per query\n", unflattenTime * 1000.0 / kQueries );
+	printf( "  BMessage and query:  %.1f ns per query\n", messageTime * 1000.0 / kQueries );
+	printf( "stored size: %.1f bytes of code, %.1f bytes of BMessage per rule\n",
+			  ( double )codeBytes / kTimedRules, ( double )archiveBytes / kTimedRules );
+	return true;
+}	// <-- end of function TimeQueries
+
+
+
+int		main()
+{
+	if ( !CheckRoundTrip() || !CheckDamagedCode() || !TimeQueries() ) {
+		return 1;
+	}
+	return 0;
+}	// <-- end of function main
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		SchedulerStress.cpp
+ *	\brief		A million timers in the EventScheduler, with random snooze churn.
+ *	\details		First, the operations are timed: a million timers are scheduled, and
+ *					a million random snoozes, edits and deletions are applied to them.
+ *					Then the same scheduler is checked against a sorted reference while
+ *					the time goes on and the churn continues: every batch of due fires
+ *					must be exactly the reference entries that are due, in the order of
+ *					their deadlines. At the end, the scheduler is drained the same way.
+ */
+
+// Project includes
+#include "EventScheduler.h"
+#include "TestUtilities.h"
+
+// POSIX includes
+#include <stdio.h>
+
+// STL includes
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+
+/*!	\brief		Number of timers.
+ */
+const		int32		kTimers					= 1000000;
+
+
+/*!	\brief		Number of operations of the timed churn.
+ */
+const		int32		kTimedChurn				= 1000000;
+
+
+/*!	\brief		The checked part: rounds, and operations in every round.
+ */
+const		int32		kRounds					= 200;
+const		int32		kChurnPerRound			= 5000;
+
+
+const		time_t	kSecondsInMinute		= 60;
+const		time_t	kSecondsInHour			= 60 * 60;
+const		time_t	kSecondsInDay			= 24 * 60 * 60;
+const		time_t	kSecondsInYear			= 365 * kSecondsInDay;
+
+
+/*!	\brief		Deadline of a timer that is not in the scheduler.
+ */
+const		time_t	kNotScheduled			= -1;
+
+
+typedef	std::pair< time_t, int32 >		ReferenceEntry;		//!< Deadline and number of the timer.
+typedef	std::set< ReferenceEntry >		Reference;
+
+
+
+/*!	\brief		A deadline after \c now, on every level of the wheel.
+ *		\details		A tenth is due within a minute, and a tenth is more than a year
+ *						away, in the overflow list.
+ */
+static time_t		RandomDeadline( time_t now )
+{
+	uint32	kind = Random() % 10;
+
+	if ( kind == 0 ) {
+		return now + 1 + Random() % kSecondsInMinute;
+	} else if ( kind < 3 ) {
+		return now + 1 + Random() % kSecondsInHour;
+	} else if ( kind < 6 ) {
+		return now + 1 + Random() % kSecondsInDay;
+	} else if ( kind < 9 ) {
+		return now + 1 + Random() % kSecondsInYear;
+	}
+	return now + kSecondsInYear + Random() % ( 2 * kSecondsInYear );
+}	// <-- end of function RandomDeadline
+
+
+
+/*!	\brief		A snooze - from five minutes to a day after \c now.
+ */
+static time_t		SnoozeDeadline( time_t now )
+{
+	return now + 5 * kSecondsInMinute + Random() % kSecondsInDay;
+}	// <-- end of function SnoozeDeadline
+
+
+
+/*!	\brief		Node of the n-th timer.
+ */
+static node_ref	NodeOf( int32 n )
+{
+	node_ref		toReturn;
+
+	toReturn.device = 1;
+	toReturn.node = n;
+	return toReturn;
+}	// <-- end of function NodeOf
+
+
+
+/*!	\brief		The timers - their handles and deadlines, and the sorted reference.
+ */
+struct Timers {
+	EventScheduler		scheduler;
+	std::vector< ScheduledFire* >	handles;
+	std::vector< time_t >			deadlines;
+	Reference			reference;
+	bool					bReference;		//!< \c true if the reference is kept up to date.
+
+	Timers() : handles( kTimers, ( ScheduledFire* )NULL ),
+				  deadlines( kTimers, kNotScheduled ),
+				  bReference( false ) {}
+
+	void		Schedule( int32 n, time_t deadline ) {
+		handles[ n ] = scheduler.Schedule( NodeOf( n ), deadline, false );
+		deadlines[ n ] = deadline;
+		if ( bReference ) { reference.insert( ReferenceEntry( deadline, n ) ); }
+	}
+	void		Reschedule( int32 n, time_t deadline ) {
+		scheduler.Reschedule( handles[ n ], deadline );
+		if ( bReference ) {
+			reference.erase( ReferenceEntry( deadlines[ n ], n ) );
+			reference.insert( ReferenceEntry( deadline, n ) );
+		}
+		deadlines[ n ] = deadline;
+	}
+	void		Cancel( int32 n ) {
+		scheduler.Cancel( handles[ n ] );
+		handles[ n ] = NULL;
+		if ( bReference ) { reference.erase( ReferenceEntry( deadlines[ n ], n ) ); }
+		deadlines[ n ] = kNotScheduled;
+	}
+
+	/*!	\brief		One random operation: a snooze, an edit, a deletion or a new timer.
+	 */
+	void		Churn( time_t now ) {
+		int32		n = ( int32 )( Random() % kTimers );
+		uint32	kind = Random() % 10;
+
+		if ( !handles[ n ] ) {
+			Schedule( n, RandomDeadline( now ) );
+		} else if ( kind < 6 ) {
+			Reschedule( n, SnoozeDeadline( now ) );
+		} else if ( kind < 8 ) {
+			Reschedule( n, RandomDeadline( now ) );
+		} else {
+			Cancel( n );
+		}
+	}
+};
+
+
+
+/*!	\brief		Fire everything that is due, and compare it with the reference.
+ *		\returns		Number of fires, or -1 if they don't match.
+ */
+static int32		FireAndCheck( Timers* timers, time_t now )
+{
+	std::vector< ReferenceEntry >	fired, expected;
+	ScheduledFire*	fire;
+	Reference::iterator	it;
+	int32				n;
+
+	while ( NULL != ( fire = timers->scheduler.PopDue( now ) ) )
+	{
+		n = ( int32 )fire->node.node;
+		if ( fire->deadline > now || timers->handles[ n ] != fire ) {
+			printf( "FAILED: timer %d fired at %ld, its deadline is %ld\n",
+					  ( int )n, ( long )now, ( long )fire->deadline );
+			return -1;
+		}
+		if ( !fired.empty() && fired.back().first > fire->deadline ) {
+			printf( "FAILED: timer %d fired after a later one\n", ( int )n );
+			return -1;
+		}
+		fired.push_back( ReferenceEntry( fire->deadline, n ) );
+		timers->handles[ n ] = NULL;
+		timers->deadlines[ n ] = kNotScheduled;
+		timers->scheduler.Release( fire );
+	}
+
+	for ( it = timers->reference.begin();
+			it != timers->reference.end() && it->first <= now; ++it )
+	{
+		expected.push_back( *it );
+	}
+	timers->reference.erase( timers->reference.begin(), it );
+
+	// Fires with the same deadline may come in any order
+	std::sort( fired.begin(), fired.end() );
+	if ( fired != expected ) {
+		printf( "FAILED: at %ld, %d timers fired, %d were due\n",
+				  ( long )now, ( int )fired.size(), ( int )expected.size() );
+		return -1;
+	}
+
+	if ( timers->scheduler.CountItems() != ( int32 )timers->reference.size() ) {
+		printf( "FAILED: %d timers in the scheduler, %d in the reference\n",
+				  ( int )timers->scheduler.CountItems(), ( int )timers->reference.size() );
+		return -1;
+	}
+	if ( !timers->reference.empty() &&
+		  timers->scheduler.NextDeadline() != timers->reference.begin()->first )
+	{
+		printf( "FAILED: next deadline is %ld, expected %ld\n",
+				  ( long )timers->scheduler.NextDeadline(),
+				  ( long )timers->reference.begin()->first );
+		return -1;
+	}
+	return ( int32 )fired.size();
+}	// <-- end of function FireAndCheck
+
+
+
+int		main()
+{
+	Timers*		timers = new Timers;
+	time_t		now = 1000000000;
+	bigtime_t	start, scheduleTime, churnTime;
+	int32			fired, totalFired = 0;
+
+	timers->scheduler.Reset( now );
+
+	// The timed part - no reference is kept
+	start = NowUsecs();
+	for ( int32 i = 0; i < kTimers; ++i ) {
+		timers->Schedule( i, RandomDeadline( now ) );
+	}
+	scheduleTime = NowUsecs() - start;
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kTimedChurn; ++i ) {
+		timers->Churn( now );
+	}
+	churnTime = NowUsecs() - start;
+
+	printf( "schedule: %d timers, %.0f ns each\n",
+			  ( int )kTimers, scheduleTime * 1000.0 / kTimers );
+	printf( "churn: %d snoozes, edits and deletions, %.0f ns each\n",
+			  ( int )kTimedChurn, churnTime * 1000.0 / kTimedChurn );
+
+	// The checked part
+	for ( int32 i = 0; i < kTimers; ++i ) {
+		if ( timers->handles[ i ] ) {
+			timers->reference.insert( ReferenceEntry( timers->deadlines[ i ], i ) );
+		}
+	}
+	timers->bReference = true;
+
+	start = NowUsecs();
+	for ( int32 round = 0; round < kRounds; ++round )
+	{
+		// Mostly short steps; sometimes the computer sleeps for a few days
+		if ( round % 50 == 49 ) {
+			now += Random() % ( 5 * kSecondsInDay );
+		} else {
+			now += Random() % ( 10 * kSecondsInMinute );
+		}
+		if ( ( fired = FireAndCheck( timers, now ) ) < 0 ) { return 1; }
+		totalFired += fired;
+
+		for ( int32 i = 0; i < kChurnPerRound; ++i ) {
+			timers->Churn( now );
+		}
+	}
+
+	// Drain, an hour at a time
+	while ( !timers->scheduler.IsEmpty() ) {
+		now += kSecondsInHour;
+		if ( ( fired = FireAndCheck( timers, now ) ) < 0 ) { return 1; }
+		totalFired += fired;
+	}
+
+	printf( "checked: %d fires matched the sorted reference in %.1f s\n",
+			  ( int )totalFired, ( NowUsecs() - start ) / 1000000.0 );
+
+	delete timers;
+	return 0;
+}	// <-- end of function main
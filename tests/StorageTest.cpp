@@ -0,0 +1,297 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+/*!	\file		StorageTest.cpp
+ *	\brief		The same checks over every EventStorage that builds on this system.
+ *	\details		EventData uses a storage only through EventNode and EventStorage,
+ *					so every storage must behave the same way:
+ *					- attributes are written and read as a whole, keep their type, and
+ *					  are listed by name;
+ *					- the data (the note) is replaced as a whole, and read at offsets;
+ *					- time attributes are found by range;
+ *					- removed Events can't be opened.
+ *					MemoryEventStorage is checked everywhere; XattrEventStorage on
+ *					Linux, in a temporary directory. Each one is timed over a small
+ *					Event written and read back.
+ */
+
+// Project includes
+#include "EventStorage.h"
+#include "MemoryEventStorage.h"
+#include "TestUtilities.h"
+#include "XattrEventStorage.h"
+
+// OS includes
+#include <TypeConstants.h>
+
+// POSIX includes
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// STL includes
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+
+/*!	\brief		Number of Events in the range check.
+ */
+const		int32		kRangeEvents		= 50;
+
+
+/*!	\brief		Number of Events written and read back in the timed part.
+ */
+const		int32		kTimedEvents		= 500;
+
+
+static const char	kNote[] = "Don't forget the tickets.";
+
+
+/*!	\brief		Key of the n-th Event.
+ */
+static std::string	KeyOf( int32 n )
+{
+	char		buffer[ 32 ];
+
+	snprintf( buffer, sizeof( buffer ), "event-%d", ( int )n );
+	return std::string( buffer );
+}	// <-- end of function KeyOf
+
+
+
+/*!	\brief		Attributes and data of a single node.
+ */
+static bool		CheckNode( EventStorage* storage )
+{
+	EventNode*		node;
+	attr_info		info;
+	BString			string;
+	std::set< std::string >	names;
+	char				nameBuffer[ B_ATTR_NAME_LENGTH ];
+	char				buffer[ 64 ];
+	int32				value = 0x12345678, readValue = 0;
+	int64				time = 0;
+	off_t				size = -1;
+
+	// A key which was never written can't be opened for reading
+	node = storage->Open( "missing", B_READ_ONLY );
+	CHECK( node != NULL );
+	CHECK( node->InitCheck() != B_OK );
+	delete node;
+
+	node = storage->Open( "single", B_READ_WRITE | B_CREATE_FILE );
+	CHECK( node != NULL );
+	CHECK( node->InitCheck() == B_OK );
+
+	CHECK( node->WriteAttr( "EVNT:name", B_STRING_TYPE, "Concert", 8 ) == 8 );
+	CHECK( node->WriteAttr( "EVNT:type", B_INT32_TYPE, &value, sizeof( value ) ) == sizeof( value ) );
+	CHECK( node->WriteTimeAttr( "EVNT:start", 1300000000LL ) == B_OK );
+	CHECK( node->SetMimeType( "application/x-vnd.Hitech.Eventual-Event", NULL ) == B_OK );
+
+	// Values and types
+	CHECK( node->ReadAttrString( "EVNT:name", &string ) == B_OK );
+	CHECK( string == "Concert" );
+	CHECK( node->ReadAttr( "EVNT:type", B_INT32_TYPE, &readValue, sizeof( readValue ) ) == sizeof( readValue ) );
+	CHECK( readValue == value );
+	CHECK( node->ReadTimeAttr( "EVNT:start", &time ) == B_OK );
+	CHECK( time == 1300000000LL );
+	CHECK( node->GetAttrInfo( "EVNT:name", &info ) == B_OK );
+	CHECK( info.type == B_STRING_TYPE && info.size == 8 );
+	CHECK( node->GetAttrInfo( "EVNT:type", &info ) == B_OK );
+	CHECK( info.type == B_INT32_TYPE && info.size == sizeof( int32 ) );
+
+	// A value larger than the buffer is cut
+	CHECK( node->ReadAttr( "EVNT:name", B_STRING_TYPE, buffer, 3 ) == 3 );
+	CHECK( memcmp( buffer, "Con", 3 ) == 0 );
+
+	// Rewriting replaces the whole value
+	CHECK( node->WriteAttr( "EVNT:name", B_STRING_TYPE, "Gig", 4 ) == 4 );
+	CHECK( node->GetAttrInfo( "EVNT:name", &info ) == B_OK && info.size == 4 );
+
+	// Removed attributes are gone
+	CHECK( node->RemoveAttr( "EVNT:type" ) == B_OK );
+	CHECK( node->GetAttrInfo( "EVNT:type", &info ) != B_OK );
+	CHECK( node->ReadAttr( "EVNT:type", B_INT32_TYPE, &readValue, sizeof( readValue ) ) < 0 );
+	CHECK( node->RemoveAttr( "EVNT:type" ) != B_OK );
+
+	// Listing
+	CHECK( node->RewindAttrs() == B_OK );
+	while ( node->GetNextAttrName( nameBuffer ) == B_OK ) {
+		names.insert( nameBuffer );
+	}
+	CHECK( names.size() == 3 );
+	CHECK( names.count( "EVNT:name" ) == 1 );
+	CHECK( names.count( "EVNT:start" ) == 1 );
+	CHECK( names.count( "BEOS:TYPE" ) == 1 );
+
+	// Data
+	CHECK( node->GetSize( &size ) == B_OK && size == 0 );
+	CHECK( node->SetData( kNote, sizeof( kNote ) ) == B_OK );
+	CHECK( node->GetSize( &size ) == B_OK && size == sizeof( kNote ) );
+	CHECK( node->ReadAt( 6, buffer, 6 ) == 6 );
+	CHECK( memcmp( buffer, "forget", 6 ) == 0 );
+	CHECK( node->ReadAt( size - 2, buffer, sizeof( buffer ) ) == 2 );
+	CHECK( node->SetData( "Tickets", 7 ) == B_OK );
+	CHECK( node->GetSize( &size ) == B_OK && size == 7 );
+	CHECK( node->SetData( NULL, 0 ) == B_OK );
+	CHECK( node->GetSize( &size ) == B_OK && size == 0 );
+	CHECK( node->Commit() == B_OK );
+	delete node;
+
+	// Everything is there when the node is opened again
+	node = storage->Open( "single", B_READ_ONLY );
+	CHECK( node != NULL && node->InitCheck() == B_OK );
+	CHECK( node->ReadAttrString( "EVNT:name", &string ) == B_OK );
+	CHECK( string == "Gig" );
+	delete node;
+
+	// Updates of a single attribute, without a node
+	CHECK( storage->UpdateTimeAttr( "single", "EVNT:start", 1400000000LL ) == B_OK );
+	CHECK( storage->UpdateAttr( "single", "EVNT:where", B_STRING_TYPE, "Hall", 5 ) == B_OK );
+	node = storage->Open( "single", B_READ_ONLY );
+	CHECK( node != NULL && node->InitCheck() == B_OK );
+	CHECK( node->ReadTimeAttr( "EVNT:start", &time ) == B_OK && time == 1400000000LL );
+	CHECK( node->ReadAttrString( "EVNT:where", &string ) == B_OK && string == "Hall" );
+	delete node;
+
+	CHECK( storage->Remove( "single" ) == B_OK );
+	node = storage->Open( "single", B_READ_ONLY );
+	CHECK( node != NULL && node->InitCheck() != B_OK );
+	delete node;
+	CHECK( storage->Remove( "single" ) != B_OK );
+	return true;
+}	// <-- end of function CheckNode
+
+
+
+/*!	\brief		Find the Events by a time attribute.
+ */
+static bool		CheckRange( EventStorage* storage )
+{
+	std::vector< BString >		keys;
+	std::vector< std::string >	found, expected;
+	EventNode*		node;
+
+	for ( int32 i = 0; i < kRangeEvents; ++i ) {
+		node = storage->Open( KeyOf( i ).c_str(), B_READ_WRITE | B_CREATE_FILE );
+		CHECK( node != NULL && node->InitCheck() == B_OK );
+		CHECK( node->WriteTimeAttr( "EVNT:next_due", 1000 + i * 10 ) == B_OK );
+		CHECK( node->Commit() == B_OK );
+		delete node;
+	}
+
+	// From is included, to is not
+	CHECK( storage->ListByRange( "EVNT:next_due", 1100, 1200, &keys ) == B_OK );
+	for ( size_t i = 0; i < keys.size(); ++i ) {
+		found.push_back( keys[ i ].String() );
+	}
+	for ( int32 i = 10; i < 20; ++i ) {
+		expected.push_back( KeyOf( i ) );
+	}
+	std::sort( found.begin(), found.end() );
+	std::sort( expected.begin(), expected.end() );
+	CHECK( found == expected );
+
+	keys.clear();
+	CHECK( storage->ListByRange( "EVNT:no_such_attribute", 0, 1000000, &keys ) == B_OK );
+	CHECK( keys.empty() );
+
+	for ( int32 i = 0; i < kRangeEvents; ++i ) {
+		CHECK( storage->Remove( KeyOf( i ).c_str() ) == B_OK );
+	}
+	return true;
+}	// <-- end of function CheckRange
+
+
+
+/*!	\brief		Write small Events and read them back.
+ */
+static bool		TimeStorage( EventStorage* storage, const char* storageName )
+{
+	EventNode*		node;
+	BString			string;
+	int64				time;
+	bigtime_t		start, writeTime, readTime;
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kTimedEvents; ++i ) {
+		node = storage->Open( KeyOf( i ).c_str(), B_READ_WRITE | B_CREATE_FILE );
+		CHECK( node != NULL && node->InitCheck() == B_OK );
+		CHECK( node->WriteAttr( "EVNT:name", B_STRING_TYPE, "Concert", 8 ) == 8 );
+		CHECK( node->WriteTimeAttr( "EVNT:start", 1300000000LL + i ) == B_OK );
+		CHECK( node->WriteTimeAttr( "EVNT:next_due", 1300000000LL + i ) == B_OK );
+		CHECK( node->SetData( kNote, sizeof( kNote ) ) == B_OK );
+		CHECK( node->Commit() == B_OK );
+		delete node;
+	}
+	writeTime = NowUsecs() - start;
+
+	start = NowUsecs();
+	for ( int32 i = 0; i < kTimedEvents; ++i ) {
+		node = storage->Open( KeyOf( i ).c_str(), B_READ_ONLY );
+		CHECK( node != NULL && node->InitCheck() == B_OK );
+		CHECK( node->ReadAttrString( "EVNT:name", &string ) == B_OK );
+		CHECK( node->ReadTimeAttr( "EVNT:start", &time ) == B_OK && time == 1300000000LL + i );
+		delete node;
+	}
+	readTime = NowUsecs() - start;
+
+	for ( int32 i = 0; i < kTimedEvents; ++i ) {
+		CHECK( storage->Remove( KeyOf( i ).c_str() ) == B_OK );
+	}
+
+	printf( "%s: %.1f us to write an Event, %.1f us to read it\n", storageName,
+			  ( double )writeTime / kTimedEvents, ( double )readTime / kTimedEvents );
+	return true;
+}	// <-- end of function TimeStorage
+
+
+
+/*!	\brief		Run all checks on a storage.
+ */
+static bool		CheckStorage( EventStorage* storage, const char* storageName )
+{
+	if ( !CheckNode( storage ) || !CheckRange( storage ) ) {
+		printf( "FAILED: in %s\n", storageName );
+		return false;
+	}
+	return TimeStorage( storage, storageName );
+}	// <-- end of function CheckStorage
+
+
+
+int		main()
+{
+	MemoryEventStorage	memory;
+
+	if ( !CheckStorage( &memory, "MemoryEventStorage" ) ) { return 1; }
+	if ( memory.CountEvents() != 0 ) {
+		printf( "FAILED: %d Events left in MemoryEventStorage\n", ( int )memory.CountEvents() );
+		return 1;
+	}
+
+#ifdef __linux__
+	char		directory[] = "/tmp/EventStorageTest.XXXXXX";
+	bool		bPassed;
+
+	if ( !mkdtemp( directory ) ) {
+		printf( "FAILED: can't create a temporary directory\n" );
+		return 1;
+	}
+	{
+		XattrEventStorage	xattr( directory );
+
+		bPassed = CheckStorage( &xattr, "XattrEventStorage" );
+	}
+	rmdir( directory );
+	if ( !bPassed ) { return 1; }
+#endif
+
+	return 0;
+}	// <-- end of function main
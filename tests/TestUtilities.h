@@ -0,0 +1,60 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _TEST_UTILITIES_H_
+#define _TEST_UTILITIES_H_
+
+/*!	\file		TestUtilities.h
+ *	\brief		What all test programs use: the clock, the random numbers and the
+ *					checks.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <stdio.h>
+#include <sys/time.h>
+
+
+/*!	\brief		Check a condition inside a function returning \c bool.
+ *		\details		On failure, the line and the condition are printed, and the
+ *						function returns \c false.
+ */
+#define CHECK( condition ) \
+	do { \
+		if ( !( condition ) ) { \
+			printf( "FAILED: %s, line %d: %s\n", __FILE__, __LINE__, #condition ); \
+			return false; \
+		} \
+	} while ( 0 )
+
+
+
+/*!	\brief		Current time, in microseconds from UNIX epoch.
+ */
+inline bigtime_t	NowUsecs()
+{
+	struct timeval	now;
+
+	gettimeofday( &now, NULL );
+	return ( bigtime_t )now.tv_sec * 1000000LL + now.tv_usec;
+}	// <-- end of function NowUsecs
+
+
+
+/*!	\brief		Fast random numbers; the same on every system.
+ */
+inline uint32		Random()
+{
+	static uint32	state = 2463534242U;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}	// <-- end of function Random
+
+
+#endif // _TEST_UTILITIES_H_
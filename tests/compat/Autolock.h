@@ -0,0 +1,29 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_AUTOLOCK_H_
+#define _COMPAT_AUTOLOCK_H_
+
+/*!	\file		Autolock.h
+ *	\brief		BAutolock of the Haiku API, for building the tests on other systems.
+ */
+
+// OS includes
+#include <Locker.h>
+
+class BAutolock
+{
+public:
+	BAutolock( BLocker* locker ) : fLocker( locker ), bLocked( locker && locker->Lock() ) {}
+	BAutolock( BLocker& locker ) : fLocker( &locker ), bLocked( locker.Lock() ) {}
+	~BAutolock() { if ( bLocked ) { fLocker->Unlock(); } }
+
+	bool			IsLocked() const { return bLocked; }
+
+private:
+	BLocker*		fLocker;
+	bool			bLocked;
+};
+
+#endif // _COMPAT_AUTOLOCK_H_
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_BYTE_ORDER_H_
+#define _COMPAT_BYTE_ORDER_H_
+
+/*!	\file		ByteOrder.h
+ *	\brief		Byte order macros of the Haiku API, for building the tests on other systems.
+ */
+
+// POSIX includes
+#include <endian.h>
+
+#define B_HOST_TO_LENDIAN_INT16( value )		htole16( value )
+#define B_HOST_TO_LENDIAN_INT32( value )		htole32( value )
+#define B_HOST_TO_LENDIAN_INT64( value )		htole64( value )
+#define B_LENDIAN_TO_HOST_INT16( value )		le16toh( value )
+#define B_LENDIAN_TO_HOST_INT32( value )		le32toh( value )
+#define B_LENDIAN_TO_HOST_INT64( value )		le64toh( value )
+#define B_HOST_TO_BENDIAN_INT32( value )		htobe32( value )
+#define B_BENDIAN_TO_HOST_INT32( value )		be32toh( value )
+
+#endif // _COMPAT_BYTE_ORDER_H_
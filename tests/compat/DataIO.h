@@ -0,0 +1,54 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_DATA_IO_H_
+#define _COMPAT_DATA_IO_H_
+
+/*!	\file		DataIO.h
+ *	\brief		BMallocIO of the Haiku API, for building the tests on other systems.
+ *	\details		Only the functions the tested code uses are implemented, on top of
+ *					std::vector.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <string.h>
+#include <sys/types.h>
+
+// STL includes
+#include <vector>
+
+class BMallocIO
+{
+public:
+	BMallocIO() : fPosition( 0 ) {}
+
+	void				SetBlockSize( size_t blockSize ) { fData.reserve( blockSize ); }
+
+	ssize_t			Write( const void* buffer, size_t size ) {
+		ssize_t		written = WriteAt( fPosition, buffer, size );
+
+		if ( written > 0 ) { fPosition += written; }
+		return written;
+	}
+	ssize_t			WriteAt( off_t position, const void* buffer, size_t size ) {
+		if ( position < 0 || !buffer ) { return B_BAD_VALUE; }
+		if ( ( size_t )position + size > fData.size() ) {
+			fData.resize( ( size_t )position + size );
+		}
+		if ( size != 0 ) { memcpy( &fData[ ( size_t )position ], buffer, size ); }
+		return ( ssize_t )size;
+	}
+
+	const void*		Buffer() const { return fData.empty() ? NULL : &fData[ 0 ]; }
+	size_t			BufferLength() const { return fData.size(); }
+
+private:
+	std::vector< char >	fData;
+	off_t						fPosition;
+};
+
+#endif // _COMPAT_DATA_IO_H_
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_ERRORS_H_
+#define _COMPAT_ERRORS_H_
+
+/*!	\file		Errors.h
+ *	\brief		Error codes of the Haiku API, for building the tests on other systems.
+ *	\details		The values are the ones of Haiku. The POSIX errors are positive
+ *					here, so B_FROM_POSIX_ERROR() negates them.
+ */
+
+// POSIX includes
+#include <errno.h>
+#include <limits.h>
+
+#define B_GENERAL_ERROR_BASE		INT_MIN
+#define B_OS_ERROR_BASE				( B_GENERAL_ERROR_BASE + 0x1000 )
+#define B_STORAGE_ERROR_BASE		( B_GENERAL_ERROR_BASE + 0x6000 )
+
+#define B_FROM_POSIX_ERROR( error )		( -( error ) )
+#define B_TO_POSIX_ERROR( error )		( -( error ) )
+
+enum {
+	B_NO_MEMORY = B_GENERAL_ERROR_BASE,
+	B_IO_ERROR,
+	B_PERMISSION_DENIED,
+	B_BAD_INDEX,
+	B_BAD_TYPE,
+	B_BAD_VALUE,
+	B_MISMATCHED_VALUES,
+	B_NAME_NOT_FOUND,
+	B_NAME_IN_USE,
+	B_TIMED_OUT,
+	B_INTERRUPTED,
+	B_WOULD_BLOCK,
+	B_CANCELED,
+	B_NO_INIT,
+	B_NOT_INITIALIZED = B_NO_INIT,
+	B_BUSY,
+	B_NOT_ALLOWED,
+	B_BAD_DATA,
+	B_DONT_DO_THAT,
+
+	B_ERROR = -1,
+	B_OK = 0,
+	B_NO_ERROR = 0
+};
+
+enum {
+	B_BAD_SEM_ID = B_OS_ERROR_BASE,
+	B_NO_MORE_SEMS,
+
+	B_BAD_THREAD_ID = B_OS_ERROR_BASE + 0x100,
+	B_NO_MORE_THREADS,
+	B_BAD_THREAD_STATE
+};
+
+enum {
+	B_FILE_ERROR = B_STORAGE_ERROR_BASE,
+	B_FILE_NOT_FOUND,
+	B_FILE_EXISTS,
+	B_ENTRY_NOT_FOUND,
+	B_NAME_TOO_LONG,
+	B_NOT_A_DIRECTORY,
+	B_DIRECTORY_NOT_EMPTY,
+	B_DEVICE_FULL,
+	B_READ_ONLY_DEVICE,
+	B_IS_A_DIRECTORY,
+	B_NO_MORE_FDS,
+	B_CROSS_DEVICE_LINK,
+	B_LINK_LIMIT,
+	B_BUSTED_PIPE,
+	B_UNSUPPORTED,
+	B_PARTITION_TOO_SMALL
+};
+
+#define B_NOT_SUPPORTED			B_FROM_POSIX_ERROR( EOPNOTSUPP )
+#define B_BUFFER_OVERFLOW		B_FROM_POSIX_ERROR( EOVERFLOW )
+
+#endif // _COMPAT_ERRORS_H_
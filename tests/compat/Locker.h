@@ -0,0 +1,57 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_LOCKER_H_
+#define _COMPAT_LOCKER_H_
+
+/*!	\file		Locker.h
+ *	\brief		BLocker of the Haiku API, for building the tests on other systems.
+ *	\details		A recursive pthread mutex, like BLocker.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <pthread.h>
+
+class BLocker
+{
+public:
+	BLocker( const char* name = NULL ) {
+		pthread_mutexattr_t	attributes;
+
+		pthread_mutexattr_init( &attributes );
+		pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_RECURSIVE );
+		pthread_mutex_init( &fMutex, &attributes );
+		pthread_mutexattr_destroy( &attributes );
+		fOwner = 0;
+		fCount = 0;
+	}
+	~BLocker() { pthread_mutex_destroy( &fMutex ); }
+
+	bool			Lock() {
+		pthread_mutex_lock( &fMutex );
+		fOwner = pthread_self();
+		++fCount;
+		return true;
+	}
+	void			Unlock() {
+		if ( --fCount == 0 ) { fOwner = 0; }
+		pthread_mutex_unlock( &fMutex );
+	}
+	bool			IsLocked() const {
+		return ( fCount > 0 && pthread_equal( fOwner, pthread_self() ) );
+	}
+
+private:
+	BLocker( const BLocker& );
+	BLocker&		operator=( const BLocker& );
+
+	pthread_mutex_t	fMutex;
+	pthread_t			fOwner;
+	int32					fCount;
+};
+
+#endif // _COMPAT_LOCKER_H_
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_MESSAGE_H_
+#define _COMPAT_MESSAGE_H_
+
+/*!	\file		Message.h
+ *	\brief		BMessage of the Haiku API, for building the tests on other systems.
+ *	\details		Only the integer fields are implemented, one item per field, on
+ *					top of std::vector. The fields are found by their names, as in
+ *					Haiku; the flattened form is a count of the fields, then the type,
+ *					the name and the data of every field. It's simpler than the one of
+ *					Haiku, so it's read at least as fast.
+ */
+
+// OS includes
+#include <Errors.h>
+#include <SupportDefs.h>
+#include <TypeConstants.h>
+
+// POSIX includes
+#include <string.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+class BMessage
+{
+public:
+	BMessage() : what( 0 ) {}
+
+	status_t			AddInt8( const char* name, int8 value ) { return _Add( name, B_INT8_TYPE, &value, sizeof( value ) ); }
+	status_t			AddInt16( const char* name, int16 value ) { return _Add( name, B_INT16_TYPE, &value, sizeof( value ) ); }
+	status_t			AddInt32( const char* name, int32 value ) { return _Add( name, B_INT32_TYPE, &value, sizeof( value ) ); }
+
+	status_t			FindInt8( const char* name, int8* value ) const { return _Find( name, B_INT8_TYPE, value, sizeof( *value ) ); }
+	status_t			FindInt16( const char* name, int16* value ) const { return _Find( name, B_INT16_TYPE, value, sizeof( *value ) ); }
+	status_t			FindInt32( const char* name, int32* value ) const { return _Find( name, B_INT32_TYPE, value, sizeof( *value ) ); }
+
+	status_t			MakeEmpty() { fFields.clear(); return B_OK; }
+
+	ssize_t			FlattenedSize() const {
+		ssize_t	size = sizeof( uint32 ) * 2;
+		for ( size_t i = 0; i < fFields.size(); ++i ) {
+			size += sizeof( uint32 ) + 1 + fFields[ i ].name.size() + 1 + fFields[ i ].data.size();
+		}
+		return size;
+	}
+
+	status_t			Flatten( char* buffer, ssize_t size ) const {
+		uint32	count = ( uint32 )fFields.size();
+		if ( !buffer || size < FlattenedSize() ) { return B_BAD_VALUE; }
+		memcpy( buffer, &what, sizeof( uint32 ) );
+		memcpy( buffer + sizeof( uint32 ), &count, sizeof( uint32 ) );
+		buffer += sizeof( uint32 ) * 2;
+		for ( size_t i = 0; i < fFields.size(); ++i ) {
+			const Field&	field = fFields[ i ];
+			memcpy( buffer, &field.type, sizeof( uint32 ) );
+			buffer += sizeof( uint32 );
+			*buffer++ = ( char )field.name.size();
+			memcpy( buffer, field.name.data(), field.name.size() );
+			buffer += field.name.size();
+			*buffer++ = ( char )field.data.size();
+			memcpy( buffer, &field.data[ 0 ], field.data.size() );
+			buffer += field.data.size();
+		}
+		return B_OK;
+	}
+
+	status_t			Unflatten( const char* buffer ) {
+		uint32	count;
+		size_t	length;
+		if ( !buffer ) { return B_BAD_VALUE; }
+		fFields.clear();
+		memcpy( &what, buffer, sizeof( uint32 ) );
+		memcpy( &count, buffer + sizeof( uint32 ), sizeof( uint32 ) );
+		buffer += sizeof( uint32 ) * 2;
+		fFields.resize( count );
+		for ( uint32 i = 0; i < count; ++i ) {
+			Field&	field = fFields[ i ];
+			memcpy( &field.type, buffer, sizeof( uint32 ) );
+			buffer += sizeof( uint32 );
+			length = ( uint8 )*buffer++;
+			field.name.assign( buffer, length );
+			buffer += length;
+			length = ( uint8 )*buffer++;
+			field.data.assign( buffer, buffer + length );
+			buffer += length;
+		}
+		return B_OK;
+	}
+
+	uint32			what;
+
+private:
+	struct Field {
+		std::string				name;
+		type_code				type;
+		std::vector< char >	data;
+	};
+
+	status_t			_Add( const char* name, type_code type, const void* data, size_t size ) {
+		Field	field;
+		if ( !name ) { return B_BAD_VALUE; }
+		field.name = name;
+		field.type = type;
+		field.data.assign( ( const char* )data, ( const char* )data + size );
+		fFields.push_back( field );
+		return B_OK;
+	}
+
+	status_t			_Find( const char* name, type_code type, void* data, size_t size ) const {
+		if ( !name || !data ) { return B_BAD_VALUE; }
+		for ( size_t i = 0; i < fFields.size(); ++i ) {
+			if ( fFields[ i ].name == name ) {
+				if ( fFields[ i ].type != type || fFields[ i ].data.size() != size ) { return B_BAD_TYPE; }
+				memcpy( data, &fFields[ i ].data[ 0 ], size );
+				return B_OK;
+			}
+		}
+		return B_NAME_NOT_FOUND;
+	}
+
+	std::vector< Field >	fFields;
+};
+
+#endif // _COMPAT_MESSAGE_H_
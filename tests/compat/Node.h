@@ -0,0 +1,32 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_NODE_H_
+#define _COMPAT_NODE_H_
+
+/*!	\file		Node.h
+ *	\brief		node_ref of the Haiku API, for building the tests on other systems.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <sys/types.h>
+
+struct node_ref {
+	node_ref() : device( -1 ), node( -1 ) {}
+
+	bool operator==( const node_ref& other ) const {
+		return ( device == other.device && node == other.node );
+	}
+	bool operator!=( const node_ref& other ) const {
+		return !( *this == other );
+	}
+
+	dev_t		device;
+	ino_t		node;
+};
+
+#endif // _COMPAT_NODE_H_
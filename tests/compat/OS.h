@@ -0,0 +1,268 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_OS_H_
+#define _COMPAT_OS_H_
+
+/*!	\file		OS.h
+ *	\brief		Threads, semaphores and atomics of the Haiku API, for building the
+ *					tests on other systems.
+ *	\details		Threads and semaphores are built on pthreads, and are kept in
+ *					tables indexed by their ids. Threads are created suspended, as in
+ *					Haiku, and start when resume_thread() is called. Deleted semaphores
+ *					wake their waiters with \c B_BAD_SEM_ID.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// STL includes
+#include <vector>
+
+typedef	int32		sem_id;
+typedef	int32		thread_id;
+typedef	int32		( *thread_func )( void* );
+
+#define B_LOW_PRIORITY				5
+#define B_NORMAL_PRIORITY			10
+#define B_DISPLAY_PRIORITY			15
+#define B_URGENT_DISPLAY_PRIORITY	20
+#define B_REAL_TIME_PRIORITY		120
+
+
+/*!	\brief		A semaphore, and the table of all of them.
+ */
+struct CompatSem {
+	pthread_mutex_t	mutex;
+	pthread_cond_t		condition;
+	int32					count;
+	bool					bDeleted;
+};
+
+inline std::vector< CompatSem* >&	compat_sems()
+{
+	static std::vector< CompatSem* >	sems;
+	return sems;
+}
+
+inline pthread_mutex_t*		compat_table_lock()
+{
+	static pthread_mutex_t		lock = PTHREAD_MUTEX_INITIALIZER;
+	return &lock;
+}
+
+inline CompatSem*		compat_find_sem( sem_id id )
+{
+	CompatSem*		sem = NULL;
+
+	pthread_mutex_lock( compat_table_lock() );
+	if ( id >= 0 && ( size_t )id < compat_sems().size() ) {
+		sem = compat_sems()[ id ];
+	}
+	pthread_mutex_unlock( compat_table_lock() );
+	return sem;
+}
+
+inline sem_id		create_sem( int32 count, const char* name )
+{
+	CompatSem*		sem = new CompatSem;
+	sem_id			id;
+
+	pthread_mutex_init( &sem->mutex, NULL );
+	pthread_cond_init( &sem->condition, NULL );
+	sem->count = count;
+	sem->bDeleted = false;
+
+	pthread_mutex_lock( compat_table_lock() );
+	id = ( sem_id )compat_sems().size();
+	compat_sems().push_back( sem );
+	pthread_mutex_unlock( compat_table_lock() );
+	return id;
+}
+
+//! The semaphore itself is never freed, so that late callers see it deleted.
+inline status_t	delete_sem( sem_id id )
+{
+	CompatSem*		sem = compat_find_sem( id );
+
+	if ( !sem ) { return B_BAD_SEM_ID; }
+	pthread_mutex_lock( &sem->mutex );
+	if ( sem->bDeleted ) {
+		pthread_mutex_unlock( &sem->mutex );
+		return B_BAD_SEM_ID;
+	}
+	sem->bDeleted = true;
+	pthread_cond_broadcast( &sem->condition );
+	pthread_mutex_unlock( &sem->mutex );
+	return B_OK;
+}
+
+inline status_t	acquire_sem( sem_id id )
+{
+	CompatSem*		sem = compat_find_sem( id );
+	status_t			status = B_OK;
+
+	if ( !sem ) { return B_BAD_SEM_ID; }
+	pthread_mutex_lock( &sem->mutex );
+	while ( !sem->bDeleted && sem->count <= 0 ) {
+		pthread_cond_wait( &sem->condition, &sem->mutex );
+	}
+	if ( sem->bDeleted ) {
+		status = B_BAD_SEM_ID;
+	} else {
+		--sem->count;
+	}
+	pthread_mutex_unlock( &sem->mutex );
+	return status;
+}
+
+inline status_t	release_sem( sem_id id )
+{
+	CompatSem*		sem = compat_find_sem( id );
+	status_t			status = B_OK;
+
+	if ( !sem ) { return B_BAD_SEM_ID; }
+	pthread_mutex_lock( &sem->mutex );
+	if ( sem->bDeleted ) {
+		status = B_BAD_SEM_ID;
+	} else {
+		++sem->count;
+		pthread_cond_signal( &sem->condition );
+	}
+	pthread_mutex_unlock( &sem->mutex );
+	return status;
+}
+
+
+/*!	\brief		A thread, and the table of all of them.
+ */
+struct CompatThread {
+	thread_func		function;
+	void*				data;
+	pthread_t		thread;
+	bool				bStarted;
+	int32				exitValue;
+};
+
+inline std::vector< CompatThread* >&	compat_threads()
+{
+	static std::vector< CompatThread* >	threads;
+	return threads;
+}
+
+inline void*		compat_thread_entry( void* data )
+{
+	CompatThread*	thread = ( CompatThread* )data;
+
+	thread->exitValue = thread->function( thread->data );
+	return NULL;
+}
+
+inline thread_id	spawn_thread( thread_func function, const char* name, int32 priority, void* data )
+{
+	CompatThread*	thread;
+	thread_id		id;
+
+	if ( !function ) { return B_BAD_VALUE; }
+	thread = new CompatThread;
+	thread->function = function;
+	thread->data = data;
+	thread->bStarted = false;
+	thread->exitValue = B_OK;
+
+	pthread_mutex_lock( compat_table_lock() );
+	id = ( thread_id )compat_threads().size();
+	compat_threads().push_back( thread );
+	pthread_mutex_unlock( compat_table_lock() );
+	return id;
+}
+
+inline CompatThread*		compat_find_thread( thread_id id )
+{
+	CompatThread*	thread = NULL;
+
+	pthread_mutex_lock( compat_table_lock() );
+	if ( id >= 0 && ( size_t )id < compat_threads().size() ) {
+		thread = compat_threads()[ id ];
+	}
+	pthread_mutex_unlock( compat_table_lock() );
+	return thread;
+}
+
+inline status_t	resume_thread( thread_id id )
+{
+	CompatThread*	thread = compat_find_thread( id );
+
+	if ( !thread ) { return B_BAD_THREAD_ID; }
+	if ( thread->bStarted ) { return B_BAD_THREAD_STATE; }
+	if ( pthread_create( &thread->thread, NULL, compat_thread_entry, thread ) != 0 ) {
+		return B_NO_MORE_THREADS;
+	}
+	thread->bStarted = true;
+	return B_OK;
+}
+
+//! Only the threads that were not resumed can be killed here.
+inline status_t	kill_thread( thread_id id )
+{
+	CompatThread*	thread = compat_find_thread( id );
+
+	if ( !thread ) { return B_BAD_THREAD_ID; }
+	return thread->bStarted ? B_NOT_ALLOWED : B_OK;
+}
+
+inline status_t	wait_for_thread( thread_id id, status_t* exitValue )
+{
+	CompatThread*	thread = compat_find_thread( id );
+
+	if ( !thread || !thread->bStarted ) { return B_BAD_THREAD_ID; }
+	if ( pthread_join( thread->thread, NULL ) != 0 ) { return B_BAD_THREAD_ID; }
+	thread->bStarted = false;
+	if ( exitValue ) { *exitValue = thread->exitValue; }
+	return B_OK;
+}
+
+
+inline int32		atomic_add( int32* value, int32 addValue ) { return __sync_fetch_and_add( value, addValue ); }
+inline int32		atomic_get( int32* value ) { return __sync_fetch_and_add( value, 0 ); }
+inline int32		atomic_set( int32* value, int32 newValue ) { return __sync_lock_test_and_set( value, newValue ); }
+inline int32		atomic_test_and_set( int32* value, int32 newValue, int32 testAgainst )
+{
+	return __sync_val_compare_and_swap( value, testAgainst, newValue );
+}
+
+/*!	\brief		The part of the system information the tested code uses.
+ */
+struct system_info {
+	uint32			cpu_count;
+};
+
+inline status_t	get_system_info( system_info* info )
+{
+	long		count = sysconf( _SC_NPROCESSORS_ONLN );
+
+	if ( !info ) { return B_BAD_VALUE; }
+	info->cpu_count = ( count > 0 ) ? ( uint32 )count : 1;
+	return B_OK;
+}
+
+inline bigtime_t	system_time()
+{
+	struct timeval		now;
+
+	gettimeofday( &now, NULL );
+	return ( bigtime_t )now.tv_sec * 1000000LL + now.tv_usec;
+}
+
+inline status_t	snooze( bigtime_t amount )
+{
+	return ( usleep( ( useconds_t )amount ) == 0 ) ? B_OK : B_INTERRUPTED;
+}
+
+#endif // _COMPAT_OS_H_
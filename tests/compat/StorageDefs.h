@@ -0,0 +1,29 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_STORAGE_DEFS_H_
+#define _COMPAT_STORAGE_DEFS_H_
+
+/*!	\file		StorageDefs.h
+ *	\brief		Open modes and limits of the Haiku API, for building the tests on other systems.
+ */
+
+// POSIX includes
+#include <fcntl.h>
+
+#define B_FILE_NAME_LENGTH		256
+#define B_PATH_NAME_LENGTH		1024
+#define B_ATTR_NAME_LENGTH		( B_FILE_NAME_LENGTH - 1 )
+
+enum {
+	B_READ_ONLY				= O_RDONLY,
+	B_WRITE_ONLY			= O_WRONLY,
+	B_READ_WRITE			= O_RDWR,
+	B_FAIL_IF_EXISTS		= O_EXCL,
+	B_CREATE_FILE			= O_CREAT,
+	B_ERASE_FILE			= O_TRUNC,
+	B_OPEN_AT_END			= O_APPEND
+};
+
+#endif // _COMPAT_STORAGE_DEFS_H_
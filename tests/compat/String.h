@@ -0,0 +1,69 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_STRING_H_
+#define _COMPAT_STRING_H_
+
+/*!	\file		String.h
+ *	\brief		BString of the Haiku API, for building the tests on other systems.
+ *	\details		Only the functions the tested code uses are implemented, on top of
+ *					std::string.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <string.h>
+
+// STL includes
+#include <string>
+
+class BString
+{
+public:
+	BString() {}
+	BString( const char* string ) : fData( string ? string : "" ) {}
+	BString( const char* string, int32 maxLength )
+		: fData( string ? string : "", string ? strnlen( string, maxLength ) : 0 ) {}
+
+	const char*		String() const { return fData.c_str(); }
+	int32				Length() const { return ( int32 )fData.size(); }
+
+	BString&			SetTo( const char* string ) { fData = string ? string : ""; return *this; }
+	BString&			SetTo( const char* string, int32 maxLength ) {
+		fData.assign( string ? string : "", string ? strnlen( string, maxLength ) : 0 );
+		return *this;
+	}
+	BString&			Truncate( int32 newLength ) {
+		if ( newLength < Length() ) { fData.resize( newLength ); }
+		return *this;
+	}
+
+	char*				LockBuffer( int32 maxLength ) {
+		if ( maxLength > Length() ) { fData.resize( maxLength ); }
+		fData.push_back( '\0' );
+		return &fData[ 0 ];
+	}
+	BString&			UnlockBuffer( int32 length = -1 ) {
+		if ( length < 0 ) { length = ( int32 )strlen( fData.c_str() ); }
+		fData.resize( length );
+		return *this;
+	}
+
+	BString&			operator=( const char* string ) { return SetTo( string ); }
+	BString&			operator<<( const char* string ) { fData += string ? string : ""; return *this; }
+	BString&			operator<<( const BString& string ) { fData += string.fData; return *this; }
+
+	bool				operator==( const BString& other ) const { return fData == other.fData; }
+	bool				operator!=( const BString& other ) const { return fData != other.fData; }
+	bool				operator<( const BString& other ) const { return fData < other.fData; }
+	bool				operator==( const char* other ) const { return fData == ( other ? other : "" ); }
+	bool				operator!=( const char* other ) const { return !( *this == other ); }
+
+private:
+	std::string		fData;
+};
+
+#endif // _COMPAT_STRING_H_
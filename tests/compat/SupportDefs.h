@@ -0,0 +1,37 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_SUPPORT_DEFS_H_
+#define _COMPAT_SUPPORT_DEFS_H_
+
+/*!	\file		SupportDefs.h
+ *	\brief		The basic types of the Haiku API, for building the tests on other systems.
+ *	\details		Only what the tested code uses is declared.
+ */
+
+// POSIX includes
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef	int8_t			int8;
+typedef	uint8_t			uint8;
+typedef	int16_t			int16;
+typedef	uint16_t			uint16;
+typedef	int32_t			int32;
+typedef	uint32_t			uint32;
+typedef	int64_t			int64;
+typedef	uint64_t			uint64;
+
+typedef	int32				status_t;
+typedef	int64				bigtime_t;
+typedef	uint32			type_code;
+
+#include <Errors.h>
+
+#ifndef NULL
+#define NULL	0
+#endif
+
+#endif // _COMPAT_SUPPORT_DEFS_H_
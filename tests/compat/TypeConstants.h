@@ -0,0 +1,24 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_TYPE_CONSTANTS_H_
+#define _COMPAT_TYPE_CONSTANTS_H_
+
+/*!	\file		TypeConstants.h
+ *	\brief		Type codes of the Haiku API, for building the tests on other systems.
+ */
+
+enum {
+	B_INT8_TYPE				= 'BYTE',
+	B_INT16_TYPE			= 'SHRT',
+	B_INT32_TYPE			= 'LONG',
+	B_INT64_TYPE			= 'LLNG',
+	B_MIME_STRING_TYPE	= 'MIMS',
+	B_RAW_TYPE				= 'RAWT',
+	B_STRING_TYPE			= 'CSTR',
+	B_UINT32_TYPE			= 'ULNG',
+	B_UINT64_TYPE			= 'ULLG'
+};
+
+#endif // _COMPAT_TYPE_CONSTANTS_H_
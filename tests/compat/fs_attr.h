@@ -0,0 +1,23 @@
+/*
+ * Copyright 2011 Alexey Burshtein <aburst02@campus.haifa.ac.il>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef _COMPAT_FS_ATTR_H_
+#define _COMPAT_FS_ATTR_H_
+
+/*!	\file		fs_attr.h
+ *	\brief		attr_info of the Haiku API, for building the tests on other systems.
+ */
+
+// OS includes
+#include <SupportDefs.h>
+
+// POSIX includes
+#include <sys/types.h>
+
+struct attr_info {
+	uint32		type;
+	off_t			size;
+};
+
+#endif // _COMPAT_FS_ATTR_H_